@@ -0,0 +1,339 @@
+// Linuxify Cron Scheduler
+// Every job's next fire time is computed from its fields and kept in a min-heap, so the
+// daemon sleeps until the earliest deadline (or until the job set is replaced) instead
+// of waking every second and testing every job. Due jobs are started from a small
+// worker pool and the scheduler thread never runs one itself; a worker is held only
+// while a run starts, and the run reports its end through a callback, so no number of
+// long-running jobs can make the daemon miss the next minute. A job that fires while
+// its previous run is still going is skipped, queued behind it, or started alongside
+// it, according to its overlap policy.
+
+#ifndef LINUXIFY_CRON_SCHEDULE_HPP
+#define LINUXIFY_CRON_SCHEDULE_HPP
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include "work_pool.hpp"
+
+// ============================================================================
+// Cron Job Structure
+// ============================================================================
+
+struct CronField {
+    bool isWildcard = false;
+    std::set<int> values;
+
+    bool matches(int value) const {
+        if (isWildcard) return true;
+        return values.count(value) > 0;
+    }
+
+    // Smallest matching value >= from, or -1
+    int nextFrom(int from) const {
+        if (isWildcard) return from;
+        auto it = values.lower_bound(from);
+        return it == values.end() ? -1 : *it;
+    }
+};
+
+// What to do when a job fires while its previous run has not finished
+enum class OverlapPolicy {
+    Parallel,  // start another run (classic cron)
+    Skip,      // drop this run
+    Queue      // run again as soon as the current run ends
+};
+
+struct CronJob {
+    CronField minute;      // 0-59
+    CronField hour;        // 0-23
+    CronField dayOfMonth;  // 1-31
+    CronField month;       // 1-12
+    CronField dayOfWeek;   // 0-6 (Sunday = 0)
+    std::string command;
+    bool isReboot = false;  // @reboot job
+    std::string rawLine;    // Original line for display
+    OverlapPolicy overlap = OverlapPolicy::Parallel;
+};
+
+namespace CronSchedule {
+
+    // Longest single sleep; bounds how late a wakeup can be after a clock change or suspend
+    constexpr int MAX_SLEEP_SECS = 300;
+    // nextFireTime gives up on schedules with no match this far ahead (e.g. 30 February)
+    constexpr time_t MAX_LOOKAHEAD_SECS = 5 * 366 * 24 * 3600;
+
+    inline std::tm localTime(time_t t) {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        return tm;
+    }
+
+    inline bool matches(const CronJob& job, const std::tm& tm) {
+        if (job.isReboot) return false;
+
+        return job.minute.matches(tm.tm_min) &&
+               job.hour.matches(tm.tm_hour) &&
+               job.dayOfMonth.matches(tm.tm_mday) &&
+               job.month.matches(tm.tm_mon + 1) &&
+               job.dayOfWeek.matches(tm.tm_wday);
+    }
+
+    // First whole minute strictly after `after` at which the job fires (local time),
+    // or 0 if it never does. Skips whole months, days and hours that cannot match
+    // rather than stepping minute by minute.
+    inline time_t nextFireTime(const CronJob& job, time_t after) {
+        if (job.isReboot) return 0;
+        for (const CronField* f : { &job.minute, &job.hour, &job.dayOfMonth, &job.month, &job.dayOfWeek }) {
+            if (!f->isWildcard && f->values.empty()) return 0;
+        }
+
+        std::tm tm = localTime(after);
+        tm.tm_sec = 0;
+        tm.tm_min++;
+
+        for (;;) {
+            std::tm want = tm;
+            want.tm_isdst = -1;
+            time_t t = mktime(&want);  // normalizes overflowed fields
+            if (t != (time_t)-1 && t <= after) {
+                // A wall-clock time repeated by a DST change; take its later occurrence
+                want = tm;
+                want.tm_isdst = 0;
+                t = mktime(&want);
+            }
+            if (t == (time_t)-1 || t - after > MAX_LOOKAHEAD_SECS) return 0;
+            if (t <= after) {
+                tm.tm_hour++;
+                tm.tm_min = 0;
+                continue;
+            }
+            tm = localTime(t);
+
+            if (!job.month.matches(tm.tm_mon + 1)) {
+                tm.tm_mon++;
+                tm.tm_mday = 1;
+                tm.tm_hour = 0;
+                tm.tm_min = 0;
+            } else if (!job.dayOfMonth.matches(tm.tm_mday) || !job.dayOfWeek.matches(tm.tm_wday)) {
+                tm.tm_mday++;
+                tm.tm_hour = 0;
+                tm.tm_min = 0;
+            } else if (!job.hour.matches(tm.tm_hour)) {
+                int h = job.hour.nextFrom(tm.tm_hour);
+                if (h < 0) {
+                    tm.tm_mday++;
+                    tm.tm_hour = 0;
+                } else {
+                    tm.tm_hour = h;
+                }
+                tm.tm_min = 0;
+            } else if (!job.minute.matches(tm.tm_min)) {
+                int m = job.minute.nextFrom(tm.tm_min);
+                if (m < 0) {
+                    tm.tm_hour++;
+                    tm.tm_min = 0;
+                } else {
+                    tm.tm_min = m;
+                }
+            } else {
+                return t;
+            }
+        }
+    }
+
+    class Scheduler {
+    public:
+        // Called when a run has ended; safe from any thread, must be called exactly once
+        using Done = std::function<void()>;
+        // Starts one run of a job on a worker thread. It should return once the run is
+        // started and call Done when it ends, without holding the worker in between.
+        using Runner = std::function<void(const CronJob&, Done)>;
+        using Logger = std::function<void(const std::string&)>;
+
+    private:
+        struct JobState {
+            CronJob job;
+            size_t running = 0;
+            size_t queued = 0;  // runs waiting behind the current one (Queue policy)
+        };
+
+        struct Due {
+            time_t when;
+            size_t slot;
+            bool operator>(const Due& o) const { return when != o.when ? when > o.when : slot > o.slot; }
+        };
+
+        Runner runner;
+        Logger log;
+        std::vector<std::shared_ptr<JobState>> jobs;
+        std::priority_queue<Due, std::vector<Due>, std::greater<Due>> heap;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopping = false;
+        bool changed = false;   // job set replaced; the sleeping loop must look again
+        size_t runningTotal = 0;
+        WorkPool::WorkStealingPool pool;  // last member: joined before the rest is destroyed
+
+        // Called with mtx held
+        void launch(const std::shared_ptr<JobState>& st) {
+            st->running++;
+            runningTotal++;
+            CronJob job = st->job;  // st->job may be replaced by a reload while this runs
+            pool.submit([this, st, job] {
+                bool skip;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    skip = stopping;
+                }
+                if (skip) {
+                    finished(st);
+                } else {
+                    runner(job, [this, st] { finished(st); });
+                }
+            });
+        }
+
+        // A run of st has ended; starts the next queued run, if any
+        void finished(const std::shared_ptr<JobState>& st) {
+            std::lock_guard<std::mutex> lock(mtx);
+            st->running--;
+            runningTotal--;
+            if (st->queued > 0 && !stopping) {
+                st->queued--;
+                launch(st);
+            }
+        }
+
+        // Called with mtx held
+        void dispatch(const std::shared_ptr<JobState>& st) {
+            if (st->running > 0) {
+                if (st->job.overlap == OverlapPolicy::Skip) {
+                    log("Skipped (previous run still active): " + st->job.command);
+                    return;
+                }
+                if (st->job.overlap == OverlapPolicy::Queue) {
+                    st->queued++;
+                    log("Queued behind the previous run: " + st->job.command);
+                    return;
+                }
+            }
+            launch(st);
+        }
+
+    public:
+        Scheduler(size_t workers, Runner run, Logger logger)
+            : runner(std::move(run)), log(std::move(logger)), pool(workers) {}
+
+        ~Scheduler() {
+            stop();
+        }
+
+        // Replaces the job set and reschedules everything from now. A job whose line is
+        // unchanged keeps its overlap bookkeeping, so a reload does not let it run twice.
+        void setJobs(const std::vector<CronJob>& newJobs) {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            std::map<std::string, std::shared_ptr<JobState>> previous;
+            for (auto& st : jobs) previous[st->job.rawLine] = st;
+
+            jobs.clear();
+            heap = {};
+            time_t now = time(nullptr);
+            for (const auto& job : newJobs) {
+                std::shared_ptr<JobState> st;
+                auto it = previous.find(job.rawLine);
+                if (it != previous.end()) {
+                    st = it->second;
+                    previous.erase(it);
+                } else {
+                    st = std::make_shared<JobState>();
+                }
+                st->job = job;
+                if (job.overlap != OverlapPolicy::Queue) st->queued = 0;
+                jobs.push_back(st);
+
+                if (time_t next = nextFireTime(job, now)) heap.push({ next, jobs.size() - 1 });
+            }
+            // Removed jobs keep running to completion but are not queued again
+            for (auto& kv : previous) kv.second->queued = 0;
+
+            changed = true;
+            cv.notify_all();
+        }
+
+        // Dispatches every @reboot job once
+        void runRebootJobs() {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& st : jobs) {
+                if (st->job.isReboot) {
+                    log("Running @reboot job: " + st->job.command);
+                    dispatch(st);
+                }
+            }
+        }
+
+        // Sleeps until the earliest deadline and dispatches what is due, until stop()
+        void run() {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!stopping) {
+                auto wake = std::chrono::system_clock::now() + std::chrono::seconds(MAX_SLEEP_SECS);
+                if (!heap.empty()) {
+                    wake = std::min(wake, std::chrono::system_clock::from_time_t(heap.top().when));
+                }
+                if (cv.wait_until(lock, wake, [&] { return stopping || changed; })) {
+                    changed = false;
+                    continue;
+                }
+
+                // After a late wakeup (suspend, clock change) each job fires once, not once
+                // per missed minute
+                time_t now = time(nullptr);
+                while (!heap.empty() && heap.top().when <= now) {
+                    Due due = heap.top();
+                    heap.pop();
+                    auto& st = jobs[due.slot];
+                    dispatch(st);
+                    if (time_t next = nextFireTime(st->job, std::max(due.when, now))) {
+                        heap.push({ next, due.slot });
+                    }
+                }
+            }
+        }
+
+        // Ends run(); runs not yet started are dropped. Runs already started may still
+        // call Done, which is safe until the Scheduler is destroyed.
+        void stop() {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+            for (auto& st : jobs) st->queued = 0;
+            cv.notify_all();
+        }
+
+        size_t jobCount() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return jobs.size();
+        }
+
+        size_t runningCount() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return runningTotal;
+        }
+    };
+
+} // namespace CronSchedule
+
+#endif // LINUXIFY_CRON_SCHEDULE_HPP
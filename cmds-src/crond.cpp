@@ -13,7 +13,12 @@
 #include <filesystem>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <memory>
 #include <iomanip>
+#include <chrono>
+#include "cron_schedule.hpp"
+#include "file_watch.hpp"
 
 namespace fs = std::filesystem;
 
@@ -23,43 +28,30 @@ namespace fs = std::filesystem;
 
 const char* PIPE_NAME = "\\\\.\\pipe\\LinuxifyCrond";
 const char* CROND_MUTEX = "Global\\LinuxifyCrondMutex";
-const int POLL_INTERVAL_SECS = 60;
-
-// ============================================================================
-// Cron Job Structure
-// ============================================================================
-
-struct CronField {
-    bool isWildcard = false;
-    std::set<int> values;
-    
-    bool matches(int value) const {
-        if (isWildcard) return true;
-        return values.count(value) > 0;
-    }
-};
-
-struct CronJob {
-    CronField minute;      // 0-59
-    CronField hour;        // 0-23
-    CronField dayOfMonth;  // 1-31
-    CronField month;       // 1-12
-    CronField dayOfWeek;   // 0-6 (Sunday = 0)
-    std::string command;
-    bool isReboot = false;  // @reboot job
-    std::string rawLine;    // Original line for display
-};
+const int LAUNCH_THREADS = 4;  // start job processes; exits are waited for by the system thread pool
 
 // ============================================================================
 // Global State
 // ============================================================================
 
-std::vector<CronJob> g_jobs;
+std::unique_ptr<CronSchedule::Scheduler> g_scheduler;
 std::atomic<bool> g_running{true};
 std::string g_linuxdbPath;
 std::string g_crontabPath;
 std::string g_logPath;
 HANDLE g_mutex = NULL;
+std::mutex g_logMutex;
+
+// What the last crontab load did; reported by LIST
+struct ReloadState {
+    uint64_t generation = 0;           // bumped every time a job table is swapped in
+    double parseMs = 0;
+    time_t loadedAt = 0;
+    size_t jobCount = 0;
+    std::vector<std::string> errors;   // from the latest parse, applied or not
+};
+ReloadState g_reload;
+std::mutex g_reloadMutex;  // the watcher and IPC threads may both reload
 
 // ============================================================================
 // Utility Functions
@@ -79,6 +71,7 @@ std::string getLinuxdbPath() {
 }
 
 void logMessage(const std::string& msg) {
+    std::lock_guard<std::mutex> lock(g_logMutex);
     std::ofstream log(g_logPath, std::ios::app);
     if (log) {
         time_t now = time(nullptr);
@@ -104,14 +97,13 @@ void printUsage() {
 // ============================================================================
 
 std::map<std::string, std::string> g_registry;  // command -> path
-std::string g_registryPath;
+std::string g_registryPath;  // set once in main, before any thread starts
+std::mutex g_registryMutex;  // jobs look up interpreters on worker threads
 
+// Parsed into a fresh map, then swapped in, so lookups never see a half-read registry
 void loadRegistry() {
-    g_registry.clear();
-    g_registryPath = g_linuxdbPath + "\\registry.lin";
-    
+    std::map<std::string, std::string> registry;
     std::ifstream file(g_registryPath);
-    if (!file) return;
     
     std::string line;
     while (std::getline(file, line)) {
@@ -129,19 +121,27 @@ void loadRegistry() {
             path.erase(path.find_last_not_of(" \t\r\n") + 1);
             
             if (!cmd.empty() && !path.empty()) {
-                g_registry[cmd] = path;
+                registry[cmd] = path;
             }
         }
     }
     
-    logMessage("Registry loaded: " + std::to_string(g_registry.size()) + " interpreters");
+    size_t count = registry.size();
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        g_registry.swap(registry);
+    }
+    logMessage("Registry loaded: " + std::to_string(count) + " interpreters");
 }
 
 std::string lookupInterpreter(const std::string& name) {
     // Check registry first
-    auto it = g_registry.find(name);
-    if (it != g_registry.end() && fs::exists(it->second)) {
-        return it->second;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        auto it = g_registry.find(name);
+        if (it != g_registry.end() && fs::exists(it->second)) {
+            return it->second;
+        }
     }
     
     // Check if it's in the cmds folder (like lish)
@@ -189,6 +189,7 @@ CronField parseField(const std::string& field, int minVal, int maxVal) {
     if (stepPos != std::string::npos) {
         step = std::stoi(field.substr(stepPos + 1));
         baseField = field.substr(0, stepPos);
+        if (step <= 0) throw std::invalid_argument(field);
     }
     
     if (baseField == "*") {
@@ -318,43 +319,177 @@ bool parseCronLine(const std::string& line, CronJob& job) {
     }
 }
 
-void loadCrontab() {
-    g_jobs.clear();
-    
+// "OVERLAP=skip|queue|parallel" sets the policy for the entries that follow it;
+// false if the line is not an OVERLAP line, error set if the value is unknown
+bool parseOverlapLine(const std::string& line, OverlapPolicy& policy, std::string& error) {
+    std::string trimmed = line;
+    trimmed.erase(0, trimmed.find_first_not_of(" \t"));
+    trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
+    if (trimmed.compare(0, 8, "OVERLAP=") != 0) return false;
+    
+    std::string value = trimmed.substr(8);
+    if (value == "skip") policy = OverlapPolicy::Skip;
+    else if (value == "queue") policy = OverlapPolicy::Queue;
+    else if (value == "parallel") policy = OverlapPolicy::Parallel;
+    else error = "unknown OVERLAP value '" + value + "'";
+    return true;
+}
+
+// Every entry of the crontab, plus "line N: ..." for each line that is not a comment
+// and does not parse (a missing crontab is an empty one)
+void parseCrontab(std::vector<CronJob>& jobs, std::vector<std::string>& errors) {
     std::ifstream file(g_crontabPath);
-    if (!file) {
-        logMessage("No crontab file found");
-        return;
-    }
     
     std::string line;
     int lineNum = 0;
+    OverlapPolicy overlap = OverlapPolicy::Parallel;
     while (std::getline(file, line)) {
         lineNum++;
-        CronJob job;
-        if (parseCronLine(line, job)) {
-            g_jobs.push_back(job);
+        std::string error;
+        
+        size_t start = line.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos || line[start] == '#') continue;
+        
+        if (!parseOverlapLine(line, overlap, error)) {
+            CronJob job;
+            if (!parseCronLine(line, job)) {
+                error = "cannot parse '" + job.rawLine + "'";
+            } else if (!job.isReboot &&
+                       ((!job.minute.isWildcard && job.minute.values.empty()) ||
+                        (!job.hour.isWildcard && job.hour.values.empty()) ||
+                        (!job.dayOfMonth.isWildcard && job.dayOfMonth.values.empty()) ||
+                        (!job.month.isWildcard && job.month.values.empty()) ||
+                        (!job.dayOfWeek.isWildcard && job.dayOfWeek.values.empty()))) {
+                error = "value out of range in '" + job.rawLine + "'";
+            } else {
+                job.overlap = overlap;
+                jobs.push_back(job);
+            }
+        }
+        
+        if (!error.empty()) {
+            errors.push_back("line " + std::to_string(lineNum) + ": " + error);
         }
     }
+}
+
+// Parses the crontab and swaps the whole job table into the scheduler at once. A
+// crontab with errors is not applied while an earlier one is running (a half-saved
+// or mistyped file must not silently drop jobs); the first load takes what parsed.
+// Returns the IPC reply.
+std::string reloadCrontab() {
+    std::lock_guard<std::mutex> lock(g_reloadMutex);
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<CronJob> jobs;
+    std::vector<std::string> errors;
+    parseCrontab(jobs, errors);
+    double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    g_reload.errors = errors;
+    for (const auto& e : errors) {
+        logMessage("Crontab " + e);
+    }
+    
+    if (!errors.empty() && g_reload.generation > 0) {
+        std::string kept = "generation " + std::to_string(g_reload.generation);
+        logMessage("Crontab has errors, still running " + kept);
+        return "ERROR: " + errors[0] +
+               (errors.size() > 1 ? " (and " + std::to_string(errors.size() - 1) + " more)" : "") +
+               "; still running " + kept;
+    }
+    
+    g_scheduler->setJobs(jobs);
+    g_reload.generation++;
+    g_reload.parseMs = parseMs;
+    g_reload.loadedAt = time(nullptr);
+    g_reload.jobCount = jobs.size();
+    
+    std::ostringstream ms;
+    ms << std::fixed << std::setprecision(2) << parseMs;
+    logMessage("Loaded " + std::to_string(jobs.size()) + " jobs from crontab (generation " +
+               std::to_string(g_reload.generation) + ", parsed in " + ms.str() + " ms)");
+    return "OK: Reloaded " + std::to_string(jobs.size()) + " jobs (generation " +
+           std::to_string(g_reload.generation) + ")";
+}
+
+// Reloads the registry or crontab whenever one of them is changed on disk
+void watchLoop(FileWatch::Watcher& watcher) {
+    if (!watcher.isWatching()) {
+        logMessage("Cannot watch " + g_linuxdbPath + ", checking for changes every " +
+                   std::to_string(FileWatch::FALLBACK_POLL_MS) + " ms");
+    }
     
-    logMessage("Loaded " + std::to_string(g_jobs.size()) + " jobs from crontab");
+    while (g_running) {
+        auto changed = watcher.wait();
+        if (changed.empty()) break;  // interrupted at shutdown
+        for (const auto& name : changed) {
+            if (name == "registry.lin") {
+                loadRegistry();
+            } else if (name == "crontab") {
+                logMessage("Crontab changed on disk");
+                reloadCrontab();
+            }
+        }
+    }
 }
 
 // ============================================================================
 // Job Execution
 // ============================================================================
 
-bool shouldRunNow(const CronJob& job, const std::tm& tm) {
-    if (job.isReboot) return false;  // Handled separately
-    
-    return job.minute.matches(tm.tm_min) &&
-           job.hour.matches(tm.tm_hour) &&
-           job.dayOfMonth.matches(tm.tm_mday) &&
-           job.month.matches(tm.tm_mon + 1) &&
-           job.dayOfWeek.matches(tm.tm_wday);
+// A started job whose exit is waited for on the system thread pool
+struct RunningJob {
+    HANDLE process = NULL;
+    HANDLE wait = NULL;
+    std::string command;
+    CronSchedule::Scheduler::Done done;
+};
+
+std::set<RunningJob*> g_runningJobs;
+bool g_runningJobsClosed = false;  // set on shutdown; no new waits are registered
+std::mutex g_runningJobsMutex;
+
+// Logs the exit, releases the handles and tells the scheduler the run is over
+void finishJob(RunningJob* run, bool exited) {
+    if (exited) {
+        DWORD exitCode = 0;
+        GetExitCodeProcess(run->process, &exitCode);
+        logMessage("Job finished: " + run->command + " (exit " + std::to_string(exitCode) + ")");
+    }
+    CloseHandle(run->process);
+    run->done();
+    delete run;
+}
+
+VOID CALLBACK onJobExit(PVOID context, BOOLEAN) {
+    RunningJob* run = (RunningJob*)context;
+    {
+        std::lock_guard<std::mutex> lock(g_runningJobsMutex);
+        // Absent once shutdown has taken it over
+        if (!g_runningJobs.erase(run)) return;
+    }
+    UnregisterWait(run->wait);  // does not block, so it is safe inside the callback
+    finishJob(run, true);
+}
+
+// At shutdown: stops waiting for jobs still running (their processes are left alone)
+void abandonRunningJobs() {
+    std::set<RunningJob*> runs;
+    {
+        std::lock_guard<std::mutex> lock(g_runningJobsMutex);
+        g_runningJobsClosed = true;
+        runs.swap(g_runningJobs);
+    }
+    for (RunningJob* run : runs) {
+        // Blocks until a callback already under way has returned
+        UnregisterWaitEx(run->wait, INVALID_HANDLE_VALUE);
+        finishJob(run, false);
+    }
 }
 
-void executeJob(const CronJob& job) {
+// Starts the job's process and returns; its exit is reported through `done`
+void executeJob(const CronJob& job, CronSchedule::Scheduler::Done done) {
     logMessage("Executing: " + job.command);
     
     // Parse the command - first word might be an interpreter
@@ -422,23 +557,30 @@ void executeJob(const CronJob& job) {
     char cmdBuffer[4096];
     strncpy_s(cmdBuffer, cmdLine.c_str(), sizeof(cmdBuffer) - 1);
     
-    if (CreateProcessA(NULL, cmdBuffer, NULL, NULL, FALSE, 
-                       CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        logMessage("Job started: " + job.command);
-    } else {
+    if (!CreateProcessA(NULL, cmdBuffer, NULL, NULL, FALSE, 
+                        CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
         logMessage("Failed to execute: " + job.command + " (error " + std::to_string(GetLastError()) + ")");
+        done();
+        return;
     }
-}
-
-void runRebootJobs() {
-    for (const auto& job : g_jobs) {
-        if (job.isReboot) {
-            logMessage("Running @reboot job: " + job.command);
-            executeJob(job);
+    CloseHandle(pi.hThread);
+    logMessage("Job started: " + job.command);
+    
+    RunningJob* run = new RunningJob{ pi.hProcess, NULL, job.command, std::move(done) };
+    {
+        // Held across registration so the callback cannot see run before run->wait is set
+        std::lock_guard<std::mutex> lock(g_runningJobsMutex);
+        if (!g_runningJobsClosed) {
+            g_runningJobs.insert(run);
+            if (RegisterWaitForSingleObject(&run->wait, run->process, onJobExit, run,
+                                            INFINITE, WT_EXECUTEONLYONCE)) {
+                return;
+            }
+            g_runningJobs.erase(run);
+            logMessage("Cannot wait for job: " + job.command + " (error " + std::to_string(GetLastError()) + ")");
         }
     }
+    finishJob(run, false);
 }
 
 // ============================================================================
@@ -447,23 +589,38 @@ void runRebootJobs() {
 
 void handleIPCRequest(const std::string& request, std::string& response) {
     if (request == "LIST") {
-        // Return crontab contents
+        // Reload generation, then the crontab contents
+        {
+            std::lock_guard<std::mutex> lock(g_reloadMutex);
+            std::ostringstream head;
+            head << "# generation " << g_reload.generation << ": " << g_reload.jobCount << " jobs";
+            if (g_reload.loadedAt) {
+                std::tm tm;
+                localtime_s(&tm, &g_reload.loadedAt);
+                head << ", loaded " << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+            }
+            head << ", parsed in " << std::fixed << std::setprecision(2) << g_reload.parseMs << " ms\n";
+            for (const auto& e : g_reload.errors) {
+                head << "# error: " << e << "\n";
+            }
+            response = head.str();
+        }
+        
         std::ifstream file(g_crontabPath);
         if (file) {
             std::ostringstream oss;
             oss << file.rdbuf();
-            response = oss.str();
-            if (response.empty()) {
-                response = "# No crontab entries\n";
-            }
+            std::string contents = oss.str();
+            response += contents.empty() ? "# No crontab entries\n" : contents;
         } else {
-            response = "# No crontab file\n";
+            response += "# No crontab file\n";
         }
     } else if (request == "RELOAD") {
-        loadCrontab();
-        response = "OK: Reloaded " + std::to_string(g_jobs.size()) + " jobs";
+        loadRegistry();
+        response = reloadCrontab();
     } else if (request == "STATUS") {
-        response = "RUNNING: " + std::to_string(g_jobs.size()) + " jobs loaded";
+        response = "RUNNING: " + std::to_string(g_scheduler->jobCount()) + " jobs loaded, " +
+                   std::to_string(g_scheduler->runningCount()) + " running";
     } else if (request == "PING") {
         response = "PONG";
     } else {
@@ -519,45 +676,31 @@ void ipcServerLoop() {
 void daemonLoop() {
     logMessage("Cron daemon started");
     
+    g_scheduler = std::make_unique<CronSchedule::Scheduler>(LAUNCH_THREADS, executeJob, logMessage);
+    
     // Load registry for interpreter lookup
     loadRegistry();
     
     // Load crontab
-    loadCrontab();
+    reloadCrontab();
     
     // Run @reboot jobs
-    runRebootJobs();
+    g_scheduler->runRebootJobs();
     
     // Start IPC server in separate thread
     std::thread ipcThread(ipcServerLoop);
     ipcThread.detach();
     
-    time_t lastCheck = 0;
+    // Reload on edits to the crontab or registry, parsing off the scheduler thread
+    FileWatch::Watcher watcher(g_linuxdbPath, { "crontab", "registry.lin" });
+    std::thread watchThread(watchLoop, std::ref(watcher));
     
-    while (g_running) {
-        time_t now = time(nullptr);
-        
-        // Check once per minute (at the start of each minute)
-        if (now / 60 != lastCheck / 60) {
-            lastCheck = now;
-            
-            std::tm tm;
-            localtime_s(&tm, &now);
-            
-            // Reload registry and crontab to pick up changes
-            loadRegistry();
-            loadCrontab();
-            
-            // Check each job
-            for (const auto& job : g_jobs) {
-                if (shouldRunNow(job, tm)) {
-                    executeJob(job);
-                }
-            }
-        }
-        
-        Sleep(1000);  // Check every second for stop signal
-    }
+    // Sleeps until the next job is due; reloads and Ctrl+C wake it early
+    g_scheduler->run();
+    
+    watcher.interrupt();
+    watchThread.join();
+    abandonRunningJobs();
     
     logMessage("Cron daemon stopped");
 }
@@ -665,6 +808,7 @@ bool isDaemonRunning() {
 BOOL WINAPI ConsoleHandler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT || signal == CTRL_CLOSE_EVENT) {
         g_running = false;
+        if (g_scheduler) g_scheduler->stop();
         return TRUE;
     }
     return FALSE;
@@ -674,6 +818,7 @@ int main(int argc, char* argv[]) {
     // Initialize paths
     g_linuxdbPath = getLinuxdbPath();
     g_crontabPath = g_linuxdbPath + "\\crontab";
+    g_registryPath = g_linuxdbPath + "\\registry.lin";
     g_logPath = g_linuxdbPath + "\\cron.log";
     
     // Ensure linuxdb directory exists
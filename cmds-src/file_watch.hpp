@@ -0,0 +1,197 @@
+// Linuxify File Watcher
+// Blocks until one of a few named files in a directory changes. The directory is
+// watched with ReadDirectoryChangesW (inotify elsewhere) purely as a wake-up; what
+// changed is decided by comparing each file's size and mtime with what was last
+// reported, so coalesced or lost notifications cannot hide an edit. If the directory
+// cannot be watched, the same comparison runs on a fixed poll interval instead.
+
+#ifndef LINUXIFY_FILE_WATCH_HPP
+#define LINUXIFY_FILE_WATCH_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace FileWatch {
+
+    constexpr int FALLBACK_POLL_MS = 2000;
+    // Quiet time after a notification before files are compared, so an editor's
+    // several writes (or write-to-temp then rename) are seen as one change
+    constexpr int SETTLE_MS = 200;
+
+    struct Signature {
+        bool exists = false;
+        uintmax_t size = 0;
+        std::filesystem::file_time_type mtime{};
+
+        bool operator==(const Signature& o) const {
+            return exists == o.exists && size == o.size && mtime == o.mtime;
+        }
+        bool operator!=(const Signature& o) const { return !(*this == o); }
+    };
+
+    inline Signature signatureOf(const std::filesystem::path& path) {
+        Signature s;
+        std::error_code ec;
+        s.size = std::filesystem::file_size(path, ec);
+        if (ec) return Signature();
+        s.mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) return Signature();
+        s.exists = true;
+        return s;
+    }
+
+    class Watcher {
+    private:
+        std::filesystem::path dir;
+        std::map<std::string, Signature> seen;  // name -> signature last reported
+        bool watching = false;
+
+#ifdef _WIN32
+        HANDLE dirHandle = INVALID_HANDLE_VALUE;
+        HANDLE wakeEvent = NULL;
+        OVERLAPPED overlapped{};
+        std::vector<DWORD> buffer = std::vector<DWORD>(16 * 1024 / sizeof(DWORD));
+
+        bool arm() {
+            ResetEvent(overlapped.hEvent);
+            return ReadDirectoryChangesW(dirHandle, buffer.data(), (DWORD)(buffer.size() * sizeof(DWORD)), FALSE,
+                                         FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                         FILE_NOTIFY_CHANGE_SIZE, NULL, &overlapped, NULL) != 0;
+        }
+#else
+        int inotifyFd = -1;
+        int wakePipe[2] = { -1, -1 };
+#endif
+
+        // Blocks until the OS reports activity in dir (or the poll interval passes);
+        // false if interrupt() was called
+        bool block() {
+#ifdef _WIN32
+            if (!watching) {
+                return WaitForSingleObject(wakeEvent, FALLBACK_POLL_MS) != WAIT_OBJECT_0;
+            }
+            HANDLE handles[2] = { overlapped.hEvent, wakeEvent };
+            DWORD w = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+            if (w != WAIT_OBJECT_0) return false;
+            DWORD bytes = 0;
+            GetOverlappedResult(dirHandle, &overlapped, &bytes, FALSE);
+            // Names in the buffer are not needed; an overflow (bytes == 0) is handled the same way
+            if (!arm()) watching = false;
+            return true;
+#else
+            struct pollfd fds[2] = { { wakePipe[0], POLLIN, 0 }, { inotifyFd, POLLIN, 0 } };
+            int n = poll(fds, watching ? 2 : 1, watching ? -1 : FALLBACK_POLL_MS);
+            if (n > 0 && (fds[0].revents & POLLIN)) return false;
+            if (watching && (fds[1].revents & POLLIN)) {
+                char events[4096];
+                while (read(inotifyFd, events, sizeof(events)) > 0) {}
+            }
+            return true;
+#endif
+        }
+
+        std::vector<std::string> diff() {
+            std::vector<std::string> changed;
+            for (auto& [name, sig] : seen) {
+                Signature now = signatureOf(dir / name);
+                if (now != sig) {
+                    sig = now;
+                    changed.push_back(name);
+                }
+            }
+            return changed;
+        }
+
+    public:
+        Watcher(const std::string& directory, const std::vector<std::string>& names) : dir(directory) {
+            for (const auto& name : names) seen[name] = signatureOf(dir / name);
+
+#ifdef _WIN32
+            wakeEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+            overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+            dirHandle = CreateFileW(dir.wstring().c_str(), FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+            watching = dirHandle != INVALID_HANDLE_VALUE && arm();
+#else
+            if (pipe(wakePipe) == 0) {
+                fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+            }
+            inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            watching = inotifyFd >= 0 &&
+                       inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE |
+                                         IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_ATTRIB) >= 0;
+#endif
+        }
+
+        ~Watcher() {
+#ifdef _WIN32
+            if (dirHandle != INVALID_HANDLE_VALUE) {
+                CancelIo(dirHandle);
+                DWORD bytes = 0;
+                GetOverlappedResult(dirHandle, &overlapped, &bytes, TRUE);
+                CloseHandle(dirHandle);
+            }
+            if (overlapped.hEvent) CloseHandle(overlapped.hEvent);
+            if (wakeEvent) CloseHandle(wakeEvent);
+#else
+            if (inotifyFd >= 0) close(inotifyFd);
+            if (wakePipe[0] >= 0) close(wakePipe[0]);
+            if (wakePipe[1] >= 0) close(wakePipe[1]);
+#endif
+        }
+
+        Watcher(const Watcher&) = delete;
+        Watcher& operator=(const Watcher&) = delete;
+
+        // False when the directory could not be watched and changes are found by polling
+        bool isWatching() const { return watching; }
+
+        // Names whose size or mtime changed since they were last reported; blocks until
+        // there is at least one, or returns empty once interrupt() is called
+        std::vector<std::string> wait() {
+            for (;;) {
+                if (!block()) return {};
+                bool any = false;
+                for (const auto& [name, sig] : seen) {
+                    if (signatureOf(dir / name) != sig) { any = true; break; }
+                }
+                if (!any) continue;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+                auto changed = diff();
+                if (!changed.empty()) return changed;
+            }
+        }
+
+        // Makes wait() return; callable from any thread
+        void interrupt() {
+#ifdef _WIN32
+            SetEvent(wakeEvent);
+#else
+            if (wakePipe[1] >= 0) {
+                char c = 1;
+                (void)!write(wakePipe[1], &c, 1);
+            }
+#endif
+        }
+    };
+
+} // namespace FileWatch
+
+#endif // LINUXIFY_FILE_WATCH_HPP
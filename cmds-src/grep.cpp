@@ -1,10 +1,12 @@
 
 #include "../shell_streams.hpp"
+#include "grep_engine.hpp"
 #include <string>
 #include <vector>
 #include <deque>
 #include <algorithm>
 #include <regex>
+#include <memory>
 #include <windows.h>
 #include <io.h>
 #include <fcntl.h>
@@ -39,76 +41,38 @@ bool isBinaryData(const std::string& s) {
     return s.find('\0') != std::string::npos;
 }
 
-bool isMatch(const std::string& line, const std::regex& re, const std::string& pattern, 
+bool isMatch(const std::string& line, GrepEngine::Matcher& matcher,
              std::vector<std::pair<size_t, size_t>>& matchRanges) {
     matchRanges.clear();
-    
-    if (opts.useRegex) {
-        try {
-            std::sregex_iterator begin(line.begin(), line.end(), re);
-            std::sregex_iterator end;
-            
-            if (begin == end) return opts.invertMatch;
-            
-            bool found = false;
-            for (auto i = begin; i != end; ++i) {
-                std::smatch match = *i;
-                if (opts.lineMatch) {
-                    if (match.position() == 0 && match.length() == line.length()) {
-                        matchRanges.push_back({(size_t)match.position(), (size_t)match.length()});
-                        found = true;
-                    } 
-                } 
-                else if (opts.wordMatch) {
-                    size_t pos = match.position();
-                    size_t len = match.length();
-                    bool startOk = (pos == 0) || (!isalnum(line[pos-1]) && line[pos-1] != '_');
-                    bool endOk = (pos + len == line.length()) || (!isalnum(line[pos+len]) && line[pos+len] != '_');
-                    if (startOk && endOk) {
-                        matchRanges.push_back({pos, len});
-                        found = true;
-                    }
-                } else {
-                    matchRanges.push_back({(size_t)match.position(), (size_t)match.length()});
+    bool found = false;
+
+    try {
+        if (opts.lineMatch) {
+            found = matcher.matchesWhole(line);
+            if (found) matchRanges.push_back({0, line.length()});
+        } else if (!opts.wordMatch && (opts.invertMatch || opts.countOnly || !opts.color)) {
+            // No highlighting needed: a single scan answers the question
+            found = matcher.matches(line);
+        } else {
+            size_t pos = 0, matchPos = 0, matchLen = 0;
+            while (pos <= line.length() && matcher.find(line, pos, matchPos, matchLen)) {
+                bool valid = true;
+                if (opts.wordMatch) {
+                    bool startOk = (matchPos == 0) || !GrepEngine::isWordChar((unsigned char)line[matchPos - 1]);
+                    bool endOk = (matchPos + matchLen == line.length()) || !GrepEngine::isWordChar((unsigned char)line[matchPos + matchLen]);
+                    valid = startOk && endOk;
+                }
+                if (valid) {
+                    matchRanges.push_back({matchPos, matchLen});
                     found = true;
+                    if (!opts.color) break;
                 }
+                pos = (valid && matchLen > 0) ? matchPos + matchLen : matchPos + 1;
             }
-            return opts.invertMatch ? !found : found;
-        } catch (...) { return opts.invertMatch; }
-    } else {
-        std::string searchLine = line;
-        std::string searchPat = pattern;
-        
-        if (opts.ignoreCase) {
-            std::transform(searchLine.begin(), searchLine.end(), searchLine.begin(), ::tolower);
-            std::transform(searchPat.begin(), searchPat.end(), searchPat.begin(), ::tolower);
         }
-        
-        if (opts.lineMatch) {
-            bool eq = (searchLine == searchPat);
-            if (eq) matchRanges.push_back({0, line.length()});
-            return opts.invertMatch ? !eq : eq;    
-        }
-        
-        size_t pos = 0;
-        bool found = false;
-        while ((pos = searchLine.find(searchPat, pos)) != std::string::npos) {
-            bool valid = true;
-            if (opts.wordMatch) {
-                bool startOk = (pos == 0) || (!isalnum(searchLine[pos-1]) && searchLine[pos-1] != '_');
-                bool endOk = (pos + searchPat.length() == searchLine.length()) || (!isalnum(searchLine[pos+searchPat.length()]) && searchLine[pos+searchPat.length()] != '_');
-                if (!startOk || !endOk) valid = false;
-            }
-            
-            if (valid) {
-                matchRanges.push_back({pos, searchPat.length()});
-                found = true;
-            }
-            pos += 1;
-            if (pos >= searchLine.length()) break;
-        }
-        return opts.invertMatch ? !found : found;
-    }
+    } catch (...) { return opts.invertMatch; }
+
+    return opts.invertMatch ? !found : found;
 }
 
 void printLine(const std::string& filename, int lineNum, const std::string& line, 
@@ -145,7 +109,7 @@ void printLine(const std::string& filename, int lineNum, const std::string& line
     ShellIO::sout << ShellIO::endl;
 }
 
-int processFile(ShellIO::ShellInStream& is, const std::string& filename, const std::string& pattern, const std::regex& re) {
+int processFile(ShellIO::ShellInStream& is, const std::string& filename, GrepEngine::Matcher& matcher) {
     std::string line;
     int lineNum = 0;
     int matchCount = 0;
@@ -163,7 +127,7 @@ int processFile(ShellIO::ShellInStream& is, const std::string& filename, const s
             return 1;
         }
 
-        bool matched = isMatch(line, re, pattern, matches);
+        bool matched = isMatch(line, matcher, matches);
         
         if (matched) {
             matchCount++;
@@ -209,7 +173,7 @@ int processFile(ShellIO::ShellInStream& is, const std::string& filename, const s
     return (matchCount > 0);
 }
 
-void processPath(const std::string& path, const std::string& pattern, const std::regex& re, int& totalMatches) {
+void processPath(const std::string& path, GrepEngine::Matcher& matcher, int& totalMatches) {
     WIN32_FIND_DATAA findData;
     HANDLE hFind = INVALID_HANDLE_VALUE;
     
@@ -227,7 +191,7 @@ void processPath(const std::string& path, const std::string& pattern, const std:
                  do {
                      std::string name = findData.cFileName;
                      if (name != "." && name != "..") {
-                         processPath(path + "\\" + name, pattern, re, totalMatches);
+                         processPath(path + "\\" + name, matcher, totalMatches);
                      }
                  } while (FindNextFileA(hFind, &findData));
                  FindClose(hFind);
@@ -241,7 +205,7 @@ void processPath(const std::string& path, const std::string& pattern, const std:
              if (!opts.noFilename) printError(path + ": Permission denied (or not found)");
         } else {
              ShellIO::ShellInStream fis(hFile);
-             totalMatches += processFile(fis, path, pattern, re);
+             totalMatches += processFile(fis, path, matcher);
              CloseHandle(hFile);
         }
     }
@@ -345,15 +309,12 @@ int main(int argc, char* argv[]) {
         return 2;
     }
     
-    std::regex re;
+    // Literal patterns (-F, or no metacharacters) skip the regex machinery entirely
+    std::unique_ptr<GrepEngine::Matcher> matcher;
     try {
-        if (opts.useRegex || (!opts.fixedStrings)) {
-            auto flags = std::regex::ECMAScript; 
-            if (opts.ignoreCase) flags |= std::regex::icase;
-            std::string finalPat = pattern;
-            re = std::regex(finalPat, flags);
-            opts.useRegex = true;
-        }
+        bool regexMode = opts.useRegex || !opts.fixedStrings;
+        matcher = std::make_unique<GrepEngine::Matcher>(pattern, opts.ignoreCase, regexMode);
+        opts.useRegex = regexMode;
     } catch (const std::regex_error& e) {
         printError("Regex error: " + std::string(e.what()));
         return 2;
@@ -366,10 +327,10 @@ int main(int argc, char* argv[]) {
     int totalMatches = 0;
     
     if (files.empty()) {
-        totalMatches += processFile(ShellIO::sin, "(standard input)", pattern, re);
+        totalMatches += processFile(ShellIO::sin, "(standard input)", *matcher);
     } else {
         for (const auto& f : files) {
-            processPath(f, pattern, re, totalMatches);
+            processPath(f, *matcher, totalMatches);
         }
     }
     
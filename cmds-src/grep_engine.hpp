@@ -0,0 +1,859 @@
+// Linuxify Grep Match Engine
+// Literal search (SSE2 first/last-byte prefilter, memchr fallback) with allocation-free case folding,
+// and a Thompson-NFA / lazy-DFA regex backend with a literal-prefix prefilter.
+// Shared by the grep builtin (main.cpp) and the standalone grep (cmds-src/grep.cpp).
+
+#ifndef LINUXIFY_GREP_ENGINE_HPP
+#define LINUXIFY_GREP_ENGINE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <regex>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINUXIFY_GREP_SSE2 1
+#endif
+
+namespace GrepEngine {
+
+    // ASCII case folding without touching the subject text
+    struct FoldTable {
+        unsigned char lower[256];
+        FoldTable() {
+            for (int i = 0; i < 256; ++i) {
+                lower[i] = (i >= 'A' && i <= 'Z') ? (unsigned char)(i - 'A' + 'a') : (unsigned char)i;
+            }
+        }
+    };
+
+    inline const FoldTable& fold() {
+        static const FoldTable table;
+        return table;
+    }
+
+    inline bool equalsFolded(const char* a, const char* b, size_t n) {
+        const unsigned char* lower = fold().lower;
+        for (size_t i = 0; i < n; ++i) {
+            if (lower[(unsigned char)a[i]] != lower[(unsigned char)b[i]]) return false;
+        }
+        return true;
+    }
+
+    inline bool isWordChar(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    // ========================================================================
+    // Literal searcher
+    // ========================================================================
+
+    class LiteralSearcher {
+    private:
+        std::string needle;
+        bool ignoreCase = false;
+        unsigned char first = 0, firstAlt = 0;  // first byte and its other case
+        unsigned char last = 0, lastAlt = 0;    // last byte and its other case
+
+        bool verify(const char* at) const {
+            if (ignoreCase) return equalsFolded(at, needle.data(), needle.size());
+            return std::memcmp(at, needle.data(), needle.size()) == 0;
+        }
+
+        static unsigned char otherCase(unsigned char c) {
+            if (c >= 'a' && c <= 'z') return (unsigned char)(c - 'a' + 'A');
+            if (c >= 'A' && c <= 'Z') return (unsigned char)(c - 'A' + 'a');
+            return c;
+        }
+
+        size_t findScalar(const char* data, size_t n, size_t from) const {
+            const size_t m = needle.size();
+            size_t limit = n - m;  // last valid start
+            size_t pos = from;
+            while (pos <= limit) {
+                const char* hit;
+                if (first == firstAlt) {
+                    hit = (const char*)std::memchr(data + pos, first, limit - pos + 1);
+                } else {
+                    const char* a = (const char*)std::memchr(data + pos, first, limit - pos + 1);
+                    const char* b = (const char*)std::memchr(data + pos, firstAlt, (a ? (size_t)(a - data) : limit + 1) - pos);
+                    hit = b ? b : a;
+                }
+                if (!hit) return std::string_view::npos;
+                size_t at = (size_t)(hit - data);
+                if (verify(hit)) return at;
+                pos = at + 1;
+            }
+            return std::string_view::npos;
+        }
+
+    public:
+        LiteralSearcher() = default;
+
+        LiteralSearcher(std::string_view pattern, bool icase) : needle(pattern), ignoreCase(icase) {
+            if (ignoreCase) {
+                for (char& c : needle) c = (char)fold().lower[(unsigned char)c];
+            }
+            if (!needle.empty()) {
+                first = (unsigned char)needle.front();
+                last = (unsigned char)needle.back();
+                firstAlt = ignoreCase ? otherCase(first) : first;
+                lastAlt = ignoreCase ? otherCase(last) : last;
+            }
+        }
+
+        size_t size() const { return needle.size(); }
+        bool empty() const { return needle.empty(); }
+
+        // Position of the first occurrence at or after `from`, npos if none
+        size_t find(std::string_view hay, size_t from = 0) const {
+            const size_t m = needle.size();
+            const size_t n = hay.size();
+            if (m == 0) return from <= n ? from : std::string_view::npos;
+            if (from > n || n - from < m) return std::string_view::npos;
+            const char* data = hay.data();
+
+#ifdef LINUXIFY_GREP_SSE2
+            // Compare the first and last needle bytes at 16 candidate starts at once;
+            // only positions where both agree are verified byte by byte.
+            if (m > 1) {
+                const __m128i f0 = _mm_set1_epi8((char)first), f1 = _mm_set1_epi8((char)firstAlt);
+                const __m128i l0 = _mm_set1_epi8((char)last), l1 = _mm_set1_epi8((char)lastAlt);
+                size_t pos = from;
+                while (pos + m - 1 + 16 <= n) {
+                    __m128i a = _mm_loadu_si128((const __m128i*)(data + pos));
+                    __m128i b = _mm_loadu_si128((const __m128i*)(data + pos + m - 1));
+                    __m128i eqFirst = _mm_or_si128(_mm_cmpeq_epi8(a, f0), _mm_cmpeq_epi8(a, f1));
+                    __m128i eqLast = _mm_or_si128(_mm_cmpeq_epi8(b, l0), _mm_cmpeq_epi8(b, l1));
+                    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+                    while (mask) {
+                        unsigned bit = 0;
+                        while (!(mask & (1u << bit))) ++bit;
+                        if (verify(data + pos + bit)) return pos + bit;
+                        mask &= mask - 1;
+                    }
+                    pos += 16;
+                }
+                return findScalar(data, n, pos);
+            }
+#endif
+            return findScalar(data, n, from);
+        }
+    };
+
+    // ========================================================================
+    // Regex: parser -> AST -> Thompson NFA -> lazily built DFA
+    // ========================================================================
+
+    // Thrown for syntax the automaton backend does not implement (backreferences,
+    // lookaround, lazy quantifiers, \b ...); the Matcher then falls back to std::regex.
+    struct Unsupported {};
+
+    using ByteSet = std::bitset<256>;
+
+    struct Node {
+        enum Type { Set, Concat, Alt, Repeat, Begin, End, Empty } type = Empty;
+        ByteSet set;
+        std::vector<std::unique_ptr<Node>> kids;
+        int min = 0, max = -1;  // Repeat bounds, max -1 = unbounded
+    };
+
+    class Parser {
+    private:
+        std::string_view src;
+        size_t pos = 0;
+        bool icase;
+
+        bool atEnd() const { return pos >= src.size(); }
+        char peek() const { return src[pos]; }
+
+        static std::unique_ptr<Node> make(Node::Type t) {
+            auto n = std::make_unique<Node>();
+            n->type = t;
+            return n;
+        }
+
+        void addFolded(ByteSet& set, unsigned char c) const {
+            set.set(c);
+            if (icase) {
+                if (c >= 'a' && c <= 'z') set.set(c - 'a' + 'A');
+                else if (c >= 'A' && c <= 'Z') set.set(c - 'A' + 'a');
+            }
+        }
+
+        static void addRange(ByteSet& set, int lo, int hi) {
+            for (int c = lo; c <= hi; ++c) set.set((size_t)c);
+        }
+
+        static bool classEscape(char e, ByteSet& set) {
+            ByteSet s;
+            switch (e) {
+                case 'd': case 'D': addRange(s, '0', '9'); break;
+                case 'w': case 'W': addRange(s, 'a', 'z'); addRange(s, 'A', 'Z'); addRange(s, '0', '9'); s.set('_'); break;
+                case 's': case 'S': s.set(' '); s.set('\t'); s.set('\n'); s.set('\r'); s.set('\f'); s.set('\v'); break;
+                default: return false;
+            }
+            if (e == 'D' || e == 'W' || e == 'S') s.flip();
+            set |= s;
+            return true;
+        }
+
+        static int escapeChar(char e) {
+            switch (e) {
+                case 'n': return '\n';
+                case 't': return '\t';
+                case 'r': return '\r';
+                case 'f': return '\f';
+                case 'v': return '\v';
+                case '0': return '\0';
+                default: break;
+            }
+            // Backreferences, word boundaries and friends are left to std::regex
+            if ((e >= '1' && e <= '9') || e == 'b' || e == 'B' || e == 'x' || e == 'u' || e == 'c' || e == 'k') {
+                throw Unsupported();
+            }
+            return (unsigned char)e;
+        }
+
+        bool posixClass(const std::string& name, ByteSet& set) const {
+            ByteSet s;
+            if (name == "alpha") { addRange(s, 'a', 'z'); addRange(s, 'A', 'Z'); }
+            else if (name == "digit") addRange(s, '0', '9');
+            else if (name == "alnum") { addRange(s, 'a', 'z'); addRange(s, 'A', 'Z'); addRange(s, '0', '9'); }
+            else if (name == "upper") { addRange(s, 'A', 'Z'); if (icase) addRange(s, 'a', 'z'); }
+            else if (name == "lower") { addRange(s, 'a', 'z'); if (icase) addRange(s, 'A', 'Z'); }
+            else if (name == "space") { s.set(' '); s.set('\t'); s.set('\n'); s.set('\r'); s.set('\f'); s.set('\v'); }
+            else if (name == "blank") { s.set(' '); s.set('\t'); }
+            else if (name == "punct") { for (const char* p = "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"; *p; ++p) s.set((unsigned char)*p); }
+            else if (name == "xdigit") { addRange(s, '0', '9'); addRange(s, 'a', 'f'); addRange(s, 'A', 'F'); }
+            else if (name == "cntrl") { addRange(s, 0, 31); s.set(127); }
+            else if (name == "print") addRange(s, 32, 126);
+            else if (name == "graph") addRange(s, 33, 126);
+            else return false;
+            set |= s;
+            return true;
+        }
+
+        std::unique_ptr<Node> parseBracket() {
+            // '[' already consumed
+            auto node = make(Node::Set);
+            bool negate = false;
+            if (!atEnd() && peek() == '^') { negate = true; pos++; }
+            bool firstItem = true;
+            while (true) {
+                if (atEnd()) throw Unsupported();  // unterminated; let std::regex report it
+                char c = src[pos];
+                if (c == ']' && !firstItem) { pos++; break; }
+                firstItem = false;
+
+                int lo;
+                if (c == '[' && pos + 1 < src.size() && src[pos + 1] == ':') {
+                    size_t close = src.find(":]", pos + 2);
+                    if (close == std::string_view::npos) throw Unsupported();
+                    if (!posixClass(std::string(src.substr(pos + 2, close - pos - 2)), node->set)) throw Unsupported();
+                    pos = close + 2;
+                    continue;
+                }
+                if (c == '\\' && pos + 1 < src.size()) {
+                    char e = src[pos + 1];
+                    pos += 2;
+                    if (classEscape(e, node->set)) continue;
+                    lo = (e == 'b') ? '\b' : escapeChar(e);
+                } else {
+                    lo = (unsigned char)c;
+                    pos++;
+                }
+
+                if (pos + 1 < src.size() && src[pos] == '-' && src[pos + 1] != ']') {
+                    pos++;
+                    int hi;
+                    if (src[pos] == '\\' && pos + 1 < src.size()) {
+                        hi = escapeChar(src[pos + 1]);
+                        pos += 2;
+                    } else {
+                        hi = (unsigned char)src[pos++];
+                    }
+                    if (hi < lo) throw Unsupported();
+                    for (int x = lo; x <= hi; ++x) addFolded(node->set, (unsigned char)x);
+                } else {
+                    addFolded(node->set, (unsigned char)lo);
+                }
+            }
+            if (negate) node->set.flip();
+            return node;
+        }
+
+        std::unique_ptr<Node> parseAtom() {
+            char c = src[pos++];
+            switch (c) {
+                case '(': {
+                    if (!atEnd() && peek() == '?') {
+                        // Only (?:...) is a plain group; lookaround goes to std::regex
+                        if (pos + 1 < src.size() && src[pos + 1] == ':') pos += 2;
+                        else throw Unsupported();
+                    }
+                    auto inner = parseAlt();
+                    if (atEnd() || peek() != ')') throw Unsupported();
+                    pos++;
+                    return inner;
+                }
+                case '[':
+                    return parseBracket();
+                case '.': {
+                    auto n = make(Node::Set);
+                    n->set.set();
+                    n->set.reset('\n');
+                    n->set.reset('\r');
+                    return n;
+                }
+                case '^':
+                    return make(Node::Begin);
+                case '$':
+                    return make(Node::End);
+                case '\\': {
+                    if (atEnd()) throw Unsupported();
+                    char e = src[pos++];
+                    auto n = make(Node::Set);
+                    if (!classEscape(e, n->set)) addFolded(n->set, (unsigned char)escapeChar(e));
+                    return n;
+                }
+                case ')': case '*': case '+': case '?': case '{': case '|':
+                    throw Unsupported();
+                default: {
+                    auto n = make(Node::Set);
+                    addFolded(n->set, (unsigned char)c);
+                    return n;
+                }
+            }
+        }
+
+        bool parseBraces(int& lo, int& hi) {
+            // pos is at '{'; returns false (and leaves pos) when it is a literal brace
+            size_t save = pos;
+            pos++;
+            auto readInt = [&](int& out) {
+                size_t start = pos;
+                out = 0;
+                while (!atEnd() && peek() >= '0' && peek() <= '9') out = out * 10 + (src[pos++] - '0');
+                return pos > start;
+            };
+            if (!readInt(lo)) { pos = save; return false; }
+            hi = lo;
+            if (!atEnd() && peek() == ',') {
+                pos++;
+                if (!readInt(hi)) hi = -1;
+            }
+            if (atEnd() || peek() != '}') { pos = save; return false; }
+            pos++;
+            if (hi != -1 && hi < lo) throw Unsupported();
+            return true;
+        }
+
+        std::unique_ptr<Node> parseRepeat() {
+            auto atom = parseAtom();
+            while (!atEnd()) {
+                char c = peek();
+                int lo, hi;
+                if (c == '*') { lo = 0; hi = -1; pos++; }
+                else if (c == '+') { lo = 1; hi = -1; pos++; }
+                else if (c == '?') { lo = 0; hi = 1; pos++; }
+                else if (c == '{') { if (!parseBraces(lo, hi)) break; }
+                else break;
+                // Lazy modifiers and stacked quantifiers (errors in ECMAScript) go to std::regex
+                if (!atEnd() && (peek() == '?' || peek() == '+' || peek() == '*' || peek() == '{')) throw Unsupported();
+                if (atom->type == Node::Begin || atom->type == Node::End) throw Unsupported();
+                if (lo > 1000 || hi > 1000) throw Unsupported();
+                auto rep = make(Node::Repeat);
+                rep->min = lo;
+                rep->max = hi;
+                rep->kids.push_back(std::move(atom));
+                atom = std::move(rep);
+            }
+            return atom;
+        }
+
+        std::unique_ptr<Node> parseConcat() {
+            auto cat = make(Node::Concat);
+            while (!atEnd() && peek() != '|' && peek() != ')') {
+                cat->kids.push_back(parseRepeat());
+            }
+            if (cat->kids.empty()) return make(Node::Empty);
+            if (cat->kids.size() == 1) return std::move(cat->kids[0]);
+            return cat;
+        }
+
+        std::unique_ptr<Node> parseAlt() {
+            auto first = parseConcat();
+            if (atEnd() || peek() != '|') return first;
+            auto alt = make(Node::Alt);
+            alt->kids.push_back(std::move(first));
+            while (!atEnd() && peek() == '|') {
+                pos++;
+                alt->kids.push_back(parseConcat());
+            }
+            return alt;
+        }
+
+    public:
+        Parser(std::string_view pattern, bool ignoreCase) : src(pattern), icase(ignoreCase) {}
+
+        std::unique_ptr<Node> parse() {
+            auto root = parseAlt();
+            if (!atEnd()) throw Unsupported();  // stray ')'
+            return root;
+        }
+    };
+
+    struct NfaState {
+        enum Kind : uint8_t { Byte, Split, Eps, Begin, End, Match } kind = Eps;
+        int out = -1;
+        int out1 = -1;
+        int set = -1;  // index into Nfa::sets for Byte states
+    };
+
+    struct Nfa {
+        // Counted repeats copy their body, so nesting multiplies: (a{1000}){1000} would need
+        // a million states. Past this many the pattern goes to std::regex instead.
+        static constexpr size_t MAX_STATES = 100000;
+
+        std::vector<NfaState> states;
+        std::vector<ByteSet> sets;
+        int start = -1;
+
+        int add(NfaState::Kind kind, int out = -1, int out1 = -1) {
+            if (states.size() >= MAX_STATES) throw Unsupported();
+            NfaState s;
+            s.kind = kind;
+            s.out = out;
+            s.out1 = out1;
+            states.push_back(s);
+            return (int)states.size() - 1;
+        }
+    };
+
+    // Compiles an AST into a Thompson NFA. Each fragment has one entry and one
+    // exit (an Eps state whose `out` gets patched by the caller).
+    class Compiler {
+    private:
+        Nfa& nfa;
+
+        struct Frag { int in; int exit; };
+
+        Frag compile(const Node& n) {
+            switch (n.type) {
+                case Node::Set: {
+                    int exit = nfa.add(NfaState::Eps);
+                    int s = nfa.add(NfaState::Byte, exit);
+                    nfa.sets.push_back(n.set);
+                    nfa.states[s].set = (int)nfa.sets.size() - 1;
+                    return {s, exit};
+                }
+                case Node::Begin: {
+                    int exit = nfa.add(NfaState::Eps);
+                    return {nfa.add(NfaState::Begin, exit), exit};
+                }
+                case Node::End: {
+                    int exit = nfa.add(NfaState::Eps);
+                    return {nfa.add(NfaState::End, exit), exit};
+                }
+                case Node::Empty: {
+                    int exit = nfa.add(NfaState::Eps);
+                    return {exit, exit};
+                }
+                case Node::Concat: {
+                    Frag f = compile(*n.kids[0]);
+                    for (size_t i = 1; i < n.kids.size(); ++i) {
+                        Frag g = compile(*n.kids[i]);
+                        nfa.states[f.exit].out = g.in;
+                        f.exit = g.exit;
+                    }
+                    return f;
+                }
+                case Node::Alt: {
+                    int exit = nfa.add(NfaState::Eps);
+                    int entry = -1;
+                    for (size_t i = n.kids.size(); i-- > 0;) {
+                        Frag g = compile(*n.kids[i]);
+                        nfa.states[g.exit].out = exit;
+                        entry = (entry < 0) ? g.in : nfa.add(NfaState::Split, g.in, entry);
+                    }
+                    return {entry, exit};
+                }
+                case Node::Repeat: {
+                    const Node& body = *n.kids[0];
+                    int entry = nfa.add(NfaState::Eps);
+                    int tail = entry;
+                    for (int i = 0; i < n.min; ++i) {
+                        Frag g = compile(body);
+                        nfa.states[tail].out = g.in;
+                        tail = g.exit;
+                    }
+                    if (n.max < 0) {
+                        // tail -> split(body -> back to split, exit)
+                        int exit = nfa.add(NfaState::Eps);
+                        Frag g = compile(body);
+                        int split = nfa.add(NfaState::Split, g.in, exit);
+                        nfa.states[g.exit].out = split;
+                        nfa.states[tail].out = split;
+                        return {entry, exit};
+                    }
+                    int exit = nfa.add(NfaState::Eps);
+                    for (int i = n.min; i < n.max; ++i) {
+                        Frag g = compile(body);
+                        int split = nfa.add(NfaState::Split, g.in, exit);
+                        nfa.states[tail].out = split;
+                        tail = g.exit;
+                    }
+                    nfa.states[tail].out = exit;
+                    return {entry, exit};
+                }
+            }
+            return {-1, -1};
+        }
+
+    public:
+        explicit Compiler(Nfa& target) : nfa(target) {}
+
+        void build(const Node& root) {
+            Frag f = compile(root);
+            int match = nfa.add(NfaState::Match);
+            nfa.states[f.exit].out = match;
+            nfa.start = f.in;
+        }
+    };
+
+    // Lazily materialised DFA over the NFA. States are created on first use and
+    // cached with a 256-entry transition row; the cache is flushed if it grows too big.
+    class LazyDfa {
+    private:
+        struct DState {
+            std::vector<int> nfaStates;   // Byte / End / Match states reached
+            bool match = false;           // Match reachable here
+            bool matchAtEnd = false;      // Match reachable if this is end of line ($)
+            std::array<int, 256> next;
+            DState() { next.fill(-1); }
+        };
+
+        const Nfa& nfa;
+        bool unanchored;  // re-inject the start closure at every position
+        std::vector<DState> states;
+        std::map<std::vector<int>, int> index;
+        std::vector<int> injected;   // closure of start (no ^) added in unanchored mode
+        std::vector<uint32_t> mark;
+        uint32_t generation = 0;
+        int startAtZero = -1;
+        int startMid = -1;
+        size_t flushes = 0;
+
+        static constexpr size_t MAX_STATES = 4096;
+
+        void closure(int s, bool allowBegin, std::vector<int>& outSet, std::vector<int>& stack) {
+            stack.push_back(s);
+            while (!stack.empty()) {
+                int cur = stack.back();
+                stack.pop_back();
+                if (cur < 0 || mark[cur] == generation) continue;
+                mark[cur] = generation;
+                const NfaState& st = nfa.states[cur];
+                switch (st.kind) {
+                    case NfaState::Split:
+                        stack.push_back(st.out1);
+                        stack.push_back(st.out);
+                        break;
+                    case NfaState::Eps:
+                        stack.push_back(st.out);
+                        break;
+                    case NfaState::Begin:
+                        if (allowBegin) stack.push_back(st.out);
+                        break;
+                    default:  // Byte, End, Match are kept in the set
+                        outSet.push_back(cur);
+                        break;
+                }
+            }
+        }
+
+        bool reachesMatchAtEnd(const std::vector<int>& set) {
+            // Follow End assertions (and anything epsilon after them) to see if Match is reachable
+            ++generation;
+            std::vector<int> stack, found;
+            for (int s : set) {
+                if (nfa.states[s].kind == NfaState::End) closure(nfa.states[s].out, false, found, stack);
+            }
+            for (size_t i = 0; i < found.size(); ++i) {
+                const NfaState& st = nfa.states[found[i]];
+                if (st.kind == NfaState::Match) return true;
+                if (st.kind == NfaState::End) closure(st.out, false, found, stack);
+            }
+            return false;
+        }
+
+        int intern(std::vector<int>& set) {
+            std::sort(set.begin(), set.end());
+            set.erase(std::unique(set.begin(), set.end()), set.end());
+            auto it = index.find(set);
+            if (it != index.end()) return it->second;
+            if (states.size() >= MAX_STATES) flush();
+
+            DState d;
+            d.nfaStates = set;
+            for (int s : set) {
+                if (nfa.states[s].kind == NfaState::Match) d.match = true;
+            }
+            d.matchAtEnd = d.match || reachesMatchAtEnd(set);
+            states.push_back(std::move(d));
+            int id = (int)states.size() - 1;
+            index.emplace(set, id);
+            return id;
+        }
+
+        void flush() {
+            ++flushes;
+            states.clear();
+            index.clear();
+            startAtZero = startMid = -1;
+        }
+
+        int makeStart(bool atZero) {
+            ++generation;
+            std::vector<int> set, stack;
+            closure(nfa.start, atZero, set, stack);
+            return intern(set);
+        }
+
+    public:
+        LazyDfa(const Nfa& automaton, bool searchAnywhere) : nfa(automaton), unanchored(searchAnywhere) {
+            mark.assign(nfa.states.size(), 0);
+            ++generation;
+            std::vector<int> stack;
+            closure(nfa.start, false, injected, stack);
+        }
+
+        int start(bool atZero) {
+            int& slot = atZero ? startAtZero : startMid;
+            if (slot < 0) slot = makeStart(atZero);
+            return slot;
+        }
+
+        int step(int from, unsigned char c) {
+            int cached = states[from].next[c];
+            if (cached >= 0) return cached;
+
+            ++generation;
+            std::vector<int> set, stack;
+            for (int s : states[from].nfaStates) {
+                const NfaState& st = nfa.states[s];
+                if (st.kind == NfaState::Byte && nfa.sets[st.set].test(c)) closure(st.out, false, set, stack);
+            }
+            if (unanchored) set.insert(set.end(), injected.begin(), injected.end());
+
+            size_t flushesBefore = flushes;
+            int to = intern(set);
+            // intern() may have flushed the cache, in which case `from` is gone
+            if (flushes == flushesBefore) states[from].next[c] = to;
+            return to;
+        }
+
+        bool isMatch(int s) const { return states[s].match; }
+        bool isMatchAtEnd(int s) const { return states[s].matchAtEnd; }
+        bool isDead(int s) const { return states[s].nfaStates.empty(); }
+    };
+
+    // ========================================================================
+    // Matcher: picks the cheapest backend for a pattern
+    // ========================================================================
+
+    class Matcher {
+    private:
+        enum class Backend { Literal, Automaton, StdRegex };
+
+        Backend backend = Backend::Literal;
+        bool ignoreCase = false;
+        LiteralSearcher literal;       // whole pattern (Literal) or required prefix (Automaton)
+        bool beginAnchored = false;    // every match must start at column 0
+        std::unique_ptr<Nfa> nfa;
+        std::unique_ptr<LazyDfa> searchDfa;    // unanchored: "is there a match anywhere"
+        std::unique_ptr<LazyDfa> anchoredDfa;  // anchored: longest match from a given start
+        std::regex stdRegex;
+
+        static bool hasRegexMeta(std::string_view p) {
+            return p.find_first_of("\\^$.|?*+()[]{}") != std::string_view::npos;
+        }
+
+        // Literal text every match must start with (empty if none can be derived)
+        static std::string literalPrefix(const Node& root, bool icase, bool& anchored) {
+            anchored = false;
+            std::vector<const Node*> items;
+            if (root.type == Node::Concat) {
+                for (const auto& k : root.kids) items.push_back(k.get());
+            } else {
+                items.push_back(&root);
+            }
+            size_t i = 0;
+            if (i < items.size() && items[i]->type == Node::Begin) { anchored = true; ++i; }
+            std::string prefix;
+            for (; i < items.size(); ++i) {
+                const Node* n = items[i];
+                if (n->type != Node::Set) break;
+                size_t count = n->set.count();
+                if (count == 1) {
+                    for (int c = 0; c < 256; ++c) if (n->set.test(c)) { prefix += (char)c; break; }
+                } else if (icase && count == 2) {
+                    int lo = -1;
+                    for (int c = 'a'; c <= 'z'; ++c) {
+                        if (n->set.test(c) && n->set.test(c - 'a' + 'A')) { lo = c; break; }
+                    }
+                    if (lo < 0) break;
+                    prefix += (char)lo;
+                } else {
+                    break;
+                }
+            }
+            return prefix;
+        }
+
+        // Longest match of the anchored automaton starting at `from`; -1 if none
+        long longestAt(std::string_view line, size_t from) {
+            int s = anchoredDfa->start(from == 0);
+            long best = -1;
+            if (anchoredDfa->isMatch(s)) best = 0;
+            size_t i = from;
+            for (; i < line.size(); ++i) {
+                s = anchoredDfa->step(s, (unsigned char)line[i]);
+                if (anchoredDfa->isDead(s)) return best;
+                if (anchoredDfa->isMatch(s)) best = (long)(i + 1 - from);
+            }
+            if (anchoredDfa->isMatchAtEnd(s)) best = (long)(line.size() - from);
+            return best;
+        }
+
+    public:
+        // Throws std::regex_error for patterns that are invalid even for std::regex
+        Matcher(const std::string& pattern, bool icase, bool regexMode) : ignoreCase(icase) {
+            if (!regexMode || !hasRegexMeta(pattern)) {
+                backend = Backend::Literal;
+                literal = LiteralSearcher(pattern, icase);
+                return;
+            }
+
+            try {
+                Parser parser(pattern, icase);
+                std::unique_ptr<Node> root = parser.parse();
+                nfa = std::make_unique<Nfa>();
+                Compiler(*nfa).build(*root);
+                literal = LiteralSearcher(literalPrefix(*root, icase, beginAnchored), icase);
+                searchDfa = std::make_unique<LazyDfa>(*nfa, true);
+                anchoredDfa = std::make_unique<LazyDfa>(*nfa, false);
+                backend = Backend::Automaton;
+            } catch (const Unsupported&) {
+                nfa.reset();
+                auto flags = std::regex::ECMAScript;
+                if (icase) flags |= std::regex::icase;
+                stdRegex = std::regex(pattern, flags);
+                backend = Backend::StdRegex;
+            }
+        }
+
+        Matcher(const Matcher&) = delete;
+        Matcher& operator=(const Matcher&) = delete;
+
+        bool isLiteral() const { return backend == Backend::Literal; }
+
+        // True if the line contains a match anywhere
+        bool matches(std::string_view line) {
+            switch (backend) {
+                case Backend::Literal:
+                    return literal.find(line) != std::string_view::npos;
+                case Backend::StdRegex:
+                    return std::regex_search(line.begin(), line.end(), stdRegex);
+                case Backend::Automaton:
+                    break;
+            }
+
+            size_t from = 0;
+            if (!literal.empty()) {
+                from = literal.find(line);
+                if (from == std::string_view::npos) return false;
+                if (beginAnchored && from != 0) return false;
+            }
+            if (beginAnchored) return longestAt(line, 0) >= 0;
+
+            int s = searchDfa->start(from == 0);
+            if (searchDfa->isMatch(s)) return true;
+            for (size_t i = from; i < line.size(); ++i) {
+                s = searchDfa->step(s, (unsigned char)line[i]);
+                if (searchDfa->isMatch(s)) return true;
+            }
+            return searchDfa->isMatchAtEnd(s);
+        }
+
+        // Leftmost match at or after `from` (longest at that start). Returns false if none.
+        bool find(std::string_view line, size_t from, size_t& matchPos, size_t& matchLen) {
+            if (from > line.size()) return false;
+            switch (backend) {
+                case Backend::Literal: {
+                    size_t p = literal.find(line, from);
+                    if (p == std::string_view::npos) return false;
+                    matchPos = p;
+                    matchLen = literal.size();
+                    return true;
+                }
+                case Backend::StdRegex: {
+                    std::match_results<std::string_view::const_iterator> m;
+                    auto flags = from > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+                    if (!std::regex_search(line.begin() + from, line.end(), m, stdRegex, flags)) return false;
+                    matchPos = from + (size_t)m.position(0);
+                    matchLen = (size_t)m.length(0);
+                    return true;
+                }
+                case Backend::Automaton:
+                    break;
+            }
+
+            // Reject non-matching lines in one linear DFA pass before probing start positions
+            if (literal.empty() && from == 0 && !matches(line)) return false;
+
+            size_t start = from;
+            while (start <= line.size()) {
+                if (!literal.empty()) {
+                    start = literal.find(line, start);
+                    if (start == std::string_view::npos) return false;
+                }
+                if (beginAnchored && start != 0) return false;
+                long len = longestAt(line, start);
+                if (len >= 0) {
+                    matchPos = start;
+                    matchLen = (size_t)len;
+                    return true;
+                }
+                ++start;
+            }
+            return false;
+        }
+
+        // True if the whole line is one match (grep -x)
+        bool matchesWhole(std::string_view line) {
+            switch (backend) {
+                case Backend::Literal:
+                    if (line.size() != literal.size()) return false;
+                    return literal.find(line) == 0;
+                case Backend::StdRegex:
+                    return std::regex_match(line.begin(), line.end(), stdRegex);
+                case Backend::Automaton:
+                    break;
+            }
+            return longestAt(line, 0) == (long)line.size();
+        }
+    };
+
+} // namespace GrepEngine
+
+#endif // LINUXIFY_GREP_ENGINE_HPP
@@ -17,6 +17,10 @@
 #include <io.h>
 #include <windows.h>
 #include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include "arith.hpp"
+#include "variable_store.hpp"
 
 namespace Bash {
 
@@ -605,10 +609,181 @@ public:
     }
 };
 
+// ============================================================================
+// COMPILED WORDS - Words pre-split into expansion segments at parse time
+// ============================================================================
+
+enum class SegmentKind : uint8_t {
+    Literal,       // plain text
+    Variable,      // $NAME / ${NAME}
+    Positional,    // $0-$9 / ${N}
+    ArgCount,      // $#
+    AllArgs,       // $@
+    ExitCode,      // $?
+    CommandSubst,  // $(cmd) / `cmd`
+    Arithmetic,    // $((expr))
+    Legacy         // forms still handled by Executor::expandVariables (${V:-x}, ${A[i]}, ...)
+};
+
+struct CompiledWord;
+
+struct WordSegment {
+    SegmentKind kind = SegmentKind::Literal;
+    std::string text;  // literal text, variable name, command source or raw word
+    int slot = -1;     // variable slot, or positional index
+    std::shared_ptr<CompiledWord> inner;  // Arithmetic: the expression, itself compiled
+};
+
+struct CompiledWord {
+    std::vector<WordSegment> segments;
+
+    bool isLiteral() const {
+        return segments.empty() || (segments.size() == 1 && segments[0].kind == SegmentKind::Literal);
+    }
+};
+
+// Splits a raw word into segments once, so execution never re-scans the string
+class WordCompiler {
+private:
+    static bool isNameStart(char c) { return isalpha((unsigned char)c) || c == '_'; }
+    static bool isNameChar(char c) { return isalnum((unsigned char)c) || c == '_'; }
+
+    // Index just past the ')' closing the '(' at `open`, or npos
+    static size_t matchParen(const std::string& raw, size_t open) {
+        int depth = 0;
+        for (size_t i = open; i < raw.size(); ++i) {
+            if (raw[i] == '(') depth++;
+            else if (raw[i] == ')' && --depth == 0) return i + 1;
+        }
+        return std::string::npos;
+    }
+
+    static void addLiteral(CompiledWord& word, const std::string& text) {
+        if (text.empty()) return;
+        if (!word.segments.empty() && word.segments.back().kind == SegmentKind::Literal) {
+            word.segments.back().text += text;
+            return;
+        }
+        WordSegment seg;
+        seg.text = text;
+        word.segments.push_back(std::move(seg));
+    }
+
+    static void addSegment(CompiledWord& word, SegmentKind kind, const std::string& text, int slot = -1) {
+        WordSegment seg;
+        seg.kind = kind;
+        seg.text = text;
+        seg.slot = slot;
+        word.segments.push_back(std::move(seg));
+    }
+
+public:
+    static CompiledWord compile(const std::string& raw) {
+        CompiledWord word;
+        if (raw.find('$') == std::string::npos && raw.find('`') == std::string::npos) {
+            addLiteral(word, raw);
+            return word;
+        }
+
+        // Defaults, array subscripts and other ${...} operators keep the original expander
+        static const std::regex legacyForms("\\$\\{[^}]*[^a-zA-Z0-9_}][^}]*\\}|\\$[a-zA-Z_][a-zA-Z0-9_]*\\[");
+        if (std::regex_search(raw, legacyForms)) {
+            addSegment(word, SegmentKind::Legacy, raw);
+            return word;
+        }
+
+        std::string literal;
+        size_t i = 0;
+        while (i < raw.size()) {
+            char c = raw[i];
+            if (c == '`') {
+                size_t end = raw.find('`', i + 1);
+                if (end == std::string::npos) { literal += raw.substr(i); break; }
+                addLiteral(word, literal); literal.clear();
+                addSegment(word, SegmentKind::CommandSubst, raw.substr(i + 1, end - i - 1));
+                i = end + 1;
+                continue;
+            }
+            if (c != '$' || i + 1 >= raw.size()) { literal += c; i++; continue; }
+
+            char n = raw[i + 1];
+            if (n == '(' && i + 2 < raw.size() && raw[i + 2] == '(') {
+                size_t end = matchParen(raw, i + 1);
+                if (end != std::string::npos && raw[end - 2] == ')') {
+                    addLiteral(word, literal); literal.clear();
+                    WordSegment seg;
+                    seg.kind = SegmentKind::Arithmetic;
+                    seg.text = raw.substr(i + 3, end - i - 5);
+                    seg.inner = std::make_shared<CompiledWord>(compile(seg.text));
+                    word.segments.push_back(std::move(seg));
+                    i = end;
+                    continue;
+                }
+            }
+            if (n == '(') {
+                size_t end = matchParen(raw, i + 1);
+                if (end == std::string::npos) { literal += c; i++; continue; }
+                addLiteral(word, literal); literal.clear();
+                addSegment(word, SegmentKind::CommandSubst, raw.substr(i + 2, end - i - 3));
+                i = end;
+                continue;
+            }
+            if (n == '{') {
+                size_t end = raw.find('}', i + 2);
+                std::string name = end == std::string::npos ? "" : raw.substr(i + 2, end - i - 2);
+                if (name.empty()) { literal += c; i++; continue; }
+                addLiteral(word, literal); literal.clear();
+                if (isdigit((unsigned char)name[0])) addSegment(word, SegmentKind::Positional, "$" + name, std::stoi(name));
+                else addSegment(word, SegmentKind::Variable, name, ShellVars::NameTable::instance().intern(name));
+                i = end + 1;
+                continue;
+            }
+            if (isNameStart(n)) {
+                size_t end = i + 1;
+                while (end < raw.size() && isNameChar(raw[end])) end++;
+                std::string name = raw.substr(i + 1, end - i - 1);
+                addLiteral(word, literal); literal.clear();
+                addSegment(word, SegmentKind::Variable, name, ShellVars::NameTable::instance().intern(name));
+                i = end;
+                continue;
+            }
+            if (isdigit((unsigned char)n) || n == '#' || n == '@' || n == '?') {
+                addLiteral(word, literal); literal.clear();
+                if (n == '#') addSegment(word, SegmentKind::ArgCount, "$#");
+                else if (n == '@') addSegment(word, SegmentKind::AllArgs, "$@");
+                else if (n == '?') addSegment(word, SegmentKind::ExitCode, "$?");
+                else addSegment(word, SegmentKind::Positional, std::string("$") + n, n - '0');
+                i += 2;
+                continue;
+            }
+            literal += c;
+            i++;
+        }
+        addLiteral(word, literal);
+        return word;
+    }
+
+    static std::vector<CompiledWord> compileAll(const std::vector<std::string>& raws) {
+        std::vector<CompiledWord> words;
+        words.reserve(raws.size());
+        for (const auto& raw : raws) words.push_back(compile(raw));
+        return words;
+    }
+};
+
 // ============================================================================
 // AST NODES - Abstract Syntax Tree
 // ============================================================================
+
+// Node tag: the Executor switches on this instead of probing with dynamic casts
+enum class NodeKind : uint8_t {
+    Command, Pipeline, Compound, Assignment, If, For, While, Function, Case,
+    ErrorBlock, OrChain, AndChain, NegatedCommand, Break, Continue, Return
+};
+
 struct ASTNode {
+    const NodeKind kind;
+    explicit ASTNode(NodeKind k) : kind(k) {}
     virtual ~ASTNode() = default;
     virtual std::string type() const = 0;
 };
@@ -616,9 +791,12 @@ struct ASTNode {
 // Simple command: ls -la
 struct CommandNode : ASTNode {
     std::vector<std::string> args;  // First element is the command name
+    std::vector<CompiledWord> words;  // args, compiled
     std::vector<std::pair<std::string, std::string>> redirects;  // type, target
     bool background = false;
     
+    CommandNode() : ASTNode(NodeKind::Command) {}
+
     std::string type() const override { return "Command"; }
 };
 
@@ -626,6 +804,8 @@ struct CommandNode : ASTNode {
 struct PipelineNode : ASTNode {
     std::vector<std::shared_ptr<CommandNode>> commands;
     
+    PipelineNode() : ASTNode(NodeKind::Pipeline) {}
+
     std::string type() const override { return "Pipeline"; }
 };
 
@@ -634,6 +814,8 @@ struct CompoundNode : ASTNode {
     std::vector<std::shared_ptr<ASTNode>> nodes;
     std::vector<TokenType> operators;  // AND, OR, SEMICOLON
     
+    CompoundNode() : ASTNode(NodeKind::Compound) {}
+
     std::string type() const override { return "Compound"; }
 };
 
@@ -641,7 +823,11 @@ struct CompoundNode : ASTNode {
 struct AssignmentNode : ASTNode {
     std::string name;
     std::string value;
+    CompiledWord compiledValue;
+    int slot = -1;  // interned name; -1 for element assignments like arr[1]=x
     
+    AssignmentNode() : ASTNode(NodeKind::Assignment) {}
+
     std::string type() const override { return "Assignment"; }
 };
 
@@ -651,6 +837,8 @@ struct IfNode : ASTNode {
     std::vector<std::shared_ptr<ASTNode>> thenBody;
     std::vector<std::shared_ptr<ASTNode>> elseBody;
     
+    IfNode() : ASTNode(NodeKind::If) {}
+
     std::string type() const override { return "If"; }
 };
 
@@ -658,8 +846,12 @@ struct IfNode : ASTNode {
 struct ForNode : ASTNode {
     std::string variable;
     std::vector<std::string> values;
+    std::vector<CompiledWord> compiledValues;
+    int variableSlot = -1;
     std::vector<std::shared_ptr<ASTNode>> body;
     
+    ForNode() : ASTNode(NodeKind::For) {}
+
     std::string type() const override { return "For"; }
 };
 
@@ -668,6 +860,8 @@ struct WhileNode : ASTNode {
     std::shared_ptr<ASTNode> condition;
     std::vector<std::shared_ptr<ASTNode>> body;
     
+    WhileNode() : ASTNode(NodeKind::While) {}
+
     std::string type() const override { return "While"; }
 };
 
@@ -676,13 +870,19 @@ struct FunctionNode : ASTNode {
     std::string name;
     std::vector<std::shared_ptr<ASTNode>> body;
     
+    FunctionNode() : ASTNode(NodeKind::Function) {}
+
     std::string type() const override { return "Function"; }
 };
 
 struct CaseNode : ASTNode {
     std::string expression;  // The value to match against
     std::vector<std::pair<std::vector<std::string>, std::vector<std::shared_ptr<ASTNode>>>> branches;  // patterns -> body
+    CompiledWord compiledExpression;
+    std::vector<std::vector<CompiledWord>> compiledPatterns;  // parallel to branches
     
+    CaseNode() : ASTNode(NodeKind::Case) {}
+
     std::string type() const override { return "Case"; }
 };
 
@@ -690,6 +890,8 @@ struct ErrorBlockNode : ASTNode {
     std::shared_ptr<ASTNode> command;
     std::vector<std::shared_ptr<ASTNode>> errorHandler;
     
+    ErrorBlockNode() : ASTNode(NodeKind::ErrorBlock) {}
+
     std::string type() const override { return "ErrorBlock"; }
 };
 
@@ -697,6 +899,8 @@ struct OrChainNode : ASTNode {
     std::shared_ptr<ASTNode> left;
     std::shared_ptr<ASTNode> right;
     
+    OrChainNode() : ASTNode(NodeKind::OrChain) {}
+
     std::string type() const override { return "OrChain"; }
 };
 
@@ -704,6 +908,8 @@ struct AndChainNode : ASTNode {
     std::shared_ptr<ASTNode> left;
     std::shared_ptr<ASTNode> right;
     
+    AndChainNode() : ASTNode(NodeKind::AndChain) {}
+
     std::string type() const override { return "AndChain"; }
 };
 
@@ -711,24 +917,109 @@ struct AndChainNode : ASTNode {
 struct NegatedCommandNode : ASTNode {
     std::shared_ptr<ASTNode> command;
     
+    NegatedCommandNode() : ASTNode(NodeKind::NegatedCommand) {}
+
     std::string type() const override { return "NegatedCommand"; }
 };
 
 struct BreakNode : ASTNode {
     int levels = 1;
+    BreakNode() : ASTNode(NodeKind::Break) {}
     std::string type() const override { return "Break"; }
 };
 
 struct ContinueNode : ASTNode {
     int levels = 1;
+    ContinueNode() : ASTNode(NodeKind::Continue) {}
     std::string type() const override { return "Continue"; }
 };
 
 struct ReturnNode : ASTNode {
     int value = 0;
+    ReturnNode() : ASTNode(NodeKind::Return) {}
     std::string type() const override { return "Return"; }
 };
 
+// Parse-time pass: compiles every word the Executor will expand
+inline void compileNodeWords(ASTNode* node) {
+    if (!node) return;
+    switch (node->kind) {
+        case NodeKind::Command: {
+            auto* cmd = static_cast<CommandNode*>(node);
+            cmd->words = WordCompiler::compileAll(cmd->args);
+            break;
+        }
+        case NodeKind::Pipeline:
+            for (auto& cmd : static_cast<PipelineNode*>(node)->commands) compileNodeWords(cmd.get());
+            break;
+        case NodeKind::Compound:
+            for (auto& child : static_cast<CompoundNode*>(node)->nodes) compileNodeWords(child.get());
+            break;
+        case NodeKind::Assignment: {
+            auto* assign = static_cast<AssignmentNode*>(node);
+            assign->compiledValue = WordCompiler::compile(assign->value);
+            if (assign->name.find('[') == std::string::npos) {
+                assign->slot = ShellVars::NameTable::instance().intern(assign->name);
+            }
+            break;
+        }
+        case NodeKind::If: {
+            auto* ifNode = static_cast<IfNode*>(node);
+            compileNodeWords(ifNode->condition.get());
+            for (auto& stmt : ifNode->thenBody) compileNodeWords(stmt.get());
+            for (auto& stmt : ifNode->elseBody) compileNodeWords(stmt.get());
+            break;
+        }
+        case NodeKind::For: {
+            auto* forNode = static_cast<ForNode*>(node);
+            forNode->compiledValues = WordCompiler::compileAll(forNode->values);
+            forNode->variableSlot = ShellVars::NameTable::instance().intern(forNode->variable);
+            for (auto& stmt : forNode->body) compileNodeWords(stmt.get());
+            break;
+        }
+        case NodeKind::While: {
+            auto* whileNode = static_cast<WhileNode*>(node);
+            compileNodeWords(whileNode->condition.get());
+            for (auto& stmt : whileNode->body) compileNodeWords(stmt.get());
+            break;
+        }
+        case NodeKind::Function:
+            for (auto& stmt : static_cast<FunctionNode*>(node)->body) compileNodeWords(stmt.get());
+            break;
+        case NodeKind::Case: {
+            auto* caseNode = static_cast<CaseNode*>(node);
+            caseNode->compiledExpression = WordCompiler::compile(caseNode->expression);
+            caseNode->compiledPatterns.clear();
+            for (auto& branch : caseNode->branches) {
+                caseNode->compiledPatterns.push_back(WordCompiler::compileAll(branch.first));
+                for (auto& stmt : branch.second) compileNodeWords(stmt.get());
+            }
+            break;
+        }
+        case NodeKind::ErrorBlock: {
+            auto* errBlock = static_cast<ErrorBlockNode*>(node);
+            compileNodeWords(errBlock->command.get());
+            for (auto& stmt : errBlock->errorHandler) compileNodeWords(stmt.get());
+            break;
+        }
+        case NodeKind::OrChain:
+            compileNodeWords(static_cast<OrChainNode*>(node)->left.get());
+            compileNodeWords(static_cast<OrChainNode*>(node)->right.get());
+            break;
+        case NodeKind::AndChain:
+            compileNodeWords(static_cast<AndChainNode*>(node)->left.get());
+            compileNodeWords(static_cast<AndChainNode*>(node)->right.get());
+            break;
+        case NodeKind::NegatedCommand:
+            compileNodeWords(static_cast<NegatedCommandNode*>(node)->command.get());
+            break;
+        case NodeKind::Break:
+        case NodeKind::Continue:
+        case NodeKind::Return:
+            break;
+    }
+}
+
 class BreakException : public std::exception {
 public:
     int levels;
@@ -747,6 +1038,13 @@ public:
     ReturnException(int v = 0) : value(v) {}
 };
 
+// Thrown by the exit builtin; whoever owns the shell process decides what exiting means
+class ExitException : public std::exception {
+public:
+    int code;
+    ExitException(int c = 0) : code(c) {}
+};
+
 // ============================================================================
 // PARSER - Builds AST from tokens
 // ============================================================================
@@ -1308,7 +1606,7 @@ private:
                 node->value = current().value;
                 advance();
             }
-            else if (node->value.empty() && (check(TokenType::WORD) || check(TokenType::NUMBER))) {
+            else if (node->value.empty() && (check(TokenType::WORD) || check(TokenType::NUMBER) || check(TokenType::VARIABLE))) {
                 node->value = current().value;
                 advance();
             }
@@ -1366,6 +1664,7 @@ public:
             
             auto stmt = parseStatement();
             if (stmt) {
+                compileNodeWords(stmt.get());
                 program.push_back(stmt);
             } else if (pos == posBefore) {
                 // parseStatement didn't advance and returned null - skip token to avoid infinite loop
@@ -1385,12 +1684,45 @@ public:
 // ============================================================================
 // EXECUTOR - Executes AST
 // ============================================================================
+// Redirects std::cout into a string buffer for the lifetime of the scope.
+// Command substitution runs builtins, functions and shell constructs in-process
+// and reads their output back from here; `depth` tells external commands to pipe
+// their stdout into the buffer instead of inheriting the console.
+class OutputCapture {
+private:
+    std::ostringstream buffer;
+    std::streambuf* previous;
+    int& depth;
+
+public:
+    explicit OutputCapture(int& captureDepth) : previous(std::cout.rdbuf()), depth(captureDepth) {
+        std::cout.flush();
+        std::cout.rdbuf(buffer.rdbuf());
+        depth++;
+    }
+
+    ~OutputCapture() {
+        std::cout.rdbuf(previous);
+        depth--;
+    }
+
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+
+    std::string str() const { return buffer.str(); }
+};
+
+// Mutable, NUL-terminated copy of a command line for CreateProcessA (no fixed-size truncation)
+inline std::vector<char> commandLineBuffer(const std::string& cmdLine) {
+    std::vector<char> buffer(cmdLine.begin(), cmdLine.end());
+    buffer.push_back('\0');
+    return buffer;
+}
+
 class Executor {
 private:
-    std::map<std::string, std::string> _localVariables;
-    std::map<std::string, std::string>* _variableMap = &_localVariables; // Default to local
-    std::map<std::string, std::vector<std::string>> _localArrays;
-    std::map<std::string, std::vector<std::string>>* _arrayMap = &_localArrays; // Default to local array map
+    ShellVars::VariableStore _localVariables;
+    ShellVars::VariableStore* _variables = &_localVariables; // Default to local
     std::function<std::string(std::string, bool)> _inputCallback;
 
     std::map<std::string, std::vector<std::shared_ptr<ASTNode>>> functions;
@@ -1399,6 +1731,8 @@ private:
     std::string currentDir;
     bool debugMode = false;  // Set true for debug output
     bool exitOnError = false;  // set -e mode
+    int captureDepth = 0;      // > 0 while running inside $(...)
+    std::unordered_map<std::string, std::vector<std::shared_ptr<ASTNode>>> substitutionCache;  // $(...) text -> parsed program
     
     // Timeout protection
     std::chrono::steady_clock::time_point startTime;
@@ -1477,7 +1811,7 @@ private:
                 if (eq != std::string::npos) {
                     std::string name = args[i].substr(0, eq);
                     std::string value = args[i].substr(eq + 1);
-                    (*_variableMap)[name] = value;
+                    _variables->set(name, value);
                     SetEnvironmentVariableA(name.c_str(), value.c_str());
                 }
             }
@@ -1501,7 +1835,24 @@ private:
         };
         builtins["declare"] = declareFunc;
         builtins["typeset"] = declareFunc;
-        builtins["local"] = declareFunc; 
+        
+        // local NAME[=value]: binding lives until the enclosing function returns
+        builtins["local"] = [this](const std::vector<std::string>& args) {
+            for (size_t i = 1; i < args.size(); i++) {
+                if (args[i][0] == '-') continue;
+                
+                size_t eq = args[i].find('=');
+                std::string name = args[i].substr(0, eq);
+                if (!_variables->declareLocal(name)) {
+                    std::cerr << "local: can only be used in a function\n";
+                    return 1;
+                }
+                if (eq != std::string::npos) {
+                    setVariable(name, expandVariables(args[i].substr(eq + 1)));
+                }
+            }
+            return 0;
+        };
         
         builtins["cd"] = [this](const std::vector<std::string>& args) {
             std::string path = args.size() > 1 ? args[1] : std::string(getenv("USERPROFILE") ? getenv("USERPROFILE") : ".");
@@ -1515,10 +1866,8 @@ private:
             return 1;
         };
         
-        builtins["exit"] = [](const std::vector<std::string>& args) {
-            int code = args.size() > 1 ? std::stoi(args[1]) : 0;
-            exit(code);
-            return code;
+        builtins["exit"] = [](const std::vector<std::string>& args) -> int {
+            throw ExitException(args.size() > 1 ? std::stoi(args[1]) : 0);
         };
         
         builtins["set"] = [this](const std::vector<std::string>& args) {
@@ -1530,7 +1879,7 @@ private:
                     else if (args[i] == "+x") debugMode = false;
                 }
             } else {
-                for (const auto& [name, value] : *_variableMap) {
+                for (const auto& [name, value] : _variables->entries()) {
                     std::cout << name << "=" << value << "\n";
                 }
             }
@@ -1567,11 +1916,11 @@ private:
             std::string line;
             if (_inputCallback) {
                 line = _inputCallback(prompt, silent);
-                (*_variableMap)[varName] = line;
+                _variables->set(varName, line);
                 return 0;
             } else {
                 if (ShellIO::sin.getline(line)) {
-                    (*_variableMap)[varName] = line;
+                    _variables->set(varName, line);
                     if (!silent && prompt.empty()) ShellIO::sout << "\n";
                     return 0;
                 }
@@ -1713,8 +2062,75 @@ private:
     }
     
     public:
-    // Execute a command and capture its output (for command substitution) using anonymous pipes
+    // Command substitution: parse the command and run it in this process with std::cout
+    // captured. Only genuine external programs get a process (see executeExternalWithRedirects).
+    // Like a subshell, variable assignments and cd inside $(...) do not leak out.
     std::string executeAndCapture(const std::string& command) {
+        std::vector<std::shared_ptr<ASTNode>> program;
+        auto cached = substitutionCache.find(command);
+        if (cached != substitutionCache.end()) {
+            program = cached->second;
+        } else {
+            try {
+                Lexer lexer(command);
+                Parser parser(lexer.tokenize(), command);
+                program = parser.parse();
+            } catch (const std::exception&) {
+                return spawnAndCapture(command);
+            }
+            if (substitutionCache.size() >= 256) substitutionCache.clear();
+            substitutionCache.emplace(command, program);
+        }
+        
+        ShellVars::VariableStore savedVariables = *_variables;  // copy-on-write: shares every value
+        std::string savedDir = currentDir;
+        std::string result;
+        {
+            OutputCapture capture(captureDepth);
+            try {
+                for (auto& node : program) {
+                    execute(node.get());
+                }
+            } catch (BreakException&) {
+            } catch (ContinueException&) {
+            } catch (ReturnException& e) {
+                lastExitCode = e.value;
+            } catch (ExitException& e) {
+                lastExitCode = e.code;  // exit leaves the substitution, not the shell
+            } catch (...) {
+                *_variables = std::move(savedVariables);
+                throw;
+            }
+            result = capture.str();
+        }
+        *_variables = std::move(savedVariables);
+        if (currentDir != savedDir) {
+            currentDir = savedDir;
+            SetCurrentDirectoryA(currentDir.c_str());
+        }
+        
+        // Trim trailing newlines
+        while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) {
+            result.pop_back();
+        }
+        return result;
+    }
+    
+    bool isCapturing() const { return captureDepth > 0; }
+    
+    private:
+    // Copies an external process' stdout pipe into the active capture buffer
+    void drainToCapture(HANDLE hRead) {
+        char chBuf[4096];
+        DWORD dwRead;
+        while (ReadFile(hRead, chBuf, sizeof(chBuf), &dwRead, NULL) && dwRead > 0) {
+            std::cout.write(chBuf, dwRead);
+        }
+        CloseHandle(hRead);
+    }
+    
+    // Fallback for command text the parser rejects: run it through a child shell using anonymous pipes
+    std::string spawnAndCapture(const std::string& command) {
         HANDLE hReadPipe, hWritePipe;
         SECURITY_ATTRIBUTES saAttr;
         saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
@@ -1732,7 +2148,7 @@ private:
         PROCESS_INFORMATION pi;
         ZeroMemory(&si, sizeof(si));
         si.cb = sizeof(si);
-        si.hStdError = hWritePipe; // Redirect stderr to same pipe
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);  // only stdout is the value
         si.hStdOutput = hWritePipe;
         si.dwFlags |= STARTF_USESTDHANDLES;
         ZeroMemory(&pi, sizeof(pi));
@@ -1744,10 +2160,9 @@ private:
         
         // Use double quotes for safety
         std::string cmdLine = "\"" + std::string(modulePath) + "\" -c \"" + command + "\"";
-        char cmdBuffer[8192];
-        strncpy_s(cmdBuffer, cmdLine.c_str(), sizeof(cmdBuffer) - 1);
+        std::vector<char> cmdBuffer = commandLineBuffer(cmdLine);
 
-        if (CreateProcessA(NULL, cmdBuffer, NULL, NULL, TRUE, 0, NULL, currentDir.c_str(), &si, &pi)) {
+        if (CreateProcessA(NULL, cmdBuffer.data(), NULL, NULL, TRUE, 0, NULL, currentDir.c_str(), &si, &pi)) {
             CloseHandle(hWritePipe); // Close write end in parent
 
             // Read output
@@ -1780,6 +2195,7 @@ private:
         return "";
     }
     
+    public:
     // Expand variables in a string
     std::string expandVariables(const std::string& input) {
         std::string result = input;
@@ -1836,8 +2252,8 @@ private:
                     varValue = positionalArgsStack.back()[idx];
                 }
             } else {
-                if (_variableMap->count(varName)) {
-                    varValue = (*_variableMap)[varName];
+                if (const std::string* value = _variables->get(varName)) {
+                    varValue = *value;
                 } else {
                     char* envVal = getenv(varName.c_str());
                     if (envVal) varValue = envVal;
@@ -1871,10 +2287,9 @@ private:
                 std::string varValue;
                 try {
                     size_t idx = std::stoul(idxStr);
-                    if (_arrayMap->count(varName)) {
-                        const auto& arr = (*_arrayMap)[varName];
-                        if (idx < arr.size()) {
-                            varValue = arr[idx];
+                    if (const auto* arr = _variables->getArray(varName)) {
+                        if (idx < arr->size()) {
+                            varValue = (*arr)[idx];
                         }
                     }
                 } catch (...) {}
@@ -1896,8 +2311,8 @@ private:
             std::string varName = match[1];
             std::string varValue;
             
-            if (_variableMap->count(varName)) {
-                varValue = (*_variableMap)[varName];
+            if (const std::string* value = _variables->get(varName)) {
+                varValue = *value;
             } else {
                 char* envVal = getenv(varName.c_str());
                 if (envVal) varValue = envVal;
@@ -2034,12 +2449,11 @@ private:
         si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
         ZeroMemory(&pi, sizeof(pi));
         
-        char cmdBuffer[8192];
-        strncpy_s(cmdBuffer, cmdLine.c_str(), sizeof(cmdBuffer) - 1);
+        std::vector<char> cmdBuffer = commandLineBuffer(cmdLine);
         
         if (!CreateProcessA(
             NULL,
-            cmdBuffer,
+            cmdBuffer.data(),
             NULL,
             NULL,
             TRUE,   // Inherit handles
@@ -2091,6 +2505,21 @@ private:
         HANDLE hInputFile = NULL;
         HANDLE hOutputFile = NULL;
         HANDLE hErrorFile = NULL;
+        
+        // Inside $(...) stdout goes to a pipe feeding the capture buffer (file redirects still win)
+        HANDLE hCaptureRead = NULL, hCaptureWrite = NULL;
+        if (isCapturing()) {
+            SECURITY_ATTRIBUTES saAttr;
+            saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+            saAttr.bInheritHandle = TRUE;
+            saAttr.lpSecurityDescriptor = NULL;
+            if (CreatePipe(&hCaptureRead, &hCaptureWrite, &saAttr, 0)) {
+                SetHandleInformation(hCaptureRead, HANDLE_FLAG_INHERIT, 0);
+                si.hStdOutput = hCaptureWrite;
+            } else {
+                hCaptureRead = hCaptureWrite = NULL;
+            }
+        }
 
         // Process redirects - this supports simple redirection natively
         for (const auto& redir : redirects) {
@@ -2135,12 +2564,11 @@ private:
 
         ZeroMemory(&pi, sizeof(pi));
         
-        char cmdBuffer[8192];
-        strncpy_s(cmdBuffer, cmdLine.c_str(), sizeof(cmdBuffer) - 1);
+        std::vector<char> cmdBuffer = commandLineBuffer(cmdLine);
         
         if (!CreateProcessA(
             NULL,
-            cmdBuffer,
+            cmdBuffer.data(),
             NULL,
             NULL,
             TRUE,   // Inherit handles is CRITICAL here
@@ -2154,9 +2582,16 @@ private:
             if (hInputFile) CloseHandle(hInputFile);
             if (hOutputFile) CloseHandle(hOutputFile);
             if (hErrorFile) CloseHandle(hErrorFile);
+            if (hCaptureRead) CloseHandle(hCaptureRead);
+            if (hCaptureWrite) CloseHandle(hCaptureWrite);
             return 127;
         }
         
+        if (hCaptureWrite) {
+            CloseHandle(hCaptureWrite);  // the child holds the only write end now
+            drainToCapture(hCaptureRead);
+        }
+        
         WaitForSingleObject(pi.hProcess, INFINITE);
         DWORD exitCode;
         GetExitCodeProcess(pi.hProcess, &exitCode);
@@ -2175,7 +2610,7 @@ private:
     // Moved to top of class
     
 public:
-    Executor() : startTime(std::chrono::steady_clock::now()), _variableMap(&_localVariables) {
+    Executor() : startTime(std::chrono::steady_clock::now()) {
         char buf[MAX_PATH];
         GetCurrentDirectoryA(MAX_PATH, buf);
         currentDir = buf;
@@ -2195,21 +2630,12 @@ public:
         };
     }
     
-    // Bind external variable map
-    void bindVariables(std::map<std::string, std::string>* vars) {
+    // Bind external variable store (scalars and arrays)
+    void bindVariables(ShellVars::VariableStore* vars) {
         if (vars) {
-            _variableMap = vars;
-        } else {
-            _variableMap = &_localVariables;
-        }
-    }
-
-    // Bind external array map
-    void bindArrays(std::map<std::string, std::vector<std::string>>* arrays) {
-        if (arrays) {
-            _arrayMap = arrays;
+            _variables = vars;
         } else {
-            _arrayMap = &_localArrays;
+            _variables = &_localVariables;
         }
     }
 
@@ -2235,20 +2661,18 @@ public:
             std::string idxStr = name.substr(openBracket + 1, name.size() - openBracket - 2);
             try {
                 size_t idx = std::stoul(idxStr);
-                if ((*_arrayMap)[arrName].size() <= idx) {
-                    (*_arrayMap)[arrName].resize(idx + 1);
-                }
-                (*_arrayMap)[arrName][idx] = value;
+                _variables->setArrayElement(arrName, idx, value);
                 return;
             } catch (...) {
                  // Invalid index parsing, fall through to scalar
             }
         }
-        (*_variableMap)[name] = value;
+        _variables->set(name, value);
     }
     
     std::string getVariable(const std::string& name) {
-        return _variableMap->count(name) ? (*_variableMap)[name] : "";
+        const std::string* value = _variables->get(name);
+        return value ? *value : "";
     }
     
     void setScriptArgs(const std::vector<std::string>& args) {
@@ -2262,7 +2686,105 @@ public:
         }
     }
     
-    int execute(std::shared_ptr<ASTNode> node) {
+    std::string lookupVariable(const std::string& name) {
+        if (const std::string* value = _variables->get(name)) return *value;
+        char* envVal = getenv(name.c_str());
+        return envVal ? std::string(envVal) : std::string();
+    }
+    
+    // Expand a parse-time compiled word: one pass over its segments, no regex scanning
+    std::string expandWord(const CompiledWord& word) {
+        if (word.segments.size() == 1 && word.segments[0].kind == SegmentKind::Literal) {
+            return word.segments[0].text;
+        }
+        
+        std::string result;
+        for (const auto& seg : word.segments) {
+            switch (seg.kind) {
+                case SegmentKind::Literal:
+                    result += seg.text;
+                    break;
+                case SegmentKind::Variable:
+                    if (const std::string* value = _variables->get(seg.slot)) {
+                        result += *value;
+                    } else if (const char* envVal = getenv(seg.text.c_str())) {
+                        result += envVal;
+                    }
+                    break;
+                case SegmentKind::Positional:
+                    // Outside a function $N is left as written, as expandVariables does
+                    if (positionalArgsStack.empty()) result += seg.text;
+                    else if ((size_t)seg.slot < positionalArgsStack.back().size()) result += positionalArgsStack.back()[seg.slot];
+                    break;
+                case SegmentKind::ArgCount:
+                    if (positionalArgsStack.empty()) result += seg.text;
+                    else {
+                        size_t count = positionalArgsStack.back().size();
+                        result += std::to_string(count > 0 ? count - 1 : 0);
+                    }
+                    break;
+                case SegmentKind::AllArgs:
+                    if (positionalArgsStack.empty()) result += seg.text;
+                    else {
+                        const auto& args = positionalArgsStack.back();
+                        for (size_t i = 1; i < args.size(); i++) {
+                            if (i > 1) result += " ";
+                            result += args[i];
+                        }
+                    }
+                    break;
+                case SegmentKind::ExitCode:
+                    result += std::to_string(lastExitCode);
+                    break;
+                case SegmentKind::CommandSubst:
+                    result += executeAndCapture(seg.text);
+                    break;
+                case SegmentKind::Arithmetic: {
+                    std::string expr = expandWord(*seg.inner);
+                    // Bare names inside $((...)) read the variable, unset ones count as 0
+                    std::string resolved;
+                    for (size_t i = 0; i < expr.size();) {
+                        if (isalpha((unsigned char)expr[i]) || expr[i] == '_') {
+                            size_t end = i;
+                            while (end < expr.size() && (isalnum((unsigned char)expr[end]) || expr[end] == '_')) end++;
+                            std::string value = lookupVariable(expr.substr(i, end - i));
+                            resolved += value.empty() ? "0" : value;
+                            i = end;
+                        } else {
+                            resolved += expr[i++];
+                        }
+                    }
+                    expr = resolved;
+                    try {
+                        result += Arith::evaluate(expr);
+                    } catch (const std::exception& e) {
+                        std::cerr << "lish: $((" << expr << ")): " << e.what() << "\n";
+                    }
+                    break;
+                }
+                case SegmentKind::Legacy:
+                    result += expandVariables(seg.text);
+                    break;
+            }
+        }
+        return result;
+    }
+    
+    std::vector<std::string> expandWords(const std::vector<CompiledWord>& words) {
+        std::vector<std::string> expanded;
+        expanded.reserve(words.size());
+        for (const auto& word : words) {
+            expanded.push_back(expandWord(word));
+        }
+        return expanded;
+    }
+    
+    int execute(const std::shared_ptr<ASTNode>& node) {
+        return execute(node.get());
+    }
+    
+    // Dispatches on the node tag; words were compiled by the parser, so expansion never re-scans source text
+    int execute(ASTNode* node) {
         if (!node) return 0;
         
         checkExecutionLimits();  // Timeout and iteration protection
@@ -2271,380 +2793,419 @@ public:
             std::cout << "[DEBUG] Executing: " << node->type() << "\n";
         }
         
-        // Assignment
-        if (auto assign = std::dynamic_pointer_cast<AssignmentNode>(node)) {
-            setVariable(assign->name, expandVariables(assign->value));
-            return 0;
-        }
+        switch (node->kind) {
+            // Assignment
+            case NodeKind::Assignment: {
+                auto* assign = static_cast<AssignmentNode*>(node);
+                if (assign->slot >= 0) _variables->set(assign->slot, expandWord(assign->compiledValue));
+                else setVariable(assign->name, expandWord(assign->compiledValue));
+                return 0;
+            }
         
-        // Command
-        if (auto cmd = std::dynamic_pointer_cast<CommandNode>(node)) {
-            if (cmd->args.empty()) return 0;
+            // Command
+            case NodeKind::Command: {
+                auto* cmd = static_cast<CommandNode*>(node);
+                if (cmd->args.empty()) return 0;
             
-            // Expand variables in all arguments
-            std::vector<std::string> expandedArgs;
-            for (const auto& arg : cmd->args) {
-                expandedArgs.push_back(expandVariables(arg));
-            }
+                // Expand variables in all arguments
+                std::vector<std::string> expandedArgs = expandWords(cmd->words);
             
-            std::string cmdName = expandedArgs[0];
+                std::string cmdName = expandedArgs[0];
             
-            if (debugMode) {
-                std::cerr << "[DEBUG EXEC] Command: " << cmdName;
-                for (size_t i = 1; i < expandedArgs.size() && i < 4; i++) {
-                    std::cerr << " " << expandedArgs[i];
+                if (debugMode) {
+                    std::cerr << "[DEBUG EXEC] Command: " << cmdName;
+                    for (size_t i = 1; i < expandedArgs.size() && i < 4; i++) {
+                        std::cerr << " " << expandedArgs[i];
+                    }
+                    if (expandedArgs.size() > 4) std::cerr << " ...";
+                    std::cerr << "\n";
+                    std::cerr.flush();
                 }
-                if (expandedArgs.size() > 4) std::cerr << " ...";
-                std::cerr << "\n";
-                std::cerr.flush();
-            }
             
-            // Check built-ins (but not if there are redirections that need special handling)
-            if (builtins.count(cmdName) && cmd->redirects.empty()) {
-                lastExitCode = builtins[cmdName](expandedArgs);
-                return lastExitCode;
-            }
+                // Check built-ins (but not if there are redirections that need special handling)
+                if (builtins.count(cmdName) && cmd->redirects.empty()) {
+                    lastExitCode = builtins[cmdName](expandedArgs);
+                    return lastExitCode;
+                }
             
-            // Handle built-ins with redirections by saving/restoring stdout
-            if (builtins.count(cmdName) && !cmd->redirects.empty()) {
-                FILE* savedStdout = nullptr;
-                FILE* savedStderr = nullptr;
-                bool hasStdoutRedir = false;
-                bool hasStderrRedir = false;
-                bool mergeStderr = false;
-                std::string stdoutFile, stderrFile;
-                bool appendStdout = false, appendStderr = false;
+                // Handle built-ins with redirections by saving/restoring stdout
+                if (builtins.count(cmdName) && !cmd->redirects.empty()) {
+                    FILE* savedStdout = nullptr;
+                    FILE* savedStderr = nullptr;
+                    bool hasStdoutRedir = false;
+                    bool hasStderrRedir = false;
+                    bool mergeStderr = false;
+                    std::string stdoutFile, stderrFile;
+                    bool appendStdout = false, appendStderr = false;
                 
-                for (const auto& redir : cmd->redirects) {
-                    if (redir.first == ">" || redir.first == ">>") {
-                        stdoutFile = redir.second;
-                        appendStdout = (redir.first == ">>");
-                        hasStdoutRedir = true;
-                    } else if (redir.first == "2>" || redir.first == "2>>") {
-                        stderrFile = redir.second;
-                        appendStderr = (redir.first == "2>>");
-                        hasStderrRedir = true;
-                    } else if (redir.first == "2>&1" || redir.first == "&>") {
-                        mergeStderr = true;
-                        if (redir.first == "&>") {
+                    for (const auto& redir : cmd->redirects) {
+                        if (redir.first == ">" || redir.first == ">>") {
                             stdoutFile = redir.second;
+                            appendStdout = (redir.first == ">>");
                             hasStdoutRedir = true;
+                        } else if (redir.first == "2>" || redir.first == "2>>") {
+                            stderrFile = redir.second;
+                            appendStderr = (redir.first == "2>>");
+                            hasStderrRedir = true;
+                        } else if (redir.first == "2>&1" || redir.first == "&>") {
+                            mergeStderr = true;
+                            if (redir.first == "&>") {
+                                stdoutFile = redir.second;
+                                hasStdoutRedir = true;
+                            }
                         }
                     }
-                }
                 
-                if (hasStdoutRedir) {
-                    savedStdout = freopen(stdoutFile.c_str(), appendStdout ? "a" : "w", stdout);
-                }
-                if (hasStderrRedir && !mergeStderr) {
-                    savedStderr = freopen(stderrFile.c_str(), appendStderr ? "a" : "w", stderr);
-                }
-                if (mergeStderr && hasStdoutRedir) {
-                    _dup2(_fileno(stdout), _fileno(stderr));
-                }
+                    if (hasStdoutRedir) {
+                        savedStdout = freopen(stdoutFile.c_str(), appendStdout ? "a" : "w", stdout);
+                    }
+                    if (hasStderrRedir && !mergeStderr) {
+                        savedStderr = freopen(stderrFile.c_str(), appendStderr ? "a" : "w", stderr);
+                    }
+                    if (mergeStderr && hasStdoutRedir) {
+                        _dup2(_fileno(stdout), _fileno(stderr));
+                    }
                 
-                lastExitCode = builtins[cmdName](expandedArgs);
+                    lastExitCode = builtins[cmdName](expandedArgs);
                 
-                if (savedStdout) freopen("CON", "w", stdout);
-                if (savedStderr) freopen("CON", "w", stderr);
-                return lastExitCode;
-            }
+                    if (savedStdout) freopen("CON", "w", stdout);
+                    if (savedStderr) freopen("CON", "w", stderr);
+                    return lastExitCode;
+                }
             
-            if (functions.count(cmdName)) {
-                positionalArgsStack.push_back(expandedArgs);
+                if (functions.count(cmdName)) {
+                    positionalArgsStack.push_back(expandedArgs);
                 
-                try {
-                    for (auto& stmt : functions[cmdName]) {
-                        lastExitCode = execute(stmt);
+                    try {
+                        ShellVars::FrameScope frame(*_variables);  // scope for `local`
+                        for (auto& stmt : functions[cmdName]) {
+                            lastExitCode = execute(stmt.get());
+                        }
+                    } catch (ReturnException& e) {
+                        lastExitCode = e.value;
                     }
-                } catch (ReturnException& e) {
-                    lastExitCode = e.value;
-                }
                 
-                positionalArgsStack.pop_back();
-                return lastExitCode;
-            }
-            
-            // Try fallback handler (e.g. for ShellLogic internal commands)
-            if (fallbackHandler) {
-                int result = fallbackHandler(expandedArgs);
-                if (result != -1) {
-                    lastExitCode = result;
+                    positionalArgsStack.pop_back();
                     return lastExitCode;
                 }
-            }
             
-            // External command - apply redirections to command line
-            lastExitCode = executeExternalWithRedirects(expandedArgs, cmd->redirects);
-            return lastExitCode;
-        }
-        
-        // Pipeline
-        if (auto pipeline = std::dynamic_pointer_cast<PipelineNode>(node)) {
-            if (pipeline->commands.size() == 1) {
-                return execute(pipeline->commands[0]);
+                // Try fallback handler (e.g. for ShellLogic internal commands)
+                if (fallbackHandler) {
+                    int result = fallbackHandler(expandedArgs);
+                    if (result != -1) {
+                        lastExitCode = result;
+                        return lastExitCode;
+                    }
+                }
+            
+                // External command - apply redirections to command line
+                lastExitCode = executeExternalWithRedirects(expandedArgs, cmd->redirects);
+                return lastExitCode;
             }
+        
+            // Pipeline
+            case NodeKind::Pipeline: {
+                auto* pipeline = static_cast<PipelineNode*>(node);
+                if (pipeline->commands.size() == 1) {
+                    return execute(pipeline->commands[0].get());
+                }
             
-            // For multi-command pipeline, execute using native Windows pipes
-            std::vector<std::string> pipeCmds;
-            for (const auto& cmdNode : pipeline->commands) {
-                std::string fullCmd;
-                for (const auto& arg : cmdNode->args) {
-                     if (!fullCmd.empty()) fullCmd += " ";
-                     fullCmd += expandVariables(arg);
+                // For multi-command pipeline, execute using native Windows pipes
+                std::vector<std::string> pipeCmds;
+                for (const auto& cmdNode : pipeline->commands) {
+                    std::string fullCmd;
+                    for (const auto& word : cmdNode->words) {
+                         if (!fullCmd.empty()) fullCmd += " ";
+                         fullCmd += expandWord(word);
+                    }
+                    pipeCmds.push_back(fullCmd);
                 }
-                pipeCmds.push_back(fullCmd);
-            }
             
-            if (pipeCmds.empty()) return 0;
+                if (pipeCmds.empty()) return 0;
             
-            std::vector<HANDLE> processes;
-            std::vector<HANDLE> threads;
-            HANDLE hPrevReadPipe = NULL;
+                std::vector<HANDLE> processes;
+                std::vector<HANDLE> threads;
+                HANDLE hPrevReadPipe = NULL;
 
-            // Save original console handles
-            HANDLE hConsoleIn = GetStdHandle(STD_INPUT_HANDLE);
-            HANDLE hConsoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
-            HANDLE hConsoleErr = GetStdHandle(STD_ERROR_HANDLE);
+                // Save original console handles
+                HANDLE hConsoleIn = GetStdHandle(STD_INPUT_HANDLE);
+                HANDLE hConsoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
+                HANDLE hConsoleErr = GetStdHandle(STD_ERROR_HANDLE);
+                
+                // Inside $(...) the last stage writes into the capture buffer
+                HANDLE hCaptureRead = NULL, hCaptureWrite = NULL;
+                if (isCapturing()) {
+                    SECURITY_ATTRIBUTES saAttr;
+                    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+                    saAttr.bInheritHandle = TRUE;
+                    saAttr.lpSecurityDescriptor = NULL;
+                    if (CreatePipe(&hCaptureRead, &hCaptureWrite, &saAttr, 0)) {
+                        SetHandleInformation(hCaptureRead, HANDLE_FLAG_INHERIT, 0);
+                        hConsoleOut = hCaptureWrite;
+                    } else {
+                        hCaptureRead = hCaptureWrite = NULL;
+                    }
+                }
 
-            for (size_t i = 0; i < pipeCmds.size(); i++) {
-                SECURITY_ATTRIBUTES saAttr;
-                saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-                saAttr.bInheritHandle = TRUE;
-                saAttr.lpSecurityDescriptor = NULL;
+                for (size_t i = 0; i < pipeCmds.size(); i++) {
+                    SECURITY_ATTRIBUTES saAttr;
+                    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+                    saAttr.bInheritHandle = TRUE;
+                    saAttr.lpSecurityDescriptor = NULL;
                 
-                HANDLE hReadPipe = NULL, hWritePipe = NULL;
+                    HANDLE hReadPipe = NULL, hWritePipe = NULL;
                 
-                // Create pipe for output (except for last command)
-                if (i < pipeCmds.size() - 1) {
-                    if (!CreatePipe(&hReadPipe, &hWritePipe, &saAttr, 0)) {
-                        return -1;
+                    // Create pipe for output (except for last command)
+                    if (i < pipeCmds.size() - 1) {
+                        if (!CreatePipe(&hReadPipe, &hWritePipe, &saAttr, 0)) {
+                            return -1;
+                        }
+                        // Ensure read handle is inheritable, write handle is inheritable
                     }
-                    // Ensure read handle is inheritable, write handle is inheritable
-                }
                 
-                STARTUPINFOA si;
-                PROCESS_INFORMATION pi;
-                ZeroMemory(&si, sizeof(si));
-                si.cb = sizeof(si);
-                si.dwFlags = STARTF_USESTDHANDLES;
+                    STARTUPINFOA si;
+                    PROCESS_INFORMATION pi;
+                    ZeroMemory(&si, sizeof(si));
+                    si.cb = sizeof(si);
+                    si.dwFlags = STARTF_USESTDHANDLES;
                 
-                // Set stdin - from previous pipe or console
-                si.hStdInput = (hPrevReadPipe) ? hPrevReadPipe : hConsoleIn;
+                    // Set stdin - from previous pipe or console
+                    si.hStdInput = (hPrevReadPipe) ? hPrevReadPipe : hConsoleIn;
                 
-                // Set stdout - to next pipe or console
-                si.hStdOutput = (hWritePipe) ? hWritePipe : hConsoleOut;
+                    // Set stdout - to next pipe or console
+                    si.hStdOutput = (hWritePipe) ? hWritePipe : hConsoleOut;
                 
-                // Set stderr - shared
-                si.hStdError = hConsoleErr;
+                    // Set stderr - shared
+                    si.hStdError = hConsoleErr;
                 
-                ZeroMemory(&pi, sizeof(pi));
+                    ZeroMemory(&pi, sizeof(pi));
                 
-                std::string currentCmd = pipeCmds[i];
-                char cmdBuffer[8192];
+                    std::string currentCmd = pipeCmds[i];
                 
-                char modulePath[MAX_PATH];
-                GetModuleFileNameA(NULL, modulePath, MAX_PATH);
-                std::string finalCmdLine = "\"" + std::string(modulePath) + "\" -c \"" + currentCmd + "\"";
+                    char modulePath[MAX_PATH];
+                    GetModuleFileNameA(NULL, modulePath, MAX_PATH);
+                    std::string finalCmdLine = "\"" + std::string(modulePath) + "\" -c \"" + currentCmd + "\"";
                 
-                strncpy_s(cmdBuffer, finalCmdLine.c_str(), sizeof(cmdBuffer) - 1);
+                    std::vector<char> cmdBuffer = commandLineBuffer(finalCmdLine);
                 
-                if (CreateProcessA(NULL, cmdBuffer, NULL, NULL, TRUE, 0, NULL, currentDir.c_str(), &si, &pi)) {
-                    processes.push_back(pi.hProcess);
-                    threads.push_back(pi.hThread);
-                } else {
-                    std::cerr << "Failed to spawn pipeline stage: " << currentCmd << "\n";
+                    if (CreateProcessA(NULL, cmdBuffer.data(), NULL, NULL, TRUE, 0, NULL, currentDir.c_str(), &si, &pi)) {
+                        processes.push_back(pi.hProcess);
+                        threads.push_back(pi.hThread);
+                    } else {
+                        std::cerr << "Failed to spawn pipeline stage: " << currentCmd << "\n";
+                    }
+                
+                    // Cleanup handles in parent
+                    if (hWritePipe) CloseHandle(hWritePipe);
+                    if (hPrevReadPipe) CloseHandle(hPrevReadPipe);
+                    hPrevReadPipe = hReadPipe; // Pass read end to next
                 }
                 
-                // Cleanup handles in parent
-                if (hWritePipe) CloseHandle(hWritePipe);
-                if (hPrevReadPipe) CloseHandle(hPrevReadPipe);
-                hPrevReadPipe = hReadPipe; // Pass read end to next
-            }
+                if (hCaptureWrite) {
+                    CloseHandle(hCaptureWrite);
+                    drainToCapture(hCaptureRead);
+                }
             
-            // Wait for all
-            for (size_t i = 0; i < processes.size(); i++) {
-                WaitForSingleObject(processes[i], INFINITE);
-                if (i == processes.size() - 1) {
-                    DWORD code;
-                    GetExitCodeProcess(processes[i], &code);
-                    lastExitCode = (int)code;
+                // Wait for all
+                for (size_t i = 0; i < processes.size(); i++) {
+                    WaitForSingleObject(processes[i], INFINITE);
+                    if (i == processes.size() - 1) {
+                        DWORD code;
+                        GetExitCodeProcess(processes[i], &code);
+                        lastExitCode = (int)code;
+                    }
+                    CloseHandle(processes[i]);
+                    CloseHandle(threads[i]);
                 }
-                CloseHandle(processes[i]);
-                CloseHandle(threads[i]);
-            }
             
-            return lastExitCode;
-        }
+                return lastExitCode;
+            }
         
-        // If statement
-        if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
-            int condResult = execute(ifNode->condition);
+            // If statement
+            case NodeKind::If: {
+                auto* ifNode = static_cast<IfNode*>(node);
+                int condResult = execute(ifNode->condition.get());
             
-            if (condResult == 0) {
-                for (auto& stmt : ifNode->thenBody) {
-                    lastExitCode = execute(stmt);
-                }
-            } else {
-                for (auto& stmt : ifNode->elseBody) {
-                    lastExitCode = execute(stmt);
+                if (condResult == 0) {
+                    for (auto& stmt : ifNode->thenBody) {
+                        lastExitCode = execute(stmt.get());
+                    }
+                } else {
+                    for (auto& stmt : ifNode->elseBody) {
+                        lastExitCode = execute(stmt.get());
+                    }
                 }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        if (auto forNode = std::dynamic_pointer_cast<ForNode>(node)) {
-            bool breakLoop = false;
-            for (const auto& value : forNode->values) {
-                if (breakLoop) break;
-                (*_variableMap)[forNode->variable] = expandVariables(value);
-                try {
-                    for (auto& stmt : forNode->body) {
-                        lastExitCode = execute(stmt);
-                    }
-                } catch (BreakException& e) {
-                    if (e.levels <= 1) {
-                        breakLoop = true;
-                    } else {
-                        throw BreakException(e.levels - 1);
-                    }
-                } catch (ContinueException& e) {
-                    if (e.levels > 1) {
-                        throw ContinueException(e.levels - 1);
+            case NodeKind::For: {
+                auto* forNode = static_cast<ForNode*>(node);
+                bool breakLoop = false;
+                for (const auto& value : forNode->compiledValues) {
+                    if (breakLoop) break;
+                    _variables->set(forNode->variableSlot, expandWord(value));
+                    try {
+                        for (auto& stmt : forNode->body) {
+                            lastExitCode = execute(stmt.get());
+                        }
+                    } catch (BreakException& e) {
+                        if (e.levels <= 1) {
+                            breakLoop = true;
+                        } else {
+                            throw BreakException(e.levels - 1);
+                        }
+                    } catch (ContinueException& e) {
+                        if (e.levels > 1) {
+                            throw ContinueException(e.levels - 1);
+                        }
                     }
                 }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
-            while (execute(whileNode->condition) == 0) {
-                try {
-                    for (auto& stmt : whileNode->body) {
-                        lastExitCode = execute(stmt);
-                    }
-                } catch (BreakException& e) {
-                    if (e.levels <= 1) {
-                        break;
-                    } else {
-                        throw BreakException(e.levels - 1);
-                    }
-                } catch (ContinueException& e) {
-                    if (e.levels > 1) {
-                        throw ContinueException(e.levels - 1);
+            case NodeKind::While: {
+                auto* whileNode = static_cast<WhileNode*>(node);
+                while (execute(whileNode->condition.get()) == 0) {
+                    try {
+                        for (auto& stmt : whileNode->body) {
+                            lastExitCode = execute(stmt.get());
+                        }
+                    } catch (BreakException& e) {
+                        if (e.levels <= 1) {
+                            break;
+                        } else {
+                            throw BreakException(e.levels - 1);
+                        }
+                    } catch (ContinueException& e) {
+                        if (e.levels > 1) {
+                            throw ContinueException(e.levels - 1);
+                        }
                     }
                 }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        // Function definition
-        if (auto funcNode = std::dynamic_pointer_cast<FunctionNode>(node)) {
-            functions[funcNode->name] = funcNode->body;
-            return 0;
-        }
+            // Function definition
+            case NodeKind::Function: {
+                auto* funcNode = static_cast<FunctionNode*>(node);
+                functions[funcNode->name] = funcNode->body;
+                return 0;
+            }
         
-        // Case statement (switch/case)
-        if (auto caseNode = std::dynamic_pointer_cast<CaseNode>(node)) {
-            std::string value = expandVariables(caseNode->expression);
+            // Case statement (switch/case)
+            case NodeKind::Case: {
+                auto* caseNode = static_cast<CaseNode*>(node);
+                std::string value = expandWord(caseNode->compiledExpression);
             
-            if (debugMode) {
-                std::cerr << "[DEBUG EXEC] Case statement, expression = '" << value << "'\n";
-                std::cerr.flush();
-            }
+                if (debugMode) {
+                    std::cerr << "[DEBUG EXEC] Case statement, expression = '" << value << "'\n";
+                    std::cerr.flush();
+                }
             
-            for (const auto& branch : caseNode->branches) {
-                bool matched = false;
+                for (size_t b = 0; b < caseNode->branches.size(); b++) {
+                    const auto& branch = caseNode->branches[b];
+                    bool matched = false;
                 
-                // Check each pattern in this branch
-                for (const auto& pattern : branch.first) {
-                    std::string expandedPattern = expandVariables(pattern);
+                    // Check each pattern in this branch
+                    for (const auto& pattern : caseNode->compiledPatterns[b]) {
+                        std::string expandedPattern = expandWord(pattern);
                     
-                    // Handle * wildcard pattern
-                    if (expandedPattern == "*") {
-                        matched = true;
-                        break;
-                    }
-                    
-                    // Simple pattern matching (exact match or with * suffix/prefix)
-                    if (expandedPattern == value) {
-                        matched = true;
-                        break;
-                    }
-                    
-                    // Handle prefix* pattern
-                    if (expandedPattern.back() == '*') {
-                        std::string prefix = expandedPattern.substr(0, expandedPattern.size() - 1);
-                        if (value.substr(0, prefix.size()) == prefix) {
+                        // Handle * wildcard pattern
+                        if (expandedPattern == "*") {
                             matched = true;
                             break;
                         }
-                    }
                     
-                    // Handle *suffix pattern
-                    if (expandedPattern.front() == '*') {
-                        std::string suffix = expandedPattern.substr(1);
-                        if (value.size() >= suffix.size() && 
-                            value.substr(value.size() - suffix.size()) == suffix) {
+                        // Simple pattern matching (exact match or with * suffix/prefix)
+                        if (expandedPattern == value) {
                             matched = true;
                             break;
                         }
+                    
+                        // Handle prefix* pattern
+                        if (expandedPattern.back() == '*') {
+                            std::string prefix = expandedPattern.substr(0, expandedPattern.size() - 1);
+                            if (value.substr(0, prefix.size()) == prefix) {
+                                matched = true;
+                                break;
+                            }
+                        }
+                    
+                        // Handle *suffix pattern
+                        if (expandedPattern.front() == '*') {
+                            std::string suffix = expandedPattern.substr(1);
+                            if (value.size() >= suffix.size() && 
+                                value.substr(value.size() - suffix.size()) == suffix) {
+                                matched = true;
+                                break;
+                            }
+                        }
                     }
-                }
                 
-                if (matched) {
-                    for (auto& stmt : branch.second) {
-                        lastExitCode = execute(stmt);
+                    if (matched) {
+                        for (auto& stmt : branch.second) {
+                            lastExitCode = execute(stmt.get());
+                        }
+                        return lastExitCode;
                     }
-                    return lastExitCode;
                 }
+                return 0;
             }
-            return 0;
-        }
         
-        if (auto orNode = std::dynamic_pointer_cast<OrChainNode>(node)) {
-            lastExitCode = execute(orNode->left);
-            if (lastExitCode != 0) {
-                lastExitCode = execute(orNode->right);
+            case NodeKind::OrChain: {
+                auto* orNode = static_cast<OrChainNode*>(node);
+                lastExitCode = execute(orNode->left.get());
+                if (lastExitCode != 0) {
+                    lastExitCode = execute(orNode->right.get());
+                }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        if (auto andNode = std::dynamic_pointer_cast<AndChainNode>(node)) {
-            lastExitCode = execute(andNode->left);
-            if (lastExitCode == 0) {
-                lastExitCode = execute(andNode->right);
+            case NodeKind::AndChain: {
+                auto* andNode = static_cast<AndChainNode*>(node);
+                lastExitCode = execute(andNode->left.get());
+                if (lastExitCode == 0) {
+                    lastExitCode = execute(andNode->right.get());
+                }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        if (auto errBlock = std::dynamic_pointer_cast<ErrorBlockNode>(node)) {
-            lastExitCode = execute(errBlock->command);
-            if (lastExitCode != 0) {
-                for (auto& stmt : errBlock->errorHandler) {
-                    lastExitCode = execute(stmt);
+            case NodeKind::ErrorBlock: {
+                auto* errBlock = static_cast<ErrorBlockNode*>(node);
+                lastExitCode = execute(errBlock->command.get());
+                if (lastExitCode != 0) {
+                    for (auto& stmt : errBlock->errorHandler) {
+                        lastExitCode = execute(stmt.get());
+                    }
                 }
+                return lastExitCode;
             }
-            return lastExitCode;
-        }
         
-        // Negated command: ! command (inverts exit code)
-        if (auto negNode = std::dynamic_pointer_cast<NegatedCommandNode>(node)) {
-            int result = execute(negNode->command);
-            lastExitCode = (result == 0) ? 1 : 0;
-            return lastExitCode;
-        }
+            // Negated command: ! command (inverts exit code)
+            case NodeKind::NegatedCommand: {
+                auto* negNode = static_cast<NegatedCommandNode*>(node);
+                int result = execute(negNode->command.get());
+                lastExitCode = (result == 0) ? 1 : 0;
+                return lastExitCode;
+            }
         
-        if (auto breakNode = std::dynamic_pointer_cast<BreakNode>(node)) {
-            throw BreakException(breakNode->levels);
-        }
+            case NodeKind::Break: {
+                auto* breakNode = static_cast<BreakNode*>(node);
+                throw BreakException(breakNode->levels);
+            }
         
-        if (auto contNode = std::dynamic_pointer_cast<ContinueNode>(node)) {
-            throw ContinueException(contNode->levels);
-        }
+            case NodeKind::Continue: {
+                auto* contNode = static_cast<ContinueNode*>(node);
+                throw ContinueException(contNode->levels);
+            }
         
-        if (auto retNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
-            throw ReturnException(retNode->value);
+            case NodeKind::Return: {
+                auto* retNode = static_cast<ReturnNode*>(node);
+                throw ReturnException(retNode->value);
+            }
+        
+            case NodeKind::Compound:
+                break;
         }
         
         return 0;
@@ -2700,6 +3261,8 @@ public:
         } catch (const ScriptError& e) {
             std::cerr << e.what();
             return 1;
+        } catch (const ExitException&) {
+            throw;
         } catch (const std::exception& e) {
             std::cerr << "\033[31mError: " << e.what() << "\033[0m\n";
             return 1;
@@ -2721,14 +3284,10 @@ public:
         executor.setFallbackHandler(handler);
     }
     
-    void bindVariables(std::map<std::string, std::string>& vars) {
+    void bindVariables(ShellVars::VariableStore& vars) {
         executor.bindVariables(&vars);
     }
     
-    void bindArrays(std::map<std::string, std::vector<std::string>>* arrays) {
-        executor.bindArrays(arrays);
-    }
-
     void bindInputHandler(std::function<std::string(std::string, bool)> callback) {
         executor.bindInputHandler(callback);
     }
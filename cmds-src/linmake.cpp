@@ -11,12 +11,19 @@
 #include <filesystem>
 #include <algorithm>
 #include <ctime>
+#include <deque>
+#include <memory>
 #include <windows.h>
+#include "linmake_jobs.hpp"
+#include "linmake_deps.hpp"
+#include "linmake_cache.hpp"
+#include "sha256.hpp"
 
 namespace fs = std::filesystem;
 
 const std::string CONFIG_FILE = "LMake";
 const std::string BUILD_DIR = "build";
+const std::string DEPS_FILE = BUILD_DIR + "/.linmake-deps";
 
 struct Config {
     std::string project = "app";
@@ -30,6 +37,7 @@ struct Config {
     bool staticLink = false;
     bool warnings = true;
     bool debug = false;
+    bool cache = true;
 };
 
 const std::map<std::string, std::string> LIBRARY_MAP = {
@@ -81,11 +89,18 @@ void printError(const std::string& msg) {
     std::cerr << msg << std::endl;
 }
 
-void printProgress(int current, int total, const std::string& file) {
+void printWarning(const std::string& msg) {
+    setColor(14);
+    std::cerr << "[Warning] ";
+    setColor(7);
+    std::cerr << msg << std::endl;
+}
+
+void printProgress(int current, int total, const std::string& file, bool cached = false) {
     setColor(14);
     std::cout << "[" << current << "/" << total << "] ";
     setColor(7);
-    std::cout << "Compiling " << file << "..." << std::endl;
+    std::cout << "Compiling " << file << "..." << (cached ? " (cached)" : "") << std::endl;
 }
 
 std::string trim(const std::string& s) {
@@ -139,6 +154,7 @@ bool parseConfig(Config& config) {
                 else if (key == "static") config.staticLink = (value == "true" || value == "1");
                 else if (key == "warnings") config.warnings = (value == "all" || value == "true");
                 else if (key == "debug") config.debug = (value == "true" || value == "1");
+                else if (key == "cache") config.cache = (value == "true" || value == "1");
             }
         }
     }
@@ -214,13 +230,30 @@ std::string getObjectFile(const std::string& source) {
     return BUILD_DIR + "/" + p.stem().string() + ".o";
 }
 
-bool needsRecompile(const std::string& source, const std::string& object) {
-    if (!fs::exists(object)) return true;
-    
-    auto srcTime = fs::last_write_time(source);
-    auto objTime = fs::last_write_time(object);
-    
-    return srcTime > objTime;
+std::string getDepFile(const std::string& source) {
+    fs::path p(source);
+    return BUILD_DIR + "/" + p.stem().string() + ".d";
+}
+
+std::string getPreprocessedFile(const std::string& source) {
+    fs::path p(source);
+    return BUILD_DIR + "/" + p.stem().string() + ".i";
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// Name plus --version output, so a compiler upgrade does not reuse cached objects
+std::string compilerIdentity(const std::string& compiler) {
+    LinMakeJobs::Runner runner;
+    if (!runner.start(0, compiler + " --version", BUILD_DIR + "/.compiler-version.log")) {
+        return compiler;
+    }
+    return compiler + "\n" + runner.waitAny().output;
 }
 
 std::string buildCompilerFlags(const Config& config) {
@@ -337,12 +370,13 @@ int cmdInit() {
     file << "static = false\n";
     file << "warnings = true\n";
     file << "debug = false\n";
+    file << "cache = true\n";
     
     printSuccess("Created " + CONFIG_FILE);
     return 0;
 }
 
-int cmdBuild(bool release, bool debug) {
+int cmdBuild(bool release, bool debug, size_t jobs, bool useCache) {
     Config config;
     if (!parseConfig(config)) {
         printError("No " + CONFIG_FILE + " found. Run 'linmake init' first.");
@@ -357,6 +391,9 @@ int cmdBuild(bool release, bool debug) {
         config.debug = true;
         config.optimize = 0;
     }
+    if (!config.cache) {
+        useCache = false;
+    }
     
     printStatus("Project: " + config.project + " v" + config.version);
     
@@ -373,35 +410,159 @@ int cmdBuild(bool release, bool debug) {
     int compiled = 0;
     int total = 0;
     
+    struct CompileJob {
+        enum Phase { PREPROCESS, COMPILE };
+        
+        std::string source;
+        std::string object;
+        std::string depFile;
+        std::string compiler;
+        std::string command;
+        std::string commandHash;
+        Phase phase = COMPILE;
+        std::string cacheKey;  // empty when the object cannot go into the cache
+    };
+    std::vector<CompileJob> stale;
+    
+    // An object is stale if its source, any header it included or its command line changed
+    LinMakeDeps::DepGraph depGraph;
+    depGraph.load(DEPS_FILE);
+    
     for (const auto& src : sources) {
         std::string obj = getObjectFile(src);
+        std::string dep = getDepFile(src);
         objects.push_back(obj);
-        if (needsRecompile(src, obj)) {
-            total++;
+        
+        bool isCpp = fs::path(src).extension() == ".cpp" || 
+                     fs::path(src).extension() == ".cc" ||
+                     fs::path(src).extension() == ".cxx";
+        std::string compiler = isCpp ? "g++" : "gcc";
+        std::string cmd = compiler + " " + compilerFlags + "-MMD -MF " + dep + " -c " + src + " -o " + obj;
+        std::string cmdHash = SHA256::hash(cmd);
+        
+        if (depGraph.isStale(obj, cmdHash)) {
+            CompileJob job;
+            job.source = src;
+            job.object = obj;
+            job.depFile = dep;
+            job.compiler = compiler;
+            job.command = cmd;
+            job.commandHash = cmdHash;
+            job.phase = useCache ? CompileJob::PREPROCESS : CompileJob::COMPILE;
+            stale.push_back(job);
         }
     }
+    total = (int)stale.size();
     
     if (total == 0) {
         printSuccess("Nothing to compile (up to date)");
     } else {
-        for (const auto& src : sources) {
-            std::string obj = getObjectFile(src);
-            if (needsRecompile(src, obj)) {
-                compiled++;
-                printProgress(compiled, total, fs::path(src).filename().string());
-                
-                bool isCpp = fs::path(src).extension() == ".cpp" || 
-                             fs::path(src).extension() == ".cc" ||
-                             fs::path(src).extension() == ".cxx";
-                std::string compiler = isCpp ? "g++" : "gcc";
+        // With the cache on, each job first preprocesses its source (which also writes
+        // the .d file); the result is hashed with the compiler and flags, and a cached
+        // object is copied instead of compiling. Misses go back to the front of the
+        // queue to be compiled and are stored once they succeed.
+        std::unique_ptr<LinMakeCache::ObjectCache> cache;
+        std::map<std::string, std::string> compilerIds;
+        if (useCache) {
+            cache = std::make_unique<LinMakeCache::ObjectCache>();
+            for (const auto& job : stale) {
+                if (!compilerIds.count(job.compiler)) compilerIds[job.compiler] = compilerIdentity(job.compiler);
+            }
+        }
+        int cacheHits = 0;
+        
+        // Up to `jobs` compilers run at once, fed from a ready queue. Each one's output
+        // is printed under its progress line when it exits. After the first failure
+        // nothing new is started, but the jobs still running are waited for.
+        size_t workers = std::min({ jobs, stale.size(), LinMakeJobs::MAX_JOBS });
+        if (workers > 1) {
+            printStatus("Compiling " + std::to_string(total) + " files with " + std::to_string(workers) + " jobs");
+        }
+        
+        std::deque<size_t> ready;
+        for (size_t i = 0; i < stale.size(); i++) ready.push_back(i);
+        
+        LinMakeJobs::Runner runner;
+        bool failed = false;
+        
+        while (!runner.empty() || (!failed && !ready.empty())) {
+            while (!failed && !ready.empty() && runner.size() < workers) {
+                const CompileJob& job = stale[ready.front()];
+                std::string cmd = job.command;
+                if (job.phase == CompileJob::PREPROCESS) {
+                    cmd = job.compiler + " " + compilerFlags + "-MMD -MF " + job.depFile + " -E " +
+                          job.source + " -o " + getPreprocessedFile(job.source);
+                }
+                if (!runner.start(ready.front(), cmd, job.object + ".log")) {
+                    printError("Could not start compiler for " + job.source);
+                    failed = true;
+                }
+                ready.pop_front();
+            }
+            if (runner.empty()) break;
+            
+            LinMakeJobs::Finished done = runner.waitAny();
+            CompileJob& job = stale[done.id];
+            bool cached = false;
+            
+            if (job.phase == CompileJob::PREPROCESS) {
+                std::string preprocessed = getPreprocessedFile(job.source);
+                if (done.exitCode == 0) {
+                    job.cacheKey = LinMakeCache::makeKey(compilerIds[job.compiler], compilerFlags, readFile(preprocessed));
+                    cached = cache->fetch(job.cacheKey, job.object, done.output);
+                } else {
+                    // Compiling reports the error, or succeeds without the cache
+                    cache->countUncacheable();
+                }
+                fs::remove(preprocessed);
                 
-                std::string cmd = compiler + " " + compilerFlags + "-c " + src + " -o " + obj;
-                int result = runCommand(cmd);
-                if (result != 0) {
-                    printError("Compilation failed for " + src);
-                    return 1;
+                if (!cached) {
+                    job.phase = CompileJob::COMPILE;
+                    ready.push_front(done.id);
+                    continue;
                 }
+                cacheHits++;
+            } else if (done.exitCode == 0 && cache && !job.cacheKey.empty()) {
+                cache->store(job.cacheKey, job.object, done.output);
             }
+            
+            compiled++;
+            printProgress(compiled, total, fs::path(job.source).filename().string(), cached);
+            if (!done.output.empty()) {
+                std::cout << done.output << std::flush;
+            }
+            if (done.exitCode != 0) {
+                printError("Compilation failed for " + job.source);
+                depGraph.forget(job.object);
+                failed = true;
+            } else {
+                auto deps = LinMakeDeps::parseDepFile(job.depFile);
+                if (deps.empty()) {
+                    // Recording only the source would miss header edits; unrecorded objects are rebuilt
+                    printWarning("No dependency list for " + job.object + "; it will be recompiled next build");
+                    depGraph.forget(job.object);
+                } else {
+                    depGraph.record(job.object, job.commandHash, std::move(deps));
+                }
+            }
+            fs::remove(job.depFile);
+        }
+        
+        if (!depGraph.save(DEPS_FILE)) {
+            printError("Could not write " + DEPS_FILE);
+        }
+        if (cache) {
+            cache->flush();
+            if (cacheHits > 0) {
+                printStatus(std::to_string(cacheHits) + " of " + std::to_string(total) + " objects from cache");
+            }
+        }
+        
+        if (failed) {
+            if (!ready.empty()) {
+                printError(std::to_string(ready.size()) + " file(s) not compiled");
+            }
+            return 1;
         }
     }
     
@@ -479,8 +640,77 @@ int cmdClean() {
     return 0;
 }
 
-int cmdRun(bool release, bool debug) {
-    int result = cmdBuild(release, debug);
+std::string formatSize(uint64_t bytes) {
+    std::stringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(1);
+    if (bytes >= 1024ull * 1024 * 1024) ss << bytes / (1024.0 * 1024 * 1024) << " GB";
+    else if (bytes >= 1024 * 1024) ss << bytes / (1024.0 * 1024) << " MB";
+    else ss << bytes / 1024.0 << " KB";
+    return ss.str();
+}
+
+// "500M", "2G", "1048576" -> bytes; 0 if malformed
+uint64_t parseSize(const std::string& text) {
+    size_t used = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &used);
+    } catch (...) {
+        return 0;
+    }
+    std::string unit = text.substr(used);
+    if (unit == "K" || unit == "KB") value *= 1024;
+    else if (unit == "M" || unit == "MB") value *= 1024 * 1024;
+    else if (unit == "G" || unit == "GB") value *= 1024.0 * 1024 * 1024;
+    else if (!unit.empty()) return 0;
+    return value > 0 ? (uint64_t)value : 0;
+}
+
+int cmdCache(const std::vector<std::string>& args) {
+    LinMakeCache::ObjectCache cache;
+    std::string sub = args.empty() ? "stats" : args[0];
+    
+    if (sub == "stats") {
+        auto s = cache.stats();
+        uint64_t lookups = s.hits + s.misses;
+        std::stringstream rate;
+        rate.setf(std::ios::fixed);
+        rate.precision(1);
+        rate << (lookups ? 100.0 * s.hits / lookups : 0.0) << " %";
+        
+        printStatus("Cache: " + cache.dir());
+        std::cout << "  Hits:         " << s.hits << "\n";
+        std::cout << "  Misses:       " << s.misses << "\n";
+        std::cout << "  Hit rate:     " << rate.str() << "\n";
+        std::cout << "  Uncacheable:  " << s.uncacheable << "\n";
+        std::cout << "  Objects:      " << s.files << "\n";
+        std::cout << "  Size:         " << formatSize(s.size) << " / " << formatSize(s.maxSize) << "\n";
+        return 0;
+    } else if (sub == "clear") {
+        cache.clear();
+        printSuccess("Cleared " + cache.dir());
+        return 0;
+    } else if (sub == "max" && args.size() == 2) {
+        uint64_t size = parseSize(args[1]);
+        if (size == 0) {
+            printError("Invalid size: " + args[1]);
+            return 1;
+        }
+        auto s = cache.stats();
+        s.maxSize = size;
+        if (s.size > s.maxSize) cache.trim(s);
+        cache.saveStats(s);
+        printSuccess("Cache limit set to " + formatSize(size));
+        return 0;
+    }
+    
+    printError("Usage: linmake cache stats | clear | max <size>");
+    return 1;
+}
+
+int cmdRun(bool release, bool debug, size_t jobs, bool useCache) {
+    int result = cmdBuild(release, debug, jobs, useCache);
     if (result != 0) return result;
     
     Config config;
@@ -511,14 +741,20 @@ void printUsage() {
     std::cout << "  build        Compile the project\n";
     std::cout << "  clean        Remove build artifacts\n";
     std::cout << "  run          Build and run the project\n";
+    std::cout << "  cache stats  Show compilation cache hits, misses and size\n";
+    std::cout << "  cache clear  Empty the compilation cache\n";
+    std::cout << "  cache max <size>  Set the cache size limit (e.g. 2G, 500M)\n";
     std::cout << "  help         Show this help message\n\n";
     std::cout << "Options:\n";
     std::cout << "  --release    Build with optimizations (-O2)\n";
-    std::cout << "  --debug      Build with debug symbols (-g)\n\n";
+    std::cout << "  --debug      Build with debug symbols (-g)\n";
+    std::cout << "  -j <N>       Run up to N compilers at once (default: all cores)\n";
+    std::cout << "  --no-cache   Compile everything, bypassing the compilation cache\n\n";
     std::cout << "Examples:\n";
     std::cout << "  linmake init           Create LinMake.lin template\n";
     std::cout << "  linmake build          Compile project\n";
     std::cout << "  linmake build --release  Optimized build\n";
+    std::cout << "  linmake build -j 4     Compile with 4 parallel jobs\n";
     std::cout << "  linmake run            Build and execute\n";
 }
 
@@ -531,21 +767,45 @@ int main(int argc, char* argv[]) {
     std::string cmd = argv[1];
     bool release = false;
     bool debug = false;
+    bool useCache = true;
+    size_t jobs = LinMakeJobs::defaultJobCount();
+    
+    if (cmd == "cache") {
+        return cmdCache(std::vector<std::string>(argv + 2, argv + argc));
+    }
     
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--release" || arg == "-r") release = true;
         if (arg == "--debug" || arg == "-d") debug = true;
+        if (arg == "--no-cache") useCache = false;
+        
+        // -j N, -jN, --jobs N, --jobs=N
+        std::string count;
+        if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 < argc) count = argv[++i];
+        } else if (arg.rfind("--jobs=", 0) == 0) count = arg.substr(7);
+        else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) count = arg.substr(2);
+        else continue;
+        
+        try {
+            int n = std::stoi(count);
+            if (n < 1) throw std::invalid_argument(count);
+            jobs = (size_t)n;
+        } catch (...) {
+            printError("Invalid job count: " + (count.empty() ? "missing after " + arg : count));
+            return 1;
+        }
     }
     
     if (cmd == "init") {
         return cmdInit();
     } else if (cmd == "build") {
-        return cmdBuild(release, debug);
+        return cmdBuild(release, debug, jobs, useCache);
     } else if (cmd == "clean") {
         return cmdClean();
     } else if (cmd == "run") {
-        return cmdRun(release, debug);
+        return cmdRun(release, debug, jobs, useCache);
     } else if (cmd == "help" || cmd == "-h" || cmd == "--help") {
         printUsage();
         return 0;
@@ -0,0 +1,233 @@
+// LinMake Compilation Cache
+// Objects are stored under the user profile (%USERPROFILE%\.linuxify\linmake-cache,
+// or LINMAKE_CACHE_DIR) keyed by SHA-256 of the compiler identity, the flags and the
+// preprocessed source, so a clean build or a branch switch back to code compiled
+// before copies objects instead of compiling them. Entries live in 256 fan-out
+// directories; an entry's mtime is its last use, and the least recently used ones
+// are evicted once the cache grows past its size limit.
+
+#ifndef LINUXIFY_LINMAKE_CACHE_HPP
+#define LINUXIFY_LINMAKE_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "sha256.hpp"
+
+namespace LinMakeCache {
+
+    constexpr uint64_t DEFAULT_MAX_SIZE = 5ull * 1024 * 1024 * 1024;
+    // Eviction trims to this fraction of the limit so it does not run on every build
+    constexpr double TRIM_TARGET = 0.9;
+
+    const char* const STATS_FILE = "stats";
+
+    inline std::string defaultDir() {
+        if (const char* dir = std::getenv("LINMAKE_CACHE_DIR")) {
+            if (*dir) return dir;
+        }
+        const char* home = std::getenv("USERPROFILE");
+        if (!home || !*home) home = std::getenv("HOME");
+        if (!home || !*home) return ".linmake-cache";
+        return (std::filesystem::path(home) / ".linuxify" / "linmake-cache").string();
+    }
+
+    // Cache key of one compile: everything that can change the object it produces
+    inline std::string makeKey(const std::string& compilerId, const std::string& flags,
+                               const std::string& preprocessed) {
+        SHA256 sha;
+        sha.update(compilerId);
+        sha.update(std::string_view("\0", 1));
+        sha.update(flags);
+        sha.update(std::string_view("\0", 1));
+        sha.update(preprocessed);
+        return sha.finalizeHex();
+    }
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t uncacheable = 0;  // preprocessing failed; compiled without the cache
+        uint64_t files = 0;
+        uint64_t size = 0;
+        uint64_t maxSize = DEFAULT_MAX_SIZE;
+    };
+
+    class ObjectCache {
+    private:
+        std::filesystem::path root;
+        Stats delta;  // this run's counters, merged into the stats file by flush()
+
+        std::filesystem::path entryPath(const std::string& key, const char* ext) const {
+            return root / key.substr(0, 2) / (key.substr(2) + ext);
+        }
+
+        static std::string readAll(const std::filesystem::path& path) {
+            std::ifstream f(path, std::ios::binary);
+            std::ostringstream oss;
+            oss << f.rdbuf();
+            return oss.str();
+        }
+
+        static void touch(const std::filesystem::path& path) {
+            std::error_code ec;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+        }
+
+        // Writes data to path through a temporary file, so concurrent builds never see half of it
+        static uint64_t putFile(const std::filesystem::path& path, const std::string& data) {
+            std::filesystem::path tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+                if (!f) return 0;
+                f.write(data.data(), data.size());
+                if (!f.good()) return 0;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, path, ec);
+            if (ec) {
+                std::filesystem::remove(tmp, ec);
+                return 0;
+            }
+            return data.size();
+        }
+
+    public:
+        explicit ObjectCache(const std::string& dir = defaultDir()) : root(dir) {}
+
+        std::string dir() const { return root.string(); }
+
+        // On a hit copies the cached object to objPath and returns the compiler output it was stored with
+        bool fetch(const std::string& key, const std::string& objPath, std::string& output) {
+            std::filesystem::path obj = entryPath(key, ".o");
+            std::error_code ec;
+            std::filesystem::copy_file(obj, objPath, std::filesystem::copy_options::overwrite_existing, ec);
+            if (ec) {
+                delta.misses++;
+                return false;
+            }
+            // The copy must look newer than its dependencies, whatever the copy kept
+            touch(objPath);
+            touch(obj);
+
+            std::filesystem::path out = entryPath(key, ".out");
+            output = std::filesystem::exists(out, ec) ? readAll(out) : "";
+            delta.hits++;
+            return true;
+        }
+
+        void store(const std::string& key, const std::string& objPath, const std::string& output) {
+            std::error_code ec;
+            std::filesystem::create_directories(entryPath(key, ".o").parent_path(), ec);
+            uint64_t bytes = putFile(entryPath(key, ".o"), readAll(objPath));
+            if (bytes == 0) return;
+            if (!output.empty()) bytes += putFile(entryPath(key, ".out"), output);
+            delta.files++;
+            delta.size += bytes;
+        }
+
+        void countUncacheable() { delta.uncacheable++; }
+
+        Stats stats() const {
+            Stats s;
+            std::ifstream f(root / STATS_FILE);
+            std::string key;
+            uint64_t value;
+            while (f >> key >> value) {
+                if (key == "hits") s.hits = value;
+                else if (key == "misses") s.misses = value;
+                else if (key == "uncacheable") s.uncacheable = value;
+                else if (key == "files") s.files = value;
+                else if (key == "size") s.size = value;
+                else if (key == "max_size") s.maxSize = value;
+            }
+            return s;
+        }
+
+        void saveStats(const Stats& s) {
+            std::error_code ec;
+            std::filesystem::create_directories(root, ec);
+            std::ostringstream oss;
+            oss << "hits " << s.hits << "\n"
+                << "misses " << s.misses << "\n"
+                << "uncacheable " << s.uncacheable << "\n"
+                << "files " << s.files << "\n"
+                << "size " << s.size << "\n"
+                << "max_size " << s.maxSize << "\n";
+            putFile(root / STATS_FILE, oss.str());
+        }
+
+        // Adds this run's counters to the stats file and evicts if the cache is over its limit.
+        // Two builds flushing at the same moment can lose each other's counts, never objects.
+        void flush() {
+            Stats s = stats();
+            s.hits += delta.hits;
+            s.misses += delta.misses;
+            s.uncacheable += delta.uncacheable;
+            s.files += delta.files;
+            s.size += delta.size;
+            delta = Stats();
+            if (s.size > s.maxSize) trim(s);
+            saveStats(s);
+        }
+
+        // Removes least recently used entries until the cache is under TRIM_TARGET of its
+        // limit, and recounts files and size from what is actually on disk
+        void trim(Stats& s) {
+            struct Entry {
+                std::filesystem::path path;
+                std::filesystem::file_time_type used;
+                uint64_t size;
+            };
+            std::vector<Entry> entries;
+            uint64_t total = 0;
+
+            std::error_code ec;
+            for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                if (!it->is_regular_file(ec) || it->path().extension() != ".o") continue;
+                Entry e{ it->path(), it->last_write_time(ec), it->file_size(ec) };
+                std::filesystem::path out = e.path;
+                out.replace_extension(".out");
+                e.size += std::filesystem::exists(out, ec) ? std::filesystem::file_size(out, ec) : 0;
+                total += e.size;
+                entries.push_back(e);
+            }
+
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+            uint64_t target = (uint64_t)(s.maxSize * TRIM_TARGET);
+            size_t evicted = 0;
+            while (evicted < entries.size() && total > target) {
+                std::filesystem::path out = entries[evicted].path;
+                out.replace_extension(".out");
+                std::filesystem::remove(entries[evicted].path, ec);
+                std::filesystem::remove(out, ec);
+                total -= entries[evicted].size;
+                evicted++;
+            }
+            s.files = entries.size() - evicted;
+            s.size = total;
+        }
+
+        void clear() {
+            Stats s = stats();
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+                if (entry.is_directory(ec)) std::filesystem::remove_all(entry.path(), ec);
+            }
+            Stats cleared;
+            cleared.maxSize = s.maxSize;
+            saveStats(cleared);
+        }
+    };
+
+} // namespace LinMakeCache
+
+#endif // LINUXIFY_LINMAKE_CACHE_HPP
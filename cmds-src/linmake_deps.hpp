@@ -0,0 +1,170 @@
+// LinMake Dependency Graph
+// Every compile is run with -MMD -MF, and the dependency file the compiler writes
+// (the source plus every non-system header it included, transitively) is folded into
+// build/.linmake-deps together with a hash of the command line that produced the
+// object. An object is rebuilt when it has no entry, when its command hash differs,
+// or when any recorded dependency is missing or newer than the object.
+
+#ifndef LINUXIFY_LINMAKE_DEPS_HPP
+#define LINUXIFY_LINMAKE_DEPS_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+
+namespace LinMakeDeps {
+
+    const char* const HEADER = "# linmake deps v1";
+
+    // Prerequisites of the first rule in a make-style .d file ("obj: src hdr ...",
+    // continued across lines), with "\ " and "$$" unescaped; empty if unreadable
+    inline std::vector<std::string> parseDepFile(const std::string& path) {
+        std::ifstream f(path, std::ios::binary);
+        std::ostringstream oss;
+        oss << f.rdbuf();
+        std::string text = oss.str();
+
+        // The target ends at the first ':' followed by whitespace, which skips drive letters
+        size_t pos = 0;
+        while ((pos = text.find(':', pos)) != std::string::npos) {
+            if (pos + 1 == text.size() || text[pos + 1] == ' ' || text[pos + 1] == '\t' ||
+                text[pos + 1] == '\r' || text[pos + 1] == '\n') break;
+            pos++;
+        }
+        if (pos == std::string::npos) return {};
+
+        std::vector<std::string> deps;
+        std::string cur;
+        for (size_t i = pos + 1; i < text.size(); i++) {
+            char c = text[i];
+            if (c == '\\' && i + 1 < text.size() && (text[i + 1] == '\n' || text[i + 1] == '\r')) {
+                // Line continuation: skip the newline too, so it does not end the rule
+                i++;
+                if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n') i++;
+                if (!cur.empty()) deps.push_back(cur);
+                cur.clear();
+            } else if (c == '\\' && i + 1 < text.size() && (text[i + 1] == ' ' || text[i + 1] == '#')) {
+                cur += text[++i];
+            } else if (c == '$' && i + 1 < text.size() && text[i + 1] == '$') {
+                cur += text[++i];
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                if (!cur.empty()) deps.push_back(cur);
+                cur.clear();
+                // A newline not escaped by '\' ends the rule
+                if (c == '\n') break;
+            } else {
+                cur += c;
+            }
+        }
+        if (!cur.empty()) deps.push_back(cur);
+        return deps;
+    }
+
+    // object path -> (command hash, dependencies)
+    class DepGraph {
+    private:
+        struct Entry {
+            std::string commandHash;
+            std::vector<std::string> deps;
+        };
+
+        std::map<std::string, Entry> entries;
+        // mtimes of dependencies, so a header shared by many objects is stat'ed once
+        std::unordered_map<std::string, std::filesystem::file_time_type> mtimes;
+        bool dirty = false;
+
+        bool mtimeOf(const std::string& path, std::filesystem::file_time_type& out) {
+            auto it = mtimes.find(path);
+            if (it == mtimes.end()) {
+                std::error_code ec;
+                auto t = std::filesystem::last_write_time(path, ec);
+                if (ec) return false;
+                it = mtimes.emplace(path, t).first;
+            }
+            out = it->second;
+            return true;
+        }
+
+    public:
+        // "obj <hash> <path>" followed by its "dep <path>" lines
+        void load(const std::string& path) {
+            entries.clear();
+            mtimes.clear();
+            dirty = false;
+
+            std::ifstream f(path);
+            std::string line;
+            if (!std::getline(f, line) || line != HEADER) return;
+
+            Entry* cur = nullptr;
+            while (std::getline(f, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.compare(0, 4, "obj ") == 0) {
+                    size_t sp = line.find(' ', 4);
+                    if (sp == std::string::npos) { cur = nullptr; continue; }
+                    cur = &entries[line.substr(sp + 1)];
+                    cur->commandHash = line.substr(4, sp - 4);
+                    cur->deps.clear();
+                } else if (line.compare(0, 4, "dep ") == 0 && cur) {
+                    cur->deps.push_back(line.substr(4));
+                }
+            }
+        }
+
+        bool save(const std::string& path) {
+            if (!dirty) return true;
+            std::string tmp = path + ".tmp";
+            {
+                std::ofstream f(tmp, std::ios::trunc);
+                if (!f) return false;
+                f << HEADER << "\n";
+                for (const auto& [obj, e] : entries) {
+                    f << "obj " << e.commandHash << " " << obj << "\n";
+                    for (const auto& d : e.deps) f << "dep " << d << "\n";
+                }
+                if (!f.good()) return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, path, ec);
+            if (ec) return false;
+            dirty = false;
+            return true;
+        }
+
+        // True if obj is missing, unrecorded, built by another command line, or older
+        // than (or missing) one of its dependencies
+        bool isStale(const std::string& obj, const std::string& commandHash) {
+            std::error_code ec;
+            auto objTime = std::filesystem::last_write_time(obj, ec);
+            if (ec) return true;
+
+            auto it = entries.find(obj);
+            if (it == entries.end() || it->second.commandHash != commandHash) return true;
+
+            for (const auto& d : it->second.deps) {
+                std::filesystem::file_time_type t;
+                if (!mtimeOf(d, t) || t > objTime) return true;
+            }
+            return false;
+        }
+
+        void record(const std::string& obj, const std::string& commandHash, std::vector<std::string> deps) {
+            Entry& e = entries[obj];
+            e.commandHash = commandHash;
+            e.deps = std::move(deps);
+            dirty = true;
+        }
+
+        void forget(const std::string& obj) {
+            if (entries.erase(obj)) dirty = true;
+        }
+    };
+
+} // namespace LinMakeDeps
+
+#endif // LINUXIFY_LINMAKE_DEPS_HPP
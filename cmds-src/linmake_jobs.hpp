@@ -0,0 +1,162 @@
+// LinMake Job Runner
+// Runs up to N build commands as concurrent child processes. Each child writes its
+// stdout/stderr to its own log file, which is handed back when the child exits, so
+// the caller can print diagnostics in one piece under the line for that job instead
+// of interleaving the output of several compilers.
+
+#ifndef LINUXIFY_LINMAKE_JOBS_HPP
+#define LINUXIFY_LINMAKE_JOBS_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace LinMakeJobs {
+
+#ifdef _WIN32
+    // WaitForMultipleObjects watches at most this many processes
+    constexpr size_t MAX_JOBS = MAXIMUM_WAIT_OBJECTS;
+#else
+    constexpr size_t MAX_JOBS = 256;
+#endif
+
+    inline size_t defaultJobCount() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 4;
+    }
+
+    struct Finished {
+        size_t id = 0;        // value passed to start()
+        int exitCode = -1;
+        std::string output;   // everything the command wrote to stdout and stderr
+    };
+
+    class Runner {
+    private:
+        struct Running {
+            size_t id;
+            std::string logPath;
+#ifdef _WIN32
+            HANDLE process;
+#else
+            pid_t pid;
+#endif
+        };
+
+        std::vector<Running> running;
+
+        static std::string takeLog(const std::string& path) {
+            std::ifstream f(path, std::ios::binary);
+            std::ostringstream oss;
+            oss << f.rdbuf();
+            f.close();
+            std::remove(path.c_str());
+            return oss.str();
+        }
+
+    public:
+        ~Runner() {
+            while (!running.empty()) waitAny();
+        }
+
+        size_t size() const { return running.size(); }
+        bool empty() const { return running.empty(); }
+
+        // Starts cmd with its output sent to logPath; false if it could not be started
+        bool start(size_t id, const std::string& cmd, const std::string& logPath) {
+#ifdef _WIN32
+            SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+            HANDLE log = CreateFileA(logPath.c_str(), GENERIC_WRITE,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, &sa,
+                                     CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+            if (log == INVALID_HANDLE_VALUE) return false;
+
+            STARTUPINFOA si;
+            PROCESS_INFORMATION pi;
+            ZeroMemory(&si, sizeof(si));
+            ZeroMemory(&pi, sizeof(pi));
+            si.cb = sizeof(si);
+            si.dwFlags |= STARTF_USESTDHANDLES;
+            si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            si.hStdOutput = log;
+            si.hStdError = log;
+
+            std::vector<char> cmdBuffer(cmd.begin(), cmd.end());
+            cmdBuffer.push_back('\0');
+            BOOL ok = CreateProcessA(NULL, cmdBuffer.data(), NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+            // Children started later must not inherit this job's log handle
+            CloseHandle(log);
+            if (!ok) {
+                DeleteFileA(logPath.c_str());
+                return false;
+            }
+            CloseHandle(pi.hThread);
+            running.push_back({ id, logPath, pi.hProcess });
+            return true;
+#else
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, 1, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            posix_spawn_file_actions_adddup2(&actions, 1, 2);
+
+            const char* argv[] = { "/bin/sh", "-c", cmd.c_str(), nullptr };
+            pid_t pid;
+            int err = posix_spawn(&pid, "/bin/sh", &actions, nullptr, (char* const*)argv, environ);
+            posix_spawn_file_actions_destroy(&actions);
+            if (err != 0) return false;
+            running.push_back({ id, logPath, pid });
+            return true;
+#endif
+        }
+
+        // Blocks until one running command exits; must not be called when empty()
+        Finished waitAny() {
+            Finished done;
+            size_t slot = 0;
+#ifdef _WIN32
+            std::vector<HANDLE> handles;
+            for (const auto& r : running) handles.push_back(r.process);
+            DWORD w = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, INFINITE);
+            if (w >= WAIT_OBJECT_0 && w < WAIT_OBJECT_0 + handles.size()) slot = w - WAIT_OBJECT_0;
+
+            DWORD exitCode = 1;
+            WaitForSingleObject(running[slot].process, INFINITE);
+            GetExitCodeProcess(running[slot].process, &exitCode);
+            CloseHandle(running[slot].process);
+            done.exitCode = (int)exitCode;
+#else
+            int status = 0;
+            pid_t pid;
+            do {
+                pid = waitpid(-1, &status, 0);
+                for (slot = 0; slot < running.size() && running[slot].pid != pid; slot++) {}
+            } while (pid > 0 && slot == running.size());
+            if (pid <= 0) {
+                // Nothing left to reap; report the oldest job as failed
+                slot = 0;
+                status = -1;
+            }
+            done.exitCode = (pid > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : 1;
+#endif
+            done.id = running[slot].id;
+            done.output = takeLog(running[slot].logPath);
+            running.erase(running.begin() + slot);
+            return done;
+        }
+    };
+
+} // namespace LinMakeJobs
+
+#endif // LINUXIFY_LINMAKE_JOBS_HPP
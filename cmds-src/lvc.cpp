@@ -18,7 +18,7 @@ void printUsage() {
     
     std::cout << "Getting Started:\n";
     std::cout << "  lvc init                      Initialize repository\n";
-    std::cout << "  lvc add <files> | .           Stage files\n";
+    std::cout << "  lvc add <files> | .           Stage files (--threads=N, default: all cores)\n";
     std::cout << "  lvc commit -v <ver> -m <msg>  Create version\n\n";
     
     std::cout << "History & Diff:\n";
@@ -46,6 +46,7 @@ void printUsage() {
     std::cout << "Other:\n";
     std::cout << "  lvc status                    Show status\n";
     std::cout << "  lvc reset [--hard]            Reset index\n";
+    std::cout << "  lvc gc                        Pack objects into a delta-compressed pack\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -66,8 +67,20 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         std::vector<std::string> paths;
-        for (int i = 2; i < argc; i++) paths.push_back(argv[i]);
-        lvc.add(paths);
+        size_t threads = WorkPool::defaultThreadCount();
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--threads=", 0) == 0) {
+                threads = (size_t)std::max(1, std::atoi(arg.c_str() + 10));
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.empty()) {
+            std::cerr << "error: nothing specified to add\n";
+            return 1;
+        }
+        lvc.add(paths, threads);
     }
     else if (cmd == "commit") {
         std::string version, message;
@@ -145,6 +158,9 @@ int main(int argc, char* argv[]) {
         std::string mode = (argc > 2) ? argv[2] : "--soft";
         lvc.reset(mode);
     }
+    else if (cmd == "gc" || cmd == "repack") {
+        lvc.gc();
+    }
     else if (cmd == "help" || cmd == "-h" || cmd == "--help") {
         printUsage();
     }
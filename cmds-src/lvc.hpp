@@ -21,11 +21,20 @@
 #include <functional>
 #include <algorithm>
 #include <numeric>
+#include <cstring>
 #include <queue>
+#include <list>
 #include <stack>
 #include <memory>
 #include <regex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <windows.h>
+#include "lvc_index.hpp"
+#include "lvc_pack.hpp"
+#include "sha256.hpp"
+#include "work_pool.hpp"
 
 namespace fs = std::filesystem;
 
@@ -34,97 +43,19 @@ namespace fs = std::filesystem;
 // ============================================================================
 
 namespace LVCConfig {
-    constexpr size_t CHUNK_SIZE = 64;           // Rolling hash window
-    constexpr size_t MIN_MATCH = 4;             // Minimum match for delta
+    constexpr size_t DELTA_WINDOW = 16;         // Gear hash window / source block size
+    constexpr size_t DELTA_PROBES = 8;          // Source candidates tried per target window
+    constexpr size_t DELTA_MIN_COPY = 32;       // Shortest copy the encoder emits
     constexpr size_t MAX_DELTA_CHAIN = 50;      // Max delta chain depth
-    constexpr size_t HASH_PRIME = 31;           // Rolling hash prime
-    constexpr size_t HASH_MOD = 1000000007;     // Rolling hash modulo
+    constexpr size_t PACK_WINDOW = 10;          // Delta candidates tried per packed object
+    constexpr size_t PACK_MAX_DEPTH = 16;       // Max delta chain depth inside a pack
+    constexpr size_t PACK_MIN_DELTA = 128;      // Smaller objects are packed whole
+    constexpr size_t OBJECT_CACHE_BYTES = 32 * 1024 * 1024;      // Raw object contents
+    constexpr size_t DELTA_BASE_CACHE_BYTES = 64 * 1024 * 1024;  // Reconstructed delta bases
+    constexpr size_t ADD_BATCH_FILES = 8;                    // Files encoded and hashed per add task
+    constexpr size_t ADD_BATCH_BYTES = 256 * 1024;           // ...unless they add up to this much
 }
 
-// ============================================================================
-// SHA-256 IMPLEMENTATION (Simplified but functional)
-// ============================================================================
-
-class SHA256 {
-private:
-    static constexpr uint32_t K[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-        0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-        0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-        0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
-    static uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
-    static uint32_t ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
-    static uint32_t maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
-    static uint32_t sig0(uint32_t x) { return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22); }
-    static uint32_t sig1(uint32_t x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25); }
-    static uint32_t ep0(uint32_t x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
-    static uint32_t ep1(uint32_t x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
-
-public:
-    static std::string hash(const std::string& data) {
-        uint32_t h[8] = {
-            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-        };
-        
-        // Padding
-        std::vector<uint8_t> msg(data.begin(), data.end());
-        size_t origLen = msg.size();
-        msg.push_back(0x80);
-        while ((msg.size() + 8) % 64 != 0) msg.push_back(0);
-        
-        uint64_t bitLen = origLen * 8;
-        for (int i = 7; i >= 0; i--) msg.push_back((bitLen >> (i * 8)) & 0xFF);
-        
-        // Process blocks
-        for (size_t i = 0; i < msg.size(); i += 64) {
-            uint32_t w[64];
-            for (int j = 0; j < 16; j++) {
-                w[j] = (msg[i + j*4] << 24) | (msg[i + j*4 + 1] << 16) |
-                       (msg[i + j*4 + 2] << 8) | msg[i + j*4 + 3];
-            }
-            for (int j = 16; j < 64; j++) {
-                w[j] = ep1(w[j-2]) + w[j-7] + ep0(w[j-15]) + w[j-16];
-            }
-            
-            uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
-            uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
-            
-            for (int j = 0; j < 64; j++) {
-                uint32_t t1 = hh + sig1(e) + ch(e, f, g) + K[j] + w[j];
-                uint32_t t2 = sig0(a) + maj(a, b, c);
-                hh = g; g = f; f = e; e = d + t1;
-                d = c; c = b; b = a; a = t1 + t2;
-            }
-            
-            h[0] += a; h[1] += b; h[2] += c; h[3] += d;
-            h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
-        }
-        
-        std::ostringstream oss;
-        for (int i = 0; i < 8; i++) {
-            oss << std::hex << std::setfill('0') << std::setw(8) << h[i];
-        }
-        return oss.str();
-    }
-};
-
-constexpr uint32_t SHA256::K[64];
-
 // ============================================================================
 // MYERS DIFF ALGORITHM - O((N+M)D) optimal diff
 // ============================================================================
@@ -436,7 +367,7 @@ public:
 };
 
 // ============================================================================
-// ROLLING HASH DELTA COMPRESSION (rsync-style)
+// GEAR HASH DELTA COMPRESSION
 // ============================================================================
 
 class DeltaCompression {
@@ -449,149 +380,187 @@ public:
     };
 
 private:
-    // Rolling hash using Rabin fingerprint style
-    struct RollingHash {
-        size_t hash = 0;
-        size_t power = 1;
-        std::deque<uint8_t> window;
-        size_t windowSize;
-        
-        RollingHash(size_t size = LVCConfig::CHUNK_SIZE) : windowSize(size) {
-            for (size_t i = 0; i < windowSize - 1; i++) {
-                power = (power * LVCConfig::HASH_PRIME) % LVCConfig::HASH_MOD;
-            }
-        }
-        
-        void add(uint8_t byte) {
-            if (window.size() >= windowSize) {
-                uint8_t old = window.front();
-                window.pop_front();
-                hash = (hash + LVCConfig::HASH_MOD - (old * power) % LVCConfig::HASH_MOD) % LVCConfig::HASH_MOD;
+    static constexpr char MAGIC[4] = { 'L', 'V', 'D', 1 };  // binary format; "DELTA\n" is the old text one
+    
+    // Gear rolling hash: h = (h << 2) + GEAR[byte] on 32 bits, so each byte is
+    // shifted out after DELTA_WINDOW (16) steps with no window buffer or modulo
+    static const uint32_t* gearTable() {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            uint64_t x = 0;
+            for (auto& v : t) {  // splitmix64
+                x += 0x9E3779B97F4A7C15ull;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                v = (uint32_t)(z ^ (z >> 31));
             }
-            window.push_back(byte);
-            hash = (hash * LVCConfig::HASH_PRIME + byte) % LVCConfig::HASH_MOD;
+            return t;
+        }();
+        return table.data();
+    }
+    
+    static uint32_t windowHash(const uint8_t* p) {
+        const uint32_t* gear = gearTable();
+        uint32_t h = 0;
+        for (size_t k = 0; k < LVCConfig::DELTA_WINDOW; k++) h = (h << 2) + gear[p[k]];
+        return h;
+    }
+    
+    // The low bits of a gear hash only see the last few bytes, so buckets use the mixed high bits
+    static uint32_t bucketOf(uint32_t h, unsigned bits) {
+        return (h * 2654435761u) >> (32 - bits);
+    }
+    
+    static void addInsert(std::vector<DeltaOp>& ops, const char* p, size_t n) {
+        DeltaOp op;
+        op.type = DeltaOp::INSERT;
+        op.srcOffset = 0;
+        op.data.assign(p, n);
+        op.length = n;
+        ops.push_back(std::move(op));
+    }
+    
+    static void addCopy(std::vector<DeltaOp>& ops, size_t offset, size_t length) {
+        if (!ops.empty() && ops.back().type == DeltaOp::COPY &&
+            ops.back().srcOffset + ops.back().length == offset) {
+            ops.back().length += length;
+            return;
         }
+        DeltaOp op;
+        op.type = DeltaOp::COPY;
+        op.srcOffset = offset;
+        op.length = length;
+        ops.push_back(std::move(op));
+    }
+    
+    // Old text format: "DELTA\n<count>\n" then "C <offset> <length>\n" or "I <length>\n<data>"
+    static std::vector<DeltaOp> deserializeText(const std::string& data) {
+        std::vector<DeltaOp> ops;
+        std::istringstream iss(data);
         
-        size_t getHash() const { return hash; }
-        bool full() const { return window.size() >= windowSize; }
-    };
-
-public:
-    // Build signature of source for matching
-    static std::unordered_map<size_t, std::vector<size_t>> buildSignature(const std::string& src) {
-        std::unordered_map<size_t, std::vector<size_t>> sig;
+        std::string header;
+        std::getline(iss, header);
+        if (header != "DELTA") return ops;
         
-        if (src.size() < LVCConfig::CHUNK_SIZE) return sig;
+        size_t count;
+        iss >> count;
+        iss.ignore();
         
-        RollingHash rh;
-        for (size_t i = 0; i < src.size(); i++) {
-            rh.add((uint8_t)src[i]);
-            if (rh.full() && i >= LVCConfig::CHUNK_SIZE - 1) {
-                sig[rh.getHash()].push_back(i - LVCConfig::CHUNK_SIZE + 1);
+        for (size_t i = 0; i < count; i++) {
+            char type;
+            iss >> type;
+            
+            DeltaOp op;
+            if (type == 'C') {
+                op.type = DeltaOp::COPY;
+                iss >> op.srcOffset >> op.length;
+                iss.ignore();
+            } else {
+                op.type = DeltaOp::INSERT;
+                size_t len;
+                iss >> len;
+                iss.ignore();
+                op.data.resize(len);
+                iss.read(&op.data[0], len);
+                op.length = len;
             }
+            ops.push_back(op);
         }
-        return sig;
+        return ops;
     }
-    
-    // Create delta between source and target
+
+public:
+    // Source is indexed once per DELTA_WINDOW-aligned block, chained per bucket.
+    // Each target window probes up to DELTA_PROBES candidates; verified ones are
+    // extended forwards and backwards into the pending literals, and the longest
+    // match wins. Any shared run of DELTA_MIN_COPY (2 * DELTA_WINDOW) bytes is found.
     static std::vector<DeltaOp> createDelta(const std::string& src, const std::string& tgt) {
         std::vector<DeltaOp> ops;
+        const size_t W = LVCConfig::DELTA_WINDOW;
         
-        if (src.empty()) {
-            if (!tgt.empty()) {
-                DeltaOp op;
-                op.type = DeltaOp::INSERT;
-                op.data = tgt;
-                op.length = tgt.size();
-                ops.push_back(op);
-            }
+        if (src.size() < W || tgt.size() < W) {
+            if (!tgt.empty()) addInsert(ops, tgt.data(), tgt.size());
             return ops;
         }
         
-        auto sig = buildSignature(src);
-        RollingHash rh;
-        std::string pending;
-        size_t pos = 0;
-        
-        while (pos < tgt.size()) {
-            rh.add((uint8_t)tgt[pos]);
-            
-            if (rh.full()) {
-                auto it = sig.find(rh.getHash());
-                if (it != sig.end()) {
-                    // Verify match and extend
-                    size_t srcPos = it->second[0];
-                    size_t matchStart = pos - LVCConfig::CHUNK_SIZE + 1;
-                    
-                    // Verify exact match
-                    bool match = true;
-                    for (size_t i = 0; i < LVCConfig::CHUNK_SIZE && match; i++) {
-                        if (src[srcPos + i] != tgt[matchStart + i]) match = false;
-                    }
-                    
-                    if (match) {
-                        // Flush pending inserts
-                        if (!pending.empty()) {
-                            // Remove the chunk we're about to copy
-                            if (pending.size() >= LVCConfig::CHUNK_SIZE) {
-                                pending = pending.substr(0, pending.size() - LVCConfig::CHUNK_SIZE + 1);
-                            } else {
-                                pending.clear();
-                            }
-                            
-                            if (!pending.empty()) {
-                                DeltaOp iop;
-                                iop.type = DeltaOp::INSERT;
-                                iop.data = pending;
-                                iop.length = pending.size();
-                                ops.push_back(iop);
-                            }
-                            pending.clear();
-                        }
-                        
-                        // Extend match forward
-                        size_t len = LVCConfig::CHUNK_SIZE;
-                        while (srcPos + len < src.size() && matchStart + len < tgt.size() &&
-                               src[srcPos + len] == tgt[matchStart + len]) {
-                            len++;
-                        }
-                        
-                        DeltaOp cop;
-                        cop.type = DeltaOp::COPY;
-                        cop.srcOffset = srcPos;
-                        cop.length = len;
-                        ops.push_back(cop);
-                        
-                        pos = matchStart + len;
-                        rh = RollingHash();
-                        continue;
-                    }
+        const uint8_t* s = (const uint8_t*)src.data();
+        const uint8_t* t = (const uint8_t*)tgt.data();
+        const uint32_t* gear = gearTable();
+        
+        size_t blocks = src.size() / W;
+        unsigned bits = 4;
+        while (((size_t)1 << bits) < blocks && bits < 24) bits++;
+        std::vector<uint32_t> head((size_t)1 << bits, UINT32_MAX);
+        std::vector<uint32_t> next(blocks);
+        for (size_t b = 0; b < blocks; b++) {
+            uint32_t bucket = bucketOf(windowHash(s + b * W), bits);
+            next[b] = head[bucket];
+            head[bucket] = (uint32_t)b;
+        }
+        
+        size_t i = 0, anchor = 0, lastEnd = 0;
+        uint32_t h = windowHash(t);
+        while (true) {
+            size_t bestLen = 0, bestSrc = 0, bestBack = 0;
+            auto consider = [&](size_t sp) {
+                if (sp + W > src.size()) return;
+                uint64_t a, b;  // cheap first look: most probes differ within 8 bytes
+                memcpy(&a, s + sp, 8);
+                memcpy(&b, t + i, 8);
+                if (a != b || memcmp(s + sp + 8, t + i + 8, W - 8) != 0) return;
+                size_t fwd = W;
+                while (sp + fwd < src.size() && i + fwd < tgt.size() && s[sp + fwd] == t[i + fwd]) fwd++;
+                size_t back = 0;
+                while (back < sp && back < i - anchor && s[sp - back - 1] == t[i - back - 1]) back++;
+                if (fwd + back > bestLen) {
+                    bestLen = fwd + back;
+                    bestSrc = sp - back;
+                    bestBack = back;
                 }
+            };
+            
+            // Where the source resumes if the literals since the last copy were inserted,
+            // or replaced as many bytes: the usual shapes of an edit
+            consider(lastEnd);
+            consider(lastEnd + (i - anchor));
+            uint32_t cand = head[bucketOf(h, bits)];
+            for (size_t probes = 0; cand != UINT32_MAX && probes < LVCConfig::DELTA_PROBES; cand = next[cand], probes++) {
+                consider((size_t)cand * W);
             }
             
-            pending += tgt[pos];
-            pos++;
-        }
-        
-        // Flush remaining
-        if (!pending.empty()) {
-            DeltaOp iop;
-            iop.type = DeltaOp::INSERT;
-            iop.data = pending;
-            iop.length = pending.size();
-            ops.push_back(iop);
+            // Shorter matches are often chance hits in repetitive text that pull the
+            // copies out of line; the right alignment comes within DELTA_WINDOW bytes
+            if (bestLen >= LVCConfig::DELTA_MIN_COPY) {
+                size_t start = i - bestBack;
+                if (start > anchor) addInsert(ops, tgt.data() + anchor, start - anchor);
+                addCopy(ops, bestSrc, bestLen);
+                lastEnd = bestSrc + bestLen;
+                i = anchor = start + bestLen;
+                if (i + W > tgt.size()) break;
+                h = windowHash(t + i);
+                continue;
+            }
+            
+            if (i + W >= tgt.size()) break;
+            h = (h << 2) + gear[t[i + W]];
+            i++;
         }
         
+        if (anchor < tgt.size()) addInsert(ops, tgt.data() + anchor, tgt.size() - anchor);
         return ops;
     }
     
     // Apply delta to reconstruct target
     static std::string applyDelta(const std::string& src, const std::vector<DeltaOp>& ops) {
+        size_t total = 0;
+        for (const auto& op : ops) total += op.length;
         std::string result;
+        result.reserve(total);
         for (const auto& op : ops) {
             if (op.type == DeltaOp::COPY) {
                 if (op.srcOffset + op.length <= src.size()) {
-                    result += src.substr(op.srcOffset, op.length);
+                    result.append(src, op.srcOffset, op.length);
                 }
             } else {
                 result += op.data;
@@ -600,53 +569,53 @@ public:
         return result;
     }
     
-    // Serialize delta for storage
+    // Serialize delta for storage: magic, then per op varint(length << 1 | isCopy)
+    // followed by the zigzag distance from the previous copy's end, or the literals
     static std::string serialize(const std::vector<DeltaOp>& ops) {
-        std::ostringstream oss;
-        oss << "DELTA\n" << ops.size() << "\n";
+        std::string out(MAGIC, sizeof(MAGIC));
+        size_t lastEnd = 0;
         for (const auto& op : ops) {
             if (op.type == DeltaOp::COPY) {
-                oss << "C " << op.srcOffset << " " << op.length << "\n";
+                LVCPack::putVarint(out, ((uint64_t)op.length << 1) | 1);
+                int64_t rel = (int64_t)op.srcOffset - (int64_t)lastEnd;
+                LVCPack::putVarint(out, ((uint64_t)rel << 1) ^ (uint64_t)(rel >> 63));
+                lastEnd = op.srcOffset + op.length;
             } else {
-                oss << "I " << op.data.size() << "\n";
-                oss.write(op.data.data(), op.data.size());
+                LVCPack::putVarint(out, (uint64_t)op.data.size() << 1);
+                out += op.data;
             }
         }
-        return oss.str();
+        return out;
     }
     
-    // Deserialize delta
+    // Deserialize delta (binary, or the old text format)
     static std::vector<DeltaOp> deserialize(const std::string& data) {
-        std::vector<DeltaOp> ops;
-        std::istringstream iss(data);
-        
-        std::string header;
-        std::getline(iss, header);
-        if (header != "DELTA") return ops;
-        
-        size_t count;
-        iss >> count;
-        iss.ignore();
+        if (data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) return deserializeText(data);
         
-        for (size_t i = 0; i < count; i++) {
-            char type;
-            iss >> type;
-            
+        std::vector<DeltaOp> ops;
+        const char* p = data.data() + sizeof(MAGIC);
+        const char* end = data.data() + data.size();
+        size_t lastEnd = 0;
+        while (p < end) {
+            uint64_t word;
+            if (!LVCPack::getVarint(p, end, word)) break;
             DeltaOp op;
-            if (type == 'C') {
+            op.length = (size_t)(word >> 1);
+            if (word & 1) {
+                uint64_t zz;
+                if (!LVCPack::getVarint(p, end, zz)) break;
+                int64_t rel = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
                 op.type = DeltaOp::COPY;
-                iss >> op.srcOffset >> op.length;
-                iss.ignore();
+                op.srcOffset = (size_t)((int64_t)lastEnd + rel);
+                lastEnd = op.srcOffset + op.length;
             } else {
+                if (op.length > (size_t)(end - p)) break;
                 op.type = DeltaOp::INSERT;
-                size_t len;
-                iss >> len;
-                iss.ignore();
-                op.data.resize(len);
-                iss.read(&op.data[0], len);
-                op.length = len;
+                op.srcOffset = 0;
+                op.data.assign(p, op.length);
+                p += op.length;
             }
-            ops.push_back(op);
+            ops.push_back(std::move(op));
         }
         return ops;
     }
@@ -659,6 +628,66 @@ public:
     }
 };
 
+// ============================================================================
+// BYTE-BUDGETED LRU CACHE
+// ============================================================================
+
+template <typename Key>
+class LRUCache {
+private:
+    struct Entry {
+        std::string value;
+        typename std::list<Key>::iterator lruPos;
+    };
+
+    std::unordered_map<Key, Entry> entries;
+    std::list<Key> lru;  // front = most recently used
+    size_t budget;
+    size_t used = 0;
+
+public:
+    explicit LRUCache(size_t budgetBytes) : budget(budgetBytes) {}
+
+    bool get(const Key& key, std::string& out) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return false;
+        lru.splice(lru.begin(), lru, it->second.lruPos);
+        out = it->second.value;
+        return true;
+    }
+
+    // Values larger than a quarter of the budget are not kept
+    void put(const Key& key, const std::string& value) {
+        if (value.size() > budget / 4) return;
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            used -= it->second.value.size();
+            it->second.value = value;
+            used += value.size();
+            lru.splice(lru.begin(), lru, it->second.lruPos);
+        } else {
+            lru.push_front(key);
+            entries[key] = Entry{ value, lru.begin() };
+            used += value.size();
+        }
+        while (used > budget && !lru.empty()) {
+            auto victim = entries.find(lru.back());
+            used -= victim->second.value.size();
+            entries.erase(victim);
+            lru.pop_back();
+        }
+    }
+
+    void clear() {
+        entries.clear();
+        lru.clear();
+        used = 0;
+    }
+
+    size_t bytes() const { return used; }
+    size_t size() const { return entries.size(); }
+};
+
 // ============================================================================
 // LVC OBJECT DATABASE - Git-like content-addressable storage
 // ============================================================================
@@ -684,19 +713,131 @@ public:
         std::string message;
     };
 
+    // A fully encoded object ready to be written: hash plus header and content
+    struct EncodedObject {
+        std::string hash;
+        std::string data;
+    };
+
+    struct RepackStats {
+        size_t objects = 0;
+        size_t deltas = 0;
+        size_t looseRemoved = 0;
+        size_t packsRemoved = 0;
+        uint64_t bytesBefore = 0;
+        uint64_t bytesAfter = 0;
+        std::string packName;
+    };
+
 private:
     std::string objectsDir;
-    std::map<std::string, std::string> cache;
+    std::string packDir;
+    LRUCache<std::string> cache{ LVCConfig::OBJECT_CACHE_BYTES };        // hash -> object content
+    LRUCache<std::string> blobCache{ LVCConfig::DELTA_BASE_CACHE_BYTES };  // hash -> reconstructed blob
+    LRUCache<uint64_t> packBaseCache{ LVCConfig::DELTA_BASE_CACHE_BYTES }; // pack slot | offset -> whole object
+    std::mutex cacheMtx;  // encodeBlob() may run on several threads at once
+    std::vector<std::unique_ptr<LVCPack::Pack>> packs;
     
     std::string getObjectPath(const std::string& hash) {
         return objectsDir + "/" + hash.substr(0, 2) + "/" + hash.substr(2);
     }
+    
+    void loadPacks() {
+        packs.clear();
+        {
+            std::lock_guard<std::mutex> lock(cacheMtx);
+            packBaseCache.clear();  // keyed by pack slot
+        }
+        if (!fs::exists(packDir)) return;
+        for (const auto& e : fs::directory_iterator(packDir)) {
+            if (e.path().extension() != ".idx") continue;
+            fs::path packPath = e.path();
+            packPath.replace_extension(".pack");
+            auto pack = std::make_unique<LVCPack::Pack>();
+            if (pack->open(packPath.string(), e.path().string())) {
+                packs.push_back(std::move(pack));
+            }
+        }
+    }
+    
+    bool readLoose(const std::string& hash, std::string& full) {
+        std::ifstream f(getObjectPath(hash), std::ios::binary);
+        if (!f) return false;
+        std::ostringstream oss;
+        oss << f.rdbuf();
+        full = oss.str();
+        return true;
+    }
+    
+    // Whole object bytes of the entry at offset in packs[slot]. The delta chain is
+    // followed down to a whole entry or a cached base, then applied back up; every
+    // base on the way is cached, since neighbouring versions share their chains.
+    bool readPackedAt(size_t slot, uint64_t offset, std::string& full) {
+        const LVCPack::Pack& pack = *packs[slot];
+        std::vector<uint64_t> chain;
+        std::vector<std::string> deltas;
+        std::string base;
+        uint64_t at = offset;
+        
+        while (true) {
+            bool cached;
+            {
+                std::lock_guard<std::mutex> lock(cacheMtx);
+                cached = packBaseCache.get(((uint64_t)slot << 48) | at, base);
+            }
+            if (cached) break;
+            if (deltas.size() > LVCConfig::PACK_MAX_DEPTH) return false;
+            LVCPack::Entry e;
+            if (!pack.readEntry(at, e)) return false;
+            if (e.kind == LVCPack::WHOLE) {
+                base = std::move(e.payload);
+                break;
+            }
+            chain.push_back(at);
+            deltas.push_back(std::move(e.payload));
+            at = e.baseOffset;
+        }
+        
+        for (size_t k = deltas.size(); k-- > 0;) {
+            {
+                std::lock_guard<std::mutex> lock(cacheMtx);
+                packBaseCache.put(((uint64_t)slot << 48) | at, base);
+            }
+            base = DeltaCompression::applyDelta(base, DeltaCompression::deserialize(deltas[k]));
+            at = chain[k];
+        }
+        full = std::move(base);
+        return true;
+    }
+    
+    bool readPacked(const std::string& hash, std::string& full) {
+        for (size_t slot = 0; slot < packs.size(); slot++) {
+            uint64_t offset;
+            if (packs[slot]->find(hash, offset)) return readPackedAt(slot, offset, full);
+        }
+        return false;
+    }
+    
+    // Header and content of an object, loose or packed
+    bool readObject(const std::string& hash, std::string& full) {
+        return readLoose(hash, full) || readPacked(hash, full);
+    }
+    
+    static ObjectType typeOf(const std::string& full) {
+        if (full.find("tree") == 0) return TREE;
+        if (full.find("commit") == 0) return COMMIT;
+        if (full.find("delta") == 0) return DELTA;
+        if (full.find("tag") == 0) return TAG;
+        return BLOB;
+    }
 
 public:
-    LVCObjectDB(const std::string& dir) : objectsDir(dir) {}
+    LVCObjectDB(const std::string& dir) : objectsDir(dir), packDir(dir + "/pack") {
+        loadPacks();
+    }
     
-    // Store object and return hash
-    std::string store(const std::string& content, ObjectType type) {
+    // Header and content of an object, hash not yet computed
+    static EncodedObject frame(const std::string& content, ObjectType type) {
         std::string typeStr;
         switch (type) {
             case BLOB: typeStr = "blob"; break;
@@ -707,17 +848,47 @@ public:
         }
         
         std::string header = typeStr + " " + std::to_string(content.size()) + '\0';
-        std::string full = header + content;
-        std::string hash = SHA256::hash(full);
-        
-        std::string path = getObjectPath(hash);
+        EncodedObject obj;
+        obj.data.reserve(header.size() + content.size());
+        obj.data = header;
+        obj.data += content;
+        return obj;
+    }
+    
+    // Header, content and hash of an object, without touching the store
+    static EncodedObject encode(const std::string& content, ObjectType type) {
+        EncodedObject obj = frame(content, type);
+        obj.hash = SHA256::hash(obj.data);
+        return obj;
+    }
+    
+    // Fills in the hashes of framed objects, hashing them as one batch
+    static void hashAll(const std::vector<EncodedObject*>& objs) {
+        std::vector<std::string_view> data;
+        data.reserve(objs.size());
+        for (const EncodedObject* obj : objs) data.push_back(obj->data);
+        std::vector<std::string> hashes = SHA256::hashMany(data);
+        for (size_t i = 0; i < objs.size(); i++) objs[i]->hash = std::move(hashes[i]);
+    }
+    
+    void write(const EncodedObject& obj) {
+        std::string path = getObjectPath(obj.hash);
+        uint64_t offset;
+        for (const auto& pack : packs) {
+            if (pack->find(obj.hash, offset)) return;
+        }
         if (!fs::exists(path)) {
             fs::create_directories(fs::path(path).parent_path());
             std::ofstream f(path, std::ios::binary);
-            f << full;
+            f << obj.data;
         }
-        
-        return hash;
+    }
+    
+    // Store object and return hash
+    std::string store(const std::string& content, ObjectType type) {
+        EncodedObject obj = encode(content, type);
+        write(obj);
+        return obj.hash;
     }
     
     // Retrieve object content
@@ -725,21 +896,20 @@ public:
         if (hash.size() < 3) return "";
         
         // Check cache
-        auto it = cache.find(hash);
-        if (it != cache.end()) return it->second;
-        
-        std::string path = getObjectPath(hash);
-        std::ifstream f(path, std::ios::binary);
-        if (!f) return "";
+        std::string content;
+        {
+            std::lock_guard<std::mutex> lock(cacheMtx);
+            if (cache.get(hash, content)) return content;
+        }
         
-        std::ostringstream oss;
-        oss << f.rdbuf();
-        std::string full = oss.str();
+        std::string full;
+        if (!readObject(hash, full)) return "";
         
         size_t nullPos = full.find('\0');
-        std::string content = (nullPos != std::string::npos) ? full.substr(nullPos + 1) : full;
+        content = (nullPos != std::string::npos) ? full.substr(nullPos + 1) : full;
         
-        cache[hash] = content;
+        std::lock_guard<std::mutex> lock(cacheMtx);
+        cache.put(hash, content);
         return content;
     }
     
@@ -747,55 +917,78 @@ public:
     ObjectType getType(const std::string& hash) {
         std::string path = getObjectPath(hash);
         std::ifstream f(path, std::ios::binary);
-        if (!f) return BLOB;
+        if (!f) {
+            std::string full;
+            return readPacked(hash, full) ? typeOf(full) : BLOB;
+        }
         
         char buf[10];
         f.read(buf, 10);
-        std::string header(buf, f.gcount());
-        
-        if (header.find("tree") == 0) return TREE;
-        if (header.find("commit") == 0) return COMMIT;
-        if (header.find("delta") == 0) return DELTA;
-        if (header.find("tag") == 0) return TAG;
-        return BLOB;
+        return typeOf(std::string(buf, f.gcount()));
     }
     
-    // Store blob with delta compression
-    std::string storeBlob(const std::string& content, const std::string& baseHash = "") {
+    // Blob or delta against baseHash, whichever is smaller, framed but not hashed;
+    // reads the store but never writes it, so it is safe to call from several threads
+    EncodedObject frameBlob(const std::string& content, const std::string& baseHash = "") {
         if (baseHash.empty()) {
-            return store(content, BLOB);
+            return frame(content, BLOB);
         }
         
         std::string base = getBlob(baseHash);
-        auto delta = DeltaCompression::createDelta(base, content);
-        double ratio = DeltaCompression::compressionRatio(content, delta);
+        std::string delta = DeltaCompression::serialize(DeltaCompression::createDelta(base, content));
         
-        if (ratio < 0.8) {
-            std::string deltaData = "base:" + baseHash + "\n" + DeltaCompression::serialize(delta);
-            return store(deltaData, DELTA);
+        if (delta.size() < content.size() * 0.8) {
+            std::string deltaData = "base:" + baseHash + "\n" + delta;
+            return frame(deltaData, DELTA);
         }
         
-        return store(content, BLOB);
+        return frame(content, BLOB);
     }
     
-    // Get blob, reconstructing from deltas if needed
-    std::string getBlob(const std::string& hash, int depth = 0) {
-        if (depth > (int)LVCConfig::MAX_DELTA_CHAIN) {
-            return "";  // Prevent infinite loops
-        }
-        
-        std::string content = get(hash);
-        
-        if (content.find("base:") == 0) {
-            size_t nl = content.find('\n');
-            std::string baseHash = content.substr(5, nl - 5);
-            std::string deltaData = content.substr(nl + 1);
+    EncodedObject encodeBlob(const std::string& content, const std::string& baseHash = "") {
+        EncodedObject obj = frameBlob(content, baseHash);
+        obj.hash = SHA256::hash(obj.data);
+        return obj;
+    }
+    
+    // Store blob with delta compression
+    std::string storeBlob(const std::string& content, const std::string& baseHash = "") {
+        EncodedObject obj = encodeBlob(content, baseHash);
+        write(obj);
+        return obj.hash;
+    }
+    
+    // Get blob, reconstructing from deltas if needed. The chain is followed down to
+    // a plain blob or a cached reconstruction, then applied back up; each
+    // reconstructed version is cached as the likely base of the next request.
+    std::string getBlob(const std::string& hash) {
+        std::vector<std::string> chain;   // delta hashes, newest first
+        std::vector<std::string> deltas;
+        std::string content;
+        std::string at = hash;
+        
+        while (true) {
+            bool cached;
+            {
+                std::lock_guard<std::mutex> lock(cacheMtx);
+                cached = blobCache.get(at, content);
+            }
+            if (cached) break;
+            if (chain.size() > LVCConfig::MAX_DELTA_CHAIN) return "";  // Prevent infinite loops
             
-            std::string base = getBlob(baseHash, depth + 1);
-            auto delta = DeltaCompression::deserialize(deltaData);
-            return DeltaCompression::applyDelta(base, delta);
+            content = get(at);
+            if (content.find("base:") != 0) break;
+            size_t nl = content.find('\n');
+            chain.push_back(at);
+            deltas.push_back(content.substr(nl + 1));
+            at = content.substr(5, nl - 5);
         }
         
+        for (size_t k = deltas.size(); k-- > 0;) {
+            content = DeltaCompression::applyDelta(content, DeltaCompression::deserialize(deltas[k]));
+            std::lock_guard<std::mutex> lock(cacheMtx);
+            blobCache.put(chain[k], content);
+        }
         return content;
     }
     
@@ -877,7 +1070,147 @@ public:
     }
     
     bool exists(const std::string& hash) {
-        return fs::exists(getObjectPath(hash));
+        if (fs::exists(getObjectPath(hash))) return true;
+        uint64_t offset;
+        for (const auto& pack : packs) {
+            if (pack->find(hash, offset)) return true;
+        }
+        return false;
+    }
+    
+    // Moves every loose and packed object into one new pack. Blobs and trees are
+    // ordered by (type, path hint, size) so versions of the same file sit together,
+    // and each is stored as a delta against the best of the previous PACK_WINDOW
+    // objects when that saves at least half its size. Nothing is pruned: the
+    // index and stashes reference objects no commit reaches.
+    RepackStats repack(const std::unordered_map<std::string, std::string>& pathHints) {
+        struct Packable {
+            std::string hash;
+            std::string full;
+            std::string hint;
+            ObjectType type;
+        };
+        
+        RepackStats stats;
+        std::vector<Packable> objects;
+        std::unordered_set<std::string> seen;
+        std::vector<fs::path> looseFiles;
+        
+        for (const auto& dir : fs::directory_iterator(objectsDir)) {
+            std::string prefix = dir.path().filename().string();
+            if (!dir.is_directory() || prefix.size() != 2) continue;
+            for (const auto& e : fs::directory_iterator(dir.path())) {
+                Packable obj;
+                obj.hash = prefix + e.path().filename().string();
+                if (obj.hash.size() != 64 || !seen.insert(obj.hash).second) continue;
+                if (!readLoose(obj.hash, obj.full)) continue;
+                stats.bytesBefore += obj.full.size();
+                looseFiles.push_back(e.path());
+                objects.push_back(std::move(obj));
+            }
+        }
+        for (size_t slot = 0; slot < packs.size(); slot++) {
+            const auto& pack = packs[slot];
+            stats.bytesBefore += fs::file_size(pack->path()) + fs::file_size(pack->indexPath());
+            for (size_t i = 0; i < pack->size(); i++) {
+                Packable obj;
+                obj.hash = pack->hashAt(i);
+                if (!seen.insert(obj.hash).second) continue;
+                if (!readPackedAt(slot, pack->offsetAt(i), obj.full)) continue;
+                objects.push_back(std::move(obj));
+            }
+        }
+        if (objects.empty()) return stats;
+        
+        for (auto& obj : objects) {
+            obj.type = typeOf(obj.full);
+            auto it = pathHints.find(obj.hash);
+            if (it != pathHints.end()) obj.hint = it->second;
+        }
+        std::sort(objects.begin(), objects.end(), [](const Packable& a, const Packable& b) {
+            if (a.type != b.type) return a.type < b.type;
+            if (a.hint != b.hint) return a.hint < b.hint;
+            if (a.full.size() != b.full.size()) return a.full.size() > b.full.size();
+            return a.hash < b.hash;
+        });
+        
+        fs::create_directories(packDir);
+        std::string tmpPath = packDir + "/tmp-pack";
+        LVCPack::PackWriter writer;
+        if (!writer.open(tmpPath)) return stats;
+        
+        std::vector<uint64_t> offsets(objects.size());
+        std::vector<size_t> depth(objects.size(), 0);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < objects.size(); i++) {
+            Packable& obj = objects[i];
+            size_t best = i;
+            std::string bestDelta;
+            bool deltify = (obj.type == BLOB || obj.type == TREE) && obj.full.size() >= LVCConfig::PACK_MIN_DELTA;
+            
+            for (size_t j = i; deltify && j > 0 && i - j < LVCConfig::PACK_WINDOW; j--) {
+                const Packable& base = objects[j - 1];
+                if (base.type != obj.type || base.full.empty()) break;
+                if (depth[j - 1] >= LVCConfig::PACK_MAX_DEPTH) continue;
+                // Bytes beyond the base's size are inserts, so a base under half the size cannot win
+                if (base.full.size() < obj.full.size() / 2) continue;
+                std::string delta = DeltaCompression::serialize(DeltaCompression::createDelta(base.full, obj.full));
+                if (delta.size() < obj.full.size() / 2 && (bestDelta.empty() || delta.size() < bestDelta.size())) {
+                    best = j - 1;
+                    bestDelta = std::move(delta);
+                }
+            }
+            
+            if (best != i) {
+                offsets[i] = writer.add(obj.hash, LVCPack::DELTA, bestDelta, offsets[best]);
+                depth[i] = depth[best] + 1;
+                stats.deltas++;
+            } else {
+                offsets[i] = writer.add(obj.hash, LVCPack::WHOLE, obj.full);
+            }
+            names.push_back(obj.hash);
+            // Only the window behind the next object is needed as delta bases
+            if (i >= LVCConfig::PACK_WINDOW) std::string().swap(objects[i - LVCConfig::PACK_WINDOW].full);
+        }
+        
+        std::sort(names.begin(), names.end());
+        std::string allNames;
+        allNames.reserve(names.size() * 64);
+        for (const auto& name : names) allNames += name;
+        stats.packName = "pack-" + SHA256::hash(allNames);
+        std::string packPath = packDir + "/" + stats.packName + ".pack";
+        std::string idxPath = packDir + "/" + stats.packName + ".idx";
+        
+        // Old packs are unmapped before they can be deleted (or replaced by an identical name)
+        std::vector<std::pair<std::string, std::string>> oldPacks;
+        for (auto& pack : packs) {
+            oldPacks.push_back({ pack->path(), pack->indexPath() });
+            pack->close();
+        }
+        packs.clear();
+        
+        if (!writer.finish(packPath, idxPath)) {
+            writer.discard();
+            stats.packName.clear();
+            loadPacks();
+            return stats;
+        }
+        stats.objects = writer.size();
+        stats.bytesAfter = fs::file_size(packPath) + fs::file_size(idxPath);
+        
+        std::error_code ec;
+        for (const auto& [oldPack, oldIdx] : oldPacks) {
+            if (oldPack == packPath) continue;
+            fs::remove(oldPack, ec);
+            fs::remove(oldIdx, ec);
+            stats.packsRemoved++;
+        }
+        for (const auto& path : looseFiles) {
+            if (fs::remove(path, ec)) stats.looseRemoved++;
+            if (fs::is_empty(path.parent_path(), ec)) fs::remove(path.parent_path(), ec);
+        }
+        loadPacks();
+        return stats;
     }
 };
 
@@ -903,6 +1236,7 @@ private:
     
     // State
     std::map<std::string, std::string> stagedFiles;  // path -> hash
+    LVCIndex::StatCache statCache;                   // path -> stat data of known content
     std::string currentBranch;
     std::string headCommit;
     
@@ -973,12 +1307,14 @@ private:
         return std::string(buf);
     }
     
-    // Index management
+    // Index management: staged "hash path" lines, then the stat cache
     void loadIndex() {
         stagedFiles.clear();
+        statCache.clear();
         std::ifstream f(indexFile);
         std::string line;
         while (std::getline(f, line)) {
+            if (line.empty() || line[0] == '#' || statCache.readLine(line)) continue;
             size_t sp = line.find(' ');
             if (sp != std::string::npos) {
                 stagedFiles[line.substr(sp + 1)] = line.substr(0, sp);
@@ -988,9 +1324,11 @@ private:
     
     void saveIndex() {
         std::ofstream f(indexFile);
+        f << LVCIndex::HEADER << "\n";
         for (const auto& [path, hash] : stagedFiles) {
             f << hash << " " << path << "\n";
         }
+        statCache.write(f, LVCIndex::now());
     }
     
     // Reference management
@@ -1113,7 +1451,7 @@ public:
         std::cout << "  └── config     (repository config)\n";
     }
     
-    void add(const std::vector<std::string>& paths) {
+    void add(const std::vector<std::string>& paths, size_t threads = WorkPool::defaultThreadCount()) {
         if (!isInitialized()) { printError("not an lvc repository"); return; }
         
         loadIndex();
@@ -1130,26 +1468,136 @@ public:
         
         int added = 0;
         
-        auto addFile = [&](const fs::path& filePath) {
-            if (!fs::is_regular_file(filePath)) return;
-            
-            std::string rel = fs::relative(filePath, repoPath).string();
-            std::replace(rel.begin(), rel.end(), '\\', '/');
+        // Pipeline: this thread enumerates paths into batches, pool workers read,
+        // encode and hash a batch at a time (several small files share one multi-buffer
+        // SHA-256 pass), and one writer thread is the only one to touch the object
+        // store and index. With threads == 1 every stage runs inline, in the same order.
+        struct AddResult {
+            std::string rel;
+            LVCIndex::StatData st;
+            LVCObjectDB::EncodedObject obj;
+            bool known = false;   // stat data matched the index; obj.hash only
+            bool failed = false;
+        };
+        using Batch = std::vector<AddResult>;
+        
+        auto encodeBatch = [&](Batch& batch) {
+            std::vector<LVCObjectDB::EncodedObject*> framed;
+            for (AddResult& r : batch) {
+                if (r.known) continue;
+                try {
+                    std::string content = readFile((fs::path(repoPath) / r.rel).string());
+                    auto prev = prevTree.find(r.rel);
+                    r.obj = db->frameBlob(content, prev != prevTree.end() ? prev->second : "");
+                    framed.push_back(&r.obj);
+                } catch (const std::exception&) {
+                    r.failed = true;
+                }
+            }
+            LVCObjectDB::hashAll(framed);
+        };
+        
+        auto applyResult = [&](AddResult& r) {
+            if (r.failed) {
+                printError("failed to add '" + r.rel + "'");
+                return;
+            }
+            if (!r.known) db->write(r.obj);
+            stagedFiles[r.rel] = r.obj.hash;
+            added++;
+        };
+        
+        std::unique_ptr<WorkPool::WorkStealingPool> pool;
+        if (threads > 1) pool = std::make_unique<WorkPool::WorkStealingPool>(threads);
+        const size_t maxInFlight = threads * 4;  // batches; bounds file contents held in memory
+        
+        std::mutex mtx;  // guards the queue and statCache
+        std::condition_variable cv;
+        std::deque<Batch> ready;
+        size_t inFlight = 0;
+        bool producing = true;
+        
+        std::thread writer;
+        if (pool) {
+            writer = std::thread([&] {
+                std::unique_lock<std::mutex> lock(mtx);
+                for (;;) {
+                    cv.wait(lock, [&] { return !ready.empty() || (!producing && inFlight == 0); });
+                    if (ready.empty()) break;
+                    Batch batch = std::move(ready.front());
+                    ready.pop_front();
+                    cv.notify_all();
+                    lock.unlock();
+                    for (AddResult& r : batch) applyResult(r);
+                    lock.lock();
+                    for (const AddResult& r : batch) {
+                        if (!r.known && !r.failed) statCache.record(r.rel, r.st, r.obj.hash);
+                    }
+                }
+            });
+        }
+        
+        Batch batch;
+        size_t batchBytes = 0;
+        
+        auto flushBatch = [&]() {
+            if (batch.empty()) return;
             
+            if (!pool) {
+                encodeBatch(batch);
+                for (AddResult& r : batch) {
+                    applyResult(r);
+                    if (!r.known && !r.failed) statCache.record(r.rel, r.st, r.obj.hash);
+                }
+            } else {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return inFlight + ready.size() < maxInFlight; });
+                inFlight++;
+                lock.unlock();
+                
+                pool->submit([&, b = std::move(batch)]() mutable {
+                    encodeBatch(b);
+                    std::lock_guard<std::mutex> done(mtx);
+                    inFlight--;
+                    ready.push_back(std::move(b));
+                    cv.notify_all();
+                });
+            }
+            batch.clear();
+            batchBytes = 0;
+        };
+        
+        // Files whose stat data matches the index are staged without being read
+        auto addFile = [&](const std::string& rel, const LVCIndex::StatData& st) {
             if (rel.find(".lvc") == 0) return;
             
-            std::string content = readFile(filePath.string());
-            std::string prevHash = prevTree.count(rel) ? prevTree[rel] : "";
-            std::string hash = db->storeBlob(content, prevHash);
+            AddResult r;
+            r.rel = rel;
+            r.st = st;
             
-            stagedFiles[rel] = hash;
-            added++;
+            if (pool) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (const std::string* known = statCache.lookup(rel, st)) {
+                    r.known = true;
+                    r.obj.hash = *known;
+                    ready.push_back(Batch(1, std::move(r)));
+                    cv.notify_all();
+                    return;
+                }
+            } else if (const std::string* known = statCache.lookup(rel, st)) {
+                r.known = true;
+                r.obj.hash = *known;
+            }
+            
+            if (!r.known) batchBytes += st.size;
+            batch.push_back(std::move(r));
+            if (batch.size() >= LVCConfig::ADD_BATCH_FILES || batchBytes >= LVCConfig::ADD_BATCH_BYTES) {
+                flushBatch();
+            }
         };
         
         if (addAll) {
-            for (const auto& e : fs::recursive_directory_iterator(repoPath)) {
-                addFile(e.path());
-            }
+            LVCIndex::scanTree(repoPath, "", addFile);
         } else {
             for (const auto& p : paths) {
                 fs::path fp = fs::path(repoPath) / p;
@@ -1157,15 +1605,29 @@ public:
                     printError("pathspec '" + p + "' did not match any files");
                     continue;
                 }
+                std::string rel = fs::relative(fp, repoPath).string();
+                std::replace(rel.begin(), rel.end(), '\\', '/');
+                if (rel == ".") rel = "";
+                
                 if (fs::is_directory(fp)) {
-                    for (const auto& e : fs::recursive_directory_iterator(fp)) {
-                        addFile(e.path());
-                    }
+                    LVCIndex::scanTree(fp.string(), rel, addFile);
                 } else {
-                    addFile(fp);
+                    LVCIndex::StatData st;
+                    if (LVCIndex::statPath(fp.string(), st)) addFile(rel, st);
                 }
             }
         }
+        flushBatch();
+        
+        if (pool) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                producing = false;
+                cv.notify_all();
+            }
+            pool->wait();
+            writer.join();
+        }
         
         saveIndex();
         std::cout << "Staged " << added << " files\n";
@@ -1405,12 +1867,8 @@ public:
         std::vector<std::string> deleted;
         std::set<std::string> seen;
         
-        for (const auto& e : fs::recursive_directory_iterator(repoPath)) {
-            if (!fs::is_regular_file(e.path())) continue;
-            
-            std::string rel = fs::relative(e.path(), repoPath).string();
-            std::replace(rel.begin(), rel.end(), '\\', '/');
-            if (rel.find(".lvc") == 0) continue;
+        LVCIndex::scanTree(repoPath, "", [&](const std::string& rel, const LVCIndex::StatData& st) {
+            if (rel.find(".lvc") == 0) return;
             
             seen.insert(rel);
             
@@ -1420,15 +1878,22 @@ public:
             if (committedIt == committedFiles.end() && stagedIt == stagedFiles.end()) {
                 // Not in commit and not staged = untracked
                 untracked.push_back(rel);
-            } else if (committedIt != committedFiles.end()) {
-                // Check if modified since last commit
-                std::string currentContent = readFile(e.path().string());
+            } else if (committedIt != committedFiles.end() && stagedIt == stagedFiles.end()) {
+                // Check if modified since last commit; unchanged stat data means unchanged content
+                const std::string* known = statCache.lookup(rel, st);
+                if (known && *known == committedIt->second) return;
+                
+                std::string currentContent = readFile((fs::path(repoPath) / rel).string());
                 std::string committedContent = db->getBlob(committedIt->second);
-                if (currentContent != committedContent && stagedIt == stagedFiles.end()) {
+                if (currentContent != committedContent) {
                     modified.push_back(rel);
+                } else {
+                    statCache.record(rel, st, committedIt->second);
                 }
             }
-        }
+        });
+        statCache.prune([&](const std::string& rel) { return seen.count(rel) != 0; });
+        if (statCache.isDirty()) saveIndex();
         
         // Check for deleted files
         for (const auto& [path, hash] : committedFiles) {
@@ -1833,6 +2298,47 @@ public:
             printSuccess("Index cleared");
         }
     }
+    
+    // Consolidate loose objects (and older packs) into a single delta-compressed pack
+    void gc() {
+        if (!isInitialized()) { printError("not an lvc repository"); return; }
+        
+        loadIndex();
+        loadHead();
+        
+        // Path of each blob, so that versions of the same file are deltified against each other
+        std::unordered_map<std::string, std::string> pathHints;
+        for (const auto& [path, hash] : stagedFiles) pathHints.emplace(hash, path);
+        
+        std::vector<std::string> tips = { headCommit };
+        for (const std::string& dir : { branchesDir, tagsDir, refsDir + "/versions" }) {
+            if (!fs::exists(dir)) continue;
+            for (const auto& e : fs::directory_iterator(dir)) {
+                std::string hash = readFile(e.path().string());
+                while (!hash.empty() && (hash.back() == '\n' || hash.back() == '\r')) hash.pop_back();
+                tips.push_back(hash);
+            }
+        }
+        std::unordered_set<std::string> visited;
+        for (std::string commit : tips) {
+            while (!commit.empty() && visited.insert(commit).second) {
+                auto data = db->parseCommit(commit);
+                for (const auto& [path, hash] : getTreeFiles(data.tree)) pathHints.emplace(hash, path);
+                commit = data.parent;
+            }
+        }
+        
+        auto stats = db->repack(pathHints);
+        if (stats.packName.empty()) {
+            std::cout << "Nothing to pack\n";
+            return;
+        }
+        
+        printSuccess("Packed " + std::to_string(stats.objects) + " objects into " + stats.packName.substr(0, 13));
+        std::cout << "  " << stats.deltas << " stored as deltas, " << stats.looseRemoved << " loose objects and "
+                  << stats.packsRemoved << " old packs removed\n";
+        std::cout << "  " << stats.bytesBefore / 1024 << " KB -> " << stats.bytesAfter / 1024 << " KB\n";
+    }
 };
 
 #endif // LVC_HPP
@@ -0,0 +1,250 @@
+// LVC Stat-Cache Index
+// Per-path stat data (size, mtime, file id) recorded next to the staging entries in
+// .lvc/index, as git's index does. A path whose stat data still matches its entry is
+// known to hold the content of the recorded object, so status and add skip reading
+// and hashing it. The working tree is walked one directory handle at a time, which
+// returns the stat data of every entry without opening the files.
+
+#ifndef LINUXIFY_LVC_INDEX_HPP
+#define LINUXIFY_LVC_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <ostream>
+#include <sstream>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#endif
+
+namespace LVCIndex {
+
+    // Native timestamp units: 100 ns since 1601 on Windows, ns since 1970 elsewhere
+#ifdef _WIN32
+    constexpr int64_t TICKS_PER_SECOND = 10000000;
+#else
+    constexpr int64_t TICKS_PER_SECOND = 1000000000;
+#endif
+    // Files modified this close to an index write may change again without their
+    // mtime moving (coarse timestamps); they are stored smudged and rehashed next time
+    constexpr int64_t RACY_WINDOW = 2 * TICKS_PER_SECOND;
+
+    const char* const HEADER = "# lvc index v2";
+    const char* const METADATA_DIR = ".lvc";
+
+    struct StatData {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t fileId = 0;  // inode, or NTFS file id
+
+        bool operator==(const StatData& o) const {
+            return size == o.size && mtime == o.mtime && fileId == o.fileId;
+        }
+        bool operator!=(const StatData& o) const { return !(*this == o); }
+    };
+
+    inline int64_t now() {
+#ifdef _WIN32
+        FILETIME ft;
+        GetSystemTimeAsFileTime(&ft);
+        return (int64_t)(((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (int64_t)ts.tv_sec * TICKS_PER_SECOND + ts.tv_nsec;
+#endif
+    }
+
+    // Stat data for one regular file; false if it is missing or not a file
+    inline bool statPath(const std::string& path, StatData& out) {
+#ifdef _WIN32
+        HANDLE h = CreateFileW(std::filesystem::path(path).wstring().c_str(), FILE_READ_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (h == INVALID_HANDLE_VALUE) return false;
+        BY_HANDLE_FILE_INFORMATION info;
+        bool ok = GetFileInformationByHandle(h, &info) != 0;
+        CloseHandle(h);
+        if (!ok || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+        out.size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+        out.mtime = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+        out.fileId = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+        return true;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        out.size = (uint64_t)st.st_size;
+        out.mtime = (int64_t)st.st_mtim.tv_sec * TICKS_PER_SECOND + st.st_mtim.tv_nsec;
+        out.fileId = (uint64_t)st.st_ino;
+        return true;
+#endif
+    }
+
+    // Calls visit(relativePath, stat) for every regular file under dir. relPrefix is
+    // dir's path relative to the repository ('/'-separated, empty for the root);
+    // the repository's own .lvc directory and linked directories are not entered.
+    inline void scanTree(const std::string& dir, const std::string& relPrefix,
+                         const std::function<void(const std::string&, const StatData&)>& visit) {
+        std::vector<std::pair<std::string, std::string>> pending = { { dir, relPrefix } };
+
+        while (!pending.empty()) {
+            auto [path, rel] = pending.back();
+            pending.pop_back();
+            std::string base = rel.empty() ? "" : rel + "/";
+
+#ifdef _WIN32
+            HANDLE h = CreateFileW(std::filesystem::path(path).wstring().c_str(), FILE_LIST_DIRECTORY,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                   OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+            if (h == INVALID_HANDLE_VALUE) continue;
+
+            std::vector<uint64_t> buffer(64 * 1024 / sizeof(uint64_t));  // 8-byte aligned records
+            FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+            while (GetFileInformationByHandleEx(h, infoClass, buffer.data(), (DWORD)(buffer.size() * sizeof(uint64_t)))) {
+                infoClass = FileIdBothDirectoryInfo;
+                auto* info = (FILE_ID_BOTH_DIR_INFO*)buffer.data();
+                while (true) {
+                    std::wstring wname(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                    if (wname != L"." && wname != L"..") {
+                        std::string name = std::filesystem::path(wname).string();
+                        bool isDir = (info->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+                        bool isLink = (info->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+                        if (isDir) {
+                            if (!isLink && !(rel.empty() && name == METADATA_DIR)) {
+                                pending.push_back({ path + "\\" + name, base + name });
+                            }
+                        } else {
+                            StatData st;
+                            st.size = (uint64_t)info->EndOfFile.QuadPart;
+                            st.mtime = (int64_t)info->LastWriteTime.QuadPart;
+                            st.fileId = (uint64_t)info->FileId.QuadPart;
+                            visit(base + name, st);
+                        }
+                    }
+                    if (info->NextEntryOffset == 0) break;
+                    info = (FILE_ID_BOTH_DIR_INFO*)((uint8_t*)info + info->NextEntryOffset);
+                }
+            }
+            CloseHandle(h);
+#else
+            DIR* d = opendir(path.c_str());
+            if (!d) continue;
+            while (struct dirent* e = readdir(d)) {
+                std::string name = e->d_name;
+                if (name == "." || name == "..") continue;
+
+                struct stat st;
+                if (fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                if (S_ISLNK(st.st_mode)) {
+                    // Linked files count, linked directories are not followed
+                    if (fstatat(dirfd(d), e->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+                }
+                if (S_ISDIR(st.st_mode)) {
+                    if (!(rel.empty() && name == METADATA_DIR)) {
+                        pending.push_back({ path + "/" + name, base + name });
+                    }
+                } else if (S_ISREG(st.st_mode)) {
+                    StatData sd;
+                    sd.size = (uint64_t)st.st_size;
+                    sd.mtime = (int64_t)st.st_mtim.tv_sec * TICKS_PER_SECOND + st.st_mtim.tv_nsec;
+                    sd.fileId = (uint64_t)st.st_ino;
+                    visit(base + name, sd);
+                }
+            }
+            closedir(d);
+#endif
+        }
+    }
+
+    // path -> (stat data, hash of an object holding exactly the file's content)
+    class StatCache {
+    private:
+        struct Entry {
+            StatData stat;
+            std::string hash;
+        };
+
+        std::unordered_map<std::string, Entry> entries;
+        bool dirty = false;
+
+    public:
+        void clear() {
+            entries.clear();
+            dirty = false;
+        }
+
+        // The recorded object hash if the file is unchanged since it was recorded
+        const std::string* lookup(const std::string& rel, const StatData& st) const {
+            auto it = entries.find(rel);
+            if (it == entries.end() || it->second.stat != st || it->second.stat.mtime == 0) return nullptr;
+            return &it->second.hash;
+        }
+
+        void record(const std::string& rel, const StatData& st, const std::string& hash) {
+            Entry& e = entries[rel];
+            if (e.stat == st && e.hash == hash) return;
+            e.stat = st;
+            e.hash = hash;
+            dirty = true;
+        }
+
+        // Drops entries for paths keep() rejects (files gone from the working tree)
+        template <typename Keep>
+        void prune(Keep keep) {
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (keep(it->first)) {
+                    ++it;
+                } else {
+                    it = entries.erase(it);
+                    dirty = true;
+                }
+            }
+        }
+
+        bool isDirty() const { return dirty; }
+        size_t size() const { return entries.size(); }
+
+        // "stat <size> <mtime> <fileId> <hash> <path>"; false for any other line
+        bool readLine(const std::string& line) {
+            if (line.compare(0, 5, "stat ") != 0) return false;
+            std::istringstream iss(line.substr(5));
+            Entry e;
+            if (!(iss >> e.stat.size >> e.stat.mtime >> e.stat.fileId >> e.hash)) return false;
+            iss.get();
+            std::string rel;
+            std::getline(iss, rel);
+            if (rel.empty()) return false;
+            entries[rel] = e;
+            return true;
+        }
+
+        // Sorted by path, so the file does not depend on the order entries were recorded
+        void write(std::ostream& out, int64_t writeTime) {
+            std::vector<const std::pair<const std::string, Entry>*> sorted;
+            sorted.reserve(entries.size());
+            for (const auto& kv : entries) sorted.push_back(&kv);
+            std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+            for (const auto* kv : sorted) {
+                const std::string& rel = kv->first;
+                const Entry& e = kv->second;
+                int64_t mtime = (e.stat.mtime > writeTime - RACY_WINDOW) ? 0 : e.stat.mtime;
+                out << "stat " << e.stat.size << " " << mtime << " " << e.stat.fileId << " "
+                    << e.hash << " " << rel << "\n";
+            }
+            dirty = false;
+        }
+    };
+
+} // namespace LVCIndex
+
+#endif // LINUXIFY_LVC_INDEX_HPP
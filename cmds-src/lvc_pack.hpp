@@ -0,0 +1,361 @@
+// LVC Pack Files
+// Loose objects are consolidated by `lvc gc` into objects/pack/pack-<name>.pack plus a
+// sorted .idx. Each pack entry is a whole object or a delta against an earlier entry of
+// the same pack, LZ77-compressed when that makes it smaller. The .idx holds a 256-entry
+// fan-out table (count of hashes whose first byte is <= i), the sorted raw hashes and
+// their pack offsets, so a lookup is one fan-out read and a binary search over a small
+// range. Both files are memory-mapped.
+
+#ifndef LINUXIFY_LVC_PACK_HPP
+#define LINUXIFY_LVC_PACK_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "../mapped_file.hpp"
+
+namespace LVCPack {
+
+    constexpr char PACK_MAGIC[8] = { 'L', 'V', 'C', 'P', 'A', 'C', 'K', 1 };
+    constexpr char IDX_MAGIC[8] = { 'L', 'V', 'C', 'I', 'D', 'X', 0, 1 };
+    constexpr size_t HEADER_BYTES = 16;  // magic + u32 count + u32 reserved
+    constexpr size_t HASH_BYTES = 32;
+
+    enum EntryKind : uint8_t { WHOLE = 0, DELTA = 1 };
+    enum Codec : uint8_t { STORED = 0, LZ = 1 };
+
+    // --- Little-endian and varint encoding ---
+
+    inline void putU32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; i++) out.push_back((char)(v >> (i * 8)));
+    }
+
+    inline void putU64(std::string& out, uint64_t v) {
+        for (int i = 0; i < 8; i++) out.push_back((char)(v >> (i * 8)));
+    }
+
+    inline uint32_t getU32(const char* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; i--) v = (v << 8) | (uint8_t)p[i];
+        return v;
+    }
+
+    inline uint64_t getU64(const char* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; i--) v = (v << 8) | (uint8_t)p[i];
+        return v;
+    }
+
+    inline void putVarint(std::string& out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+
+    inline bool getVarint(const char*& p, const char* end, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) return false;
+            uint8_t b = (uint8_t)*p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // --- Hashes: 64 hex digits <-> 32 raw bytes ---
+
+    inline bool hexToRaw(const std::string& hex, uint8_t* raw) {
+        if (hex.size() != HASH_BYTES * 2) return false;
+        for (size_t i = 0; i < HASH_BYTES; i++) {
+            int v = 0;
+            for (int k = 0; k < 2; k++) {
+                char c = hex[i * 2 + k];
+                int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+                if (d < 0) return false;
+                v = v * 16 + d;
+            }
+            raw[i] = (uint8_t)v;
+        }
+        return true;
+    }
+
+    inline std::string rawToHex(const uint8_t* raw) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(HASH_BYTES * 2, '0');
+        for (size_t i = 0; i < HASH_BYTES; i++) {
+            hex[i * 2] = digits[raw[i] >> 4];
+            hex[i * 2 + 1] = digits[raw[i] & 15];
+        }
+        return hex;
+    }
+
+    // --- LZ77 codec ---
+    // A sequence is varint(literal count), literals, varint(match length - 3), varint(distance);
+    // a match length field of 0 ends the stream. Matches are found through a single-slot
+    // hash table of 4-byte prefixes (LZ4 style): fast, and good on text and tree objects.
+
+    constexpr size_t LZ_MIN_MATCH = 4;
+    constexpr size_t LZ_HASH_BITS = 16;
+    constexpr size_t LZ_MAX_DISTANCE = 1 << 20;
+
+    inline uint32_t read32(const char* p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    inline std::string compress(std::string_view in) {
+        std::string out;
+        out.reserve(in.size() / 2 + 16);
+        unsigned bits = 8;  // table sized to the input: small objects dominate a pack
+        while (bits < LZ_HASH_BITS && ((size_t)1 << bits) < in.size()) bits++;
+        std::vector<uint32_t> table((size_t)1 << bits, UINT32_MAX);
+        const char* src = in.data();
+        size_t n = in.size(), i = 0, anchor = 0;
+
+        while (n >= LZ_MIN_MATCH && i <= n - LZ_MIN_MATCH) {
+            uint32_t seq = read32(src + i);
+            uint32_t h = (seq * 2654435761u) >> (32 - bits);
+            uint32_t cand = table[h];
+            table[h] = (uint32_t)i;
+            if (cand == UINT32_MAX || i - cand > LZ_MAX_DISTANCE || read32(src + cand) != seq) {
+                i++;
+                continue;
+            }
+            size_t len = LZ_MIN_MATCH;
+            while (i + len < n && src[cand + len] == src[i + len]) len++;
+
+            putVarint(out, i - anchor);
+            out.append(src + anchor, i - anchor);
+            putVarint(out, len - 3);
+            putVarint(out, i - cand);
+            i += len;
+            anchor = i;
+        }
+        putVarint(out, n - anchor);
+        out.append(src + anchor, n - anchor);
+        putVarint(out, 0);
+        return out;
+    }
+
+    inline bool decompress(std::string_view in, size_t rawSize, std::string& out) {
+        out.clear();
+        out.reserve(rawSize);
+        const char* p = in.data();
+        const char* end = p + in.size();
+        for (;;) {
+            uint64_t lit, len, dist;
+            if (!getVarint(p, end, lit) || lit > (uint64_t)(end - p) || out.size() + lit > rawSize) return false;
+            out.append(p, (size_t)lit);
+            p += lit;
+            if (!getVarint(p, end, len)) return false;
+            if (len == 0) break;
+            len += 3;
+            if (!getVarint(p, end, dist) || dist == 0 || dist > out.size() || out.size() + len > rawSize) return false;
+            size_t from = out.size() - (size_t)dist;
+            for (size_t k = 0; k < len; k++) out.push_back(out[from + k]);  // may overlap itself
+        }
+        return out.size() == rawSize;
+    }
+
+    // --- Reading ---
+
+    struct Entry {
+        EntryKind kind = WHOLE;
+        uint64_t baseOffset = 0;  // DELTA: pack offset of the base entry
+        std::string payload;      // whole object bytes, or delta against the base's
+    };
+
+    class Pack {
+    private:
+        TextStream::MappedFile packMap;
+        TextStream::MappedFile idxMap;
+        std::string packPath;
+        std::string idxPath;
+        uint32_t count = 0;
+        const char* fanout = nullptr;
+        const char* hashes = nullptr;
+        const char* offsets = nullptr;
+
+    public:
+        bool open(const std::string& pack, const std::string& idx) {
+            packPath = pack;
+            idxPath = idx;
+            if (!packMap.open(pack) || !idxMap.open(idx)) return false;
+            std::string_view pv = packMap.view(), iv = idxMap.view();
+            if (pv.size() < HEADER_BYTES || memcmp(pv.data(), PACK_MAGIC, 8) != 0) return false;
+            if (iv.size() < HEADER_BYTES + 256 * 4 || memcmp(iv.data(), IDX_MAGIC, 8) != 0) return false;
+            count = getU32(iv.data() + 8);
+            if (count != getU32(pv.data() + 8)) return false;
+            if (iv.size() < HEADER_BYTES + 256 * 4 + (size_t)count * (HASH_BYTES + 8)) return false;
+            fanout = iv.data() + HEADER_BYTES;
+            hashes = fanout + 256 * 4;
+            offsets = hashes + (size_t)count * HASH_BYTES;
+            return true;
+        }
+
+        void close() {
+            packMap.close();
+            idxMap.close();
+            count = 0;
+        }
+
+        size_t size() const { return count; }
+        const std::string& path() const { return packPath; }
+        const std::string& indexPath() const { return idxPath; }
+
+        std::string hashAt(size_t i) const { return rawToHex((const uint8_t*)hashes + i * HASH_BYTES); }
+        uint64_t offsetAt(size_t i) const { return getU64(offsets + i * 8); }
+
+        // Pack offset of the object, found through the fan-out range for its first byte
+        bool find(const std::string& hexHash, uint64_t& offset) const {
+            uint8_t raw[HASH_BYTES];
+            if (count == 0 || !hexToRaw(hexHash, raw)) return false;
+            size_t lo = raw[0] == 0 ? 0 : getU32(fanout + (raw[0] - 1) * 4);
+            size_t hi = getU32(fanout + raw[0] * 4);
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                int c = memcmp(hashes + mid * HASH_BYTES, raw, HASH_BYTES);
+                if (c == 0) {
+                    offset = offsetAt(mid);
+                    return true;
+                }
+                if (c < 0) lo = mid + 1;
+                else hi = mid;
+            }
+            return false;
+        }
+
+        bool readEntry(uint64_t offset, Entry& e) const {
+            std::string_view pv = packMap.view();
+            if (offset < HEADER_BYTES || offset + 2 > pv.size()) return false;
+            const char* p = pv.data() + offset;
+            const char* end = pv.data() + pv.size();
+            e.kind = (EntryKind)(uint8_t)*p++;
+            Codec codec = (Codec)(uint8_t)*p++;
+            uint64_t rawSize, storedSize;
+            if (!getVarint(p, end, rawSize) || !getVarint(p, end, storedSize)) return false;
+            if (e.kind == DELTA) {
+                uint64_t distance;
+                if (!getVarint(p, end, distance) || distance == 0 || distance > offset) return false;
+                e.baseOffset = offset - distance;
+            }
+            if (storedSize > (uint64_t)(end - p)) return false;
+            std::string_view stored(p, (size_t)storedSize);
+            if (codec == STORED) {
+                e.payload.assign(stored.data(), stored.size());
+                return e.payload.size() == rawSize;
+            }
+            return decompress(stored, (size_t)rawSize, e.payload);
+        }
+    };
+
+    // --- Writing ---
+
+    class PackWriter {
+    private:
+        struct Indexed {
+            uint8_t raw[HASH_BYTES];
+            uint64_t offset;
+        };
+
+        std::ofstream out;
+        std::string tmpPath;
+        std::vector<Indexed> index;
+        uint64_t position = 0;
+
+    public:
+        bool open(const std::string& tempPackPath) {
+            tmpPath = tempPackPath;
+            out.open(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            std::string header(PACK_MAGIC, 8);
+            putU32(header, 0);  // count, patched by finish()
+            putU32(header, 0);
+            out.write(header.data(), header.size());
+            position = header.size();
+            return true;
+        }
+
+        // Appends an entry and returns its offset (the base of later deltas)
+        uint64_t add(const std::string& hexHash, EntryKind kind, const std::string& payload, uint64_t baseOffset = 0) {
+            Indexed ix;
+            hexToRaw(hexHash, ix.raw);
+            ix.offset = position;
+            index.push_back(ix);
+
+            std::string packed = compress(payload);
+            bool useLz = packed.size() < payload.size();
+            const std::string& stored = useLz ? packed : payload;
+
+            std::string head;
+            head.push_back((char)kind);
+            head.push_back((char)(useLz ? LZ : STORED));
+            putVarint(head, payload.size());
+            putVarint(head, stored.size());
+            if (kind == DELTA) putVarint(head, position - baseOffset);
+            out.write(head.data(), head.size());
+            out.write(stored.data(), stored.size());
+            position += head.size() + stored.size();
+            return ix.offset;
+        }
+
+        uint64_t bytesWritten() const { return position; }
+        size_t size() const { return index.size(); }
+
+        // Patches the entry count, writes the .idx and moves the pack into place
+        bool finish(const std::string& packPath, const std::string& idxPath) {
+            std::string count;
+            putU32(count, (uint32_t)index.size());
+            out.seekp(8);
+            out.write(count.data(), 4);
+            out.close();
+            if (!out) return false;
+
+            std::sort(index.begin(), index.end(), [](const Indexed& a, const Indexed& b) {
+                return memcmp(a.raw, b.raw, HASH_BYTES) < 0;
+            });
+            std::string idx(IDX_MAGIC, 8);
+            putU32(idx, (uint32_t)index.size());
+            putU32(idx, 0);
+            uint32_t fan[256] = { 0 };
+            for (const auto& ix : index) fan[ix.raw[0]]++;
+            uint32_t running = 0;
+            for (int b = 0; b < 256; b++) {
+                running += fan[b];
+                putU32(idx, running);
+            }
+            for (const auto& ix : index) idx.append((const char*)ix.raw, HASH_BYTES);
+            for (const auto& ix : index) putU64(idx, ix.offset);
+
+            std::ofstream f(idxPath + ".tmp", std::ios::binary | std::ios::trunc);
+            f.write(idx.data(), idx.size());
+            f.close();
+            if (!f) return false;
+
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, packPath, ec);
+            if (ec) return false;
+            std::filesystem::rename(idxPath + ".tmp", idxPath, ec);
+            return !ec;
+        }
+
+        // Abandons a partly written pack
+        void discard() {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmpPath, ec);
+        }
+    };
+
+} // namespace LVCPack
+
+#endif // LINUXIFY_LVC_PACK_HPP
@@ -20,64 +20,25 @@
 #include <algorithm>
 #include <stack>
 
+#include "node_cipher.hpp"
+#include "sha256.hpp"
+
 constexpr uint32_t NODE_MAGIC = 0x4E4F4445;
-constexpr uint32_t NODE_VERSION = 3;
+constexpr uint32_t NODE_VERSION = 4;
+constexpr uint32_t NODE_LEGACY_VERSION = 3;
 constexpr uint32_t DEFAULT_BLOCK_SIZE = 4096;
 constexpr uint32_t MAX_NAME_LEN = 63;
 constexpr uint32_t DATA_BLOCKS_COUNT = 10;
+constexpr uint32_t DIRECT_BLOCKS_COUNT = 8;
+constexpr uint32_t INDIRECT_SLOT = 8;
+constexpr uint32_t DOUBLE_INDIRECT_SLOT = 9;
+constexpr uint32_t NODE_FLAG_BLOCK_MAP = 0x1;
 constexpr uint32_t EDGE_BLOCKS_COUNT = 4;
 constexpr uint32_t SUPERBLOCK_SIZE = 512;
 constexpr uint32_t SALT_SIZE = 16;
 constexpr uint32_t VERIFY_TAG_SIZE = 32;
 constexpr uint32_t KDF_ITERATIONS = 10000;
 
-class SHA256 {
-private:
-    static constexpr uint32_t K[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    static uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
-    static uint32_t ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
-    static uint32_t maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
-    static uint32_t sig0(uint32_t x) { return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22); }
-    static uint32_t sig1(uint32_t x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25); }
-    static uint32_t ep0(uint32_t x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
-    static uint32_t ep1(uint32_t x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
-public:
-    static std::string hash(const std::string& data) {
-        uint32_t h[8] = {0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19};
-        std::vector<uint8_t> msg(data.begin(), data.end());
-        size_t origLen = msg.size();
-        msg.push_back(0x80);
-        while ((msg.size() + 8) % 64 != 0) msg.push_back(0);
-        uint64_t bitLen = origLen * 8;
-        for (int i = 7; i >= 0; i--) msg.push_back((bitLen >> (i * 8)) & 0xFF);
-        for (size_t i = 0; i < msg.size(); i += 64) {
-            uint32_t w[64];
-            for (int j = 0; j < 16; j++) w[j] = (msg[i+j*4]<<24)|(msg[i+j*4+1]<<16)|(msg[i+j*4+2]<<8)|msg[i+j*4+3];
-            for (int j = 16; j < 64; j++) w[j] = ep1(w[j-2]) + w[j-7] + ep0(w[j-15]) + w[j-16];
-            uint32_t a=h[0],b=h[1],c=h[2],d=h[3],e=h[4],f=h[5],g=h[6],hh=h[7];
-            for (int j = 0; j < 64; j++) {
-                uint32_t t1 = hh + sig1(e) + ch(e,f,g) + K[j] + w[j];
-                uint32_t t2 = sig0(a) + maj(a,b,c);
-                hh=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
-            }
-            h[0]+=a; h[1]+=b; h[2]+=c; h[3]+=d; h[4]+=e; h[5]+=f; h[6]+=g; h[7]+=hh;
-        }
-        std::ostringstream oss;
-        for (int i = 0; i < 8; i++) oss << std::hex << std::setfill('0') << std::setw(8) << h[i];
-        return oss.str();
-    }
-};
-constexpr uint32_t SHA256::K[64];
-
 std::string deriveKey(const std::string& password, const uint8_t* salt) {
     std::string input = password;
     for (size_t i = 0; i < SALT_SIZE; i++) input += static_cast<char>(salt[i]);
@@ -86,26 +47,22 @@ std::string deriveKey(const std::string& password, const uint8_t* salt) {
     return key;
 }
 
-void generateEncryptedMagic(uint8_t* dest, const std::string& key) {
+void generateEncryptedMagic(uint8_t* dest, const std::string& key, uint32_t version) {
     std::string pattern = SHA256::hash(key + "MAGIC_OBFUSCATE");
-    uint32_t magicData[2] = { NODE_MAGIC, NODE_VERSION };
+    uint32_t magicData[2] = { NODE_MAGIC, version };
     for (size_t i = 0; i < 8; i++) dest[i] = reinterpret_cast<uint8_t*>(magicData)[i] ^ static_cast<uint8_t>(pattern[i]);
 }
 
-bool verifyEncryptedMagic(const uint8_t* magic, const std::string& key) {
+bool verifyEncryptedMagic(const uint8_t* magic, const std::string& key, uint32_t version) {
     uint8_t expected[8];
-    generateEncryptedMagic(expected, key);
+    generateEncryptedMagic(expected, key, version);
     return memcmp(magic, expected, 8) == 0;
 }
 
-void xorData(char* data, size_t size, size_t fileOffset, const std::string& encryptionKey) {
-    if (encryptionKey.empty()) return;
-    const size_t ENCRYPTED_START = 8 + SALT_SIZE + VERIFY_TAG_SIZE;
-    if (fileOffset < ENCRYPTED_START) {
-        size_t skip = ENCRYPTED_START - fileOffset;
-        if (skip >= size) return;
-        data += skip; size -= skip; fileOffset = ENCRYPTED_START;
-    }
+uint32_t g_imageVersion = NODE_VERSION;
+NodeCipher::ChaCha20 g_cipher;
+
+void legacyXorData(char* data, size_t size, size_t fileOffset, const std::string& encryptionKey) {
     const size_t CHUNK_SIZE = 64;
     size_t lastChunkIdx = SIZE_MAX;
     std::string lastPad;
@@ -122,6 +79,19 @@ void xorData(char* data, size_t size, size_t fileOffset, const std::string& encr
     }
 }
 
+// v4 images use ChaCha20 (block counter = file offset / 64), v3 images the SHA-256 pads
+void xorData(char* data, size_t size, size_t fileOffset, const std::string& encryptionKey) {
+    if (encryptionKey.empty()) return;
+    const size_t ENCRYPTED_START = 8 + SALT_SIZE + VERIFY_TAG_SIZE;
+    if (fileOffset < ENCRYPTED_START) {
+        size_t skip = ENCRYPTED_START - fileOffset;
+        if (skip >= size) return;
+        data += skip; size -= skip; fileOffset = ENCRYPTED_START;
+    }
+    if (g_imageVersion == NODE_LEGACY_VERSION) legacyXorData(data, size, fileOffset, encryptionKey);
+    else g_cipher.apply(reinterpret_cast<uint8_t*>(data), size, fileOffset);
+}
+
 #pragma pack(push, 1)
 struct Superblock {
     uint8_t encryptedMagic[8]; uint8_t salt[SALT_SIZE]; uint8_t verifyTag[VERIFY_TAG_SIZE];
@@ -133,7 +103,7 @@ struct Superblock {
 struct GraphNode {
     uint32_t id; uint32_t size; uint32_t dataBlockCount; uint32_t dataBlocks[DATA_BLOCKS_COUNT];
     uint32_t edgeCount; uint32_t edgeBlockCount; uint32_t edgeBlocks[EDGE_BLOCKS_COUNT];
-    uint32_t refCount; int64_t created; int64_t modified; uint8_t padding[36];
+    uint32_t refCount; int64_t created; int64_t modified; uint32_t flags; uint8_t padding[32];
 };
 struct LinkEntry { uint32_t targetNodeId; char name[MAX_NAME_LEN + 1]; };
 #pragma pack(pop)
@@ -208,12 +178,47 @@ std::vector<LinkEntry> readLinks(const GraphNode& node) {
     return links;
 }
 
+std::vector<uint32_t> readPointerBlock(uint32_t blockId) {
+    auto raw = readBlock(blockId);
+    std::vector<uint32_t> pointers(g_superblock.blockSize / sizeof(uint32_t));
+    memcpy(pointers.data(), raw.data(), pointers.size() * sizeof(uint32_t));
+    return pointers;
+}
+
+// Data block IDs in file order: flat list for v3 nodes, direct + indirect + double-indirect otherwise
+std::vector<uint32_t> fileBlocks(const GraphNode& node) {
+    std::vector<uint32_t> ids;
+    uint32_t count = node.dataBlockCount;
+    if (!(node.flags & NODE_FLAG_BLOCK_MAP)) {
+        for (uint32_t i = 0; i < count && i < DATA_BLOCKS_COUNT; i++) ids.push_back(node.dataBlocks[i]);
+        return ids;
+    }
+    uint32_t ppb = g_superblock.blockSize / sizeof(uint32_t);
+    for (uint32_t i = 0; i < count && i < DIRECT_BLOCKS_COUNT; i++) ids.push_back(node.dataBlocks[i]);
+    if (count > DIRECT_BLOCKS_COUNT) {
+        auto table = readPointerBlock(node.dataBlocks[INDIRECT_SLOT]);
+        uint32_t n = std::min(count - DIRECT_BLOCKS_COUNT, ppb);
+        ids.insert(ids.end(), table.begin(), table.begin() + n);
+    }
+    if (count > DIRECT_BLOCKS_COUNT + ppb) {
+        auto outer = readPointerBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT]);
+        uint32_t remaining = count - DIRECT_BLOCKS_COUNT - ppb;
+        for (uint32_t k = 0; remaining > 0 && k < ppb; k++) {
+            auto table = readPointerBlock(outer[k]);
+            uint32_t n = std::min(remaining, ppb);
+            ids.insert(ids.end(), table.begin(), table.begin() + n);
+            remaining -= n;
+        }
+    }
+    return ids;
+}
+
 std::string readFileContent(const GraphNode& node) {
     std::string content;
     size_t totalRead = 0;
-    for (uint32_t i = 0; i < node.dataBlockCount && i < DATA_BLOCKS_COUNT; i++) {
+    for (uint32_t blockId : fileBlocks(node)) {
         if (totalRead >= node.size) break;
-        auto block = readBlock(node.dataBlocks[i]);
+        auto block = readBlock(blockId);
         size_t toRead = std::min((size_t)g_superblock.blockSize, (size_t)node.size - totalRead);
         content.append(reinterpret_cast<char*>(block.data()), toRead);
         totalRead += toRead;
@@ -446,7 +451,7 @@ bool openNodeFile(const std::string& path, const std::string& password) {
     g_imageFile.open(path, std::ios::in | std::ios::binary);
     if (!g_imageFile) return false;
     g_imageFile.read(reinterpret_cast<char*>(&g_superblock), sizeof(Superblock));
-    g_isEncrypted = false; g_encryptionKey.clear();
+    g_isEncrypted = false; g_encryptionKey.clear(); g_imageVersion = NODE_VERSION; g_cipher.clear();
     
     bool hasSalt = false;
     for (size_t i = 0; i < SALT_SIZE; i++) if (g_superblock.salt[i] != 0) { hasSalt = true; break; }
@@ -472,7 +477,12 @@ bool openNodeFile(const std::string& path, const std::string& password) {
         }
         if (pwd.empty()) { MessageBoxA(NULL, "No password.", "Error", MB_ICONERROR); g_imageFile.close(); return false; }
         g_encryptionKey = deriveKey(pwd, g_superblock.salt);
-        if (!verifyEncryptedMagic(g_superblock.encryptedMagic, g_encryptionKey)) {
+        if (verifyEncryptedMagic(g_superblock.encryptedMagic, g_encryptionKey, NODE_VERSION)) {
+            g_imageVersion = NODE_VERSION;
+            g_cipher.setKdfKey(g_encryptionKey);
+        } else if (verifyEncryptedMagic(g_superblock.encryptedMagic, g_encryptionKey, NODE_LEGACY_VERSION)) {
+            g_imageVersion = NODE_LEGACY_VERSION;
+        } else {
             MessageBoxA(NULL, "Incorrect password.", "Error", MB_ICONERROR);
             g_imageFile.close(); g_encryptionKey.clear(); return false;
         }
@@ -16,7 +16,14 @@
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
 #include <windows.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "node_cipher.hpp"
+#include "sha256.hpp"
 
 namespace fs = std::filesystem;
 
@@ -25,11 +32,16 @@ namespace fs = std::filesystem;
 // ============================================================================
 
 constexpr uint32_t NODE_MAGIC = 0x4E4F4445;  // "NODE" - used internally
-constexpr uint32_t NODE_VERSION = 3;          // v3: hardened encryption
+constexpr uint32_t NODE_VERSION = 4;          // v4: ChaCha20 stream cipher
+constexpr uint32_t NODE_LEGACY_VERSION = 3;   // v3: SHA-256 pad cipher (mount + migrate only)
 constexpr uint32_t DEFAULT_BLOCK_SIZE = 4096;
 constexpr uint32_t DEFAULT_INODE_COUNT = 1024;
 constexpr uint32_t MAX_NAME_LEN = 63;
 constexpr uint32_t DATA_BLOCKS_COUNT = 10;
+constexpr uint32_t DIRECT_BLOCKS_COUNT = 8;   // dataBlocks[0..7] map file blocks directly
+constexpr uint32_t INDIRECT_SLOT = 8;         // dataBlocks[8]: block of block IDs
+constexpr uint32_t DOUBLE_INDIRECT_SLOT = 9;  // dataBlocks[9]: block of indirect block IDs
+constexpr uint32_t NODE_FLAG_BLOCK_MAP = 0x1; // dataBlocks uses the direct/indirect layout
 constexpr uint32_t EDGE_BLOCKS_COUNT = 4;
 constexpr uint32_t SUPERBLOCK_SIZE = 512;
 
@@ -39,88 +51,6 @@ constexpr uint32_t KDF_ITERATIONS = 10000;    // PBKDF2-style iterations
 constexpr uint32_t VERIFY_TAG_SIZE = 32;      // Password verification tag
 constexpr uint64_t DEFAULT_MAX_FILE_SIZE = 0; // 0 = no limit
 
-// ============================================================================
-// SHA-256 IMPLEMENTATION (Simplified for Node)
-// ============================================================================
-
-class SHA256 {
-private:
-    static constexpr uint32_t K[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-        0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-        0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-        0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
-    static uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
-    static uint32_t ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
-    static uint32_t maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
-    static uint32_t sig0(uint32_t x) { return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22); }
-    static uint32_t sig1(uint32_t x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25); }
-    static uint32_t ep0(uint32_t x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
-    static uint32_t ep1(uint32_t x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
-
-public:
-    static std::string hash(const std::string& data) {
-        uint32_t h[8] = {
-            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-        };
-        
-        std::vector<uint8_t> msg(data.begin(), data.end());
-        size_t origLen = msg.size();
-        msg.push_back(0x80);
-        while ((msg.size() + 8) % 64 != 0) msg.push_back(0);
-        
-        uint64_t bitLen = origLen * 8;
-        for (int i = 7; i >= 0; i--) msg.push_back((bitLen >> (i * 8)) & 0xFF);
-        
-        for (size_t i = 0; i < msg.size(); i += 64) {
-            uint32_t w[64];
-            for (int j = 0; j < 16; j++) {
-                w[j] = (msg[i + j*4] << 24) | (msg[i + j*4 + 1] << 16) |
-                       (msg[i + j*4 + 2] << 8) | msg[i + j*4 + 3];
-            }
-            for (int j = 16; j < 64; j++) {
-                w[j] = ep1(w[j-2]) + w[j-7] + ep0(w[j-15]) + w[j-16];
-            }
-            
-            uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
-            uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
-            
-            for (int j = 0; j < 64; j++) {
-                uint32_t t1 = hh + sig1(e) + ch(e, f, g) + K[j] + w[j];
-                uint32_t t2 = sig0(a) + maj(a, b, c);
-                hh = g; g = f; f = e; e = d + t1;
-                d = c; c = b; b = a; a = t1 + t2;
-            }
-            
-            h[0] += a; h[1] += b; h[2] += c; h[3] += d;
-            h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
-        }
-        
-        std::ostringstream oss;
-        for (int i = 0; i < 8; i++) {
-            oss << std::hex << std::setfill('0') << std::setw(8) << h[i];
-        }
-        return oss.str();
-    }
-};
-
-constexpr uint32_t SHA256::K[64];
-
 // ============================================================================
 // DATA STRUCTURES
 // ============================================================================
@@ -138,7 +68,7 @@ struct Superblock {
     uint8_t verifyTag[VERIFY_TAG_SIZE]; // 32 bytes: Encrypted verification tag
     
     // === Encrypted Payload (from here everything is encrypted) ===
-    uint32_t version;             // Format version (3)
+    uint32_t version;             // Format version (4, or 3 for legacy images)
     uint32_t blockSize;           // Block size in bytes
     uint32_t totalBlocks;         // Total data blocks
     uint32_t totalNodes;          // Total graph nodes
@@ -160,7 +90,7 @@ struct GraphNode {
     // Content Data
     uint32_t size;            // content size in bytes
     uint32_t dataBlockCount;  // Number of blocks used for data
-    uint32_t dataBlocks[DATA_BLOCKS_COUNT]; // Blocks for content
+    uint32_t dataBlocks[DATA_BLOCKS_COUNT]; // Direct + indirect block map (see NODE_FLAG_BLOCK_MAP)
     
     // Edges (Links)
     uint32_t edgeCount;       // Number of outgoing edges
@@ -170,7 +100,8 @@ struct GraphNode {
     uint32_t refCount;        // Incoming edges (0 = orphan/garbage)
     int64_t created;          // Creation timestamp
     int64_t modified;         // Modification timestamp
-    uint8_t padding[36];      // Future use & alignment 
+    uint32_t flags;           // NODE_FLAG_* bits
+    uint8_t padding[32];      // Future use & alignment 
 };
 
 struct LinkEntry {
@@ -192,11 +123,15 @@ private:
     Superblock superblock;
     std::vector<uint8_t> nodeBitmap; // Was inodeBitmap
     std::vector<uint8_t> blockBitmap;
+    uint32_t nodeHint = 0;           // Next-fit allocation cursors (not persisted)
+    uint32_t blockHint = 0;
     std::vector<GraphNode> nodes;    // Was inodes
     bool mounted;
     bool isEncrypted;                // True if password protected
     
     std::string encryptionKey;       // Derived key (after KDF)
+    uint32_t imageVersion;           // Format of the mounted image, selects the cipher
+    NodeCipher::ChaCha20 cipher;     // v4 keystream, keyed from encryptionKey
 
     // Console colors
     HANDLE hConsole;
@@ -248,21 +183,21 @@ private:
     }
     
     // Generate obfuscated magic bytes (not plain "NODE")
-    void generateEncryptedMagic(uint8_t* dest, const std::string& key) {
+    void generateEncryptedMagic(uint8_t* dest, const std::string& key, uint32_t version = NODE_VERSION) {
         // Create a unique pattern from the key
         std::string pattern = SHA256::hash(key + "MAGIC_OBFUSCATE");
         
         // XOR with a representation of NODE_MAGIC + version
-        uint32_t magicData[2] = { NODE_MAGIC, NODE_VERSION };
+        uint32_t magicData[2] = { NODE_MAGIC, version };
         for (size_t i = 0; i < 8; i++) {
             dest[i] = reinterpret_cast<uint8_t*>(magicData)[i] ^ static_cast<uint8_t>(pattern[i]);
         }
     }
     
     // Verify magic bytes match (for password verification)
-    bool verifyEncryptedMagic(const uint8_t* magic, const std::string& key) {
+    bool verifyEncryptedMagic(const uint8_t* magic, const std::string& key, uint32_t version = NODE_VERSION) {
         uint8_t expected[8];
-        generateEncryptedMagic(expected, key);
+        generateEncryptedMagic(expected, key, version);
         return memcmp(magic, expected, 8) == 0;
     }
     
@@ -281,7 +216,9 @@ private:
         return memcmp(tag, expected, VERIFY_TAG_SIZE) == 0;
     }
     
-    // Hardened stream cipher - encrypts ALL data including superblock payload
+    // Stream cipher - encrypts ALL data including superblock payload.
+    // v4 images use ChaCha20 with the block counter taken from the file offset;
+    // v3 images keep their original SHA-256 pad cipher until migrated.
     void xorData(char* data, size_t size, size_t fileOffset) {
         if (encryptionKey.empty()) return;
         
@@ -297,6 +234,15 @@ private:
             fileOffset = ENCRYPTED_START;
         }
         
+        if (imageVersion == NODE_LEGACY_VERSION) {
+            legacyXorData(data, size, fileOffset);
+        } else {
+            cipher.apply(reinterpret_cast<uint8_t*>(data), size, fileOffset);
+        }
+    }
+    
+    // v3 cipher: one double SHA-256 per 64-byte chunk (offset already past the header)
+    void legacyXorData(char* data, size_t size, size_t fileOffset) {
         const size_t CHUNK_SIZE = 64;
         
         // Use thread-local to avoid static variable issues
@@ -351,16 +297,46 @@ private:
         bitmap[index / 8] &= ~(1 << (index % 8));
     }
 
-    // Allocate a new node
+    static unsigned lowestClearBit(uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward64(&idx, ~word);
+        return (unsigned)idx;
+#else
+        return (unsigned)__builtin_ctzll(~word);
+#endif
+    }
+
+    // First clear bit at or after `hint`, wrapping around once; -1 if the bitmap is full.
+    // Tests 64 bits per step (bit i is bit i % 8 of byte i / 8, i.e. little-endian words).
+    static int64_t findClearBit(const std::vector<uint8_t>& bitmap, uint32_t count, uint32_t hint) {
+        if (count == 0) return -1;
+        if (hint >= count) hint = 0;
+        const uint64_t words = (count + 63) / 64;
+        const uint64_t start = hint / 64;
+        const uint64_t belowHint = (1ULL << (hint % 64)) - 1;
+        
+        for (uint64_t n = 0; n <= words; n++) {
+            uint64_t w = (start + n) % words;
+            uint64_t word = ~0ULL;
+            memcpy(&word, bitmap.data() + w * 8, (std::min)((size_t)8, bitmap.size() - (size_t)(w * 8)));
+            if (n == 0) word |= belowHint;            // bits before the hint are checked last
+            if (n == words) word |= ~belowHint;       // ...on the wrap-around visit
+            if (w == words - 1 && count % 64 != 0) word |= ~0ULL << (count % 64);
+            if (word != ~0ULL) return (int64_t)(w * 64 + lowestClearBit(word));
+        }
+        return -1;
+    }
+
+    // Allocate a new node (next-fit from the last allocation)
     int32_t allocNode() {
-        for (uint32_t i = 0; i < superblock.totalNodes; i++) {
-            if (!isBitSet(nodeBitmap, i)) {
-                setBit(nodeBitmap, i);
-                superblock.freeNodes--;
-                return static_cast<int32_t>(i);
-            }
-        }
-        return -1; // No free nodes
+        if (superblock.freeNodes == 0) return -1;
+        int64_t i = findClearBit(nodeBitmap, superblock.totalNodes, nodeHint);
+        if (i < 0) return -1; // No free nodes
+        setBit(nodeBitmap, static_cast<uint32_t>(i));
+        superblock.freeNodes--;
+        nodeHint = static_cast<uint32_t>(i) + 1;
+        return static_cast<int32_t>(i);
     }
     
     void freeNode(uint32_t id) {
@@ -371,16 +347,16 @@ private:
         }
     }
 
-    // Allocate a new block
+    // Allocate a new block. Next-fit, so a file grown block by block gets consecutive
+    // blocks while the space after the previous allocation is free.
     int32_t allocBlock() {
-        for (uint32_t i = 0; i < superblock.totalBlocks; i++) {
-            if (!isBitSet(blockBitmap, i)) {
-                setBit(blockBitmap, i);
-                superblock.freeBlocks--;
-                return static_cast<int32_t>(i);
-            }
-        }
-        return -1; // No free blocks
+        if (superblock.freeBlocks == 0) return -1;
+        int64_t i = findClearBit(blockBitmap, superblock.totalBlocks, blockHint);
+        if (i < 0) return -1; // No free blocks
+        setBit(blockBitmap, static_cast<uint32_t>(i));
+        superblock.freeBlocks--;
+        blockHint = static_cast<uint32_t>(i) + 1;
+        return static_cast<int32_t>(i);
     }
     
     void freeBlock(uint32_t id) {
@@ -418,6 +394,210 @@ private:
         imageFile.write(reinterpret_cast<const char*>(buffer.data()), superblock.blockSize);
     }
 
+    // --- File block maps ---
+    // Files are dense: logical blocks 0..dataBlockCount-1 are all allocated. With
+    // NODE_FLAG_BLOCK_MAP, dataBlocks[0..7] hold blocks 0-7, dataBlocks[8] an indirect
+    // block with the IDs of the next blockSize/4 blocks, and dataBlocks[9] a double-indirect
+    // block of indirect blocks (about 4GB at 4096-byte blocks). Nodes from v3 images keep
+    // a flat list of up to 10 direct blocks until their next write converts them.
+
+    uint32_t pointersPerBlock() const {
+        return superblock.blockSize / sizeof(uint32_t);
+    }
+
+    uint64_t maxMappedBlocks() const {
+        uint64_t ppb = pointersPerBlock();
+        return DIRECT_BLOCKS_COUNT + ppb + ppb * ppb;
+    }
+
+    // Indirect/double-indirect blocks a mapped file of `count` blocks needs
+    uint64_t pointerBlocksFor(uint64_t count) const {
+        uint64_t ppb = pointersPerBlock();
+        if (count <= DIRECT_BLOCKS_COUNT) return 0;
+        uint64_t rel = count - DIRECT_BLOCKS_COUNT;
+        if (rel <= ppb) return 1;
+        return 2 + (rel - ppb + ppb - 1) / ppb;
+    }
+
+    std::vector<uint32_t> readPointerBlock(uint32_t blockId) {
+        auto raw = readBlock(blockId);
+        std::vector<uint32_t> pointers(pointersPerBlock());
+        memcpy(pointers.data(), raw.data(), pointers.size() * sizeof(uint32_t));
+        return pointers;
+    }
+
+    void writePointerBlock(uint32_t blockId, const std::vector<uint32_t>& pointers) {
+        std::vector<uint8_t> raw(superblock.blockSize, 0);
+        memcpy(raw.data(), pointers.data(), pointers.size() * sizeof(uint32_t));
+        writeBlock(blockId, raw);
+    }
+
+    // Physical IDs of logical blocks [first, first + count), clipped to the file.
+    // Each indirect block on the way is read once.
+    std::vector<uint32_t> mapBlocks(const GraphNode& node, uint32_t first, uint32_t count) {
+        std::vector<uint32_t> result;
+        uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(first) + count, node.dataBlockCount));
+        if (first >= end) return result;
+        result.reserve(end - first);
+        
+        if (!(node.flags & NODE_FLAG_BLOCK_MAP)) {
+            for (uint32_t i = first; i < end && i < DATA_BLOCKS_COUNT; i++) result.push_back(node.dataBlocks[i]);
+            return result;
+        }
+        
+        const uint32_t ppb = pointersPerBlock();
+        std::vector<uint32_t> outer, table;
+        int64_t loadedTable = -1; // 0 = indirect, k = k-th table under the double-indirect block
+        for (uint32_t i = first; i < end; i++) {
+            if (i < DIRECT_BLOCKS_COUNT) {
+                result.push_back(node.dataBlocks[i]);
+                continue;
+            }
+            uint32_t rel = i - DIRECT_BLOCKS_COUNT;
+            int64_t tableIdx = 0;
+            if (rel >= ppb) {
+                rel -= ppb;
+                tableIdx = 1 + rel / ppb;
+                rel %= ppb;
+            }
+            if (tableIdx != loadedTable) {
+                if (tableIdx == 0) {
+                    table = readPointerBlock(node.dataBlocks[INDIRECT_SLOT]);
+                } else {
+                    if (outer.empty()) outer = readPointerBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT]);
+                    table = readPointerBlock(outer[tableIdx - 1]);
+                }
+                loadedTable = tableIdx;
+            }
+            result.push_back(table[rel]);
+        }
+        return result;
+    }
+
+    // Free blocks growing `node` to newCount takes, including the indirect block that
+    // ensureBlockMap allocates when it converts a flat v3 node of more than 8 blocks
+    uint64_t blocksToGrow(const GraphNode& node, uint32_t newCount) const {
+        uint64_t oldCount = node.dataBlockCount;
+        uint64_t target = std::max<uint64_t>(newCount, oldCount);
+        uint64_t existing = (node.flags & NODE_FLAG_BLOCK_MAP) ? pointerBlocksFor(oldCount) : 0;
+        return (target - oldCount) + pointerBlocksFor(target) - existing;
+    }
+
+    // Converts a flat v3 node to the block-map layout (only blocks 8-9 move)
+    bool ensureBlockMap(GraphNode& node) {
+        if (node.flags & NODE_FLAG_BLOCK_MAP) return true;
+        if (node.dataBlockCount > DIRECT_BLOCKS_COUNT) {
+            int32_t indirect = allocBlock();
+            if (indirect < 0) return false;
+            std::vector<uint32_t> pointers(pointersPerBlock(), 0);
+            for (uint32_t i = DIRECT_BLOCKS_COUNT; i < node.dataBlockCount && i < DATA_BLOCKS_COUNT; i++) {
+                pointers[i - DIRECT_BLOCKS_COUNT] = node.dataBlocks[i];
+            }
+            writePointerBlock(indirect, pointers);
+            node.dataBlocks[INDIRECT_SLOT] = indirect;
+            node.dataBlocks[DOUBLE_INDIRECT_SLOT] = 0;
+        }
+        node.flags |= NODE_FLAG_BLOCK_MAP;
+        return true;
+    }
+
+    // Allocates logical blocks up to newCount (contents are left to the caller).
+    // Checks free space up front, so it either fully succeeds or changes nothing.
+    bool growBlocks(GraphNode& node, uint32_t newCount) {
+        uint32_t oldCount = node.dataBlockCount;
+        if (newCount <= oldCount) return true;
+        if (newCount > maxMappedBlocks()) return false;
+        if (blocksToGrow(node, newCount) > superblock.freeBlocks) return false;
+        
+        const uint32_t ppb = pointersPerBlock();
+        std::vector<uint32_t> outer, table;
+        bool outerDirty = false, tableDirty = false;
+        uint32_t tableBlock = 0;
+        int64_t loadedTable = -1;
+        auto flushTable = [&]() {
+            if (tableDirty) writePointerBlock(tableBlock, table);
+            tableDirty = false;
+        };
+        
+        for (uint32_t i = oldCount; i < newCount; i++) {
+            uint32_t block = static_cast<uint32_t>(allocBlock());
+            if (i < DIRECT_BLOCKS_COUNT) {
+                node.dataBlocks[i] = block;
+                node.dataBlockCount++;
+                continue;
+            }
+            uint32_t rel = i - DIRECT_BLOCKS_COUNT;
+            int64_t tableIdx = 0;
+            if (rel >= ppb) {
+                rel -= ppb;
+                tableIdx = 1 + rel / ppb;
+                rel %= ppb;
+            }
+            if (tableIdx != loadedTable) {
+                flushTable();
+                if (tableIdx == 0) {
+                    if (rel == 0) {
+                        node.dataBlocks[INDIRECT_SLOT] = static_cast<uint32_t>(allocBlock());
+                        table.assign(ppb, 0);
+                    } else {
+                        table = readPointerBlock(node.dataBlocks[INDIRECT_SLOT]);
+                    }
+                    tableBlock = node.dataBlocks[INDIRECT_SLOT];
+                } else {
+                    if (outer.empty()) {
+                        if (tableIdx == 1 && rel == 0) {
+                            node.dataBlocks[DOUBLE_INDIRECT_SLOT] = static_cast<uint32_t>(allocBlock());
+                            outer.assign(ppb, 0);
+                            outerDirty = true;
+                        } else {
+                            outer = readPointerBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT]);
+                        }
+                    }
+                    if (rel == 0) {
+                        outer[tableIdx - 1] = static_cast<uint32_t>(allocBlock());
+                        outerDirty = true;
+                        table.assign(ppb, 0);
+                    } else {
+                        table = readPointerBlock(outer[tableIdx - 1]);
+                    }
+                    tableBlock = outer[tableIdx - 1];
+                }
+                loadedTable = tableIdx;
+            }
+            table[rel] = block;
+            tableDirty = true;
+            node.dataBlockCount++;
+        }
+        
+        flushTable();
+        if (outerDirty) writePointerBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT], outer);
+        return true;
+    }
+
+    // Frees logical blocks from newCount on, plus the indirect blocks no longer needed
+    void shrinkBlocks(GraphNode& node, uint32_t newCount) {
+        uint32_t oldCount = node.dataBlockCount;
+        if (newCount >= oldCount) return;
+        
+        for (uint32_t block : mapBlocks(node, newCount, oldCount - newCount)) freeBlock(block);
+        
+        if (node.flags & NODE_FLAG_BLOCK_MAP) {
+            const uint32_t ppb = pointersPerBlock();
+            const uint64_t doubleStart = static_cast<uint64_t>(DIRECT_BLOCKS_COUNT) + ppb;
+            if (oldCount > doubleStart) {
+                uint64_t tablesBefore = (oldCount - doubleStart + ppb - 1) / ppb;
+                uint64_t tablesAfter = newCount > doubleStart ? (newCount - doubleStart + ppb - 1) / ppb : 0;
+                std::vector<uint32_t> outer = readPointerBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT]);
+                for (uint64_t k = tablesAfter; k < tablesBefore; k++) freeBlock(outer[k]);
+                if (tablesAfter == 0) freeBlock(node.dataBlocks[DOUBLE_INDIRECT_SLOT]);
+            }
+            if (oldCount > DIRECT_BLOCKS_COUNT && newCount <= DIRECT_BLOCKS_COUNT) {
+                freeBlock(node.dataBlocks[INDIRECT_SLOT]);
+            }
+        }
+        node.dataBlockCount = newCount;
+    }
+
     // Write superblock to disk (encrypts payload if encrypted)
     void writeSuperblock() {
         // Make a copy to encrypt
@@ -573,7 +753,7 @@ private:
     }
 
 public:
-    NodeFS() : mounted(false), isEncrypted(false), hConsole(GetStdHandle(STD_OUTPUT_HANDLE)) {}
+    NodeFS() : mounted(false), isEncrypted(false), imageVersion(NODE_VERSION), hConsole(GetStdHandle(STD_OUTPUT_HANDLE)) {}
     
     ~NodeFS() {
         if (mounted) unmount();
@@ -583,6 +763,7 @@ public:
     bool format(const std::string& path, uint32_t sizeMB, const std::string& password = "", uint64_t maxFileSize = 0) {
         imagePath = path;
         isEncrypted = !password.empty();
+        imageVersion = NODE_VERSION;
         
         // Calculate layout
         uint64_t totalSize = static_cast<uint64_t>(sizeMB) * 1024 * 1024;
@@ -610,6 +791,7 @@ public:
             
             // Derive encryption key using PBKDF2-style iteration
             encryptionKey = deriveKey(password, superblock.salt);
+            cipher.setKdfKey(encryptionKey);
             
             // Generate encrypted magic (file won't have plain "NODE" text)
             generateEncryptedMagic(superblock.encryptedMagic, encryptionKey);
@@ -623,6 +805,7 @@ public:
             memset(superblock.salt, 0, SALT_SIZE);
             memset(superblock.verifyTag, 0, VERIFY_TAG_SIZE);
             encryptionKey = "";
+            cipher.clear();
         }
         
         superblock.version = NODE_VERSION;
@@ -636,8 +819,10 @@ public:
         superblock.flags = 0;
         
         // Initialize bitmaps
-        nodeBitmap.resize((totalNodes + 7) / 8, 0);
-        blockBitmap.resize((totalBlocks + 7) / 8, 0);
+        nodeBitmap.assign((totalNodes + 7) / 8, 0);
+        blockBitmap.assign((totalBlocks + 7) / 8, 0);
+        nodeHint = 0;
+        blockHint = 0;
         
         // Initialize nodes
         nodes.resize(totalNodes);
@@ -712,7 +897,7 @@ public:
         setColor(COLOR_SUCCESS);
         std::cout << "Formatted (Graph v" << NODE_VERSION << "): " << sizeMB << "MB image: " << path << "\n";
         if (isEncrypted) {
-            std::cout << "Full disk encryption enabled (PBKDF2 + AES-CTR style).\n";
+            std::cout << "Full disk encryption enabled (PBKDF2 + ChaCha20).\n";
             std::cout << "File appears as random data to external tools.\n";
         }
         if (maxFileSize > 0) {
@@ -728,6 +913,8 @@ public:
         imagePath = path;
         encryptionKey = "";
         isEncrypted = false;
+        imageVersion = NODE_VERSION;
+        cipher.clear();
         
         imageFile.open(path, std::ios::in | std::ios::out | std::ios::binary);
         if (!imageFile) {
@@ -761,8 +948,13 @@ public:
             // Derive key from password + salt
             encryptionKey = deriveKey(password, superblock.salt);
             
-            // Verify password by checking encrypted magic
-            if (!verifyEncryptedMagic(superblock.encryptedMagic, encryptionKey)) {
+            // Verify password by checking encrypted magic (it also encodes the format version)
+            if (verifyEncryptedMagic(superblock.encryptedMagic, encryptionKey, NODE_VERSION)) {
+                imageVersion = NODE_VERSION;
+                cipher.setKdfKey(encryptionKey);
+            } else if (verifyEncryptedMagic(superblock.encryptedMagic, encryptionKey, NODE_LEGACY_VERSION)) {
+                imageVersion = NODE_LEGACY_VERSION;
+            } else {
                 setColor(COLOR_ERROR);
                 std::cerr << "Error: Incorrect password\n";
                 resetColor();
@@ -789,9 +981,11 @@ public:
                 imageFile.close();
                 return false;
             }
+            imageVersion = magicData[1];
         }
         
-        if (superblock.version != NODE_VERSION) {
+        if (superblock.version != imageVersion ||
+            (imageVersion != NODE_VERSION && imageVersion != NODE_LEGACY_VERSION)) {
             setColor(COLOR_ERROR);
             std::cerr << "Error: Unsupported node image version (Expected " << NODE_VERSION << ", got " << superblock.version << ")\n";
             std::cerr << "This file may have been created with an older version of node.\n";
@@ -803,6 +997,8 @@ public:
         // Read bitmaps
         nodeBitmap.resize((superblock.totalNodes + 7) / 8);
         blockBitmap.resize((superblock.totalBlocks + 7) / 8);
+        nodeHint = 0;
+        blockHint = 0;
         
         size_t offset = getNodeBitmapOffset();
         imageFile.seekg(offset);
@@ -837,6 +1033,11 @@ public:
         std::cout << "\n";
         resetColor();
         
+        if (imageVersion == NODE_LEGACY_VERSION && isEncrypted) {
+            std::cout << "Note: this is a v" << NODE_LEGACY_VERSION << " image using the old, slow cipher. "
+                      << "Run 'node migrate' on it to upgrade to v" << NODE_VERSION << ".\n";
+        }
+        
         return true;
     }
     
@@ -859,6 +1060,190 @@ public:
         return false;
     }
 
+    // Upgrade a v3 image to the current format. Every byte is decrypted with the legacy
+    // cipher and re-encrypted with ChaCha20 into a temporary copy, which then replaces the
+    // image, so an interrupted migration leaves the original untouched.
+    bool migrate(const std::string& path, const std::string& password = "") {
+        if (mounted) {
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: Cannot migrate while an image is mounted\n";
+            resetColor();
+            return false;
+        }
+        
+        std::ifstream in(path, std::ios::binary);
+        Superblock header;
+        if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(Superblock))) {
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: Cannot read node image: " << path << "\n";
+            resetColor();
+            return false;
+        }
+        
+        bool encrypted = false;
+        for (size_t i = 0; i < SALT_SIZE; i++) {
+            if (header.salt[i] != 0) {
+                encrypted = true;
+                break;
+            }
+        }
+        
+        std::string key;
+        uint32_t version = 0;
+        if (encrypted) {
+            if (password.empty()) return false;
+            key = deriveKey(password, header.salt);
+            if (verifyEncryptedMagic(header.encryptedMagic, key, NODE_VERSION)) version = NODE_VERSION;
+            else if (verifyEncryptedMagic(header.encryptedMagic, key, NODE_LEGACY_VERSION)) version = NODE_LEGACY_VERSION;
+            else {
+                setColor(COLOR_ERROR);
+                std::cerr << "Error: Incorrect password\n";
+                resetColor();
+                return false;
+            }
+        } else {
+            uint32_t magicData[2];
+            memcpy(magicData, header.encryptedMagic, 8);
+            if (magicData[0] != NODE_MAGIC) {
+                setColor(COLOR_ERROR);
+                std::cerr << "Error: Invalid node image file (bad magic)\n";
+                resetColor();
+                return false;
+            }
+            version = magicData[1];
+        }
+        
+        if (version == NODE_VERSION) {
+            std::cout << "Already a v" << NODE_VERSION << " image: " << path << "\n";
+            return true;
+        }
+        if (version != NODE_LEGACY_VERSION) {
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: Cannot migrate node image version " << version << "\n";
+            resetColor();
+            return false;
+        }
+        
+        std::string tempPath = path + ".migrating";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: Cannot create " << tempPath << "\n";
+            resetColor();
+            return false;
+        }
+        
+        // xorData works on the member key state; borrow it for the duration
+        isEncrypted = encrypted;
+        encryptionKey = key;
+        if (encrypted) cipher.setKdfKey(key);
+        
+        uint64_t totalSize = fs::file_size(path);
+        std::vector<char> buffer(1 << 20);
+        uint64_t offset = 0;
+        bool ok = true;
+        in.seekg(0);
+        
+        while (ok) {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            size_t n = static_cast<size_t>(in.gcount());
+            if (n == 0) break;
+            
+            imageVersion = NODE_LEGACY_VERSION;
+            xorData(buffer.data(), n, offset);
+            
+            if (offset == 0) {
+                Superblock* sb = reinterpret_cast<Superblock*>(buffer.data());
+                if (n < sizeof(Superblock) || sb->version != NODE_LEGACY_VERSION) {
+                    ok = false;
+                    break;
+                }
+                sb->version = NODE_VERSION;
+                if (encrypted) {
+                    generateEncryptedMagic(sb->encryptedMagic, key, NODE_VERSION);
+                } else {
+                    uint32_t magicData[2] = { NODE_MAGIC, NODE_VERSION };
+                    memcpy(sb->encryptedMagic, magicData, 8);
+                }
+            }
+            
+            imageVersion = NODE_VERSION;
+            xorData(buffer.data(), n, offset);
+            
+            out.write(buffer.data(), static_cast<std::streamsize>(n));
+            offset += n;
+            if (!out) ok = false;
+            
+            if (totalSize > 0) {
+                std::cout << "\rMigrating... " << (offset * 100 / totalSize) << "%" << std::flush;
+            }
+        }
+        std::cout << "\n";
+        
+        in.close();
+        out.close();
+        isEncrypted = false;
+        encryptionKey = "";
+        imageVersion = NODE_VERSION;
+        cipher.clear();
+        
+        std::error_code ec;
+        if (ok && !out.fail()) fs::rename(tempPath, path, ec);
+        if (!ok || out.fail() || ec) {
+            fs::remove(tempPath, ec);
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: Migration failed; the original image was not modified\n";
+            resetColor();
+            return false;
+        }
+        
+        setColor(COLOR_SUCCESS);
+        std::cout << "Migrated to v" << NODE_VERSION << ": " << path << "\n";
+        resetColor();
+        return true;
+    }
+    
+    // Cipher throughput on an in-memory buffer, encrypted one block at a time the way
+    // readBlock/writeBlock do. The v3 cipher is measured on at most 4MB; it is that slow.
+    void benchmarkCipher(uint32_t sizeMB) {
+        if (mounted) return;
+        if (sizeMB == 0) sizeMB = 1;
+        
+        isEncrypted = true;
+        encryptionKey = SHA256::hash("node cipher benchmark");
+        cipher.setKdfKey(encryptionKey);
+        
+        std::vector<char> buffer(static_cast<size_t>(sizeMB) * 1024 * 1024);
+        auto measure = [&](uint32_t version, size_t bytes) {
+            imageVersion = version;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t off = 0; off < bytes; off += DEFAULT_BLOCK_SIZE) {
+                size_t n = std::min(static_cast<size_t>(DEFAULT_BLOCK_SIZE), bytes - off);
+                xorData(buffer.data() + off, n, SUPERBLOCK_SIZE + off);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return (bytes / (1024.0 * 1024.0)) / std::max(seconds, 1e-9);
+        };
+        
+        double current = measure(NODE_VERSION, buffer.size());
+        double legacy = measure(NODE_LEGACY_VERSION, std::min(buffer.size(), static_cast<size_t>(4) << 20));
+        
+        std::cout << std::fixed << std::setprecision(1);
+#ifdef LINUXIFY_NODE_CIPHER_SSE2
+        std::cout << "v" << NODE_VERSION << " ChaCha20 (SSE2):   " << current << " MB/s\n";
+#else
+        std::cout << "v" << NODE_VERSION << " ChaCha20:          " << current << " MB/s\n";
+#endif
+        std::cout << "v" << NODE_LEGACY_VERSION << " SHA-256 pad:       " << legacy << " MB/s\n";
+        std::cout << "Speedup:             " << (current / std::max(legacy, 1e-9)) << "x\n";
+        std::cout.unsetf(std::ios::floatfield);
+        
+        isEncrypted = false;
+        encryptionKey = "";
+        imageVersion = NODE_VERSION;
+        cipher.clear();
+    }
+
     // Unmount the file system
     void unmount() {
         if (!mounted) return;
@@ -870,6 +1255,7 @@ public:
         imageFile.flush();
         imageFile.close();
         mounted = false;
+        cipher.clear();
         
         setColor(COLOR_SUCCESS);
         std::cout << "Unmounted: " << imagePath << "\n";
@@ -919,29 +1305,13 @@ public:
         newNode.dataBlockCount = 0;
         newNode.edgeCount = 0;
         newNode.edgeBlockCount = 0;
+        newNode.flags = NODE_FLAG_BLOCK_MAP;
         
         // Write content if provided
-        if (!content.empty()) {
-            // Calculate needed blocks
-            uint32_t blockSize = superblock.blockSize;
-            uint32_t neededBlocks = (content.size() + blockSize - 1) / blockSize;
-            
-            // Allocate data blocks
-            for (uint32_t i = 0; i < neededBlocks && i < DATA_BLOCKS_COUNT; i++) {
-                int32_t block = allocBlock();
-                if (block >= 0) {
-                    newNode.dataBlocks[i] = block;
-                    newNode.dataBlockCount++;
-                    
-                    std::vector<uint8_t> buffer(blockSize, 0);
-                    size_t copySize = std::min(static_cast<size_t>(blockSize), content.size() - i * blockSize);
-                    memcpy(buffer.data(), content.data() + i * blockSize, copySize);
-                    writeBlock(block, buffer);
-                } else {
-                    break; // Out of blocks
-                }
-            }
-            newNode.size = content.size();
+        if (!content.empty() && !writeNodeRange(newNodeId, 0, content.data(), content.size())) {
+            shrinkBlocks(newNode, 0);
+            freeNode(newNodeId);
+            return false;
         }
         
         // Link from current node
@@ -1012,10 +1382,8 @@ public:
             }
         }
         
-        // Free data blocks
-        for (uint32_t i = 0; i < nodes[nodeId].dataBlockCount; i++) {
-            freeBlock(nodes[nodeId].dataBlocks[i]);
-        }
+        // Free data blocks (and the file's indirect blocks)
+        shrinkBlocks(nodes[nodeId], 0);
         
         // Free edge blocks
         for (uint32_t i = 0; i < nodes[nodeId].edgeBlockCount; i++) {
@@ -1066,64 +1434,126 @@ public:
 
     // Read node content
     std::string readNodeContent(uint32_t nodeId) {
+        if (nodeId >= superblock.totalNodes) return "";
+        return readNodeRange(nodeId, 0, nodes[nodeId].size);
+    }
+
+    // Read `length` bytes at `offset`, touching only the blocks that hold them
+    std::string readNodeRange(uint32_t nodeId, uint64_t offset, size_t length) {
         if (nodeId >= superblock.totalNodes) return "";
         GraphNode& node = nodes[nodeId];
+        if (offset >= node.size || length == 0) return "";
+        length = static_cast<size_t>(std::min<uint64_t>(length, node.size - offset));
         
-        std::string content;
-        content.reserve(node.size);
+        uint32_t blockSize = superblock.blockSize;
+        uint32_t first = static_cast<uint32_t>(offset / blockSize);
+        uint32_t last = static_cast<uint32_t>((offset + length - 1) / blockSize);
+        auto blocks = mapBlocks(node, first, last - first + 1);
         
-        size_t totalRead = 0;
-        for (uint32_t i = 0; i < node.dataBlockCount && i < DATA_BLOCKS_COUNT; i++) {
-            auto block = readBlock(node.dataBlocks[i]);
-            size_t toRead = std::min(static_cast<size_t>(superblock.blockSize), static_cast<size_t>(node.size - totalRead));
-            content.append(reinterpret_cast<char*>(block.data()), toRead);
-            totalRead += toRead;
+        std::string content;
+        content.reserve(length);
+        size_t skip = static_cast<size_t>(offset % blockSize);
+        for (uint32_t blockId : blocks) {
+            auto block = readBlock(blockId);
+            size_t toRead = std::min(static_cast<size_t>(blockSize) - skip, length - content.size());
+            content.append(reinterpret_cast<char*>(block.data()) + skip, toRead);
+            skip = 0;
         }
         return content;
     }
 
-    // Write node content (overwrite)
-    bool writeNodeContent(uint32_t nodeId, const std::string& content) {
+    // Write `length` bytes at `offset`, growing the file if needed. Only blocks the range
+    // overlaps are written (plus zero blocks for any gap past the old end of file).
+    bool writeNodeRange(uint32_t nodeId, uint64_t offset, const char* data, size_t length) {
         if (nodeId >= superblock.totalNodes) return false;
+        if (length == 0) return true;
         GraphNode& node = nodes[nodeId];
-        
-        // Calculate needed blocks
         uint32_t blockSize = superblock.blockSize;
-        uint32_t neededBlocks = (content.size() + blockSize - 1) / blockSize;
-        if (content.empty()) neededBlocks = 0;
+        uint64_t end = offset + length;
         
-        // Allocate blocks if needed
-        while (node.dataBlockCount < neededBlocks && node.dataBlockCount < DATA_BLOCKS_COUNT) {
-            int32_t block = allocBlock();
-            if (block < 0) break;
-            node.dataBlocks[node.dataBlockCount++] = block;
+        if (end > UINT32_MAX || (superblock.maxFileSize > 0 && end > superblock.maxFileSize)) {
+            setColor(COLOR_ERROR);
+            std::cerr << "Error: File would exceed the maximum file size\n";
+            resetColor();
+            return false;
         }
         
-        if (node.dataBlockCount < neededBlocks) {
+        uint32_t oldCount = node.dataBlockCount;
+        uint32_t neededBlocks = static_cast<uint32_t>((end + blockSize - 1) / blockSize);
+        // Checked before ensureBlockMap, so a write that cannot fit allocates nothing
+        bool fits = neededBlocks <= maxMappedBlocks() && blocksToGrow(node, neededBlocks) <= superblock.freeBlocks;
+        if (!fits || !ensureBlockMap(node) || !growBlocks(node, neededBlocks)) {
             setColor(COLOR_ERROR);
-            std::cerr << "Error: Not enough blocks or exceeding max file size\n";
+            std::cerr << "Error: Not enough free blocks\n";
             resetColor();
             return false;
         }
         
-        // Free excess blocks
-        while (node.dataBlockCount > neededBlocks) {
-            freeBlock(node.dataBlocks[--node.dataBlockCount]);
+        uint32_t first = static_cast<uint32_t>(offset / blockSize);
+        uint32_t last = static_cast<uint32_t>((end - 1) / blockSize);
+        uint32_t start = std::min(first, oldCount); // new blocks before the range are zero-filled
+        auto blocks = mapBlocks(node, start, last - start + 1);
+        
+        for (uint32_t i = start; i <= last; i++) {
+            uint64_t blockStart = static_cast<uint64_t>(i) * blockSize;
+            uint64_t from = std::max(offset, blockStart);
+            uint64_t to = std::min(end, blockStart + blockSize);
+            
+            std::vector<uint8_t> buffer;
+            bool partial = from > blockStart || to < blockStart + blockSize;
+            if (i < oldCount && partial) buffer = readBlock(blocks[i - start]);
+            else buffer.assign(blockSize, 0);
+            
+            if (from < to) memcpy(buffer.data() + (from - blockStart), data + (from - offset), to - from);
+            writeBlock(blocks[i - start], buffer);
         }
         
-        // Write content
-        for (uint32_t i = 0; i < node.dataBlockCount; i++) {
-            std::vector<uint8_t> buffer(blockSize, 0);
-            size_t copySize = std::min(static_cast<size_t>(blockSize), content.size() - i * blockSize);
-            memcpy(buffer.data(), content.data() + i * blockSize, copySize);
-            writeBlock(node.dataBlocks[i], buffer);
+        node.size = static_cast<uint32_t>(std::max<uint64_t>(node.size, end));
+        node.modified = time(nullptr);
+        return true;
+    }
+
+    bool writeNodeRange(uint32_t nodeId, uint64_t offset, const std::string& data) {
+        return writeNodeRange(nodeId, offset, data.data(), data.size());
+    }
+
+    // Set the file size: shrinking frees whole blocks past the end and zeroes the tail
+    // of the last one; growing appends zeros
+    bool truncateNode(uint32_t nodeId, uint64_t newSize) {
+        if (nodeId >= superblock.totalNodes) return false;
+        GraphNode& node = nodes[nodeId];
+        if (newSize > node.size) {
+            char zero = 0;
+            return writeNodeRange(nodeId, newSize - 1, &zero, 1);
         }
+        if (newSize == node.size) return true;
         
-        node.size = content.size();
+        uint32_t blockSize = superblock.blockSize;
+        shrinkBlocks(node, static_cast<uint32_t>((newSize + blockSize - 1) / blockSize));
+        
+        // Bytes past the end of file stay zero, so a later extension reads zeros
+        size_t tail = static_cast<size_t>(newSize % blockSize);
+        if (tail != 0) {
+            uint32_t lastBlock = mapBlocks(node, node.dataBlockCount - 1, 1)[0];
+            auto block = readBlock(lastBlock);
+            memset(block.data() + tail, 0, blockSize - tail);
+            writeBlock(lastBlock, block);
+        }
+        
+        node.size = static_cast<uint32_t>(newSize);
         node.modified = time(nullptr);
         return true;
     }
 
+    // Write node content (overwrite)
+    bool writeNodeContent(uint32_t nodeId, const std::string& content) {
+        if (nodeId >= superblock.totalNodes) return false;
+        if (content.size() < nodes[nodeId].size && !truncateNode(nodeId, content.size())) return false;
+        if (!writeNodeRange(nodeId, 0, content)) return false;
+        nodes[nodeId].modified = time(nullptr);
+        return true;
+    }
+
     // List links from a node
     std::vector<std::pair<std::string, uint32_t>> listLinks(uint32_t nodeId) {
         std::vector<std::pair<std::string, uint32_t>> result;
@@ -1440,11 +1870,11 @@ private:
             if (targetId >= 0) {
                 // Exists
                 if (append) {
-                    std::string existing = fs.readNodeContent(targetId);
-                    content = existing + content;
+                    // Only the last block (and any new ones) are written
+                    fs.writeNodeRange(targetId, fs.nodes[targetId].size, content);
+                } else {
+                    fs.writeNodeContent(targetId, content);
                 }
-                // Write content
-                fs.writeNodeContent(targetId, content);
             } else {
                 // New node
                 fs.makeNode(filename, currentNodeId, content);
@@ -1459,6 +1889,16 @@ private:
         }
     }
 
+    // Save an edited file by writing only from the first changed byte onwards
+    void saveEdit(uint32_t id, const std::string& before, const std::string& after) {
+        size_t common = 0;
+        size_t limit = std::min(before.size(), after.size());
+        while (common < limit && before[common] == after[common]) common++;
+
+        if (after.size() < before.size()) fs.truncateNode(id, after.size());
+        fs.writeNodeRange(id, common, after.data() + common, after.size() - common);
+    }
+
     void cmdLino(const std::vector<std::string>& args) {
         if (args.size() < 2) {
             setColor(NodeFS::getColorError());
@@ -1515,11 +1955,12 @@ private:
                 }
                 
                 if (id >= 0) {
-                     fs.writeNodeContent(id, newContent);
+                     saveEdit(id, content, newContent);
                 } else {
                      fs.makeNode(filename, currentNodeId, newContent);
                      id = fs.findNode(filename, currentNodeId);
                 }
+                content = newContent;
                 
                 setColor(NodeFS::getColorSuccess());
                 std::cout << "Saved.\n";
@@ -1530,7 +1971,7 @@ private:
                     newContent += l + "\n";
                 }
                 if (id >= 0) {
-                     fs.writeNodeContent(id, newContent);
+                     saveEdit(id, content, newContent);
                 } else {
                      fs.makeNode(filename, currentNodeId, newContent);
                 }
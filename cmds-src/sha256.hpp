@@ -0,0 +1,441 @@
+// Linuxify SHA-256
+// One incremental hasher (update/finalize) for lvc, node, nexplore and linmake. Blocks
+// are compressed with the SHA-NI instructions on x86 or the SHA2 instructions on ARMv8
+// when the CPU has them, chosen once at first use, and with portable code otherwise.
+// Input is consumed as it arrives, so hashing a file never needs a padded copy of it.
+// hashMany() hashes a batch of small inputs at once; without SHA instructions it runs
+// four messages side by side in vector lanes (SSE2 / NEON).
+
+#ifndef LINUXIFY_SHA256_HPP
+#define LINUXIFY_SHA256_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LINUXIFY_SHA256_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LINUXIFY_SHA256_TARGET
+#else
+#include <cpuid.h>
+#define LINUXIFY_SHA256_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define LINUXIFY_SHA256_ARM 1
+#include <arm_neon.h>
+#if defined(__clang__)
+#define LINUXIFY_SHA256_TARGET __attribute__((target("sha2")))
+#elif defined(__GNUC__)
+#define LINUXIFY_SHA256_TARGET __attribute__((target("+crypto")))
+#else
+#define LINUXIFY_SHA256_TARGET
+#endif
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+class SHA256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    enum class Impl { Portable, ShaNi, Armv8 };
+
+private:
+    static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+        0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+        0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+        0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static constexpr uint32_t INITIAL[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    using CompressFn = void (*)(uint32_t state[8], const uint8_t* blocks, size_t count);
+
+    uint32_t state[8];
+    uint8_t buffer[BLOCK_SIZE];
+    size_t buffered = 0;
+    uint64_t total = 0;
+
+    static uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
+    static uint32_t ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
+    static uint32_t maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
+    static uint32_t sig0(uint32_t x) { return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22); }
+    static uint32_t sig1(uint32_t x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25); }
+    static uint32_t ep0(uint32_t x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
+    static uint32_t ep1(uint32_t x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
+
+    static uint32_t loadBE(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static void compressPortable(uint32_t h[8], const uint8_t* data, size_t blocks) {
+        for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+            uint32_t w[64];
+            for (int j = 0; j < 16; j++) w[j] = loadBE(data + j * 4);
+            for (int j = 16; j < 64; j++) w[j] = ep1(w[j - 2]) + w[j - 7] + ep0(w[j - 15]) + w[j - 16];
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+            uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+            for (int j = 0; j < 64; j++) {
+                uint32_t t1 = hh + sig1(e) + ch(e, f, g) + K[j] + w[j];
+                uint32_t t2 = sig0(a) + maj(a, b, c);
+                hh = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+            h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+        }
+    }
+
+#if defined(LINUXIFY_SHA256_X86)
+    // Four rounds per step: sha256rnds2 twice on the (ABEF, CDGH) state halves, with
+    // sha256msg1/msg2 producing the message schedule four words at a time
+    LINUXIFY_SHA256_TARGET
+    static void compressShaNi(uint32_t h[8], const uint8_t* data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[0]), 0xB1);  // CDAB
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[4]), 0x1B);  // EFGH
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+        for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+            __m128i saved0 = state0, saved1 = state1;
+            __m128i msg[4];
+            for (int i = 0; i < 4; i++) {
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), byteSwap);
+            }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 16
+#endif
+            for (int r = 0; r < 16; r++) {
+                __m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i*)&K[r * 4]));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+                if (r < 12) {
+                    __m128i next = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+                    msg[r & 3] = _mm_sha256msg2_epu32(next, msg[(r + 3) & 3]);
+                }
+            }
+            state0 = _mm_add_epi32(state0, saved0);
+            state1 = _mm_add_epi32(state1, saved1);
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B);         // FEBA
+        state1 = _mm_shuffle_epi32(state1, 0xB1);      // DCHG
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);   // DCBA
+        state1 = _mm_alignr_epi8(state1, tmp, 8);      // HGFE
+        _mm_storeu_si128((__m128i*)&h[0], state0);
+        _mm_storeu_si128((__m128i*)&h[4], state1);
+    }
+
+    static bool cpuHasShaNi() {
+#ifdef _MSC_VER
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7) return false;
+        __cpuid(r, 1);
+        bool sse41 = (r[2] & (1 << 19)) != 0, ssse3 = (r[2] & (1 << 9)) != 0;
+        __cpuidex(r, 7, 0);
+        return sse41 && ssse3 && (r[1] & (1 << 29)) != 0;
+#else
+        unsigned a, b, c, d;
+        if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+        bool sse41 = (c & bit_SSE4_1) != 0, ssse3 = (c & bit_SSSE3) != 0;
+        if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+        return sse41 && ssse3 && (b & (1u << 29)) != 0;
+#endif
+    }
+#endif
+
+#if defined(LINUXIFY_SHA256_ARM)
+    // sha256h/h2 do four rounds on the ABCD/EFGH halves; su0/su1 extend the schedule
+    LINUXIFY_SHA256_TARGET
+    static void compressArmv8(uint32_t h[8], const uint8_t* data, size_t blocks) {
+        uint32x4_t state0 = vld1q_u32(&h[0]);
+        uint32x4_t state1 = vld1q_u32(&h[4]);
+
+        for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+            uint32x4_t saved0 = state0, saved1 = state1;
+            uint32x4_t msg[4];
+            for (int i = 0; i < 4; i++) {
+                msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+            }
+            for (int r = 0; r < 16; r++) {
+                uint32x4_t wk = vaddq_u32(msg[r & 3], vld1q_u32(&K[r * 4]));
+                uint32x4_t abcd = state0;
+                state0 = vsha256hq_u32(state0, state1, wk);
+                state1 = vsha256h2q_u32(state1, abcd, wk);
+                if (r < 12) {
+                    msg[r & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[r & 3], msg[(r + 1) & 3]),
+                                                 msg[(r + 2) & 3], msg[(r + 3) & 3]);
+                }
+            }
+            state0 = vaddq_u32(state0, saved0);
+            state1 = vaddq_u32(state1, saved1);
+        }
+
+        vst1q_u32(&h[0], state0);
+        vst1q_u32(&h[4], state1);
+    }
+
+    static bool cpuHasArmSha2() {
+#if defined(_WIN32)
+        return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__APPLE__)
+        return true;  // every Apple arm64 core has them
+#elif defined(__linux__) && defined(HWCAP_SHA2)
+        return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+        return false;
+#endif
+    }
+#endif
+
+    static Impl detect() {
+#if defined(LINUXIFY_SHA256_X86)
+        if (cpuHasShaNi()) return Impl::ShaNi;
+#elif defined(LINUXIFY_SHA256_ARM)
+        if (cpuHasArmSha2()) return Impl::Armv8;
+#endif
+        return Impl::Portable;
+    }
+
+    static Impl& selected() {
+        static Impl impl = detect();
+        return impl;
+    }
+
+    static CompressFn compressor() {
+        switch (selected()) {
+#if defined(LINUXIFY_SHA256_X86)
+            case Impl::ShaNi: return compressShaNi;
+#elif defined(LINUXIFY_SHA256_ARM)
+            case Impl::Armv8: return compressArmv8;
+#endif
+            default: return compressPortable;
+        }
+    }
+
+#if defined(__GNUC__)
+    // Multi-buffer: lane i of every vector belongs to message i, so four independent
+    // messages share each instruction. Used only when there are no SHA instructions.
+    static constexpr size_t LANES = 4;
+    typedef uint32_t Lanes __attribute__((vector_size(16)));
+
+    static Lanes lrotr(Lanes x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    // Compresses one block of each lane; blocks[i] points at lane i's 64 bytes
+    static void compressLanes(Lanes h[8], const uint8_t* const blocks[LANES]) {
+        Lanes w[64];
+        for (int j = 0; j < 16; j++) {
+            w[j] = Lanes{ loadBE(blocks[0] + j * 4), loadBE(blocks[1] + j * 4),
+                          loadBE(blocks[2] + j * 4), loadBE(blocks[3] + j * 4) };
+        }
+        for (int j = 16; j < 64; j++) {
+            Lanes s0 = lrotr(w[j - 15], 7) ^ lrotr(w[j - 15], 18) ^ (w[j - 15] >> 3);
+            Lanes s1 = lrotr(w[j - 2], 17) ^ lrotr(w[j - 2], 19) ^ (w[j - 2] >> 10);
+            w[j] = s1 + w[j - 7] + s0 + w[j - 16];
+        }
+
+        Lanes a = h[0], b = h[1], c = h[2], d = h[3];
+        Lanes e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int j = 0; j < 64; j++) {
+            Lanes t1 = hh + (lrotr(e, 6) ^ lrotr(e, 11) ^ lrotr(e, 25)) + ((e & f) ^ (~e & g)) + K[j] + w[j];
+            Lanes t2 = (lrotr(a, 2) ^ lrotr(a, 13) ^ lrotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+    }
+#endif
+
+    // Final one or two blocks of a message: the tail after its whole blocks plus padding
+    static size_t padTail(std::string_view data, uint8_t out[2 * BLOCK_SIZE]) {
+        size_t whole = data.size() / BLOCK_SIZE * BLOCK_SIZE;
+        size_t rest = data.size() - whole;
+        size_t blocks = rest + 9 <= BLOCK_SIZE ? 1 : 2;
+        memset(out, 0, blocks * BLOCK_SIZE);
+        memcpy(out, data.data() + whole, rest);
+        out[rest] = 0x80;
+        uint64_t bits = (uint64_t)data.size() * 8;
+        for (int i = 0; i < 8; i++) out[blocks * BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (i * 8));
+        return blocks;
+    }
+
+public:
+    SHA256() { reset(); }
+
+    void reset() {
+        memcpy(state, INITIAL, sizeof(state));
+        buffered = 0;
+        total = 0;
+    }
+
+    SHA256& update(const void* data, size_t len) {
+        const uint8_t* p = (const uint8_t*)data;
+        total += len;
+        if (buffered > 0) {
+            size_t take = std::min(len, BLOCK_SIZE - buffered);
+            memcpy(buffer + buffered, p, take);
+            buffered += take;
+            p += take;
+            len -= take;
+            if (buffered < BLOCK_SIZE) return *this;
+            compressor()(state, buffer, 1);
+            buffered = 0;
+        }
+        if (len >= BLOCK_SIZE) {
+            size_t blocks = len / BLOCK_SIZE;
+            compressor()(state, p, blocks);
+            p += blocks * BLOCK_SIZE;
+            len -= blocks * BLOCK_SIZE;
+        }
+        memcpy(buffer, p, len);
+        buffered = len;
+        return *this;
+    }
+
+    SHA256& update(std::string_view data) { return update(data.data(), data.size()); }
+
+    // Writes the digest and resets the hasher for reuse
+    void finalize(uint8_t digest[DIGEST_SIZE]) {
+        uint64_t bits = total * 8;
+        uint8_t pad[BLOCK_SIZE + 8] = { 0x80 };
+        size_t padLen = (buffered < 56 ? 56 : 120) - buffered;
+        for (int i = 0; i < 8; i++) pad[padLen + i] = (uint8_t)(bits >> (56 - i * 8));
+        update(pad, padLen + 8);
+        for (int i = 0; i < 8; i++) {
+            digest[i * 4] = (uint8_t)(state[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)state[i];
+        }
+        reset();
+    }
+
+    std::string finalizeHex() {
+        uint8_t digest[DIGEST_SIZE];
+        finalize(digest);
+        return toHex(digest);
+    }
+
+    static std::string toHex(const uint8_t digest[DIGEST_SIZE]) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(DIGEST_SIZE * 2, '0');
+        for (size_t i = 0; i < DIGEST_SIZE; i++) {
+            hex[i * 2] = digits[digest[i] >> 4];
+            hex[i * 2 + 1] = digits[digest[i] & 15];
+        }
+        return hex;
+    }
+
+    // Hex digest of data in one call
+    static std::string hash(std::string_view data) {
+        SHA256 h;
+        h.update(data);
+        return h.finalizeHex();
+    }
+
+    // Hex digests of many inputs. With SHA instructions each message is hashed on its
+    // own (already faster than any lane split); otherwise messages of similar length
+    // are grouped four at a time and compressed together for their common blocks.
+    static std::vector<std::string> hashMany(const std::vector<std::string_view>& inputs) {
+        std::vector<std::string> out(inputs.size());
+#if defined(__GNUC__)
+        if (selected() == Impl::Portable && inputs.size() >= LANES) {
+            std::vector<size_t> order(inputs.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return inputs[a].size() < inputs[b].size(); });
+
+            size_t g = 0;
+            for (; g + LANES <= order.size(); g += LANES) {
+                uint8_t tails[LANES][2 * BLOCK_SIZE];
+                size_t blocks[LANES], whole[LANES];
+                uint32_t scalar[LANES][8];
+                for (size_t l = 0; l < LANES; l++) {
+                    std::string_view msg = inputs[order[g + l]];
+                    whole[l] = msg.size() / BLOCK_SIZE;
+                    blocks[l] = whole[l] + padTail(msg, tails[l]);
+                }
+                auto blockAt = [&](size_t l, size_t k) {
+                    std::string_view msg = inputs[order[g + l]];
+                    return k < whole[l] ? (const uint8_t*)msg.data() + k * BLOCK_SIZE : tails[l] + (k - whole[l]) * BLOCK_SIZE;
+                };
+
+                Lanes h[8];
+                for (int i = 0; i < 8; i++) h[i] = Lanes{ INITIAL[i], INITIAL[i], INITIAL[i], INITIAL[i] };
+                size_t common = *std::min_element(blocks, blocks + LANES);
+                for (size_t k = 0; k < common; k++) {
+                    const uint8_t* ptrs[LANES] = { blockAt(0, k), blockAt(1, k), blockAt(2, k), blockAt(3, k) };
+                    compressLanes(h, ptrs);
+                }
+                for (size_t l = 0; l < LANES; l++) {
+                    for (int i = 0; i < 8; i++) scalar[l][i] = h[i][l];
+                    for (size_t k = common; k < blocks[l]; k++) compressPortable(scalar[l], blockAt(l, k), 1);
+                    uint8_t digest[DIGEST_SIZE];
+                    for (int i = 0; i < 8; i++) {
+                        digest[i * 4] = (uint8_t)(scalar[l][i] >> 24);
+                        digest[i * 4 + 1] = (uint8_t)(scalar[l][i] >> 16);
+                        digest[i * 4 + 2] = (uint8_t)(scalar[l][i] >> 8);
+                        digest[i * 4 + 3] = (uint8_t)scalar[l][i];
+                    }
+                    out[order[g + l]] = toHex(digest);
+                }
+            }
+            for (; g < order.size(); g++) out[order[g]] = hash(inputs[order[g]]);
+            return out;
+        }
+#endif
+        for (size_t i = 0; i < inputs.size(); i++) out[i] = hash(inputs[i]);
+        return out;
+    }
+
+    static Impl implementation() { return selected(); }
+
+    static const char* implementationName() {
+        switch (selected()) {
+            case Impl::ShaNi: return "sha-ni";
+            case Impl::Armv8: return "armv8-sha2";
+            default: return "portable";
+        }
+    }
+
+    // Switches the block function (benchmarks, tests); false if the CPU lacks it
+    static bool useImplementation(Impl impl) {
+        if (impl != Impl::Portable && impl != detect()) return false;
+        selected() = impl;
+        return true;
+    }
+};
+
+#endif // LINUXIFY_SHA256_HPP
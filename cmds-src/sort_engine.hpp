@@ -0,0 +1,366 @@
+// Linuxify Sort Engine
+// External merge sort for the sort builtin: keys are extracted once per line into a compact
+// record array, runs are sorted in parallel, spilled to temp files once the memory budget
+// (-S) is exceeded, and merged back with a k-way heap merge.
+
+#ifndef LINUXIFY_SORT_ENGINE_HPP
+#define LINUXIFY_SORT_ENGINE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+
+namespace SortEngine {
+
+    struct Options {
+        bool numeric = false;
+        bool ignoreCase = false;
+        bool reverse = false;
+        bool unique = false;
+        int keyStart = 0;  // 1-based first field, 0 = whole line
+        int keyEnd = 0;    // 1-based last field, 0 = to end of line
+        size_t memoryBudget = 256ull * 1024 * 1024;
+        size_t threads = 1;
+        std::string tempDir;  // empty = system temp directory
+    };
+
+    // Parses a -S size: "512K", "100M", "2G", "1T"; a bare number is KiB (as in GNU sort).
+    // Returns 0 for malformed input.
+    inline size_t parseSize(const std::string& text) {
+        if (text.empty()) return 0;
+        size_t i = 0;
+        unsigned long long value = 0;
+        while (i < text.size() && isdigit((unsigned char)text[i])) value = value * 10 + (text[i++] - '0');
+        if (i == 0) return 0;
+        unsigned long long unit = 1024;
+        if (i < text.size()) {
+            switch (toupper((unsigned char)text[i])) {
+                case 'B': unit = 1; break;
+                case 'K': unit = 1024ull; break;
+                case 'M': unit = 1024ull * 1024; break;
+                case 'G': unit = 1024ull * 1024 * 1024; break;
+                case 'T': unit = 1024ull * 1024 * 1024 * 1024; break;
+                default: return 0;
+            }
+            if (i + 1 != text.size()) return 0;
+        }
+        return (size_t)(value * unit);
+    }
+
+    // Key of a line: fields keyStart..keyEnd (whitespace separated) joined by single spaces,
+    // lowercased for -f. Appended to `out`.
+    inline void extractKey(std::string_view line, const Options& opts, std::string& out) {
+        size_t start = out.size();
+        if (opts.keyStart <= 0) {
+            out.append(line.data(), line.size());
+        } else {
+            int col = 0;
+            size_t i = 0;
+            bool first = true;
+            while (i < line.size()) {
+                while (i < line.size() && isspace((unsigned char)line[i])) i++;
+                if (i >= line.size()) break;
+                size_t tokenStart = i;
+                while (i < line.size() && !isspace((unsigned char)line[i])) i++;
+                col++;
+                if (col >= opts.keyStart) {
+                    if (!first) out += ' ';
+                    out.append(line.data() + tokenStart, i - tokenStart);
+                    first = false;
+                }
+                if (opts.keyEnd > 0 && col >= opts.keyEnd) break;
+            }
+        }
+        if (opts.ignoreCase) {
+            for (size_t k = start; k < out.size(); ++k) out[k] = (char)tolower((unsigned char)out[k]);
+        }
+    }
+
+    // Numeric value of a key for -n: leading blanks, an optional sign, digits and an
+    // optional fraction, parsed without the locale. Anything else ("nan", "inf", "0x10",
+    // exponents) stops the number where it is, and a key with no digits sorts as 0,
+    // like GNU sort. The value is never NaN, so the ordering stays a strict weak order.
+    inline double numericValue(std::string_view key) {
+        size_t i = 0;
+        while (i < key.size() && (key[i] == ' ' || key[i] == '\t')) i++;
+        bool negative = false;
+        if (i < key.size() && (key[i] == '-' || key[i] == '+')) negative = key[i++] == '-';
+
+        double value = 0;
+        bool digits = false;
+        while (i < key.size() && isdigit((unsigned char)key[i])) {
+            value = value * 10 + (key[i++] - '0');
+            digits = true;
+        }
+        if (i < key.size() && key[i] == '.') {
+            double scale = 0.1;
+            for (i++; i < key.size() && isdigit((unsigned char)key[i]); i++) {
+                value += (key[i] - '0') * scale;
+                scale *= 0.1;
+                digits = true;
+            }
+        }
+        if (!digits) return 0.0;
+        return negative ? -value : value;
+    }
+
+    // Three-way key comparison shared by the in-memory sort, the merge and --check
+    inline int compareKeys(std::string_view ka, double na, std::string_view kb, double nb, const Options& opts) {
+        int result = 0;
+        if (opts.numeric) {
+            if (na < nb) result = -1;
+            else if (na > nb) result = 1;
+        }
+        if (result == 0) {
+            int c = ka.compare(kb);
+            result = (c < 0) ? -1 : (c > 0 ? 1 : 0);
+        }
+        return opts.reverse ? -result : result;
+    }
+
+    // Stable sort of `items` with up to `threads` workers: slices are sorted concurrently,
+    // then merged pairwise, each round's merges also running concurrently.
+    template <typename T, typename Less>
+    void parallelSort(std::vector<T>& items, Less less, size_t threads) {
+        const size_t n = items.size();
+        const size_t minSlice = 1 << 15;
+        size_t slices = (std::min)(threads, n / minSlice);
+        if (slices <= 1) {
+            std::stable_sort(items.begin(), items.end(), less);
+            return;
+        }
+
+        std::vector<size_t> bounds(slices + 1);
+        for (size_t i = 0; i <= slices; ++i) bounds[i] = n * i / slices;
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < slices; ++i) {
+            workers.emplace_back([&, i] { std::stable_sort(items.begin() + bounds[i], items.begin() + bounds[i + 1], less); });
+        }
+        for (auto& t : workers) t.join();
+
+        while (bounds.size() > 2) {
+            std::vector<size_t> next;
+            workers.clear();
+            for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+                size_t lo = bounds[i], mid = bounds[i + 1], hi = bounds[i + 2];
+                workers.emplace_back([&items, lo, mid, hi, less] {
+                    std::inplace_merge(items.begin() + lo, items.begin() + mid, items.begin() + hi, less);
+                });
+                next.push_back(lo);
+            }
+            if (bounds.size() % 2 == 0) next.push_back(bounds[bounds.size() - 2]);  // odd slice carries over
+            next.push_back(bounds.back());
+            for (auto& t : workers) t.join();
+            bounds.swap(next);
+        }
+    }
+
+    class ExternalSorter {
+    public:
+        using Writer = std::function<void(std::string_view)>;
+
+    private:
+        // One input line. Text lives in `lineArena`; the key either aliases the line
+        // (whole-line, case-sensitive keys) or lives in `keyArena`.
+        struct Record {
+            size_t lineOffset;
+            size_t keyOffset;
+            uint32_t lineLength;
+            uint32_t keyLength;
+            bool keyIsLine;
+            double number;
+        };
+
+        Options opts;
+        std::string lineArena;
+        std::string keyArena;
+        std::vector<Record> records;
+        std::vector<std::string> runFiles;
+        bool keyNeedsCopy;
+        std::string lastEmittedKey;
+        bool emittedAny = false;
+
+        std::string_view lineOf(const Record& r) const { return std::string_view(lineArena.data() + r.lineOffset, r.lineLength); }
+
+        std::string_view keyOf(const Record& r) const {
+            if (r.keyIsLine) return lineOf(r);
+            return std::string_view(keyArena.data() + r.keyOffset, r.keyLength);
+        }
+
+        size_t memoryUsed() const {
+            return lineArena.size() + keyArena.size() + records.size() * sizeof(Record);
+        }
+
+        void sortRecords() {
+            auto less = [this](const Record& a, const Record& b) {
+                return compareKeys(keyOf(a), a.number, keyOf(b), b.number, opts) < 0;
+            };
+            parallelSort(records, less, opts.threads);
+        }
+
+        void clearBuffers() {
+            records.clear();
+            lineArena.clear();
+            keyArena.clear();
+        }
+
+        std::string newRunPath() {
+            static std::atomic<unsigned> counter{0};
+            namespace fs = std::filesystem;
+            fs::path dir = opts.tempDir.empty() ? fs::temp_directory_path() : fs::path(opts.tempDir);
+            auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            std::string name = "linuxify-sort-" + std::to_string((unsigned long long)stamp) + "-" +
+                               std::to_string(counter++) + ".run";
+            return (dir / name).string();
+        }
+
+        // Sorted records of the current buffer go to a temp file, one line each
+        bool spill() {
+            if (records.empty()) return true;
+            sortRecords();
+            std::string path = newRunPath();
+            std::ofstream run(path, std::ios::binary);
+            if (!run) return false;
+            std::vector<char> buffer(1 << 16);
+            run.rdbuf()->pubsetbuf(buffer.data(), (std::streamsize)buffer.size());
+            for (const Record& r : records) {
+                std::string_view line = lineOf(r);
+                run.write(line.data(), (std::streamsize)line.size());
+                run.put('\n');
+            }
+            run.close();
+            if (!run) {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                return false;
+            }
+            runFiles.push_back(path);
+            clearBuffers();
+            return true;
+        }
+
+        void emit(std::string_view line, std::string_view key, const Writer& write) {
+            if (opts.unique) {
+                if (emittedAny && key == lastEmittedKey) return;
+                lastEmittedKey.assign(key.data(), key.size());
+                emittedAny = true;
+            }
+            write(line);
+        }
+
+        struct RunCursor {
+            std::ifstream stream;
+            std::vector<char> buffer;
+            std::string line;
+            std::string key;
+            double number = 0;
+            size_t index = 0;
+        };
+
+        bool advance(RunCursor& c) {
+            if (!std::getline(c.stream, c.line)) return false;
+            c.key.clear();
+            extractKey(c.line, opts, c.key);
+            c.number = opts.numeric ? numericValue(c.key) : 0.0;
+            return true;
+        }
+
+        bool mergeRuns(const Writer& write) {
+            std::vector<std::unique_ptr<RunCursor>> cursors;
+            for (size_t i = 0; i < runFiles.size(); ++i) {
+                auto c = std::make_unique<RunCursor>();
+                c->buffer.resize(1 << 16);
+                c->stream.rdbuf()->pubsetbuf(c->buffer.data(), (std::streamsize)c->buffer.size());
+                c->stream.open(runFiles[i], std::ios::binary);
+                if (!c->stream) return false;
+                c->index = i;
+                if (advance(*c)) cursors.push_back(std::move(c));
+            }
+
+            // Min-heap on (key, run index); earlier runs win ties so equal keys keep input order
+            auto after = [this](const RunCursor* a, const RunCursor* b) {
+                int c = compareKeys(a->key, a->number, b->key, b->number, opts);
+                return c != 0 ? c > 0 : a->index > b->index;
+            };
+            std::vector<RunCursor*> heap;
+            for (auto& c : cursors) heap.push_back(c.get());
+            std::make_heap(heap.begin(), heap.end(), after);
+
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), after);
+                RunCursor* top = heap.back();
+                emit(top->line, top->key, write);
+                if (advance(*top)) {
+                    std::push_heap(heap.begin(), heap.end(), after);
+                } else {
+                    heap.pop_back();
+                }
+            }
+            return true;
+        }
+
+    public:
+        explicit ExternalSorter(const Options& options) : opts(options) {
+            if (opts.threads == 0) opts.threads = 1;
+            if (opts.memoryBudget < 64 * 1024) opts.memoryBudget = 64 * 1024;
+            keyNeedsCopy = opts.keyStart > 0 || opts.ignoreCase;
+        }
+
+        ~ExternalSorter() {
+            for (const auto& path : runFiles) {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+            }
+        }
+
+        ExternalSorter(const ExternalSorter&) = delete;
+        ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+        // Buffers one line; spills a sorted run when the memory budget is exceeded.
+        // Returns false if a run could not be written.
+        bool add(std::string_view line) {
+            Record r;
+            r.lineOffset = lineArena.size();
+            r.lineLength = (uint32_t)line.size();
+            lineArena.append(line.data(), line.size());
+            r.keyIsLine = !keyNeedsCopy;
+            r.keyOffset = keyArena.size();
+            if (keyNeedsCopy) extractKey(line, opts, keyArena);
+            r.keyLength = (uint32_t)(keyArena.size() - r.keyOffset);
+            r.number = opts.numeric ? numericValue(keyOf(r)) : 0.0;
+            records.push_back(r);
+
+            if (memoryUsed() > opts.memoryBudget) return spill();
+            return true;
+        }
+
+        size_t runCount() const { return runFiles.size(); }
+
+        // Writes every line in order. Without spills this is a plain in-memory sort.
+        bool finish(const Writer& write) {
+            if (runFiles.empty()) {
+                sortRecords();
+                for (const Record& r : records) emit(lineOf(r), keyOf(r), write);
+                clearBuffers();
+                return true;
+            }
+            if (!spill()) return false;
+            return mergeRuns(write);
+        }
+    };
+
+} // namespace SortEngine
+
+#endif // LINUXIFY_SORT_ENGINE_HPP
@@ -0,0 +1,273 @@
+// Linuxify Shell Variable Store
+// Variable names are interned once into small integer slots through an open-addressing
+// hash table; values live in flat slot-indexed arrays, so a lookup by slot is a single
+// index and a lookup by name is one hash probe sequence, neither allocating. Values are
+// shared copy-on-write, which makes subshell snapshots cheap, and `local` bindings are
+// saved on a per-function frame stack and restored when the function returns.
+
+#ifndef LINUXIFY_VARIABLE_STORE_HPP
+#define LINUXIFY_VARIABLE_STORE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+namespace ShellVars {
+
+    // Process-wide name -> slot table. Slots are never reused, so a slot compiled
+    // into a script word stays valid for the life of the process.
+    class NameTable {
+    private:
+        std::vector<int> buckets;      // slot + 1, 0 = empty; size is a power of two
+        std::deque<std::string> names; // deque: references stay valid as it grows
+        mutable std::mutex mtx;
+
+        static uint64_t hashName(std::string_view name) {
+            uint64_t h = 1469598103934665603ull;  // FNV-1a
+            for (unsigned char c : name) {
+                h ^= c;
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        // Bucket holding `name`, or the empty bucket where it would go
+        size_t probe(std::string_view name) const {
+            size_t mask = buckets.size() - 1;
+            size_t i = (size_t)hashName(name) & mask;
+            while (buckets[i] != 0 && names[(size_t)buckets[i] - 1] != name) {
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+        void grow() {
+            std::vector<int> old;
+            old.swap(buckets);
+            buckets.assign(old.size() * 2, 0);
+            for (int entry : old) {
+                if (entry != 0) buckets[probe(names[(size_t)entry - 1])] = entry;
+            }
+        }
+
+    public:
+        NameTable() : buckets(256, 0) {}
+
+        static NameTable& instance() {
+            static NameTable table;
+            return table;
+        }
+
+        int intern(std::string_view name) {
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t i = probe(name);
+            if (buckets[i] != 0) return buckets[i] - 1;
+            if ((names.size() + 1) * 4 > buckets.size() * 3) {  // keep load under 3/4
+                grow();
+                i = probe(name);
+            }
+            names.emplace_back(name);
+            buckets[i] = (int)names.size();
+            return (int)names.size() - 1;
+        }
+
+        // Slot of an already interned name, -1 otherwise (never inserts)
+        int find(std::string_view name) const {
+            std::lock_guard<std::mutex> lock(mtx);
+            int entry = buckets[probe(name)];
+            return entry - 1;
+        }
+
+        const std::string& name(int slot) const {
+            std::lock_guard<std::mutex> lock(mtx);
+            return names[(size_t)slot];
+        }
+    };
+
+    using ScalarValue = std::shared_ptr<const std::string>;
+    // Not const: an array no snapshot or frame shares is written in place
+    using ArrayValue = std::shared_ptr<std::vector<std::string>>;
+
+    class VariableStore {
+    private:
+        std::vector<ScalarValue> scalars;  // by slot, null = unset
+        std::vector<ArrayValue> arrays;    // by slot, null = unset
+        size_t scalarCount = 0;
+        size_t arrayCount = 0;
+
+        // Binding that a `local` shadowed, restored when its frame is popped
+        struct SavedBinding {
+            int slot;
+            ScalarValue scalar;
+            ArrayValue array;
+        };
+        std::vector<std::vector<SavedBinding>> frames;
+
+        static NameTable& table() { return NameTable::instance(); }
+
+        void reserveSlot(int slot) {
+            if ((size_t)slot >= scalars.size()) {
+                size_t n = (std::max)((size_t)slot + 1, scalars.size() * 2);
+                scalars.resize(n);
+                arrays.resize(n);
+            }
+        }
+
+        void assignScalar(int slot, ScalarValue value) {
+            reserveSlot(slot);
+            if (!scalars[slot] && value) scalarCount++;
+            else if (scalars[slot] && !value) scalarCount--;
+            scalars[slot] = std::move(value);
+        }
+
+        void assignArray(int slot, ArrayValue value) {
+            reserveSlot(slot);
+            if (!arrays[slot] && value) arrayCount++;
+            else if (arrays[slot] && !value) arrayCount--;
+            arrays[slot] = std::move(value);
+        }
+
+    public:
+        // --- Scalars ---
+
+        const std::string* get(int slot) const {
+            if (slot < 0 || (size_t)slot >= scalars.size() || !scalars[slot]) return nullptr;
+            return scalars[slot].get();
+        }
+
+        const std::string* get(std::string_view name) const {
+            return get(table().find(name));
+        }
+
+        void set(int slot, std::string value) {
+            assignScalar(slot, std::make_shared<const std::string>(std::move(value)));
+        }
+
+        void set(std::string_view name, std::string value) {
+            set(table().intern(name), std::move(value));
+        }
+
+        // Shares the value object with another variable instead of copying the text
+        void share(int slot, const ScalarValue& value) {
+            assignScalar(slot, value);
+        }
+
+        ScalarValue shared(int slot) const {
+            if (slot < 0 || (size_t)slot >= scalars.size()) return nullptr;
+            return scalars[slot];
+        }
+
+        bool contains(std::string_view name) const { return get(name) != nullptr; }
+
+        bool erase(std::string_view name) {
+            int slot = table().find(name);
+            if (!get(slot)) return false;
+            assignScalar(slot, nullptr);
+            return true;
+        }
+
+        bool empty() const { return scalarCount == 0; }
+
+        // (name, value) pairs sorted by name, for listings and persistence
+        std::vector<std::pair<std::string, std::string>> entries() const {
+            std::vector<std::pair<std::string, std::string>> out;
+            out.reserve(scalarCount);
+            for (size_t slot = 0; slot < scalars.size(); ++slot) {
+                if (scalars[slot]) out.emplace_back(table().name((int)slot), *scalars[slot]);
+            }
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+
+        // --- Arrays ---
+
+        const std::vector<std::string>* getArray(std::string_view name) const {
+            int slot = table().find(name);
+            if (slot < 0 || (size_t)slot >= arrays.size() || !arrays[slot]) return nullptr;
+            return arrays[slot].get();
+        }
+
+        void setArray(std::string_view name, std::vector<std::string> values) {
+            assignArray(table().intern(name), std::make_shared<std::vector<std::string>>(std::move(values)));
+        }
+
+        // Writes one element, growing the array; copies it first only if a snapshot or a
+        // saved `local` binding shares it, so filling an array in a loop stays linear
+        void setArrayElement(std::string_view name, size_t index, std::string value) {
+            int slot = table().intern(name);
+            reserveSlot(slot);
+            if (!arrays[slot]) {
+                assignArray(slot, std::make_shared<std::vector<std::string>>());
+            } else if (arrays[slot].use_count() > 1) {
+                arrays[slot] = std::make_shared<std::vector<std::string>>(*arrays[slot]);
+            }
+            std::vector<std::string>& values = *arrays[slot];
+            if (values.size() <= index) values.resize(index + 1);
+            values[index] = std::move(value);
+        }
+
+        std::vector<std::pair<std::string, std::vector<std::string>>> arrayEntries() const {
+            std::vector<std::pair<std::string, std::vector<std::string>>> out;
+            out.reserve(arrayCount);
+            for (size_t slot = 0; slot < arrays.size(); ++slot) {
+                if (arrays[slot]) out.emplace_back(table().name((int)slot), *arrays[slot]);
+            }
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+
+        // --- Function frames ---
+
+        void pushFrame() { frames.emplace_back(); }
+
+        void popFrame() {
+            if (frames.empty()) return;
+            std::vector<SavedBinding> saved = std::move(frames.back());
+            frames.pop_back();
+            for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+                assignScalar(it->slot, std::move(it->scalar));
+                assignArray(it->slot, std::move(it->array));
+            }
+        }
+
+        size_t frameDepth() const { return frames.size(); }
+
+        // `local NAME`: shadows the current binding until the innermost frame is popped.
+        // Returns false outside a function.
+        bool declareLocal(std::string_view name) {
+            if (frames.empty()) return false;
+            int slot = table().intern(name);
+            reserveSlot(slot);
+            auto& frame = frames.back();
+            for (const auto& saved : frame) {
+                if (saved.slot == slot) return true;  // already local in this frame
+            }
+            frame.push_back({slot, scalars[slot], arrays[slot]});
+            assignScalar(slot, nullptr);
+            assignArray(slot, nullptr);
+            return true;
+        }
+    };
+
+    // RAII function frame: locals declared while it is alive are undone on scope exit,
+    // including when a return/break unwinds through it
+    class FrameScope {
+    private:
+        VariableStore& store;
+
+    public:
+        explicit FrameScope(VariableStore& s) : store(s) { store.pushFrame(); }
+        ~FrameScope() { store.popFrame(); }
+        FrameScope(const FrameScope&) = delete;
+        FrameScope& operator=(const FrameScope&) = delete;
+    };
+
+} // namespace ShellVars
+
+#endif // LINUXIFY_VARIABLE_STORE_HPP
@@ -0,0 +1,151 @@
+// Linuxify Work-Stealing Thread Pool
+// Each worker owns a deque: it pushes/pops its own work at the back and idle workers
+// steal from the front of someone else's. Tasks may submit more tasks (e.g. a directory
+// walker queueing subdirectories), and wait() returns once the whole task tree is done.
+
+#ifndef LINUXIFY_WORK_POOL_HPP
+#define LINUXIFY_WORK_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace WorkPool {
+
+    using Task = std::function<void()>;
+
+    class WorkStealingPool;
+
+    // Pool and worker slot of the calling thread (null / -1 outside a pool)
+    inline thread_local WorkStealingPool* tlsPool = nullptr;
+    inline thread_local int tlsWorker = -1;
+
+    class WorkStealingPool {
+    private:
+        struct Worker {
+            std::mutex mtx;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> pending{0};  // submitted but not yet finished
+        std::atomic<size_t> queued{0};   // sitting in some deque
+        std::atomic<size_t> nextWorker{0};
+        std::mutex idleMtx;
+        std::condition_variable idleCv;
+        std::condition_variable doneCv;
+        bool shuttingDown = false;
+
+        bool popLocal(size_t self, Task& task) {
+            Worker& w = *workers[self];
+            std::lock_guard<std::mutex> lock(w.mtx);
+            if (w.tasks.empty()) return false;
+            task = std::move(w.tasks.back());
+            w.tasks.pop_back();
+            queued--;
+            return true;
+        }
+
+        bool steal(size_t self, Task& task) {
+            for (size_t i = 1; i < workers.size(); ++i) {
+                Worker& w = *workers[(self + i) % workers.size()];
+                std::lock_guard<std::mutex> lock(w.mtx);
+                if (w.tasks.empty()) continue;
+                task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+                queued--;
+                return true;
+            }
+            return false;
+        }
+
+        void finishOne() {
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(idleMtx);
+                doneCv.notify_all();
+            }
+        }
+
+        void workerLoop(size_t self) {
+            tlsPool = this;
+            tlsWorker = (int)self;
+            for (;;) {
+                Task task;
+                if (popLocal(self, task) || steal(self, task)) {
+                    try { task(); } catch (...) {}
+                    finishOne();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(idleMtx);
+                idleCv.wait(lock, [&] { return queued.load() > 0 || shuttingDown; });
+                if (shuttingDown && queued.load() == 0) break;
+            }
+            tlsPool = nullptr;
+            tlsWorker = -1;
+        }
+
+    public:
+        explicit WorkStealingPool(size_t threadCount) {
+            if (threadCount == 0) threadCount = 1;
+            for (size_t i = 0; i < threadCount; ++i) workers.push_back(std::make_unique<Worker>());
+            for (size_t i = 0; i < threadCount; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+        }
+
+        ~WorkStealingPool() {
+            wait();
+        }
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        size_t size() const { return workers.size(); }
+
+        // Worker slot of the calling thread, or -1 if it is not one of this pool's workers
+        int currentWorker() const { return tlsPool == this ? tlsWorker : -1; }
+
+        // Workers submit to their own deque (depth-first, cache friendly);
+        // outside callers spread work round-robin.
+        void submit(Task task) {
+            pending++;
+            int self = currentWorker();
+            size_t target = self >= 0 ? (size_t)self : nextWorker++ % workers.size();
+            {
+                Worker& w = *workers[target];
+                std::lock_guard<std::mutex> lock(w.mtx);
+                w.tasks.push_back(std::move(task));
+                queued++;
+            }
+            std::lock_guard<std::mutex> lock(idleMtx);
+            idleCv.notify_one();
+        }
+
+        // Blocks until every submitted task (and everything they submitted) has run,
+        // then stops the workers. Must not be called from a worker thread.
+        void wait() {
+            if (threads.empty()) return;
+            {
+                std::unique_lock<std::mutex> lock(idleMtx);
+                doneCv.wait(lock, [&] { return pending.load() == 0; });
+                shuttingDown = true;
+                idleCv.notify_all();
+            }
+            for (auto& t : threads) t.join();
+            threads.clear();
+        }
+    };
+
+    // Worker count for CPU-bound fan-out: one per hardware thread
+    inline size_t defaultThreadCount() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 4;
+    }
+
+} // namespace WorkPool
+
+#endif // LINUXIFY_WORK_POOL_HPP
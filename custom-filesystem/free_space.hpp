@@ -0,0 +1,212 @@
+/*
+ * Free-Space Map for LevelFS
+ * Compile: Included in mount.cpp
+ *
+ * In-memory allocation bitmap, one bit per cluster (1 = in use), kept in 64-bit
+ * words so a search tests 64 clusters at a time and picks the first free one
+ * with a count-trailing-zeros. A per-group free count (4096 clusters/group)
+ * lets searches skip full regions of the disk without touching their words.
+ *
+ * The map is built once at mount from the LABs, or loaded from the copy saved
+ * by the previous clean unmount, and then kept in step with every allocation
+ * so allocating never has to read LAB clusters to find a free one.
+ */
+
+#ifndef FREE_SPACE_HPP
+#define FREE_SPACE_HPP
+
+#include "fs_common.hpp"
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+class FreeSpaceMap {
+public:
+    static const uint64_t NONE = 0xFFFFFFFFFFFFFFFFULL;
+    static const uint64_t GROUP_WORDS = 64;
+    static const uint64_t GROUP_BITS = GROUP_WORDS * 64;
+
+private:
+    vector<uint64_t> words;      // bit set = cluster in use; bits past the end are set
+    vector<uint32_t> groupFree;  // free clusters per GROUP_WORDS words
+    uint64_t total;
+    uint64_t freeClusters;
+
+    static unsigned lowestBit(uint64_t x) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward64(&idx, x);
+        return (unsigned)idx;
+#else
+        return (unsigned)__builtin_ctzll(x);
+#endif
+    }
+
+    static unsigned popcount(uint64_t x) {
+#ifdef _MSC_VER
+        return (unsigned)__popcnt64(x);
+#else
+        return (unsigned)__builtin_popcountll(x);
+#endif
+    }
+
+    void rebuildSummary() {
+        groupFree.assign((words.size() + GROUP_WORDS - 1) / GROUP_WORDS, 0);
+        freeClusters = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            uint32_t n = 64 - popcount(words[i]);
+            groupFree[i / GROUP_WORDS] += n;
+            freeClusters += n;
+        }
+    }
+
+    void padTail() {
+        if (total % 64 != 0) words.back() |= ~0ULL << (total % 64);
+    }
+
+    // First free cluster in words [from, to), skipping groups with nothing free
+    uint64_t searchWords(uint64_t from, uint64_t to) const {
+        uint64_t i = from;
+        while (i < to) {
+            uint64_t g = i / GROUP_WORDS;
+            if (groupFree[g] == 0) {
+                i = (g + 1) * GROUP_WORDS;
+                continue;
+            }
+            uint64_t groupEnd = min(to, (g + 1) * GROUP_WORDS);
+            for (; i < groupEnd; i++) {
+                if (~words[i]) return i * 64 + lowestBit(~words[i]);
+            }
+        }
+        return NONE;
+    }
+
+public:
+    FreeSpaceMap() : total(0), freeClusters(0) {}
+
+    // Every cluster free
+    void reset(uint64_t clusterCount) {
+        total = clusterCount;
+        words.assign((size_t)((clusterCount + 63) / 64), 0);
+        if (!words.empty()) padTail();
+        rebuildSummary();
+    }
+
+    bool isLoaded() const { return total != 0; }
+    uint64_t clusterCount() const { return total; }
+    uint64_t freeCount() const { return freeClusters; }
+
+    bool isUsed(uint64_t c) const {
+        if (c >= total) return true;
+        return (words[c / 64] >> (c % 64)) & 1;
+    }
+
+    void markUsed(uint64_t c) {
+        if (c >= total || isUsed(c)) return;
+        words[c / 64] |= 1ULL << (c % 64);
+        groupFree[c / GROUP_BITS]--;
+        freeClusters--;
+    }
+
+    void markFree(uint64_t c) {
+        if (c >= total || !isUsed(c)) return;
+        words[c / 64] &= ~(1ULL << (c % 64));
+        groupFree[c / GROUP_BITS]++;
+        freeClusters++;
+    }
+
+    void markRangeUsed(uint64_t first, uint64_t count) {
+        uint64_t end = min(total, first + count);
+        for (uint64_t c = first; c < end; c++) markUsed(c);
+    }
+
+    // Next free cluster at or after hint, wrapping around once; NONE when full
+    uint64_t findFree(uint64_t hint) const {
+        if (freeClusters == 0) return NONE;
+        if (hint >= total) hint = 0;
+        uint64_t w = hint / 64;
+        uint64_t bits = ~words[w] & (~0ULL << (hint % 64));
+        if (bits) return w * 64 + lowestBit(bits);
+        uint64_t c = searchWords(w + 1, words.size());
+        if (c != NONE) return c;
+        return searchWords(0, w + 1);
+    }
+
+    // Lowest start of `count` consecutive free clusters; NONE if no run is long enough.
+    // Whole free groups and words extend a run in one step.
+    uint64_t findRun(uint64_t count) const {
+        if (count == 0 || count > freeClusters) return NONE;
+        if (count == 1) return findFree(0);
+        uint64_t runStart = 0, runLen = 0;
+        uint64_t i = 0;
+        while (i < words.size()) {
+            uint64_t g = i / GROUP_WORDS;
+            if (i % GROUP_WORDS == 0 && groupFree[g] == 0) {
+                runLen = 0;
+                i += GROUP_WORDS;
+                continue;
+            }
+            if (i % GROUP_WORDS == 0 && groupFree[g] == GROUP_BITS) {
+                if (runLen == 0) runStart = i * 64;
+                runLen += GROUP_BITS;
+                if (runLen >= count) return runStart;
+                i += GROUP_WORDS;
+                continue;
+            }
+            uint64_t word = words[i];
+            if (word == 0) {
+                if (runLen == 0) runStart = i * 64;
+                runLen += 64;
+                if (runLen >= count) return runStart;
+            } else if (word == ~0ULL) {
+                runLen = 0;
+            } else {
+                for (unsigned b = 0; b < 64; b++) {
+                    if ((word >> b) & 1) {
+                        runLen = 0;
+                    } else {
+                        if (runLen == 0) runStart = i * 64 + b;
+                        if (++runLen >= count) return runStart;
+                    }
+                }
+            }
+            i++;
+        }
+        return NONE;
+    }
+
+    // --- Persistence ---
+
+    const vector<uint64_t>& rawWords() const { return words; }
+
+    static uint64_t checksumOf(const vector<uint64_t>& data) {
+        uint64_t h = 1469598103934665603ULL;  // FNV-1a over the words
+        for (uint64_t w : data) {
+            for (int b = 0; b < 8; b++) {
+                h ^= (w >> (b * 8)) & 0xFF;
+                h *= 1099511628211ULL;
+            }
+        }
+        return h;
+    }
+
+    uint64_t checksum() const { return checksumOf(words); }
+
+    bool load(const vector<uint64_t>& saved, uint64_t clusterCount) {
+        if (saved.size() != (clusterCount + 63) / 64 || saved.empty()) return false;
+        total = clusterCount;
+        words = saved;
+        padTail();
+        rebuildSummary();
+        return true;
+    }
+
+    // Clusters needed to store the map
+    uint64_t storageClusters() const {
+        return (words.size() * sizeof(uint64_t) + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    }
+};
+
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include "fs_common.hpp"
+#ifdef _WIN32
 #include <setupapi.h>
 #include <initguid.h>
 #include <devguid.h>
@@ -423,12 +424,14 @@ public:
         return {0, 0, 0, false};
     }
 };
+#endif
 
 class Formatter {
     DiskDevice disk;
     SuperBlock sb;
 
 public:
+#ifdef _WIN32
     bool formatDirect(int diskIndex, uint64_t partitionOffset, uint64_t partitionSize) {
         string path = "\\\\.\\PhysicalDrive" + to_string(diskIndex);
         if (!disk.open(path, partitionOffset)) {
@@ -454,6 +457,7 @@ public:
         }
         return performFormat(diskSizeBytes);
     }
+#endif
 
     bool performFormat(uint64_t diskSizeBytes) {
         memset(&sb, 0, sizeof(sb));
@@ -512,14 +516,12 @@ public:
         }
         
         cout << "Initializing Level Index Table (LIT)...\n";
-        LITEntry emptyLIT[CLUSTER_SIZE / sizeof(LITEntry)];
-        memset(emptyLIT, 0, sizeof(emptyLIT));
+        const uint64_t ZERO_BATCH = 256;  // clusters per write (1 MB)
+        vector<char> zeroClusters(ZERO_BATCH * CLUSTER_SIZE, 0);
         
-        for (uint64_t c = 0; c < sb.litClusters; c++) {
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.writeSector((sb.litStartCluster + c) * SECTORS_PER_CLUSTER + s, 
-                    ((char*)emptyLIT) + s * SECTOR_SIZE);
-            }
+        for (uint64_t c = 0; c < sb.litClusters; c += ZERO_BATCH) {
+            uint64_t n = min(ZERO_BATCH, sb.litClusters - c);
+            disk.writeCluster(sb.litStartCluster + c, zeroClusters.data(), (uint32_t)n);
         }
         cout << "  LIT initialized (" << sb.litClusters << " clusters, sparse allocation ready)\n";
         
@@ -534,30 +536,20 @@ public:
         }
         
         for (uint64_t c = 0; c < min(sb.labPoolClusters, (uint64_t)16); c++) {
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.writeSector((sb.labPoolStart + c) * SECTORS_PER_CLUSTER + s,
-                    ((char*)emptyLAB) + s * SECTOR_SIZE);
-            }
+            disk.writeCluster(sb.labPoolStart + c, emptyLAB);
         }
         cout << "  LAB Pool initialized (" << sb.labPoolClusters << " blocks available)\n";
         
         cout << "Initializing Journal...\n";
-        JournalEntry emptyJournal[SECTOR_SIZE / sizeof(JournalEntry)];
-        memset(emptyJournal, 0, sizeof(emptyJournal));
-        for (uint64_t i = 0; i < sb.journalSectors; i++) {
-            disk.writeSector((sb.journalStartCluster * SECTORS_PER_CLUSTER) + i, emptyJournal);
-        }
+        vector<char> emptyJournal(sb.journalSectors * SECTOR_SIZE, 0);
+        disk.writeSector(sb.journalStartCluster * SECTORS_PER_CLUSTER, emptyJournal.data(), (uint32_t)sb.journalSectors);
         cout << "  Journal initialized (" << journalEntries << " entries)\n";
         
         cout << "Initializing Global Level Registry...\n";
-        LevelDescriptor levelRegistry[CLUSTER_SIZE / sizeof(LevelDescriptor)];
+        LevelDescriptor levelRegistry[CLUSTER_SIZE / sizeof(LevelDescriptor) + 1];
         memset(levelRegistry, 0, sizeof(levelRegistry));
         
-        SYSTEMTIME st;
-        GetSystemTime(&st);
-        FILETIME ft;
-        SystemTimeToFileTime(&st, &ft);
-        uint64_t timestamp = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+        uint64_t timestamp = currentFileTime();
         
         strcpy(levelRegistry[0].name, "master");
         levelRegistry[0].levelID = LEVEL_ID_MASTER;
@@ -570,18 +562,12 @@ public:
         levelRegistry[0].childCount = 0;
         levelRegistry[0].totalSize = 0;
         
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.writeSector(sb.levelRegistryCluster * SECTORS_PER_CLUSTER + s,
-                ((char*)levelRegistry) + s * SECTOR_SIZE);
-        }
-        char zeros[SECTOR_SIZE] = {0};
-        for (int s = SECTORS_PER_CLUSTER; s < SECTORS_PER_CLUSTER * 2; s++) {
-            disk.writeSector(sb.levelRegistryCluster * SECTORS_PER_CLUSTER + s, zeros);
-        }
+        disk.writeCluster(sb.levelRegistryCluster, levelRegistry);
+        disk.writeCluster(sb.levelRegistryCluster + 1, zeroClusters.data());
         cout << "  Level Registry initialized with 'master' (ID: 1)\n";
         
         cout << "Initializing Root Directory...\n";
-        VersionEntry vTable[CLUSTER_SIZE / sizeof(VersionEntry)];
+        VersionEntry vTable[CLUSTER_SIZE / sizeof(VersionEntry) + 1];
         memset(vTable, 0, sizeof(vTable));
         strcpy(vTable[0].versionName, "master");
         vTable[0].isActive = 1;
@@ -595,10 +581,7 @@ public:
         vTable[0].isLocked = 0;
         vTable[0].isSnapshot = 0;
         
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.writeSector(sb.rootDirCluster * SECTORS_PER_CLUSTER + s,
-                ((char*)vTable) + s * SECTOR_SIZE);
-        }
+        disk.writeCluster(sb.rootDirCluster, vTable);
         
         DirEntry content[CLUSTER_SIZE / sizeof(DirEntry)];
         memset(content, 0, sizeof(content));
@@ -616,10 +599,7 @@ public:
             content[i].attributes = 0;
         }
         
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.writeSector((sb.rootDirCluster + 1) * SECTORS_PER_CLUSTER + s,
-                ((char*)content) + s * SECTOR_SIZE);
-        }
+        disk.writeCluster(sb.rootDirCluster + 1, content);
         cout << "  Root directory initialized with perms: rwx\n";
         
         disk.close();
@@ -632,6 +612,7 @@ public:
     }
 
     static bool createImageFile(const string& filePath, uint64_t sizeMB) {
+#ifdef _WIN32
         HANDLE hFile = CreateFileA(filePath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
         if (hFile == INVALID_HANDLE_VALUE) {
             cout << "Failed to create file: " << filePath << "\n";
@@ -657,6 +638,21 @@ public:
         }
         
         CloseHandle(hFile);
+#else
+        int fd = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            cout << "Failed to create file: " << filePath << "\n";
+            return false;
+        }
+        
+        uint64_t sizeBytes = sizeMB * 1024 * 1024;
+        if (ftruncate(fd, (off_t)sizeBytes) != 0) {  // reads back as zeros
+            cout << "Failed to set file size.\n";
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+#endif
         cout << "Created image file: " << filePath << " (" << sizeMB << " MB)\n";
         return true;
     }
@@ -696,6 +692,7 @@ int main(int argc, char** argv) {
         ss >> cmd;
 
         if (cmd == "exit") break;
+#ifdef _WIN32
         if (cmd == "list") {
             DiskPartitionManager::listDisks();
         }
@@ -711,7 +708,9 @@ int main(int argc, char** argv) {
                 cout << "Partition creation aborted or failed.\n";
             }
         }
-        else if (cmd == "createimg") {
+        else
+#endif
+        if (cmd == "createimg") {
             string filePath;
             uint64_t sizeMB = 0;
             ss >> filePath >> sizeMB;
@@ -735,8 +734,10 @@ int main(int argc, char** argv) {
             }
         }
         else if (cmd == "help") {
+#ifdef _WIN32
             cout << "list      - List all physical disks.\n";
             cout << "format    - Create partition and format on physical disk.\n";
+#endif
             cout << "createimg - Create empty image file: createimg <path> <size_mb>\n";
             cout << "formatimg - Format an image file: formatimg <path>\n";
             cout << "exit      - Quit.\n";
@@ -15,8 +15,15 @@
 #ifndef FS_COMMON_HPP
 #define FS_COMMON_HPP
 
+#ifdef _WIN32
 #include <windows.h>
 #include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
 #include <iostream>
 #include <vector>
 #include <string>
@@ -25,6 +32,9 @@
 #include <iomanip>
 #include <algorithm>
 #include <map>
+#include <array>
+#include <chrono>
+#include <cstring>
 #include <cstdint>
 
 #define SECTOR_SIZE 512
@@ -109,7 +119,17 @@ struct SuperBlock {
     uint64_t latSectors;
     
     char volumeName[32];
-    char padding[312];
+
+    // Free-space bitmap saved on clean unmount (0 = none)
+    uint64_t freeMapCluster;
+    uint64_t freeMapClusters;
+    uint64_t freeMapChecksum;
+    uint64_t freeMapFreeCount;  // totalFreeClusters when saved
+    uint64_t freeMapHint;       // freeClusterHint when saved
+    uint64_t freeMapTxId;       // lastTxId when saved
+    uint32_t freeMapValid;      // set on unmount, cleared once mounted
+
+    char padding[260];
 };
 
 struct LITEntry {
@@ -240,17 +260,141 @@ struct VersionEntry {
 
 #pragma pack(pop)
 
+// Current time as a Windows FILETIME value (100 ns ticks since 1601), the unit
+// stored in level and directory timestamps
+inline uint64_t currentFileTime() {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+#else
+    using namespace std::chrono;
+    uint64_t ticks = (uint64_t)duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count() / 100;
+    return ticks + 116444736000000000ULL;  // 1601 -> 1970
+#endif
+}
+
+/*
+ * DiskDevice - sector I/O on a raw volume (Windows) or an image file.
+ *
+ * All I/O is positional (ReadFile/WriteFile with an OVERLAPPED offset on
+ * Windows, pread/pwrite elsewhere), so image files work on any platform.
+ * Writes go to a write-back buffer keyed by sector; reads see buffered data.
+ * flush() hands buffered sectors to the OS in ascending order, merging
+ * adjacent sectors into single writes. barrier() is flush() and orders the
+ * writes before it ahead of any later ones against a crash of the process;
+ * sync() additionally forces them to stable storage and is used at journal
+ * commit points and on close.
+ */
 class DiskDevice {
 private:
+#ifdef _WIN32
     HANDLE hDevice;
-    fstream imageFile;
+#else
+    int fd;
+#endif
     string currentPath;
     uint64_t baseOffset;
     bool verbose;
     bool isImageFile;
+    bool isVolume;
+
+    map<uint64_t, array<uint8_t, SECTOR_SIZE>> pending;  // sector -> buffered contents
+    static constexpr size_t MAX_PENDING_SECTORS = 8192;      // 4 MB before an automatic flush
+    static constexpr size_t MAX_RUN_BYTES = 1024 * 1024;     // largest single merged write
+
+    uint64_t readCalls;
+    uint64_t writeCalls;
+    uint64_t syncCalls;
+
+    bool handleOpen() const {
+#ifdef _WIN32
+        return hDevice != INVALID_HANDLE_VALUE;
+#else
+        return fd >= 0;
+#endif
+    }
+
+    bool rawRead(uint64_t byteOffset, void* buffer, size_t length) {
+        readCalls++;
+        uint8_t* p = (uint8_t*)buffer;
+        while (length > 0) {
+#ifdef _WIN32
+            OVERLAPPED ov;
+            memset(&ov, 0, sizeof(ov));
+            ov.Offset = (DWORD)(byteOffset & 0xFFFFFFFF);
+            ov.OffsetHigh = (DWORD)(byteOffset >> 32);
+            DWORD chunk = (DWORD)min(length, (size_t)0x40000000), got = 0;
+            if (!ReadFile(hDevice, p, chunk, &got, &ov) || got == 0) return false;
+#else
+            ssize_t got = pread(fd, p, length, (off_t)byteOffset);
+            if (got <= 0) return false;
+#endif
+            p += got;
+            byteOffset += got;
+            length -= got;
+        }
+        return true;
+    }
+
+    bool rawWrite(uint64_t byteOffset, const void* buffer, size_t length) {
+        writeCalls++;
+        const uint8_t* p = (const uint8_t*)buffer;
+        while (length > 0) {
+#ifdef _WIN32
+            OVERLAPPED ov;
+            memset(&ov, 0, sizeof(ov));
+            ov.Offset = (DWORD)(byteOffset & 0xFFFFFFFF);
+            ov.OffsetHigh = (DWORD)(byteOffset >> 32);
+            DWORD chunk = (DWORD)min(length, (size_t)0x40000000), put = 0;
+            if (!WriteFile(hDevice, p, chunk, &put, &ov) || put == 0) return false;
+#else
+            ssize_t put = pwrite(fd, p, length, (off_t)byteOffset);
+            if (put <= 0) return false;
+#endif
+            p += put;
+            byteOffset += put;
+            length -= put;
+        }
+        return true;
+    }
+
+    void logTransfer(const char* kind, uint64_t sectorIndex, const void* buffer, uint32_t count) {
+        cout << "\n----------------------------------------------------------------\n";
+        cout << kind << " Sector: " << setw(8) << left << sectorIndex 
+             << " Offset: 0x" << hex << setw(8) << setfill('0') << (baseOffset + (sectorIndex * SECTOR_SIZE)) << dec << setfill(' ')
+             << " Size: " << (count * SECTOR_SIZE) << "\n";
+        cout << "----------------------------------------------------------------\n";
+        
+        const unsigned char* p = (const unsigned char*)buffer;
+        cout << "DATA: ";
+        for(int i=0; i<16 && i < (int)(count * SECTOR_SIZE); ++i) 
+            cout << hex << setw(2) << setfill('0') << (int)p[i] << " ";
+        cout << dec << setfill(' ') << "\n";
+        cout << "----------------------------------------------------------------\n";
+    }
+
+    bool openHandle(const string& path) {
+#ifdef _WIN32
+        hDevice = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+#else
+        fd = ::open(path.c_str(), O_RDWR);
+#endif
+        return handleOpen();
+    }
 
 public:
-    DiskDevice() : hDevice(INVALID_HANDLE_VALUE), baseOffset(0), verbose(false), isImageFile(false) {}
+    DiskDevice() :
+#ifdef _WIN32
+        hDevice(INVALID_HANDLE_VALUE),
+#else
+        fd(-1),
+#endif
+        baseOffset(0), verbose(false), isImageFile(false), isVolume(false),
+        readCalls(0), writeCalls(0), syncCalls(0) {}
+
+    DiskDevice(const DiskDevice&) = delete;
+    DiskDevice& operator=(const DiskDevice&) = delete;
 
     void setVerbose(bool v) { verbose = v; }
 
@@ -259,186 +403,190 @@ public:
     }
 
     bool open(char driveLetter) {
+#ifdef _WIN32
         close();
         string path = "\\\\.\\";
         path += driveLetter;
         path += ":";
         return open(path, 0);
+#else
+        (void)driveLetter;
+        return false;  // drive letters only exist on Windows; use openFile()
+#endif
     }
 
     bool open(string path, uint64_t offsetBytes = 0) {
         close();
         isImageFile = false;
-        
-        hDevice = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
-        if (hDevice == INVALID_HANDLE_VALUE) return false;
+        if (!openHandle(path)) return false;
 
         currentPath = path;
         baseOffset = offsetBytes;
+        isVolume = true;
         
+#ifdef _WIN32
         DWORD bytesReturned;
         DeviceIoControl(hDevice, FSCTL_LOCK_VOLUME, NULL, 0, NULL, 0, &bytesReturned, NULL);
+#endif
         return true;
     }
 
     bool openFile(const string& filePath) {
         close();
+        if (!openHandle(filePath)) return false;
         isImageFile = true;
-        
-        imageFile.open(filePath, ios::in | ios::out | ios::binary);
-        if (!imageFile.is_open()) {
-            isImageFile = false;
-            return false;
-        }
         currentPath = filePath;
         baseOffset = 0;
         return true;
     }
 
     void close() {
-        if (isImageFile) {
-            if (imageFile.is_open()) {
-                imageFile.flush();
-                imageFile.close();
-            }
-        } else {
-            if (hDevice != INVALID_HANDLE_VALUE) {
-                DeviceIoControl(hDevice, FSCTL_UNLOCK_VOLUME, NULL, 0, NULL, 0, NULL, NULL);
-                CloseHandle(hDevice);
-                hDevice = INVALID_HANDLE_VALUE;
-            }
-        }
+        if (!handleOpen()) return;
+        sync();
+#ifdef _WIN32
+        if (isVolume) DeviceIoControl(hDevice, FSCTL_UNLOCK_VOLUME, NULL, 0, NULL, 0, NULL, NULL);
+        CloseHandle(hDevice);
+        hDevice = INVALID_HANDLE_VALUE;
+#else
+        ::close(fd);
+        fd = -1;
+#endif
+        pending.clear();
         baseOffset = 0;
         isImageFile = false;
+        isVolume = false;
     }
 
     uint64_t getDiskSize() {
         if (isImageFile) {
             return getFileSizeFromHandle();
         }
-        if (hDevice == INVALID_HANDLE_VALUE) return 0;
+        if (!handleOpen()) return 0;
+#ifdef _WIN32
         GET_LENGTH_INFORMATION info = {0};
         DWORD bytesReturned;
         if (DeviceIoControl(hDevice, IOCTL_DISK_GET_LENGTH_INFO, NULL, 0, &info, sizeof(info), &bytesReturned, NULL)) {
             return (uint64_t)info.Length.QuadPart;
         }
         return 0;
+#else
+        off_t end = lseek(fd, 0, SEEK_END);
+        return end > 0 ? (uint64_t)end : 0;
+#endif
     }
 
     bool readSector(uint64_t sectorIndex, void* buffer, uint32_t count = 1) {
-        bool success = false;
-        if (isImageFile) {
-            if (!imageFile.is_open()) return false;
-            imageFile.clear();
-            size_t offset = baseOffset + (sectorIndex * SECTOR_SIZE);
-            imageFile.seekg(offset, ios::beg);
-            if (imageFile.fail() || imageFile.bad()) {
-                imageFile.clear();
-                return false;
-            }
-            memset(buffer, 0, count * SECTOR_SIZE);
-            imageFile.read(reinterpret_cast<char*>(buffer), count * SECTOR_SIZE);
-            success = !imageFile.fail() && (imageFile.gcount() == (streamsize)(count * SECTOR_SIZE));
-            imageFile.clear();
-        } else {
-            if (hDevice == INVALID_HANDLE_VALUE) return false;
-            LARGE_INTEGER offset;
-            offset.QuadPart = baseOffset + (sectorIndex * SECTOR_SIZE);
-            if (!SetFilePointerEx(hDevice, offset, NULL, FILE_BEGIN)) return false;
-            DWORD bytesRead;
-            if (!ReadFile(hDevice, buffer, count * SECTOR_SIZE, &bytesRead, NULL)) return false;
-            success = bytesRead == count * SECTOR_SIZE;
+        if (!handleOpen()) return false;
+        memset(buffer, 0, count * SECTOR_SIZE);
+        uint8_t* out = (uint8_t*)buffer;
+
+        // Sectors wholly in the write-back buffer need no device read
+        bool allBuffered = !pending.empty();
+        for (uint32_t i = 0; i < count && allBuffered; i++) {
+            allBuffered = pending.count(sectorIndex + i) != 0;
+        }
+        bool success = allBuffered || rawRead(baseOffset + sectorIndex * SECTOR_SIZE, buffer, (size_t)count * SECTOR_SIZE);
+
+        for (auto it = pending.lower_bound(sectorIndex); it != pending.end() && it->first < sectorIndex + count; ++it) {
+            memcpy(out + (it->first - sectorIndex) * SECTOR_SIZE, it->second.data(), SECTOR_SIZE);
         }
 
         if (verbose) {
-            if (success) {
-                cout << "\n----------------------------------------------------------------\n";
-                cout << "[DISK READ]  Sector: " << setw(8) << left << sectorIndex 
-                     << " Offset: 0x" << hex << setw(8) << setfill('0') << (baseOffset + (sectorIndex * SECTOR_SIZE)) << dec << setfill(' ')
-                     << " Size: " << (count * SECTOR_SIZE) << "\n";
-                cout << "----------------------------------------------------------------\n";
-                
-                unsigned char* p = (unsigned char*)buffer;
-                cout << "DATA: ";
-                for(int i=0; i<16 && i < (int)(count * SECTOR_SIZE); ++i) 
-                    cout << hex << setw(2) << setfill('0') << (int)p[i] << " ";
-                cout << dec << setfill(' ') << "\n";
-                cout << "----------------------------------------------------------------\n";
-            } else {
-                 cout << "[DISK] READ FAILED | Sector: " << sectorIndex << endl;
-            }
+            if (success) logTransfer("[DISK READ] ", sectorIndex, buffer, count);
+            else cout << "[DISK] READ FAILED | Sector: " << sectorIndex << endl;
         }
         return success;
     }
 
+    // Buffers the sectors; they reach the device at the next flush/barrier/sync
     bool writeSector(uint64_t sectorIndex, const void* buffer, uint32_t count = 1) {
-        if (verbose) {
-            cout << "\n----------------------------------------------------------------\n";
-            cout << "[DISK WRITE] Sector: " << setw(8) << left << sectorIndex 
-                 << " Offset: 0x" << hex << setw(8) << setfill('0') << (baseOffset + (sectorIndex * SECTOR_SIZE)) << dec << setfill(' ')
-                 << " Size: " << (count * SECTOR_SIZE) << "\n";
-            cout << "----------------------------------------------------------------\n";
-                 
-            unsigned char* p = (unsigned char*)buffer;
-            cout << "DATA: ";
-            for(int i=0; i<16 && i < (int)(count * SECTOR_SIZE); ++i) 
-                cout << hex << setw(2) << setfill('0') << (int)p[i] << " ";
-            cout << dec << setfill(' ') << "\n";
-            cout << "----------------------------------------------------------------\n";
+        if (verbose) logTransfer("[DISK WRITE]", sectorIndex, buffer, count);
+        if (!handleOpen()) return false;
+
+        const uint8_t* in = (const uint8_t*)buffer;
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(pending[sectorIndex + i].data(), in + (size_t)i * SECTOR_SIZE, SECTOR_SIZE);
         }
+        if (pending.size() >= MAX_PENDING_SECTORS) return flush();
+        return true;
+    }
 
-        if (isImageFile) {
-            if (!imageFile.is_open()) return false;
-            imageFile.clear();
-            size_t offset = baseOffset + (sectorIndex * SECTOR_SIZE);
-            imageFile.seekp(offset, ios::beg);
-            if (imageFile.fail() || imageFile.bad()) {
-                imageFile.clear();
-                return false;
-            }
-            imageFile.write(reinterpret_cast<const char*>(buffer), count * SECTOR_SIZE);
-            imageFile.flush();
-            bool success = !imageFile.fail();
-            imageFile.clear();
-            return success;
-        } else {
-            if (hDevice == INVALID_HANDLE_VALUE) return false;
-            LARGE_INTEGER offset;
-            offset.QuadPart = baseOffset + (sectorIndex * SECTOR_SIZE);
-            if (!SetFilePointerEx(hDevice, offset, NULL, FILE_BEGIN)) return false;
-            DWORD bytesWritten;
-            if (!WriteFile(hDevice, buffer, count * SECTOR_SIZE, &bytesWritten, NULL)) return false;
-            if (!FlushFileBuffers(hDevice)) {
-                 DWORD err = GetLastError();
-                 cout << "[DISK] CRITICAL ERROR: FlushFileBuffers failed. Error Code: " << err << endl;
-                 return false;
+    bool readCluster(uint64_t cluster, void* buffer, uint32_t count = 1) {
+        return readSector(cluster * SECTORS_PER_CLUSTER, buffer, count * SECTORS_PER_CLUSTER);
+    }
+
+    bool writeCluster(uint64_t cluster, const void* buffer, uint32_t count = 1) {
+        return writeSector(cluster * SECTORS_PER_CLUSTER, buffer, count * SECTORS_PER_CLUSTER);
+    }
+
+    // Writes buffered sectors in ascending order, one device write per contiguous run
+    bool flush() {
+        if (pending.empty()) return true;
+        bool ok = true;
+        vector<uint8_t> run;
+        run.reserve(min(pending.size() * SECTOR_SIZE, MAX_RUN_BYTES));
+        uint64_t runStart = 0;
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            bool extends = !run.empty() && it->first == runStart + run.size() / SECTOR_SIZE && run.size() < MAX_RUN_BYTES;
+            if (!run.empty() && !extends) {
+                ok = rawWrite(baseOffset + runStart * SECTOR_SIZE, run.data(), run.size()) && ok;
+                run.clear();
             }
-            return bytesWritten == count * SECTOR_SIZE;
+            if (run.empty()) runStart = it->first;
+            run.insert(run.end(), it->second.begin(), it->second.end());
+        }
+        if (!run.empty()) ok = rawWrite(baseOffset + runStart * SECTOR_SIZE, run.data(), run.size()) && ok;
+        pending.clear();
+        if (!ok) cout << "[DISK] CRITICAL ERROR: write-back failed.\n";
+        return ok;
+    }
+
+    // Everything written so far reaches the OS before anything written after
+    bool barrier() {
+        return flush();
+    }
+
+    // Everything written so far is on stable storage
+    bool sync() {
+        if (!handleOpen()) return false;
+        bool ok = flush();
+        syncCalls++;
+#ifdef _WIN32
+        if (!FlushFileBuffers(hDevice)) {
+            DWORD err = GetLastError();
+            cout << "[DISK] CRITICAL ERROR: FlushFileBuffers failed. Error Code: " << err << endl;
+            return false;
+        }
+#else
+        if (fsync(fd) != 0) {
+            cout << "[DISK] CRITICAL ERROR: fsync failed.\n";
+            return false;
         }
+#endif
+        return ok;
     }
     
     uint64_t getFileSizeFromHandle() {
-        if (isImageFile) {
-            if (!imageFile.is_open()) return 0;
-            auto pos = imageFile.tellg();
-            imageFile.seekg(0, ios::end);
-            auto size = imageFile.tellg();
-            imageFile.seekg(pos);
-            return size;
-        }
-        if (hDevice == INVALID_HANDLE_VALUE) return 0;
+        if (!handleOpen()) return 0;
+#ifdef _WIN32
         LARGE_INTEGER size;
         if (GetFileSizeEx(hDevice, &size)) {
             return (uint64_t)size.QuadPart;
         }
         return 0;
+#else
+        struct stat st;
+        if (fstat(fd, &st) != 0) return 0;
+        return (uint64_t)st.st_size;
+#endif
     }
     
-    bool isOpen() const { 
-        if (isImageFile) return imageFile.is_open();
-        return hDevice != INVALID_HANDLE_VALUE; 
-    }
+    bool isOpen() const { return handleOpen(); }
     string getPath() const { return currentPath; }
+
+    uint64_t deviceReads() const { return readCalls; }
+    uint64_t deviceWrites() const { return writeCalls; }
+    uint64_t deviceSyncs() const { return syncCalls; }
 };
 
 #endif
@@ -139,7 +139,7 @@ public:
         
         while (current != 0 && current != LAT_END && limit-- > 0) {
             for (int sector = 0; sector < SECTORS_PER_CLUSTER; sector++) {
-                VersionEntry entries[SECTOR_SIZE / sizeof(VersionEntry)];
+                VersionEntry entries[SECTOR_SIZE / sizeof(VersionEntry) + 1];  // +1: a sector is not a whole number of entries
                 
                 if (!disk.readSector(current * SECTORS_PER_CLUSTER + sector, entries)) {
                     continue;
@@ -275,7 +275,7 @@ public:
     bool writeVersionEntry(uint64_t cluster, int sector, int index, const VersionEntry& entry) {
         if (!disk.isOpen()) return false;
         
-        VersionEntry entries[SECTOR_SIZE / sizeof(VersionEntry)];
+        VersionEntry entries[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         uint64_t sectorNum = cluster * SECTORS_PER_CLUSTER + sector;
         
         if (!disk.readSector(sectorNum, entries)) {
@@ -7,6 +7,7 @@
 #define JOURNAL_HPP
 
 #include "fs_common.hpp"
+#include "meta_cache.hpp"
 #include <vector>
 
 // CRC64 polynomial (ECMA-182)
@@ -18,6 +19,7 @@ private:
     SuperBlock* sb;
     uint64_t currentTxId;
     uint64_t journalHead;  // Write position in circular buffer
+    MetadataCache* metaCache;  // Flushed before a commit record is written
     
     // CRC64 calculation
     uint64_t calculateCRC64(const void* data, size_t length) {
@@ -35,7 +37,9 @@ private:
     }
     
 public:
-    Journal(DiskDevice* d, SuperBlock* s) : disk(d), sb(s), currentTxId(s->lastTxId), journalHead(0) {}
+    Journal(DiskDevice* d, SuperBlock* s) : disk(d), sb(s), currentTxId(s->lastTxId), journalHead(0), metaCache(nullptr) {}
+    
+    void attachCache(MetadataCache* cache) { metaCache = cache; }
     
     // Log an operation before executing it
     uint64_t logOperation(uint32_t opType, uint64_t targetCluster, const string& metadata) {
@@ -59,11 +63,12 @@ public:
         uint64_t entryInSector = journalHead % entriesPerSector;
         
         // Read-Modify-Write sector
-        JournalEntry buffer[entriesPerSector];
+        JournalEntry buffer[SECTOR_SIZE / sizeof(JournalEntry) + 1];  // a sector is not a whole number of entries
         uint64_t sectorIdx = (sb->journalStartCluster * 8) + journalSectorOffset;
         disk->readSector(sectorIdx, buffer);
         buffer[entryInSector] = entry;
         disk->writeSector(sectorIdx, buffer);
+        disk->barrier();  // the intent record goes out before the operation's own writes
         
         // Advance head (circular)
         journalHead = (journalHead + 1) % (sb->journalSectors * entriesPerSector);
@@ -73,11 +78,15 @@ public:
     
     // Mark operation as committed
     void commitOperation(uint64_t txId) {
+        // Allocation metadata and data of the operation must be durable before its commit record
+        if (metaCache) metaCache->flush();
+        disk->sync();
+        
         // Find entry and update status
         uint64_t entriesPerSector = SECTOR_SIZE / sizeof(JournalEntry);
         
         for (uint64_t i = 0; i < sb->journalSectors; i++) {
-            JournalEntry buffer[entriesPerSector];
+            JournalEntry buffer[SECTOR_SIZE / sizeof(JournalEntry) + 1];
             uint64_t sectorIdx = (sb->journalStartCluster * 8) + i;
             disk->readSector(sectorIdx, buffer);
             
@@ -91,6 +100,7 @@ public:
                     // Update SuperBlock's lastTxId
                     sb->lastTxId = txId;
                     disk->writeSector(0, sb);
+                    disk->barrier();
                     return;
                 }
             }
@@ -105,7 +115,7 @@ public:
         int pendingCount = 0;
         
         for (uint64_t i = 0; i < sb->journalSectors; i++) {
-            JournalEntry buffer[entriesPerSector];
+            JournalEntry buffer[SECTOR_SIZE / sizeof(JournalEntry) + 1];
             uint64_t sectorIdx = (sb->journalStartCluster * 8) + i;
             disk->readSector(sectorIdx, buffer);
             
@@ -163,6 +173,7 @@ public:
             disk->writeSector(sectorIdx, buffer);
         }
         
+        disk->sync();
         cout << "[Journal] Replay complete. Recovered " << pendingCount << " pending operations.\n";
     }
     
@@ -267,7 +278,7 @@ public:
         uint64_t entriesPerSector = SECTOR_SIZE / sizeof(JournalEntry);
         
         for (uint64_t i = 0; i < sb->journalSectors; i++) {
-            JournalEntry buffer[entriesPerSector];
+            JournalEntry buffer[SECTOR_SIZE / sizeof(JournalEntry) + 1];
             uint64_t sectorIdx = (sb->journalStartCluster * 8) + i;
             disk->readSector(sectorIdx, buffer);
             
@@ -0,0 +1,131 @@
+/*
+ * Metadata Cache for LevelFS
+ * Compile: Included in mount.cpp
+ *
+ * Mount-lifetime write-back cache of LIT and LAB clusters. Lookups are served
+ * from memory after the first read of a cluster; updates only mark the cluster
+ * dirty. Dirty clusters are written back in ascending cluster order by flush(),
+ * which the Journal calls before it marks a transaction committed and the shell
+ * calls after every command and on unmount. Least recently used clusters are
+ * evicted past the capacity, written back first if dirty.
+ */
+
+#ifndef META_CACHE_HPP
+#define META_CACHE_HPP
+
+#include "fs_common.hpp"
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+class MetadataCache {
+private:
+    struct Entry {
+        vector<uint8_t> data;
+        bool dirty;
+        list<uint64_t>::iterator lruPos;
+    };
+
+    DiskDevice* disk;
+    unordered_map<uint64_t, Entry> entries;
+    list<uint64_t> lru;  // front = most recently used
+    size_t capacity;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+
+    void writeBack(uint64_t cluster, Entry& e) {
+        disk->writeCluster(cluster, e.data.data());
+        e.dirty = false;
+        writebacks++;
+    }
+
+    void touch(Entry& e) {
+        lru.splice(lru.begin(), lru, e.lruPos);
+    }
+
+    void evictOverflow() {
+        while (entries.size() > capacity && !lru.empty()) {
+            uint64_t victim = lru.back();
+            auto it = entries.find(victim);
+            if (it->second.dirty) writeBack(victim, it->second);
+            lru.pop_back();
+            entries.erase(it);
+        }
+    }
+
+    Entry& insert(uint64_t cluster) {
+        lru.push_front(cluster);
+        Entry& e = entries[cluster];
+        e.data.assign(CLUSTER_SIZE, 0);
+        e.dirty = false;
+        e.lruPos = lru.begin();
+        return e;
+    }
+
+public:
+    static const size_t DEFAULT_CAPACITY = 4096;  // clusters (16 MB)
+
+    MetadataCache(DiskDevice* d, size_t capacityClusters = DEFAULT_CAPACITY)
+        : disk(d), capacity(capacityClusters), hits(0), misses(0), writebacks(0) {}
+
+    // Cached contents of a cluster, read from disk on first use. The pointer stays
+    // valid until the next get()/create(), which may evict it.
+    uint8_t* get(uint64_t cluster) {
+        auto it = entries.find(cluster);
+        if (it != entries.end()) {
+            hits++;
+            touch(it->second);
+            return it->second.data.data();
+        }
+        misses++;
+        evictOverflow();
+        Entry& e = insert(cluster);
+        disk->readCluster(cluster, e.data.data());
+        return e.data.data();
+    }
+
+    // A cluster about to be fully overwritten: zero-filled and dirty, no disk read
+    uint8_t* create(uint64_t cluster) {
+        auto it = entries.find(cluster);
+        if (it == entries.end()) {
+            evictOverflow();
+            Entry& e = insert(cluster);
+            e.dirty = true;
+            return e.data.data();
+        }
+        touch(it->second);
+        it->second.dirty = true;
+        memset(it->second.data.data(), 0, CLUSTER_SIZE);
+        return it->second.data.data();
+    }
+
+    void markDirty(uint64_t cluster) {
+        auto it = entries.find(cluster);
+        if (it != entries.end()) it->second.dirty = true;
+    }
+
+    // Writes every dirty cluster, lowest cluster first
+    void flush() {
+        vector<uint64_t> dirty;
+        for (auto& kv : entries) {
+            if (kv.second.dirty) dirty.push_back(kv.first);
+        }
+        sort(dirty.begin(), dirty.end());
+        for (uint64_t c : dirty) writeBack(c, entries[c]);
+    }
+
+    // Drops everything without writing (call flush() first to keep changes)
+    void clear() {
+        entries.clear();
+        lru.clear();
+    }
+
+    size_t size() const { return entries.size(); }
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+    uint64_t writebackCount() const { return writebacks; }
+};
+
+#endif
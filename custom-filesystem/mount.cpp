@@ -5,14 +5,19 @@
 
 #include "fs_common.hpp"
 #include "journal.hpp"
+#include "free_space.hpp"
+#include "meta_cache.hpp"
 #include "permissions.hpp"
 #include "fs_entry.hpp"
 #include "fs_context.hpp"
+#include <unordered_set>
 
 class FileSystemShell {
     DiskDevice disk;
     SuperBlock sb;
     Journal* journal;
+    FreeSpaceMap freeSpace;
+    MetadataCache metaCache;  // LIT/LAB clusters, written back at commit points
     
     PermissionCache permCache;
     EntryReader* entryReader;
@@ -31,13 +36,14 @@ class FileSystemShell {
     } context;
 
 public:
-    FileSystemShell() : journal(nullptr), entryReader(nullptr), entryWriter(nullptr), entryFinder(nullptr) {
+    FileSystemShell() : journal(nullptr), metaCache(&disk), entryReader(nullptr), entryWriter(nullptr), entryFinder(nullptr) {
         memset(&context, 0, sizeof(context));
         context.currentPath = "/";
         context.currentFolderPerms = PERM_ROOT_DEFAULT;
     }
     
     ~FileSystemShell() {
+        unmount();
         if (journal) delete journal;
         if (entryReader) delete entryReader;
         if (entryWriter) delete entryWriter;
@@ -47,7 +53,7 @@ public:
     LevelDescriptor* findLevelByID(uint64_t levelID) {
         if (sb.levelRegistryCluster == 0) return nullptr;
         
-        static LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor)];
+        static LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor) + 1];  // +1: a sector is not a whole number of descriptors
         vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
         
         for (uint64_t c : chain) {
@@ -66,7 +72,7 @@ public:
     LevelDescriptor* findLevelByName(const string& name) {
         if (sb.levelRegistryCluster == 0) return nullptr;
         
-        static LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor)];
+        static LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor) + 1];
         vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
         
         for (uint64_t c : chain) {
@@ -83,6 +89,7 @@ public:
     }
 
     bool mount(char driveLetter) {
+        unmount();
         if (!disk.open(driveLetter)) return false;
         
         if (!disk.readSector(0, &sb)) {
@@ -96,8 +103,12 @@ public:
             }
         }
 
+        if (journal) delete journal;
+        metaCache.clear();
         journal = new Journal(&disk, &sb);
+        journal->attachCache(&metaCache);
         journal->replayJournal();
+        initFreeSpace();
 
         context.currentDirCluster = sb.rootDirCluster;
         context.currentPath = "/";
@@ -125,6 +136,7 @@ public:
     }
 
     bool mountImage(const string& path) {
+        unmount();
         if (!disk.openFile(path)) {
             cout << "Failed to open image file: " << path << "\n";
             return false;
@@ -143,8 +155,12 @@ public:
             }
         }
 
+        if (journal) delete journal;
+        metaCache.clear();
         journal = new Journal(&disk, &sb);
+        journal->attachCache(&metaCache);
         journal->replayJournal();
+        initFreeSpace();
 
         context.currentDirCluster = sb.rootDirCluster;
         context.currentPath = "/";
@@ -172,7 +188,7 @@ public:
             context.rootContentCluster = context.currentContentCluster;
         } else {
             cout << "No master version found. Creating...\n";
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             memset(vps, 0, sizeof(vps));
             strcpy(vps[0].versionName, "master");
             vps[0].isActive = 1;
@@ -225,15 +241,8 @@ public:
             return result;
         }
         
-        char* litBuffer = new char[CLUSTER_SIZE];
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.readSector((sb.litStartCluster + litClusterIdx) * SECTORS_PER_CLUSTER + s,
-                litBuffer + s * SECTOR_SIZE);
-        }
-        LITEntry* litEntries = (LITEntry*)litBuffer;
-        
+        const LITEntry* litEntries = (const LITEntry*)metaCache.get(sb.litStartCluster + litClusterIdx);
         uint64_t labCluster = litEntries[litEntryIdx].labCluster;
-        delete[] litBuffer;
         
         if (labCluster == LIT_EMPTY || labCluster == 0) {
             return result;
@@ -243,16 +252,8 @@ public:
             return result;
         }
         
-        char* labBuffer = new char[CLUSTER_SIZE];
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.readSector(labCluster * SECTORS_PER_CLUSTER + s,
-                labBuffer + s * SECTOR_SIZE);
-        }
-        LABEntry* labEntries = (LABEntry*)labBuffer;
-        
-        result = labEntries[labOffset];
-        delete[] labBuffer;
-        return result;
+        const LABEntry* labEntries = (const LABEntry*)metaCache.get(labCluster);
+        return labEntries[labOffset];
     }
     
     uint64_t getLATEntry(uint64_t cluster) {
@@ -269,64 +270,36 @@ public:
         uint64_t litClusterIdx = litIndex / (CLUSTER_SIZE / sizeof(LITEntry));
         uint64_t litEntryIdx = litIndex % (CLUSTER_SIZE / sizeof(LITEntry));
         
-        char* litBuffer = new char[CLUSTER_SIZE];
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.readSector((sb.litStartCluster + litClusterIdx) * SECTORS_PER_CLUSTER + s,
-                litBuffer + s * SECTOR_SIZE);
-        }
-        LITEntry* litEntries = (LITEntry*)litBuffer;
-        
+        uint64_t litCluster = sb.litStartCluster + litClusterIdx;
+        LITEntry* litEntries = (LITEntry*)metaCache.get(litCluster);
         uint64_t labCluster = litEntries[litEntryIdx].labCluster;
         
         if (labCluster == LIT_EMPTY || labCluster == 0) {
             uint64_t newLABCluster = sb.labPoolStart + sb.nextFreeLAB;
             sb.nextFreeLAB++;
             
-            char* newLABBuffer = new char[CLUSTER_SIZE];
-            memset(newLABBuffer, 0, CLUSTER_SIZE);
-            LABEntry* newLAB = (LABEntry*)newLABBuffer;
+            // Point the LIT at the new LAB first: creating the LAB may evict the LIT cluster
+            litEntries[litEntryIdx].labCluster = newLABCluster;
+            litEntries[litEntryIdx].baseCluster = litIndex * CLUSTERS_PER_LIT_ENTRY;
+            litEntries[litEntryIdx].allocatedCount = 0;
+            litEntries[litEntryIdx].flags = 0;
+            metaCache.markDirty(litCluster);
+            
+            LABEntry* newLAB = (LABEntry*)metaCache.create(newLABCluster);
             for (int i = 0; i < LAB_ENTRIES_PER_CLUSTER; i++) {
                 newLAB[i].nextCluster = LAT_FREE;
                 newLAB[i].levelID = LEVEL_ID_NONE;
                 newLAB[i].flags = 0;
                 newLAB[i].refCount = 0;
             }
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.writeSector(newLABCluster * SECTORS_PER_CLUSTER + s,
-                    newLABBuffer + s * SECTOR_SIZE);
-            }
-            delete[] newLABBuffer;
-            
-            litEntries[litEntryIdx].labCluster = newLABCluster;
-            litEntries[litEntryIdx].baseCluster = litIndex * CLUSTERS_PER_LIT_ENTRY;
-            litEntries[litEntryIdx].allocatedCount = 0;
-            litEntries[litEntryIdx].flags = 0;
             labCluster = newLABCluster;
             
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.writeSector((sb.litStartCluster + litClusterIdx) * SECTORS_PER_CLUSTER + s,
-                    litBuffer + s * SECTOR_SIZE);
-            }
-            
             writeSuperBlock();
         }
         
-        delete[] litBuffer;
-        
-        char* labBuffer = new char[CLUSTER_SIZE];
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.readSector(labCluster * SECTORS_PER_CLUSTER + s,
-                labBuffer + s * SECTOR_SIZE);
-        }
-        LABEntry* labEntries = (LABEntry*)labBuffer;
-        
+        LABEntry* labEntries = (LABEntry*)metaCache.get(labCluster);
         labEntries[labOffset] = value;
-        
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.writeSector(labCluster * SECTORS_PER_CLUSTER + s,
-                labBuffer + s * SECTOR_SIZE);
-        }
-        delete[] labBuffer;
+        metaCache.markDirty(labCluster);
     }
 
     void setLATEntry(uint64_t cluster, uint64_t value) {
@@ -355,7 +328,10 @@ public:
         entry.refCount = 0;
         setLABEntry(cluster, entry);
         
-        sb.totalFreeClusters++;
+        if (freeSpace.isUsed(cluster)) {
+            freeSpace.markFree(cluster);
+            sb.totalFreeClusters++;
+        }
         writeSuperBlock();
     }
     
@@ -370,7 +346,10 @@ public:
             entry.flags = 0;
             entry.refCount = 0;
             setLABEntry(c, entry);
-            sb.totalFreeClusters++;
+            if (freeSpace.isUsed(c)) {
+                freeSpace.markFree(c);
+                sb.totalFreeClusters++;
+            }
         }
         writeSuperBlock();
     }
@@ -379,55 +358,151 @@ public:
         return allocClusterForLevel(context.currentLevelID);
     }
     
-    uint64_t skipPastReserved(uint64_t c) {
-        if (c == 0) return 1;
-        if (c == sb.backupSBCluster) return c + 1;
-        if (c >= sb.litStartCluster && c < sb.litStartCluster + sb.litClusters) 
-            return sb.litStartCluster + sb.litClusters;
-        if (c >= sb.labPoolStart && c < sb.labPoolStart + sb.labPoolClusters) 
-            return sb.labPoolStart + sb.labPoolClusters;
-        if (c >= sb.levelRegistryCluster && c < sb.levelRegistryCluster + sb.levelRegistryClusters) 
-            return sb.levelRegistryCluster + sb.levelRegistryClusters;
-        if (c >= sb.journalStartCluster && c < sb.journalStartCluster + (sb.journalSectors / SECTORS_PER_CLUSTER + 1)) 
-            return sb.journalStartCluster + (sb.journalSectors / SECTORS_PER_CLUSTER + 1);
-        if (c >= sb.rootDirCluster && c <= sb.rootDirCluster + 1) 
-            return sb.rootDirCluster + 2;
+    // Next free cluster from the free-space map, no LAB reads needed to find it
+    uint64_t allocClusterForLevel(uint32_t levelID) {
+        uint64_t c = freeSpace.findFree(sb.freeClusterHint);
+        if (c == FreeSpaceMap::NONE) return 0;
+        
+        freeSpace.markUsed(c);
+        setLATEntryWithLevel(c, LAT_END, levelID);
+        sb.freeClusterHint = c + 1;
+        sb.totalFreeClusters--;
+        writeSuperBlock();
         return c;
     }
     
-    uint64_t allocClusterForLevel(uint32_t levelID) {
-        uint64_t c = sb.freeClusterHint;
-        if (c == 0) c = 1;
+    // `count` consecutive clusters linked into one chain; returns the first, 0 if no run fits
+    uint64_t allocClusterRun(uint64_t count, uint32_t levelID) {
+        uint64_t start = freeSpace.findRun(count);
+        if (start == FreeSpaceMap::NONE) return 0;
         
-        uint64_t startC = c;
-        bool wrapped = false;
-        
-        while (true) {
-            c = skipPastReserved(c);
-            
-            if (c >= sb.totalClusters) {
-                if (wrapped) return 0;
-                wrapped = true;
-                c = 1;
-                continue;
-            }
-            
-            if (wrapped && c >= startC) return 0;
+        for (uint64_t i = 0; i < count; i++) {
+            freeSpace.markUsed(start + i);
+            setLATEntryWithLevel(start + i, (i + 1 < count) ? start + i + 1 : LAT_END, levelID);
+        }
+        sb.totalFreeClusters -= count;
+        writeSuperBlock();
+        return start;
+    }
+    
+    // --- Free-space map ---
+    
+    // Full rebuild: metadata regions, then every cluster a LAB records as allocated.
+    // Reads each LIT and LAB cluster once (through the metadata cache).
+    void rebuildFreeSpace() {
+        freeSpace.reset(sb.totalClusters);
+        freeSpace.markUsed(0);
+        if (sb.backupSBCluster != 0) freeSpace.markUsed(sb.backupSBCluster);
+        freeSpace.markRangeUsed(sb.litStartCluster, sb.litClusters);
+        freeSpace.markRangeUsed(sb.labPoolStart, sb.labPoolClusters);
+        freeSpace.markRangeUsed(sb.levelRegistryCluster, sb.levelRegistryClusters);
+        freeSpace.markRangeUsed(sb.journalStartCluster, sb.journalSectors / SECTORS_PER_CLUSTER + 1);
+        freeSpace.markRangeUsed(sb.rootDirCluster, 2);
+        
+        const uint64_t litPerCluster = CLUSTER_SIZE / sizeof(LITEntry);
+        uint64_t litCount = (sb.totalClusters + CLUSTERS_PER_LIT_ENTRY - 1) / CLUSTERS_PER_LIT_ENTRY;
+        
+        for (uint64_t litIndex = 0; litIndex < litCount; litIndex++) {
+            uint64_t litClusterIdx = litIndex / litPerCluster;
+            if (litClusterIdx >= sb.litClusters || sb.litStartCluster + litClusterIdx >= sb.totalClusters) break;
+            const LITEntry* lit = (const LITEntry*)metaCache.get(sb.litStartCluster + litClusterIdx);
+            uint64_t labCluster = lit[litIndex % litPerCluster].labCluster;
+            if (labCluster == LIT_EMPTY || labCluster < sb.labPoolStart ||
+                labCluster >= sb.labPoolStart + sb.labPoolClusters) continue;
             
-            if (!isReservedCluster(c)) {
-                LABEntry entry = getLABEntry(c);
-                if (entry.nextCluster == LAT_FREE && entry.flags == 0) {
-                    setLATEntryWithLevel(c, LAT_END, levelID);
-                    sb.freeClusterHint = c + 1;
-                    sb.totalFreeClusters--;
-                    writeSuperBlock();
-                    return c;
-                }
+            const LABEntry* lab = (const LABEntry*)metaCache.get(labCluster);
+            uint64_t base = litIndex * CLUSTERS_PER_LIT_ENTRY;
+            for (uint64_t k = 0; k < LAB_ENTRIES_PER_CLUSTER && base + k < sb.totalClusters; k++) {
+                if (lab[k].nextCluster != LAT_FREE || lab[k].flags != 0) freeSpace.markUsed(base + k);
             }
-            
-            c++;
         }
-        return 0;
+    }
+    
+    // The copy saved at unmount, if nothing has touched the volume since
+    bool loadSavedFreeSpace() {
+        if (!sb.freeMapValid || sb.freeMapCluster == 0) return false;
+        if (sb.freeMapFreeCount != sb.totalFreeClusters || sb.freeMapHint != sb.freeClusterHint ||
+            sb.freeMapTxId != sb.lastTxId) return false;
+        
+        uint64_t wordCount = (sb.totalClusters + 63) / 64;
+        if (sb.freeMapClusters * CLUSTER_SIZE < wordCount * sizeof(uint64_t)) return false;
+        if (sb.freeMapCluster + sb.freeMapClusters > sb.totalClusters) return false;
+        
+        vector<uint64_t> saved(sb.freeMapClusters * CLUSTER_SIZE / sizeof(uint64_t));
+        if (!disk.readCluster(sb.freeMapCluster, saved.data(), (uint32_t)sb.freeMapClusters)) return false;
+        saved.resize(wordCount);
+        if (FreeSpaceMap::checksumOf(saved) != sb.freeMapChecksum) return false;
+        return freeSpace.load(saved, sb.totalClusters);
+    }
+    
+    void initFreeSpace() {
+        if (!loadSavedFreeSpace()) rebuildFreeSpace();
+        
+        // The saved copy only describes an unmounted volume; give its clusters back
+        // and mark it stale so a crash before the next unmount forces a rescan
+        if (sb.freeMapCluster != 0) {
+            LABEntry entry;
+            entry.nextCluster = LAT_FREE;
+            entry.levelID = LEVEL_ID_NONE;
+            entry.flags = 0;
+            entry.refCount = 0;
+            for (uint64_t i = 0; i < sb.freeMapClusters; i++) {
+                uint64_t c = sb.freeMapCluster + i;
+                if (c >= sb.totalClusters || isReservedCluster(c)) break;
+                setLABEntry(c, entry);
+                freeSpace.markFree(c);
+            }
+        }
+        sb.freeMapCluster = 0;
+        sb.freeMapClusters = 0;
+        sb.freeMapChecksum = 0;
+        sb.freeMapFreeCount = 0;
+        sb.freeMapHint = 0;
+        sb.freeMapTxId = 0;
+        sb.freeMapValid = 0;
+        sb.totalFreeClusters = freeSpace.freeCount();
+        writeSuperBlock();
+    }
+    
+    // Writes the map into a fresh cluster run so the next mount can skip the LAB scan.
+    // A volume too full for the run is simply rescanned next time.
+    void saveFreeSpace() {
+        if (!freeSpace.isLoaded()) return;
+        uint64_t need = freeSpace.storageClusters();
+        uint64_t start = allocClusterRun(need, LEVEL_ID_NONE);
+        if (start == 0) return;
+        
+        const vector<uint64_t>& words = freeSpace.rawWords();
+        vector<char> buffer(need * CLUSTER_SIZE, 0);
+        memcpy(buffer.data(), words.data(), words.size() * sizeof(uint64_t));
+        disk.writeCluster(start, buffer.data(), (uint32_t)need);
+        metaCache.flush();  // the run's LAB entries before the SuperBlock that points at it
+        
+        sb.freeMapCluster = start;
+        sb.freeMapClusters = need;
+        sb.freeMapChecksum = freeSpace.checksum();
+        sb.freeMapFreeCount = sb.totalFreeClusters;
+        sb.freeMapHint = sb.freeClusterHint;
+        sb.freeMapTxId = sb.lastTxId;
+        sb.freeMapValid = 1;
+        writeSuperBlock();
+    }
+    
+    // Writes back cached metadata and buffered sectors; called after every shell command.
+    // Only a journal commit or unmount also forces them to stable storage.
+    void syncMetadata() {
+        if (!disk.isOpen()) return;
+        metaCache.flush();
+        disk.barrier();
+    }
+    
+    void unmount() {
+        if (!disk.isOpen()) return;
+        saveFreeSpace();
+        metaCache.flush();
+        metaCache.clear();
+        disk.close();
+        freeSpace = FreeSpaceMap();
     }
 
     vector<uint64_t> getChain(uint64_t startCluster) {
@@ -440,9 +515,11 @@ public:
             return chain;
         }
         
+        unordered_set<uint64_t> seen;
+        seen.insert(startCluster);
         uint64_t current = getLATEntry(startCluster);
         while (current != 0 && current != LAT_END && current != LAT_BAD && current < sb.totalClusters) {
-            if (find(chain.begin(), chain.end(), current) != chain.end()) break;
+            if (!seen.insert(current).second) break;  // cycle
             chain.push_back(current);
             if (chain.size() > 1000000) break;
             current = getLATEntry(current);
@@ -480,7 +557,7 @@ public:
         vector<uint64_t> chain = getChain(context.currentDirCluster);
         
         for (uint64_t c : chain) {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int i=0; i<8; i++) {
                 disk.readSector(c * 8 + i, vps);
                 for(int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -559,7 +636,7 @@ public:
 
             if (!found) return {0, "", false};
 
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             bool levelFound = false;
             uint64_t nextContent = 0;
             for (int s = 0; s < 8; s++) {
@@ -641,7 +718,7 @@ public:
              
              if (levelName.empty()) {
                   cout << "Levels of " << folderName << ":\n";
-                  VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+                  VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                   for (int i=0; i<8; i++) {
                       disk.readSector(foundCluster * 8 + i, vps);
                       for (int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -650,7 +727,7 @@ public:
                   }
                   return;
              } else {
-                 VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+                 VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                  bool lvlFound = false;
                  for (int i=0; i<8; i++) {
                      disk.readSector(foundCluster * 8 + i, vps);
@@ -703,9 +780,7 @@ public:
                         if (entries[j].type == TYPE_SYMLINK && entries[j].startCluster != 0) {
                             char targetBuf[CLUSTER_SIZE];
                             memset(targetBuf, 0, CLUSTER_SIZE);
-                            for (int s=0; s<8; s++) {
-                                disk.readSector(entries[j].startCluster * 8 + s, targetBuf + (s * SECTOR_SIZE));
-                            }
+                            disk.readCluster(entries[j].startCluster, targetBuf);
                             cout << " -> " << targetBuf;
                         }
                         if (entries[j].type == TYPE_LEVEL_MOUNT) {
@@ -754,7 +829,7 @@ public:
         
         if (levelName.empty()) {
             cout << "Levels of '" << folderName << "':\n";
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             int count = 0;
             for (int i=0; i<8; i++) {
                 disk.readSector(folderCluster * 8 + i, vps);
@@ -767,7 +842,7 @@ public:
             }
             if (count == 0) cout << "  (no levels)\n";
         } else {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             uint64_t contentCluster = 0;
             for (int i=0; i<8; i++) {
                 disk.readSector(folderCluster * 8 + i, vps);
@@ -838,7 +913,7 @@ public:
             bool last = (i == folders.size() - 1);
             cout << prefix << (last ? "└── " : "├── ") << "[" << folders[i].first << "]" << "\n";
             
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int s=0; s<8; s++) {
                 disk.readSector(folders[i].second * 8 + s, vps);
                 for (int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -850,7 +925,7 @@ public:
                         }
                         if (lastLevel) {
                             for (int ns=s+1; ns<8 && lastLevel; ns++) {
-                                VersionEntry vp2[SECTOR_SIZE/sizeof(VersionEntry)];
+                                VersionEntry vp2[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                                 disk.readSector(folders[i].second * 8 + ns, vp2);
                                 for (int k=0; k<SECTOR_SIZE/sizeof(VersionEntry); k++) {
                                     if (vp2[k].isActive) { lastLevel = false; break; }
@@ -901,9 +976,7 @@ public:
                         char buffer[CLUSTER_SIZE];
                         memset(buffer, 0, CLUSTER_SIZE);
                         strncpy(buffer, targetPath.c_str(), CLUSTER_SIZE - 1);
-                        for (int s=0; s<8; s++) {
-                            disk.writeSector(targetCluster * 8 + s, buffer + (s * SECTOR_SIZE));
-                        }
+                        disk.writeCluster(targetCluster, buffer);
                         
                         entries[j].startCluster = targetCluster;
                         entries[j].size = targetPath.length();
@@ -1056,7 +1129,7 @@ found_slot:
             target->attributes = PERM_DIR_DEFAULT;
             
             if (target->startCluster != 0) {
-                VersionEntry vTable[CLUSTER_SIZE / sizeof(VersionEntry)];
+                VersionEntry vTable[CLUSTER_SIZE / sizeof(VersionEntry) + 1];
                 memset(vTable, 0, sizeof(vTable));
                 strcpy(vTable[0].versionName, "master");
                 vTable[0].isActive = 1;
@@ -1070,16 +1143,12 @@ found_slot:
                 vTable[0].isLocked = 0;
                 vTable[0].isSnapshot = 0;
                 
-                for (int s = 0; s < 8; s++) {
-                    disk.writeSector(target->startCluster * 8 + s, ((char*)vTable) + s * SECTOR_SIZE);
-                }
+                disk.writeCluster(target->startCluster, (char*)vTable);
                 
                 if (vTable[0].contentTableCluster != 0) {
                     DirEntry emptyContent[CLUSTER_SIZE / sizeof(DirEntry)];
                     memset(emptyContent, 0, sizeof(emptyContent));
-                    for (int s = 0; s < 8; s++) {
-                        disk.writeSector(vTable[0].contentTableCluster * 8 + s, ((char*)emptyContent) + s * SECTOR_SIZE);
-                    }
+                    disk.writeCluster(vTable[0].contentTableCluster, (char*)emptyContent);
                 }
             }
         } else if (type == "symlink") {
@@ -1201,7 +1270,7 @@ found_slot:
                     for (int j = 0; j < SECTOR_SIZE/sizeof(DirEntry); j++) {
                         if (entries[j].type == TYPE_LEVELED_DIR && string(entries[j].name) == res.name) {
                             // Need to pick a level - use first active
-                            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+                            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                             disk.readSector(entries[j].startCluster * 8, vps);
                             for (int v = 0; v < SECTOR_SIZE/sizeof(VersionEntry); v++) {
                                 if (vps[v].isActive) {
@@ -1318,7 +1387,7 @@ found:
             int levelCount = 0;
             vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
             for (uint64_t c : chain) {
-                LevelDescriptor reg[SECTOR_SIZE / sizeof(LevelDescriptor)];
+                LevelDescriptor reg[SECTOR_SIZE / sizeof(LevelDescriptor) + 1];
                 for (int s = 0; s < 8; s++) {
                     disk.readSector(c * 8 + s, reg);
                     for (int j = 0; j < SECTOR_SIZE / sizeof(LevelDescriptor); j++) {
@@ -1330,42 +1399,17 @@ found:
         }
         
         // Check 4: Free space consistency
-        cout << "[4/5] Checking free space... ";
-        cout.flush();
+        cout << "[4/5] Checking free space...\n";
         
         uint64_t reportedFree = sb.totalFreeClusters;
-        uint64_t sampleFree = 0;
-        uint64_t sampleCount = 0;
-        
-        // Fast sampling: check every 100th cluster with spinner
-        uint64_t dataStart = sb.labPoolStart + sb.labPoolClusters;
-        uint64_t totalToCheck = min(sb.totalClusters - dataStart, (uint64_t)100000);
-        const char spinner[] = "|/-\\";
-        int spinIdx = 0;
-        
-        for (uint64_t i = 0; i < totalToCheck; i += 100) {
-            uint64_t cluster = dataStart + i;
-            if (cluster >= sb.totalClusters) break;
-            
-            LABEntry lab = getLABEntry(cluster);
-            if (lab.nextCluster == LAT_FREE) sampleFree++;
-            sampleCount++;
-            
-            // Update spinner every 1000 samples
-            if (sampleCount % 10 == 0) {
-                cout << "\b" << spinner[spinIdx++ % 4];
-                cout.flush();
-            }
-        }
+        uint64_t mapFree = freeSpace.freeCount();
         
-        cout << "\b \n";  // Clear spinner
-        
-        // Estimate total free from sample
-        if (sampleCount > 0 && sampleFree > 0) {
-            uint64_t estimatedFree = (sampleFree * 100);  // Scale up from sampling
-            cout << "  OK: ~" << estimatedFree << " free clusters (sampled).\n";
-        } else if (reportedFree > 0) {
-            cout << "  OK: " << reportedFree << " free clusters (from superblock).\n";
+        if (mapFree != reportedFree) {
+            cout << "  WARNING: SuperBlock reports " << reportedFree << " free clusters, free-space map has "
+                 << mapFree << ".\n";
+            warnings++;
+        } else if (mapFree > 0) {
+            cout << "  OK: " << mapFree << " free clusters.\n";
         } else {
             cout << "  WARNING: Disk may be full.\n";
             warnings++;
@@ -1389,6 +1433,17 @@ found:
         }
     }
     
+    // Device and metadata-cache counters since mount
+    void ioStats() {
+        if (!disk.isOpen()) return;
+        cout << "\n=== I/O Statistics ===\n";
+        cout << "  Device reads:   " << disk.deviceReads() << "\n";
+        cout << "  Device writes:  " << disk.deviceWrites() << "\n";
+        cout << "  Device syncs:   " << disk.deviceSyncs() << "\n";
+        cout << "  Metadata cache: " << metaCache.size() << " clusters, " << metaCache.hitCount() << " hits, "
+             << metaCache.missCount() << " misses, " << metaCache.writebackCount() << " write-backs\n\n";
+    }
+    
     // Analyze fragmentation
     void fragInfo() {
         if (!disk.isOpen()) return;
@@ -1459,44 +1514,17 @@ found:
         
         // Need to find contiguous space
         uint64_t neededClusters = oldChain.size();
-        uint64_t newStart = 0;
-        uint64_t consecutive = 0;
-        uint64_t dataStart = sb.labPoolStart + sb.labPoolClusters;
-        
-        for (uint64_t c = dataStart; c < sb.totalClusters; c++) {
-            LABEntry lab = getLABEntry(c);
-            if (lab.nextCluster == LAT_FREE) {
-                if (consecutive == 0) newStart = c;
-                consecutive++;
-                if (consecutive >= neededClusters) break;
-            } else {
-                consecutive = 0;
-            }
-        }
-        
-        if (consecutive < neededClusters) {
+        uint32_t levelID = getLABEntry(oldChain[0]).levelID;
+        uint64_t newStart = allocClusterRun(neededClusters, levelID);
+        if (newStart == 0) {
             return false;  // Not enough contiguous space
         }
         
         // Copy data to new location
         for (size_t i = 0; i < oldChain.size(); i++) {
             uint8_t buffer[CLUSTER_SIZE];
-            for (int s = 0; s < 8; s++) {
-                disk.readSector(oldChain[i] * 8 + s, buffer + s * SECTOR_SIZE);
-            }
-            for (int s = 0; s < 8; s++) {
-                disk.writeSector((newStart + i) * 8 + s, buffer + s * SECTOR_SIZE);
-            }
-            
-            // Update LAT for new cluster
-            if (i < oldChain.size() - 1) {
-                setLATEntry(newStart + i, newStart + i + 1);
-            } else {
-                setLATEntry(newStart + i, LAT_END);
-            }
-            
-            // Free old cluster
-            setLATEntry(oldChain[i], LAT_FREE);
+            disk.readCluster(oldChain[i], buffer);
+            disk.writeCluster(newStart + i, buffer);
         }
         
         // Update entry
@@ -1505,6 +1533,9 @@ found:
         entries[entryIdx].startCluster = newStart;
         disk.writeSector(entrySector, entries);
         
+        // Free old clusters
+        for (uint64_t c : oldChain) freeCluster(c);
+        
         return true;
     }
     
@@ -1597,18 +1628,12 @@ found:
     void updateLevelDescriptor(LevelDescriptor& updated) {
         vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
         for (uint64_t c : chain) {
-            LevelDescriptor registry[CLUSTER_SIZE / sizeof(LevelDescriptor)];
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.readSector(c * SECTORS_PER_CLUSTER + s,
-                    ((char*)registry) + s * SECTOR_SIZE);
-            }
+            LevelDescriptor registry[CLUSTER_SIZE / sizeof(LevelDescriptor) + 1];
+            disk.readCluster(c, (char*)registry);
             for (int j = 0; j < CLUSTER_SIZE / sizeof(LevelDescriptor); j++) {
                 if (registry[j].levelID == updated.levelID) {
                     registry[j] = updated;
-                    for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                        disk.writeSector(c * SECTORS_PER_CLUSTER + s,
-                            ((char*)registry) + s * SECTOR_SIZE);
-                    }
+                    disk.writeCluster(c, (char*)registry);
                     return;
                 }
             }
@@ -1680,7 +1705,7 @@ found:
     }
     
     void enterFolder(uint64_t cluster, string name, string level) {
-        VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+        VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         vector<string> versions;
         for (int i=0; i<8; i++) {
              disk.readSector(cluster * 8 + i, vps);
@@ -1731,16 +1756,12 @@ found:
         uint64_t newLevelID = sb.nextLevelID++;
         sb.totalLevels++;
         
-        SYSTEMTIME st;
-        GetSystemTime(&st);
-        FILETIME ft;
-        SystemTimeToFileTime(&st, &ft);
-        uint64_t timestamp = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+        uint64_t timestamp = currentFileTime();
         
         vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
         
         for (uint64_t c : chain) {
-            LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor)];
+            LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor) + 1];
             for (int s = 0; s < 8; s++) {
                 disk.readSector(c * 8 + s, registry);
                 for (int j = 0; j < SECTOR_SIZE / sizeof(LevelDescriptor); j++) {
@@ -1778,7 +1799,7 @@ found:
         vector<uint64_t> chain = getChain(cluster);
         
         for (uint64_t c : chain) {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int i=0; i<8; i++) {
                  disk.readSector(c * 8 + i, vps);
                  for(int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -1806,7 +1827,7 @@ found:
         
         setLATEntry(lastCluster, newCluster);
         
-        VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+        VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         memset(vps, 0, sizeof(vps));
         strcpy(vps[0].versionName, name.c_str());
         vps[0].contentTableCluster = cont;
@@ -1833,7 +1854,7 @@ found:
         
         vector<uint64_t> chain = getChain(folderCluster);
         for (uint64_t c : chain) {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int i = 0; i < 8; i++) {
                 disk.readSector(c * 8 + i, vps);
                 for (int j = 0; j < SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -1862,27 +1883,17 @@ found:
         
         DirEntry emptyContent[CLUSTER_SIZE / sizeof(DirEntry)];
         memset(emptyContent, 0, sizeof(emptyContent));
-        for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-            disk.writeSector(newContentCluster * SECTORS_PER_CLUSTER + s,
-                ((char*)emptyContent) + s * SECTOR_SIZE);
-        }
+        disk.writeCluster(newContentCluster, (char*)emptyContent);
         
         uint64_t newLevelID = sb.nextLevelID++;
         sb.totalLevels++;
         
-        SYSTEMTIME st;
-        GetSystemTime(&st);
-        FILETIME ft;
-        SystemTimeToFileTime(&st, &ft);
-        uint64_t timestamp = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+        uint64_t timestamp = currentFileTime();
         
         vector<uint64_t> regChain = getChain(sb.levelRegistryCluster);
         for (uint64_t c : regChain) {
-            LevelDescriptor registry[CLUSTER_SIZE / sizeof(LevelDescriptor)];
-            for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                disk.readSector(c * SECTORS_PER_CLUSTER + s,
-                    ((char*)registry) + s * SECTOR_SIZE);
-            }
+            LevelDescriptor registry[CLUSTER_SIZE / sizeof(LevelDescriptor) + 1];
+            disk.readCluster(c, (char*)registry);
             for (int j = 0; j < CLUSTER_SIZE / sizeof(LevelDescriptor); j++) {
                 if (registry[j].levelID == 0 && !(registry[j].flags & LEVEL_FLAG_ACTIVE)) {
                     strcpy(registry[j].name, newLevelName.c_str());
@@ -1895,10 +1906,7 @@ found:
                     registry[j].refCount = 1;
                     registry[j].childCount = 0;
                     
-                    for (int s = 0; s < SECTORS_PER_CLUSTER; s++) {
-                        disk.writeSector(c * SECTORS_PER_CLUSTER + s,
-                            ((char*)registry) + s * SECTOR_SIZE);
-                    }
+                    disk.writeCluster(c, (char*)registry);
                     goto registry_done;
                 }
             }
@@ -1906,7 +1914,7 @@ found:
         registry_done:
         
         for (uint64_t c : chain) {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int i = 0; i < 8; i++) {
                 disk.readSector(c * 8 + i, vps);
                 for (int j = 0; j < SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -2043,7 +2051,7 @@ found:
         vector<uint64_t> chain = getChain(dirCluster);
         
         for (uint64_t c : chain) {
-            VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+            VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
             for (int i=0; i<8; i++) {
                  disk.readSector(c * 8 + i, vps);
                  for(int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -2067,7 +2075,7 @@ found:
         setLATEntry(lastCluster, newCluster);
         
         // Initialize new cluster
-        VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+        VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         memset(vps, 0, sizeof(vps));
         strcpy(vps[0].versionName, levelName.c_str());
         vps[0].contentTableCluster = contentCluster;
@@ -2135,9 +2143,7 @@ found:
             // Read target path from symlink cluster
             char targetPath[CLUSTER_SIZE];
             memset(targetPath, 0, CLUSTER_SIZE);
-            for (int i=0; i<8; i++) {
-                disk.readSector(fileEntry.startCluster * 8 + i, targetPath + (i * SECTOR_SIZE));
-            }
+            disk.readCluster(fileEntry.startCluster, targetPath);
             
             // Resolve target
             PathResult targetRes = resolvePath(string(targetPath));
@@ -2180,9 +2186,7 @@ found:
             uint64_t toRead = std::min((uint64_t)CLUSTER_SIZE, remaining);
             
             char buffer[CLUSTER_SIZE];
-            for (int i=0; i<8; i++) {
-                disk.readSector(c*8 + i, buffer + (i*SECTOR_SIZE));
-            }
+            disk.readCluster(c, buffer);
             cout.write(buffer, toRead);
             remaining -= toRead;
         }
@@ -2215,7 +2219,7 @@ found:
                 for (int j=0; j<SECTOR_SIZE/sizeof(DirEntry); j++) {
                     if (entries[j].type != TYPE_FREE && string(entries[j].name) == res.name) {
                         if (entries[j].type == TYPE_LEVELED_DIR && !recursive) {
-                             VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+                             VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                              for(int k=0; k<8; k++) {
                                  disk.readSector(entries[j].startCluster*8 + k, vps);
                                  for(int l=0; l<SECTOR_SIZE/sizeof(VersionEntry); l++) {
@@ -2251,7 +2255,7 @@ found:
                         
                         if (entries[j].startCluster != 0 && entries[j].type != TYPE_SYMLINK) {
                             if (entries[j].type == TYPE_LEVELED_DIR) {
-                                VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+                                VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
                                 disk.readSector(entries[j].startCluster * 8, vps);
                                 for (int v = 0; v < SECTOR_SIZE/sizeof(VersionEntry); v++) {
                                     if (vps[v].isActive && vps[v].contentTableCluster != 0) {
@@ -2352,7 +2356,7 @@ found_src:
             cout << "Folder '" << folderName << "' not found.\n";
             return;
         }
-        VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+        VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         for (int i=0; i<8; i++) {
              disk.readSector(cluster * 8 + i, vps);
              for(int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -2378,7 +2382,7 @@ found_src:
             cout << "Folder '" << folderName << "' not found.\n";
             return;
         }
-        VersionEntry vps[SECTOR_SIZE/sizeof(VersionEntry)];
+        VersionEntry vps[SECTOR_SIZE / sizeof(VersionEntry) + 1];
         for (int i=0; i<8; i++) {
              disk.readSector(cluster * 8 + i, vps);
              for(int j=0; j<SECTOR_SIZE/sizeof(VersionEntry); j++) {
@@ -2517,9 +2521,7 @@ scan_done:
              memset(buffer, 0, CLUSTER_SIZE);
              memcpy(buffer, data.data() + offset, chunk);
              
-             for (int i=0; i<8; i++) {
-                 disk.writeSector(current*8 + i, buffer + (i*SECTOR_SIZE));
-             }
+             disk.writeCluster(current, buffer);
              
              offset += chunk;
              
@@ -2559,7 +2561,7 @@ scan_done:
         vector<uint64_t> chain = getChain(sb.levelRegistryCluster);
         
         for (uint64_t c : chain) {
-            LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor)];
+            LevelDescriptor registry[SECTOR_SIZE / sizeof(LevelDescriptor) + 1];
             for (int s = 0; s < 8; s++) {
                 disk.readSector(c * 8 + s, registry);
                 for (int j = 0; j < SECTOR_SIZE / sizeof(LevelDescriptor); j++) {
@@ -2603,12 +2605,11 @@ int main(int argc, char** argv) {
         string arg = argv[1];
         if (arg.length() == 1 && isalpha(arg[0])) {
             fs.mount(arg[0]);
-        } else {
-            cout << "Error: Invalid disk '" << arg << "'. This tool only supports physical disks (e.g. 'D'). Image files are not supported.\n";
+        } else if (!fs.mountImage(arg)) {
             return 1;
         }
     } else {
-        cout << "Usage: mount.exe <DriveLetter>\n";
+        cout << "Usage: mount.exe <DriveLetter|ImageFile>\n";
     }
 
     while (true) {
@@ -2629,10 +2630,12 @@ int main(int argc, char** argv) {
             if (cmd == "exit") break;
             if (cmd == "mount") {
                 string arg; ss >> arg;
-                if (arg.length() == 1 && isalpha(arg[0])) {
+                if (arg.empty()) {
+                    cout << "Usage: mount <DriveLetter|ImageFile>\n";
+                } else if (arg.length() == 1 && isalpha(arg[0])) {
                     fs.mount(arg[0]);
                 } else {
-                     cout << "Error: Invalid disk '" << arg << "'. This tool only supports physical disks (e.g. 'D'). Image files are not supported.\n";
+                    fs.mountImage(arg);
                 }
             }
             else if (cmd == "log") {
@@ -2773,17 +2776,20 @@ int main(int argc, char** argv) {
                 cout << "  fsck          - Check filesystem integrity\n";
                 cout << "  fraginfo      - Show fragmentation info\n";
                 cout << "  defrag        - Defragment disk\n";
+                cout << "  iostat        - Show device I/O counters\n";
                 cout << "  exit          - Exit\n";
             }
             else if (cmd == "fsck") fs.fsck();
             else if (cmd == "fraginfo") fs.fragInfo();
             else if (cmd == "defrag") fs.defrag();
+            else if (cmd == "iostat") fs.ioStats();
             else cout << "Unknown command. Type 'help' for list.\n";
         } catch (const exception& e) {
             cout << "Error: " << e.what() << "\n";
         } catch (...) {
             cout << "Unknown error occurred.\n";
         }
+        fs.syncMetadata();
     }
     return 0;
 }
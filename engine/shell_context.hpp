@@ -30,8 +30,7 @@ struct ShellContext {
     Bash::Interpreter interpreter;
     
     // Variables
-    std::map<std::string, std::string> sessionEnv;
-    std::map<std::string, std::vector<std::string>> sessionArrayEnv;
+    ShellVars::VariableStore sessionEnv;  // scalars and arrays, shared with the interpreter
     std::set<std::string> persistentVars;
     std::set<std::string> persistentArrayVars;
     
@@ -105,7 +105,13 @@ inline std::unique_ptr<Continuation> StateReadInput::run(ShellContext& ctx) {
 }
 
 inline std::unique_ptr<Continuation> StateExecute::run(ShellContext& ctx) {
-    execute_command_logic(ctx, inputLine);
+    try {
+        execute_command_logic(ctx, inputLine);
+    } catch (const Bash::ExitException& e) {
+        // exit from a script construct or function ends the session like the exit command
+        ctx.lastExitCode = e.code;
+        ctx.running = false;
+    }
 
     if (!ctx.running) return nullptr;
 
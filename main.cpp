@@ -48,6 +48,11 @@
 #include "input_handler.hpp"
 #include "shell_streams.hpp"
 #include "crash_handler.hpp"
+#include "pipeline.hpp"
+#include "text_stream.hpp"
+#include "cmds-src/grep_engine.hpp"
+#include "cmds-src/work_pool.hpp"
+#include "cmds-src/sort_engine.hpp"
 #include "cmds-src/system_integrator.hpp"
 #include "cmds-src/child_handler.hpp" // Integrated ChildHandler
 
@@ -82,6 +87,16 @@ class ShellLogic {
         "fuzz"
     }; 
 
+    // Built-ins that can run as an in-process pipeline stage (read via in(), write via out())
+    const std::set<std::string> streamingCmds = {
+        "cat", "grep", "head", "tail", "wc", "sort", "uniq", "cut", "tr", "sed", "awk", "rev"
+    };
+
+    // Built-ins that mutate shell state; inside a pipeline they keep running in a child shell
+    const std::set<std::string> stateChangingCmds = {
+        "cd", "export", "alias", "unalias", "source", "read", "exit", "setup", "history"
+    };
+
 
 public:
     ShellLogic(ShellContext& context) : ctx(context) {
@@ -96,12 +111,11 @@ public:
                 FreeSid(adminGroup);
             }
             ctx.isAdmin = (isAdmin == TRUE);
-            ctx.sessionEnv["IS_ADMIN"] = ctx.isAdmin ? "1" : "0";
+            ctx.sessionEnv.set("IS_ADMIN", ctx.isAdmin ? "1" : "0");
         }
 
         // Bind interpreter to shell context variables for shared state
         ctx.interpreter.bindVariables(ctx.sessionEnv);
-        ctx.interpreter.bindArrays(&ctx.sessionArrayEnv);
         // Bind input handler for read command
         ctx.interpreter.bindInputHandler([](std::string prompt, bool isPassword) -> std::string {
             if (!_isatty(_fileno(stdin))) {
@@ -238,6 +252,61 @@ public:
                       << ShellIO::Color::Reset << ShellIO::endl;
     }
 
+    // Output of the pipeline stage bound to this thread, std::cout otherwise
+    std::ostream& out() {
+        Pipeline::StageIO* stage = Pipeline::currentStage;
+        return (stage && stage->out) ? *stage->out : std::cout;
+    }
+
+    // True when an upstream pipeline stage feeds this thread
+    bool hasStageInput() {
+        Pipeline::StageIO* stage = Pipeline::currentStage;
+        return stage && stage->in;
+    }
+
+    // Input of the pipeline stage bound to this thread, std::cin otherwise
+    std::istream& in() {
+        return hasStageInput() ? *Pipeline::currentStage->in : std::cin;
+    }
+
+    // Standard input of a text filter: piped text, the upstream pipeline stage, or stdin
+    TextStream::LineReader openStdInput(const std::string& pipedInput) {
+        if (!pipedInput.empty()) return TextStream::LineReader(std::string_view(pipedInput));
+        if (hasStageInput()) return TextStream::LineReader(in());
+        return TextStream::LineReader(GetStdHandle(STD_INPUT_HANDLE), false);
+    }
+
+    // Pipeline stages keep their own exit code; ctx is shared between stage threads
+    void setExitCode(int code) {
+        if (Pipeline::currentStage) Pipeline::currentStage->exitCode = code;
+        else ctx.lastExitCode = code;
+    }
+
+    // Console colors only make sense when writing straight to the console
+    void setOutColor(WORD attrs) {
+        if (Pipeline::StageIO* stage = Pipeline::currentStage) {
+            if (stage->colors) stage->colors->push_back({ (size_t)stage->out->tellp(), attrs });
+            return;
+        }
+        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), attrs);
+    }
+
+    void runStreamingCommand(const std::vector<std::string>& tokens) {
+        const std::string& cmd = tokens[0];
+        if (cmd == "cat") cmdCat(tokens);
+        else if (cmd == "grep") cmdGrep(tokens);
+        else if (cmd == "head") cmdHead(tokens);
+        else if (cmd == "tail") cmdTail(tokens);
+        else if (cmd == "wc") cmdWc(tokens);
+        else if (cmd == "sort") cmdSort(tokens);
+        else if (cmd == "uniq") cmdUniq(tokens);
+        else if (cmd == "cut") cmdCut(tokens);
+        else if (cmd == "tr") cmdTr(tokens);
+        else if (cmd == "sed") cmdSed(tokens);
+        else if (cmd == "awk") cmdAwk(tokens);
+        else if (cmd == "rev") cmdRev(tokens);
+    }
+
     // Execute a command - handles built-in commands internally or uses CreateProcessA for external
     // Returns exit code, -1 on failure
     int runProcess(const std::string& cmdLine, const std::string& workDir = "", bool wait = true) {
@@ -294,124 +363,251 @@ public:
         return ChildHandler::spawn(cmdLine, dir, wait);
     }
     
-    // Execute a pipeline of commands using real Windows pipes
+    // Resolve the command line used to spawn one pipeline stage as a process.
+    // Built-ins that cannot run in-process re-enter linuxify.exe with -c.
+    std::string buildStageCommandLine(const std::string& command, const std::vector<std::string>& tokens) {
+        const std::string& cmd = tokens[0];
+
+        if (internalCmds.count(cmd)) {
+            char selfPath[MAX_PATH];
+            GetModuleFileNameA(NULL, selfPath, MAX_PATH);
+
+            // Escape quotes
+            std::string escapedCmd;
+            for (char c : command) {
+                if (c == '"') escapedCmd += "\\\"";
+                else escapedCmd += c;
+            }
+            return "\"" + std::string(selfPath) + "\" -c \"" + escapedCmd + "\"";
+        }
+
+        std::string execPath;
+        char exePath[MAX_PATH];
+        GetModuleFileNameA(NULL, exePath, MAX_PATH);
+        fs::path cmdsDir = fs::path(exePath).parent_path() / "cmds";
+        std::vector<std::string> exts = {".exe", ".cmd", ".bat", ""};
+        for (const auto& ext : exts) {
+            fs::path tryPath = cmdsDir / (cmd + ext);
+            if (fs::exists(tryPath)) { execPath = tryPath.string(); break; }
+        }
+        if (execPath.empty()) {
+            std::string regPath = g_registry.getExecutablePath(cmd);
+            if (!regPath.empty() && fs::exists(regPath)) execPath = regPath;
+        }
+        if (execPath.empty()) {
+            std::string resolved = resolvePath(cmd);
+            if (fs::exists(resolved)) execPath = resolved;
+        }
+        if (execPath.empty() && (cmd.find('/') != std::string::npos || cmd.find('\\') != std::string::npos)) {
+            execPath = cmd;
+        }
+        if (execPath.empty()) execPath = cmd;
+
+        std::string cmdLine = "\"" + execPath + "\"";
+        for (size_t j = 1; j < tokens.size(); j++) {
+            cmdLine += " \"" + tokens[j] + "\"";
+        }
+        return cmdLine;
+    }
+
+    // Runs one streaming built-in on a worker thread, wired to its neighbours' channels
+    void runThreadStage(const std::vector<std::string>& tokens, Pipeline::StageIO& stage,
+                        Pipeline::BoundedChannel* input, Pipeline::BoundedChannel* output, HANDLE hFinalOut) {
+        std::unique_ptr<Pipeline::ChannelReadBuf> inBuf;
+        std::unique_ptr<std::istream> inStream;
+        if (input) {
+            inBuf = std::make_unique<Pipeline::ChannelReadBuf>(*input);
+            inStream = std::make_unique<std::istream>(inBuf.get());
+            stage.in = inStream.get();
+        }
+
+        std::unique_ptr<std::streambuf> outBuf;
+        if (output) outBuf = std::make_unique<Pipeline::ChannelWriteBuf>(*output);
+        else outBuf = std::make_unique<Pipeline::HandleWriteBuf>(hFinalOut);
+        std::ostream os(outBuf.get());
+        stage.out = &os;
+
+        {
+            Pipeline::StageScope scope(&stage);
+            try {
+                runStreamingCommand(tokens);
+            } catch (const std::exception& e) {
+                printError(tokens[0] + ": " + e.what());
+                stage.exitCode = 1;
+            } catch (...) {
+                stage.exitCode = 1;
+            }
+        }
+
+        os.flush();
+        stage.out = nullptr;
+        outBuf.reset();
+        if (output) output->closeWrite();
+        // Let the upstream stage stop early instead of filling a channel nobody reads
+        if (input) input->closeRead();
+    }
+
+    // Execute a pipeline of commands.
+    // Streaming built-ins (grep, sort, uniq, ...) run as threads connected by bounded
+    // in-memory channels; a leading built-in runs on this thread with std::cout captured;
+    // only external programs (and built-ins that need a process of their own) are spawned.
     // Returns exit code of last command
     int executePipeline(const std::vector<std::string>& commands, HANDLE hRedirectOut = INVALID_HANDLE_VALUE) {
         if (commands.empty()) return 0;
         if (commands.size() == 1 && hRedirectOut == INVALID_HANDLE_VALUE) {
             return runProcess(commands[0]);
         }
-        
-        // For pipelines, we need to chain processes with real pipes
+
+        enum class StageKind { Thread, Inline, Process };
+
+        const size_t n = commands.size();
+        std::vector<std::vector<std::string>> stageTokens(n);
+        std::vector<StageKind> kinds(n);
+
+        for (size_t i = 0; i < n; i++) {
+            stageTokens[i] = tokenize(commands[i]);
+            if (stageTokens[i].empty()) {
+                printError("syntax error near unexpected token '|'");
+                return 2;
+            }
+            const std::string& cmd = stageTokens[i][0];
+            if (streamingCmds.count(cmd)) {
+                kinds[i] = StageKind::Thread;
+                stageTokens[i] = expandTokens(stageTokens[i]);
+            } else if (i == 0 && internalCmds.count(cmd) && !stateChangingCmds.count(cmd)) {
+                kinds[i] = StageKind::Inline;
+            } else {
+                kinds[i] = StageKind::Process;
+            }
+        }
+
+        // A link needs an in-memory channel whenever one of its ends runs inside the shell
+        std::vector<std::unique_ptr<Pipeline::BoundedChannel>> channels(n - 1);
+        for (size_t i = 0; i + 1 < n; i++) {
+            if (kinds[i] != StageKind::Process || kinds[i + 1] != StageKind::Process) {
+                channels[i] = std::make_unique<Pipeline::BoundedChannel>();
+            }
+        }
+
+        HANDLE hFinalOut = (hRedirectOut != INVALID_HANDLE_VALUE) ? hRedirectOut : GetStdHandle(STD_OUTPUT_HANDLE);
+        std::vector<Pipeline::StageIO> stageIO(n);
+        std::vector<std::thread> workers;
         std::vector<HANDLE> processes;
         std::vector<HANDLE> threads;
+        HANDLE hLastProcess = NULL;
         HANDLE hPrevReadPipe = NULL;
 
         // Restore console mode for the pipeline
         SignalHandler::InputDispatcher::getInstance().restore();
-        
-        for (size_t i = 0; i < commands.size(); i++) {
-            SECURITY_ATTRIBUTES saAttr;
-            saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-            saAttr.bInheritHandle = TRUE;
-            saAttr.lpSecurityDescriptor = NULL;
-            
-            HANDLE hReadPipe = NULL, hWritePipe = NULL;
-            
-            // Create pipe for output (except for last command)
-            if (i < commands.size() - 1) {
-                if (!CreatePipe(&hReadPipe, &hWritePipe, &saAttr, 0)) {
-                    SignalHandler::InputDispatcher::getInstance().init();
-                    return -1;
-                }
-            }
-            // For the last command, if we have a redirection handle, use it
-            else if (hRedirectOut != INVALID_HANDLE_VALUE) {
-                 hWritePipe = hRedirectOut;
-                 // Don't close hRedirectOut in the loop!
+
+        SECURITY_ATTRIBUTES saAttr;
+        saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+        saAttr.bInheritHandle = TRUE;
+        saAttr.lpSecurityDescriptor = NULL;
+
+        for (size_t i = 0; i < n; i++) {
+            bool isLast = (i == n - 1);
+            Pipeline::BoundedChannel* input = (i > 0) ? channels[i - 1].get() : nullptr;
+            Pipeline::BoundedChannel* output = isLast ? nullptr : channels[i].get();
+
+            if (kinds[i] == StageKind::Thread) {
+                workers.emplace_back([this, i, &stageTokens, &stageIO, input, output, hFinalOut]() {
+                    runThreadStage(stageTokens[i], stageIO[i], input, output, hFinalOut);
+                });
+                continue;
             }
-            
-            // Tokenize command to find executable
-            std::vector<std::string> tokens = tokenize(commands[i]);
-            if (tokens.empty()) continue;
-            
-            std::string cmd = tokens[0];
-            std::string cmdLine;
-            
-            if (internalCmds.count(cmd)) {
-                 // Internal command: spawn self with -c
-                 char selfPath[MAX_PATH];
-                 GetModuleFileNameA(NULL, selfPath, MAX_PATH);
-                 
-                 // Escape quotes
-                 std::string escapedCmd;
-                 for (char c : commands[i]) {
-                     if (c == '"') escapedCmd += "\\\"";
-                     else escapedCmd += c;
-                 }
-                 
-                 cmdLine = "\"" + std::string(selfPath) + "\" -c \"" + escapedCmd + "\"";
-            } else {
-                std::string execPath;
-                char exePath[MAX_PATH];
-                GetModuleFileNameA(NULL, exePath, MAX_PATH);
-                fs::path cmdsDir = fs::path(exePath).parent_path() / "cmds";
-                std::vector<std::string> exts = {".exe", ".cmd", ".bat", ""};
-                for (const auto& ext : exts) {
-                    fs::path tryPath = cmdsDir / (cmd + ext);
-                    if (fs::exists(tryPath)) { execPath = tryPath.string(); break; }
-                }
-                if (execPath.empty()) {
-                    std::string regPath = g_registry.getExecutablePath(cmd);
-                    if (!regPath.empty() && fs::exists(regPath)) execPath = regPath;
-                }
-                if (execPath.empty()) {
-                    std::string resolved = resolvePath(cmd);
-                    if (fs::exists(resolved)) execPath = resolved;
-                }
-                if (execPath.empty() && (cmd.find('/') != std::string::npos || cmd.find('\\') != std::string::npos)) {
-                    execPath = cmd;
+            if (kinds[i] == StageKind::Inline) continue; // Started below, once all consumers exist
+
+            // External process (or a built-in that must not share the shell's state)
+            HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
+            HANDLE hOut = hFinalOut;
+            HANDLE hPumpRead = NULL;
+            HANDLE hNextRead = NULL;
+
+            if (input) {
+                HANDLE hRead = NULL, hWrite = NULL;
+                if (CreatePipe(&hRead, &hWrite, &saAttr, 0)) {
+                    SetHandleInformation(hWrite, HANDLE_FLAG_INHERIT, 0);
+                    hIn = hRead;
+                    workers.emplace_back(Pipeline::pumpChannelToHandle, std::ref(*input), hWrite);
+                } else {
+                    input->closeRead();
+                    hIn = NULL;
                 }
-                if (execPath.empty()) execPath = cmd;
-                
-                cmdLine = "\"" + execPath + "\"";
-                for (size_t j = 1; j < tokens.size(); j++) {
-                    cmdLine += " \"" + tokens[j] + "\"";
+            } else if (i > 0) {
+                hIn = hPrevReadPipe;
+            }
+
+            if (!isLast) {
+                HANDLE hRead = NULL, hWrite = NULL;
+                if (CreatePipe(&hRead, &hWrite, &saAttr, 0)) {
+                    SetHandleInformation(hRead, HANDLE_FLAG_INHERIT, 0);
+                    hOut = hWrite;
+                    if (output) hPumpRead = hRead;
+                    else hNextRead = hRead;
+                } else {
+                    hOut = NULL;
+                    if (output) output->closeWrite();
                 }
             }
-            
-            // Setup process
+
+            std::string cmdLine = buildStageCommandLine(commands[i], stageTokens[i]);
+
             STARTUPINFOA si;
             PROCESS_INFORMATION pi;
             ZeroMemory(&si, sizeof(si));
             si.cb = sizeof(si);
             si.dwFlags = STARTF_USESTDHANDLES;
-            
-            si.hStdInput = (hPrevReadPipe) ? hPrevReadPipe : GetStdHandle(STD_INPUT_HANDLE);
-            si.hStdOutput = (hWritePipe) ? hWritePipe : GetStdHandle(STD_OUTPUT_HANDLE);
+            si.hStdInput = hIn;
+            si.hStdOutput = hOut;
             si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-            
             ZeroMemory(&pi, sizeof(pi));
-            
+
             std::vector<char> cmdBuffer(cmdLine.length() + 1);
             strcpy(cmdBuffer.data(), cmdLine.c_str());
-            
+
             if (CreateProcessA(NULL, cmdBuffer.data(), NULL, NULL, TRUE, 0, NULL,
                                ctx.currentDir.c_str(), &si, &pi)) {
                 processes.push_back(pi.hProcess);
                 threads.push_back(pi.hThread);
+                if (isLast) hLastProcess = pi.hProcess;
+            } else {
+                printError(stageTokens[i][0] + ": command not found");
             }
-            
-            if (hWritePipe && hWritePipe != hRedirectOut) CloseHandle(hWritePipe);
-            if (hPrevReadPipe) CloseHandle(hPrevReadPipe);
-            hPrevReadPipe = hReadPipe;
+
+            // Close the child's ends; our ends now see EOF / broken pipe when it exits
+            if (i > 0 && hIn) CloseHandle(hIn);
+            if (!isLast && hOut) CloseHandle(hOut);
+            if (hPumpRead) workers.emplace_back(Pipeline::pumpHandleToChannel, hPumpRead, std::ref(*output));
+            hPrevReadPipe = hNextRead;
         }
-        
+
+        // A leading built-in produces on this thread, with std::cout captured into the first link
+        if (kinds[0] == StageKind::Inline) {
+            Pipeline::BoundedChannel* output = (n > 1) ? channels[0].get() : nullptr;
+            std::unique_ptr<std::streambuf> outBuf;
+            if (output) outBuf = std::make_unique<Pipeline::ChannelWriteBuf>(*output);
+            else outBuf = std::make_unique<Pipeline::HandleWriteBuf>(hFinalOut);
+
+            std::streambuf* oldCout = std::cout.rdbuf(outBuf.get());
+            try {
+                executeCommand(stageTokens[0]);
+            } catch (...) {}
+            std::cout.flush();
+            std::cout.rdbuf(oldCout);
+            std::cout.clear();
+            outBuf.reset();
+            if (output) output->closeWrite();
+            stageIO[0].exitCode = ctx.lastExitCode;
+        }
+
+        for (auto& worker : workers) worker.join();
+
         // Wait for all processes
         int exitCode = 0;
         for (size_t i = 0; i < processes.size(); i++) {
             WaitForSingleObject(processes[i], INFINITE);
-            if (i == processes.size() - 1) {
+            if (processes[i] == hLastProcess) {
                 DWORD code;
                 GetExitCodeProcess(processes[i], &code);
                 exitCode = (int)code;
@@ -419,10 +615,15 @@ public:
             CloseHandle(processes[i]);
             CloseHandle(threads[i]);
         }
+        if (kinds[n - 1] != StageKind::Process) {
+            exitCode = stageIO[n - 1].exitCode;
+        } else if (!hLastProcess) {
+            exitCode = 127;
+        }
 
         // Restore raw mode
         SignalHandler::InputDispatcher::getInstance().init();
-        
+
         return exitCode;
     }
     
@@ -996,6 +1197,10 @@ public:
     }
 
     void cmdCat(const std::vector<std::string>& args) {
+        if (args.size() < 2 && hasStageInput()) {
+            out() << in().rdbuf();
+            return;
+        }
         if (args.size() < 2) {
             printError("cat: missing operand");
             return;
@@ -1012,9 +1217,6 @@ public:
             }
         }
 
-        constexpr size_t BUFFER_SIZE = 65536; 
-        std::vector<char> buffer(BUFFER_SIZE);
-
         for (const auto& file : files) {
             try {
                 std::string fullPath = resolvePath(file);
@@ -1029,41 +1231,40 @@ public:
                     continue;
                 }
 
-                std::ifstream ifs(fullPath, std::ios::binary);
-                if (!ifs) {
+                // Regular files are mapped, so chunks are views over the page cache
+                TextStream::LineReader reader = TextStream::LineReader::openFile(fullPath);
+                if (!reader.isOpen()) {
                     printError("cat: " + file + ": Cannot open file");
                     continue;
                 }
 
+                std::string_view chunk;
                 if (!showNumbers) {
-                    while (ifs.read(buffer.data(), BUFFER_SIZE) || ifs.gcount() > 0) {
-                        std::cout.write(buffer.data(), ifs.gcount());
-                        if (!ifs) break; 
+                    while (reader.nextChunk(chunk)) {
+                        out().write(chunk.data(), (std::streamsize)chunk.size());
                     }
-                    std::cout.flush();
+                    out().flush();
                 } else {
                     long long lineNum = 1;
                     bool newLine = true; 
 
-                    while (ifs.read(buffer.data(), BUFFER_SIZE) || ifs.gcount() > 0) {
-                        std::streamsize count = ifs.gcount();
-                        for (std::streamsize i = 0; i < count; ++i) {
+                    while (reader.nextChunk(chunk)) {
+                        size_t pos = 0;
+                        while (pos < chunk.size()) {
                             if (newLine) {
-                                std::cout << std::setw(6) << lineNum << "  ";
+                                out() << std::setw(6) << lineNum << "  ";
                                 lineNum++;
                                 newLine = false;
                             }
-                            char c = buffer[i];
-                            std::cout.put(c);
-                            if (c == '\n') {
-                                newLine = true;
-                            }
+                            const char* nl = (const char*)std::memchr(chunk.data() + pos, '\n', chunk.size() - pos);
+                            size_t end = nl ? (size_t)(nl - chunk.data()) + 1 : chunk.size();
+                            out().write(chunk.data() + pos, (std::streamsize)(end - pos));
+                            if (nl) newLine = true;
+                            pos = end;
                         }
-                        if (!ifs) break;
                     }
-                    if (newLine && lineNum > 1) { 
-                    } else if (!newLine) {
-                        std::cout << std::endl; 
+                    if (!newLine) {
+                        out() << std::endl; 
                     }
                 }
             } catch (const std::exception& e) {
@@ -1463,10 +1664,10 @@ public:
                     }
                 }
                 
-                ctx.sessionArrayEnv[arrName] = arr;
+                ctx.sessionEnv.setArray(arrName, arr);
                 ctx.persistentArrayVars.insert(arrName);
             } else {
-                ctx.sessionEnv[name] = value;
+                ctx.sessionEnv.set(name, value);
                 ctx.persistentVars.insert(name);
                 SetEnvironmentVariableA(name.c_str(), value.c_str());
             }
@@ -1481,19 +1682,19 @@ public:
         file << "# Format: VAR=value or ARR[]={val1,val2,val3}\n\n";
         
         for (const auto& varName : ctx.persistentVars) {
-            auto it = ctx.sessionEnv.find(varName);
-            if (it != ctx.sessionEnv.end()) {
-                file << it->first << "=" << it->second << "\n";
+            const std::string* found = ctx.sessionEnv.get(varName);
+            if (found) {
+                file << varName << "=" << *found << "\n";
             }
         }
         
         for (const auto& arrName : ctx.persistentArrayVars) {
-            auto it = ctx.sessionArrayEnv.find(arrName);
-            if (it != ctx.sessionArrayEnv.end()) {
-                file << it->first << "[]={";
-                for (size_t i = 0; i < it->second.size(); ++i) {
+            const std::vector<std::string>* found = ctx.sessionEnv.getArray(arrName);
+            if (found) {
+                file << arrName << "[]={";
+                for (size_t i = 0; i < found->size(); ++i) {
                     if (i > 0) file << ",";
-                    file << it->second[i];
+                    file << (*found)[i];
                 }
                 file << "}\n";
             }
@@ -1529,12 +1730,12 @@ public:
                     if (bracket != std::string::npos && inner.back() == ']') {
                         std::string arrName = inner.substr(0, bracket);
                         std::string idxStr = inner.substr(bracket + 1, inner.size() - bracket - 2);
-                        auto it = ctx.sessionArrayEnv.find(arrName);
-                        if (it != ctx.sessionArrayEnv.end()) {
+                        const std::vector<std::string>* found = ctx.sessionEnv.getArray(arrName);
+                        if (found) {
                             try {
                                 size_t idx = std::stoul(idxStr);
-                                if (idx < it->second.size()) {
-                                    value = it->second[idx];
+                                if (idx < found->size()) {
+                                    value = (*found)[idx];
                                 }
                             } catch (...) {}
                         }
@@ -1543,9 +1744,9 @@ public:
                     else if (inner.find(' ') == std::string::npos && 
                              inner.find('\t') == std::string::npos) {
                         // First try as variable
-                        auto it = ctx.sessionEnv.find(inner);
-                        if (it != ctx.sessionEnv.end()) {
-                            value = it->second;
+                        const std::string* found = ctx.sessionEnv.get(inner);
+                        if (found) {
+                            value = *found;
                         } else {
                             char* envVal = nullptr;
                             size_t len;
@@ -1604,9 +1805,9 @@ public:
                 if (close != std::string::npos) {
                     std::string varName = text.substr(end + 1, close - end - 1);
                     std::string value;
-                    auto it = ctx.sessionEnv.find(varName);
-                    if (it != ctx.sessionEnv.end()) {
-                        value = it->second;
+                    const std::string* found = ctx.sessionEnv.get(varName);
+                    if (found) {
+                        value = *found;
                     } else {
                         char* envVal = nullptr;
                         size_t len;
@@ -1629,12 +1830,12 @@ public:
                         std::string idxStr = text.substr(end + 1, closeBracket - end - 1);
                         std::string val;
                         
-                        auto it = ctx.sessionArrayEnv.find(varName);
-                        if (it != ctx.sessionArrayEnv.end()) {
+                        const std::vector<std::string>* found = ctx.sessionEnv.getArray(varName);
+                        if (found) {
                             try {
                                 size_t idx = std::stoul(idxStr);
-                                if (idx < it->second.size()) {
-                                    val = it->second[idx];
+                                if (idx < found->size()) {
+                                    val = (*found)[idx];
                                 }
                             } catch (...) {}
                         }
@@ -1646,9 +1847,9 @@ public:
 
                 std::string varName = text.substr(pos + 1, end - pos - 1);
                 std::string value;
-                auto it = ctx.sessionEnv.find(varName);
-                if (it != ctx.sessionEnv.end()) {
-                    value = it->second;
+                const std::string* found = ctx.sessionEnv.get(varName);
+                if (found) {
+                    value = *found;
                 } else {
                     char* envVal = nullptr;
                     size_t len;
@@ -1801,19 +2002,19 @@ public:
                         if (bracket != std::string::npos && inner.back() == ']') {
                             std::string arrName = inner.substr(0, bracket);
                             std::string idxStr = inner.substr(bracket + 1, inner.size() - bracket - 2);
-                            auto it = ctx.sessionArrayEnv.find(arrName);
-                            if (it != ctx.sessionArrayEnv.end()) {
+                            const std::vector<std::string>* found = ctx.sessionEnv.getArray(arrName);
+                            if (found) {
                                 try {
                                     size_t idx = std::stoul(idxStr);
-                                    if (idx < it->second.size()) {
-                                        value = it->second[idx];
+                                    if (idx < found->size()) {
+                                        value = (*found)[idx];
                                     }
                                 } catch (...) {}
                             }
                         } else {
-                            auto it = ctx.sessionEnv.find(inner);
-                            if (it != ctx.sessionEnv.end()) {
-                                value = it->second;
+                            const std::string* found = ctx.sessionEnv.get(inner);
+                            if (found) {
+                                value = *found;
                             } else {
                                 char* envVal = nullptr;
                                 size_t len;
@@ -1829,9 +2030,9 @@ public:
                     if (close != std::string::npos) {
                         std::string varName = text.substr(end + 1, close - end - 1);
                         std::string value;
-                        auto it = ctx.sessionEnv.find(varName);
-                        if (it != ctx.sessionEnv.end()) {
-                            value = it->second;
+                        const std::string* found = ctx.sessionEnv.get(varName);
+                        if (found) {
+                            value = *found;
                         } else {
                             char* envVal = nullptr;
                             size_t len;
@@ -1847,9 +2048,9 @@ public:
                     }
                     std::string varName = text.substr(pos + 1, end - pos - 1);
                     std::string value;
-                    auto it = ctx.sessionEnv.find(varName);
-                    if (it != ctx.sessionEnv.end()) {
-                        value = it->second;
+                    const std::string* found = ctx.sessionEnv.get(varName);
+                    if (found) {
+                        value = *found;
                     } else {
                         char* envVal = nullptr;
                         size_t len;
@@ -1880,9 +2081,9 @@ public:
             std::string varName = args[1];
             
             // Check session env first
-            auto it = ctx.sessionEnv.find(varName);
-            if (it != ctx.sessionEnv.end()) {
-                std::cout << it->second << std::endl;
+            const std::string* found = ctx.sessionEnv.get(varName);
+            if (found) {
+                std::cout << *found << std::endl;
                 return;
             }
             
@@ -1904,7 +2105,7 @@ public:
             SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
             std::cout << "# Session Variables:\n";
             SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
-            for (const auto& pair : ctx.sessionEnv) {
+            for (const auto& pair : ctx.sessionEnv.entries()) {
                 std::cout << pair.first << "=" << pair.second << std::endl;
             }
             std::cout << std::endl;
@@ -1924,11 +2125,11 @@ public:
 
     void cmdExport(const std::vector<std::string>& args) {
         if (args.size() < 2) {
-            for (const auto& pair : ctx.sessionEnv) {
+            for (const auto& pair : ctx.sessionEnv.entries()) {
                 bool isPersistent = ctx.persistentVars.find(pair.first) != ctx.persistentVars.end();
                 std::cout << "export " << (isPersistent ? "-p " : "") << pair.first << "=\"" << pair.second << "\"" << std::endl;
             }
-            for (const auto& pair : ctx.sessionArrayEnv) {
+            for (const auto& pair : ctx.sessionEnv.arrayEntries()) {
                 bool isPersistent = ctx.persistentArrayVars.find(pair.first) != ctx.persistentArrayVars.end();
                 std::cout << "export " << (isPersistent ? "-p " : "") << "-arr " << pair.first << "={";
                 for (size_t i = 0; i < pair.second.size(); ++i) {
@@ -1997,14 +2198,14 @@ public:
                     continue;
                 }
                 
-                ctx.sessionArrayEnv[name] = arr;
+                ctx.sessionEnv.setArray(name, arr);
                 if (persistent) {
                     ctx.persistentArrayVars.insert(name);
                     savePersistentVars();
                 }
                 printSuccess("Exported array: " + name + " (" + std::to_string(arr.size()) + " elements)" + (persistent ? " [persistent]" : ""));
             } else {
-                ctx.sessionEnv[name] = value;
+                ctx.sessionEnv.set(name, value);
                 SetEnvironmentVariableA(name.c_str(), value.c_str());
                 if (persistent) {
                     ctx.persistentVars.insert(name);
@@ -2422,6 +2623,146 @@ public:
         return false;
     }
 
+    // What `grep -r` leaves out of a directory tree; each can be turned off from the command line
+    struct GrepTreeFilter {
+        bool skipBinary = true;       // a NUL byte in the first 4 KB; -a / --text scans them
+        bool skipVcsDirs = true;      // .git .lvc .svn .hg; --no-ignore-vcs descends into them
+        bool followSymlinks = false;  // -R follows symlinked directories, -r does not
+    };
+
+    // `grep -r`: the tree is walked on the calling thread in sorted directory order and every
+    // file is scanned on a work-stealing pool into its own buffer. A buffer is written out once
+    // every file before it in walk order is done, so the output is the same for any thread
+    // count and matches from different files never interleave. At most a few files per
+    // worker are pending at once; a slow file holds up the walker rather than letting later
+    // results pile up behind it. Colors set while scanning are recorded in the buffer and
+    // replayed when it reaches the console.
+    template <typename ScanFn>
+    int grepTree(const std::string& root, const std::string& pattern, bool ignoreCase, bool useRegex,
+                 size_t threadCount, const GrepTreeFilter& filter, ScanFn scan) {
+        static const std::set<std::string> vcsDirs = {".git", ".lvc", ".svn", ".hg"};
+
+        struct Slot {
+            std::string text;
+            std::vector<std::pair<size_t, WORD>> colors;
+            bool done = false;
+        };
+
+        std::ostream& sink = out();
+        bool toConsole = Pipeline::currentStage == nullptr;
+        std::mutex sinkMutex;
+        std::deque<Slot> slots;  // files not yet written out, in walk order; guarded by sinkMutex
+        std::condition_variable slotFreed;
+        std::atomic<int> totalMatches{0};
+        WorkPool::WorkStealingPool pool(threadCount);
+        const size_t maxPending = 16 * pool.size();
+
+        // The lazy DFA cache is per-matcher state, so every worker gets its own matcher
+        std::vector<std::unique_ptr<GrepEngine::Matcher>> matchers(pool.size());
+        for (auto& m : matchers) m = std::make_unique<GrepEngine::Matcher>(pattern, ignoreCase, useRegex);
+
+        // Called with sinkMutex held
+        auto emitReady = [&] {
+            if (!slots.empty() && slots.front().done) slotFreed.notify_one();
+            while (!slots.empty() && slots.front().done) {
+                Slot& slot = slots.front();
+                size_t pos = 0;
+                for (const auto& [offset, attrs] : slot.colors) {
+                    sink.write(slot.text.data() + pos, (std::streamsize)(offset - pos));
+                    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), attrs);
+                    pos = offset;
+                }
+                sink.write(slot.text.data() + pos, (std::streamsize)(slot.text.size() - pos));
+                slots.pop_front();
+            }
+        };
+
+        auto scanReader = [&](TextStream::LineReader& reader, const std::string& path, Slot& slot) {
+            std::ostringstream buffer;
+            Pipeline::StageIO io;
+            io.out = &buffer;
+            if (toConsole) io.colors = &slot.colors;
+            {
+                Pipeline::StageScope scope(&io);
+                totalMatches += scan(reader, path, *matchers[pool.currentWorker()]);
+            }
+            slot.text = buffer.str();
+        };
+
+        auto scanFile = [&](const std::string& path, Slot& slot) {
+            // Sniff the first block: a NUL byte means binary, skip before scanning any lines
+            TextStream::MappedFile mapped(path);
+            if (mapped.isOpen()) {
+                std::string_view data = mapped.view();
+                if (filter.skipBinary &&
+                    std::memchr(data.data(), '\0', (std::min)(data.size(), (size_t)4096)) != nullptr) return;
+                TextStream::LineReader reader(data);
+                scanReader(reader, path, slot);
+                return;
+            }
+
+            HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (h == INVALID_HANDLE_VALUE) return;
+            if (filter.skipBinary) {
+                char probe[4096];
+                DWORD got = 0;
+                if (!ReadFile(h, probe, sizeof(probe), &got, NULL) || std::memchr(probe, '\0', got) != nullptr) {
+                    CloseHandle(h);
+                    return;
+                }
+                SetFilePointer(h, 0, NULL, FILE_BEGIN);
+            }
+            TextStream::LineReader reader(h, true);
+            scanReader(reader, path, slot);
+        };
+
+        // Directories already entered, so following symlinks cannot loop
+        std::set<fs::path> visited;
+        std::function<void(const fs::path&)> walk = [&](const fs::path& dir) {
+            std::error_code ec;
+            if (filter.followSymlinks) {
+                fs::path real = fs::canonical(dir, ec);
+                if (ec || !visited.insert(real).second) return;
+            }
+
+            std::vector<fs::directory_entry> entries;
+            fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end;
+            for (; !ec && it != end; it.increment(ec)) entries.push_back(*it);
+            std::sort(entries.begin(), entries.end(),
+                      [](const fs::directory_entry& a, const fs::directory_entry& b) { return a.path() < b.path(); });
+
+            for (const auto& entry : entries) {
+                std::error_code typeEc;
+                if (entry.is_directory(typeEc)) {
+                    if (!filter.followSymlinks && entry.is_symlink(typeEc)) continue;
+                    if (filter.skipVcsDirs && vcsDirs.count(entry.path().filename().string())) continue;
+                    walk(entry.path());
+                } else if (entry.is_regular_file(typeEc)) {
+                    Slot* slot;
+                    {
+                        std::unique_lock<std::mutex> lock(sinkMutex);
+                        slotFreed.wait(lock, [&] { return slots.size() < maxPending; });
+                        slots.emplace_back();
+                        slot = &slots.back();  // deque::emplace_back keeps element addresses stable
+                    }
+                    std::string path = entry.path().string();
+                    pool.submit([&, path, slot] {
+                        scanFile(path, *slot);
+                        std::lock_guard<std::mutex> lock(sinkMutex);
+                        slot->done = true;
+                        emitReady();
+                    });
+                }
+            }
+        };
+
+        walk(fs::path(root));
+        pool.wait();
+        sink.flush();
+        return totalMatches.load();
+    }
+
     // grep - search for pattern in file or input using buffered reading and regex
     void cmdGrep(const std::vector<std::string>& args, const std::string& pipedInput = "") {
 
@@ -2429,7 +2770,7 @@ public:
 
         if (args.size() < 2) {
             printError("grep: missing pattern");
-            std::cout << "Usage: grep [OPTIONS] PATTERN [FILE...]" << std::endl;
+            out() << "Usage: grep [OPTIONS] PATTERN [FILE...]" << std::endl;
             return;
         }
 
@@ -2442,6 +2783,8 @@ public:
              bool useRegex = false;
              bool showFilename = false; // Implicit if multiple files
              int context = 0;
+             size_t threads = WorkPool::defaultThreadCount(); // -r scanners
+             GrepTreeFilter tree;
         } opts;
 
         std::string pattern;
@@ -2459,12 +2802,17 @@ public:
                  else if (arg == "-n" || arg == "--line-number") opts.lineNumbers = true;
                  else if (arg == "-v" || arg == "--invert-match") opts.invertMatch = true;
                  else if (arg == "-c" || arg == "--count") opts.countOnly = true;
-                 else if (arg == "-r" || arg == "-R" || arg == "--recursive") opts.recursive = true;
+                 else if (arg == "-r" || arg == "--recursive") opts.recursive = true;
+                 else if (arg == "-R" || arg == "--dereference-recursive") { opts.recursive = true; opts.tree.followSymlinks = true; }
+                 else if (arg == "-a" || arg == "--text") opts.tree.skipBinary = false;
+                 else if (arg == "--no-ignore-vcs") opts.tree.skipVcsDirs = false;
                  else if (arg == "-E" || arg == "--extended-regexp") opts.useRegex = true;
                  else if (arg == "-h" || arg == "--no-filename") opts.showFilename = false;
                  else if (arg == "-H" || arg == "--with-filename") opts.showFilename = true;
                  else if (arg.rfind("-C", 0) == 0 && arg.length() > 2) opts.context = std::stoi(arg.substr(2));
                  else if (arg == "-C" && argIdx + 1 < args.size()) opts.context = std::stoi(args[++argIdx]);
+                 else if (arg.rfind("--threads=", 0) == 0) opts.threads = (size_t)(std::max)(1, std::stoi(arg.substr(10)));
+                 else if (arg == "--threads" && argIdx + 1 < args.size()) opts.threads = (size_t)(std::max)(1, std::stoi(args[++argIdx]));
                  else if (pattern.empty()) pattern = arg; // Handle negative pattern?? No, usually flags first
             }
         }
@@ -2480,39 +2828,24 @@ public:
         if (opts.recursive) multipleFiles = true;
         int totalMatches = 0;
 
-        std::regex regexPattern;
+        std::unique_ptr<GrepEngine::Matcher> matcher;
         try {
-            if (opts.useRegex) {
-                regexPattern = std::regex(pattern, opts.ignoreCase ? std::regex::icase : std::regex::ECMAScript);
-            }
+            matcher = std::make_unique<GrepEngine::Matcher>(pattern, opts.ignoreCase, opts.useRegex);
         } catch (...) {
             printError("grep: invalid regular expression");
             return;
         }
 
-        auto performGrep = [&](std::istream& is, const std::string& filename) {
-             std::string line;
+        auto performGrep = [&](TextStream::LineReader& reader, const std::string& filename, GrepEngine::Matcher& matcher) {
+             std::string_view line;
              int lineNum = 0;
              int matches = 0;
              std::deque<std::string> contextBuffer; // For leading context
              int contextCountdown = 0; // For trailing context
 
-             while (std::getline(is, line)) {
+             while (reader.nextLine(line)) {
                  lineNum++;
-                 bool found = false;
-                 std::smatch sm;
-
-                 if (opts.useRegex) {
-                     found = std::regex_search(line, sm, regexPattern);
-                 } else {
-                     std::string searchLine = line;
-                     std::string searchPat = pattern;
-                     if (opts.ignoreCase) {
-                         std::transform(searchLine.begin(), searchLine.end(), searchLine.begin(), ::tolower);
-                         std::transform(searchPat.begin(), searchPat.end(), searchPat.begin(), ::tolower);
-                     }
-                     found = searchLine.find(searchPat) != std::string::npos;
-                 }
+                 bool found = matcher.matches(line);
 
                  if (opts.invertMatch) found = !found;
 
@@ -2524,9 +2857,9 @@ public:
                      if (opts.context > 0 && !contextBuffer.empty()) {
                           int cLine = lineNum - (int)contextBuffer.size();
                           for (const auto& cL : contextBuffer) {
-                              if (multipleFiles || opts.showFilename) std::cout << filename << "-";
-                              if (opts.lineNumbers) std::cout << cLine << "-";
-                              std::cout << cL << std::endl;
+                              if (multipleFiles || opts.showFilename) out() << filename << "-";
+                              if (opts.lineNumbers) out() << cLine << "-";
+                              out() << cL << std::endl;
                               cLine++;
                           }
                           contextBuffer.clear();
@@ -2534,94 +2867,77 @@ public:
 
                      // Print Match
                      if (multipleFiles || opts.showFilename) {
-                         SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_BLUE | FOREGROUND_INTENSITY);
-                         std::cout << filename << ":";
-                         SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+                         setOutColor(FOREGROUND_RED | FOREGROUND_BLUE | FOREGROUND_INTENSITY);
+                         out() << filename << ":";
+                         setOutColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
                      }
                      if (opts.lineNumbers) {
-                         SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_GREEN | FOREGROUND_INTENSITY);
-                         std::cout << lineNum << ":";
-                         SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+                         setOutColor(FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+                         out() << lineNum << ":";
+                         setOutColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
                      }
 
-                     // Highlight Pattern if not inverted
-                     if (!opts.invertMatch && !opts.useRegex) {
-                         // Basic highlight
-                         size_t pos = 0;
-                         std::string temp = line;
-                         std::string searchTemp = temp;
-                         if (opts.ignoreCase) std::transform(searchTemp.begin(), searchTemp.end(), searchTemp.begin(), ::tolower);
-                         std::string searchPat = pattern;
-                         if (opts.ignoreCase) std::transform(searchPat.begin(), searchPat.end(), searchPat.begin(), ::tolower);
-
-                         while ((pos = searchTemp.find(searchPat)) != std::string::npos) {
-                             std::cout << temp.substr(0, pos);
-                             SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_INTENSITY);
-                             std::cout << temp.substr(pos, pattern.length());
-                             SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
-                             temp = temp.substr(pos + pattern.length());
-                             searchTemp = searchTemp.substr(pos + searchPat.length());
+                     // Highlight every match if not inverted
+                     if (!opts.invertMatch) {
+                         size_t pos = 0, matchPos = 0, matchLen = 0;
+                         while (pos < line.size() && matcher.find(line, pos, matchPos, matchLen) && matchLen > 0) {
+                             out() << line.substr(pos, matchPos - pos);
+                             setOutColor(FOREGROUND_RED | FOREGROUND_INTENSITY);
+                             out() << line.substr(matchPos, matchLen);
+                             setOutColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+                             pos = matchPos + matchLen;
                          }
-                         std::cout << temp << std::endl;
+                         out() << line.substr(pos) << std::endl;
                      } else {
-                         std::cout << line << std::endl;
+                         out() << line << std::endl;
                      }
                      
                      contextCountdown = opts.context;
                  } else {
                      // Not found
                      if (contextCountdown > 0 && !opts.countOnly) {
-                         if (multipleFiles || opts.showFilename) std::cout << filename << "-";
-                         if (opts.lineNumbers) std::cout << lineNum << "-";
-                         std::cout << line << std::endl;
+                         if (multipleFiles || opts.showFilename) out() << filename << "-";
+                         if (opts.lineNumbers) out() << lineNum << "-";
+                         out() << line << std::endl;
                          contextCountdown--;
                      } else if (opts.context > 0) {
-                         contextBuffer.push_back(line);
+                         contextBuffer.emplace_back(line);
                          if (contextBuffer.size() > (size_t)opts.context) contextBuffer.pop_front();
                      }
                  }
              }
 
              if (opts.countOnly) {
-                 if (multipleFiles || opts.showFilename) std::cout << filename << ":";
-                 std::cout << matches << std::endl;
+                 if (multipleFiles || opts.showFilename) out() << filename << ":";
+                 out() << matches << std::endl;
              }
              return matches;
         };
 
         if (files.empty()) {
-            if (!pipedInput.empty()) {
-                std::istringstream iss(pipedInput);
-                totalMatches += performGrep(iss, "(standard input)");
-            } else {
-                // If no piped input string, try reading from stdin
-                // This handles 'linuxify -c' pipeline cases
-                totalMatches += performGrep(std::cin, "(standard input)");
-            }
+            // Piped text, upstream pipeline stage, or stdin ('linuxify -c' pipeline cases)
+            TextStream::LineReader reader = openStdInput(pipedInput);
+            totalMatches += performGrep(reader, "(standard input)", *matcher);
         } else {
             for (const auto& file : files) {
                 if (opts.recursive && fs::is_directory(file)) {
-                     try {
-                         for (const auto& entry : fs::recursive_directory_iterator(file)) {
-                             if (entry.is_regular_file()) {
-                                 std::ifstream ifs(entry.path());
-                                 if (ifs) totalMatches += performGrep(ifs, entry.path().string());
-                             }
-                         }
-                     } catch (...) {}
+                     totalMatches += grepTree(file, pattern, opts.ignoreCase, opts.useRegex, opts.threads, opts.tree,
+                         [&](TextStream::LineReader& reader, const std::string& filename, GrepEngine::Matcher& m) {
+                             return performGrep(reader, filename, m);
+                         });
                 } else {
-                     std::ifstream ifs(resolvePath(file));
-                     if (!ifs) {
+                     TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(file));
+                     if (!reader.isOpen()) {
                          if (!opts.recursive) printError("grep: " + file + ": No such file or directory");
-                         ctx.lastExitCode = 2;
+                         setExitCode(2);
                      } else {
-                         totalMatches += performGrep(ifs, file);
+                         totalMatches += performGrep(reader, file, *matcher);
                      }
                 }
             }
         }
         
-        ctx.lastExitCode = (totalMatches > 0) ? 0 : 1;
+        setExitCode((totalMatches > 0) ? 0 : 1);
     }
 
     // head - output first part of files
@@ -2642,44 +2958,45 @@ public:
             else files.push_back(arg);
         }
 
-        auto process = [&](std::istream& is, const std::string& name, bool showHeader) {
+        // Stops pulling input as soon as enough lines/bytes have been written
+        auto process = [&](TextStream::LineReader& reader, const std::string& name, bool showHeader) {
             if (showHeader) {
-                std::cout << "==> " << name << " <==\n";
+                out() << "==> " << name << " <==\n";
             }
             if (useBytes) {
-                char buf[4096];
+                std::string_view chunk;
                 long long remaining = count;
-                while (remaining > 0 && is) {
-                    long long toRead = (std::min)((long long)sizeof(buf), remaining);
-                    is.read(buf, toRead);
-                    std::cout.write(buf, is.gcount());
-                    remaining -= is.gcount();
+                while (remaining > 0 && reader.nextChunk(chunk)) {
+                    size_t take = (size_t)(std::min)((long long)chunk.size(), remaining);
+                    out().write(chunk.data(), take);
+                    remaining -= take;
                 }
             } else {
-                std::string line;
+                std::string_view line;
                 long long remaining = count;
-                while (remaining > 0 && std::getline(is, line)) {
-                    std::cout << line << "\n";
+                while (remaining > 0 && reader.nextLine(line)) {
+                    out().write(line.data(), line.size());
+                    out() << "\n";
                     remaining--;
                 }
             }
-            if (showHeader) std::cout << "\n";
+            if (showHeader) out() << "\n";
         };
 
-        if (files.empty() && !pipedInput.empty()) {
-            std::istringstream iss(pipedInput);
-            process(iss, "", false);
+        if (files.empty() && (!pipedInput.empty() || hasStageInput())) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
+            process(reader, "", false);
         } else if (files.empty()) {
              printError("head: missing file operand");
         } else {
              bool showHeader = (files.size() > 1 && !quiet) || verbose;
              for (const auto& file : files) {
-                 std::ifstream ifs(resolvePath(file), std::ios::binary);
-                 if (!ifs) {
+                 TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(file));
+                 if (!reader.isOpen()) {
                      printError("head: cannot open '" + file + "'");
                      continue;
                  }
-                 process(ifs, file, showHeader);
+                 process(reader, file, showHeader);
                  showHeader = (files.size() > 1 && !quiet); // Show separator for subsequent
              }
         }
@@ -2707,77 +3024,61 @@ public:
             else files.push_back(arg);
         }
 
+        // Unseekable input (pipes, devices): keep only the last N lines / bytes while streaming
+        auto tailStream = [&](TextStream::LineReader& reader) {
+            if (useBytes) {
+                std::string tailBytes;
+                std::string_view chunk;
+                while (reader.nextChunk(chunk)) {
+                    tailBytes.append(chunk.data(), chunk.size());
+                    if ((long long)tailBytes.size() > count) tailBytes.erase(0, tailBytes.size() - count);
+                }
+                out() << tailBytes;
+            } else {
+                std::deque<std::string> ring;
+                std::string line;
+                while (reader.nextLine(line)) {
+                    if ((long long)ring.size() == count) {
+                        if (count == 0) continue;
+                        // Recycle the oldest slot instead of allocating a new string
+                        std::string recycled = std::move(ring.front());
+                        ring.pop_front();
+                        recycled.swap(line);
+                        ring.push_back(std::move(recycled));
+                    } else {
+                        ring.push_back(line);
+                    }
+                }
+                for (const auto& l : ring) out() << l << "\n";
+            }
+        };
+
         auto tailFile = [&](const std::string& path, bool showHeader) {
-            std::ifstream file(path, std::ios::binary);
-             if (!file) {
-                 printError("tail: cannot open '" + path + "'");
-                 return;
-             }
-             if (showHeader) std::cout << "==> " << path << " <==\n";
-
-             if (useBytes) {
-                 // Seek to end - count
-                 file.seekg(0, std::ios::end);
-                 long long fileSize = file.tellg();
-                 long long startPos = (std::max)(0LL, fileSize - count);
-                 file.seekg(startPos);
-                 std::cout << file.rdbuf();
-             } else {
-                 // Efficient backwards reading for lines
-                 file.seekg(0, std::ios::end);
-                 long long fileSize = file.tellg();
-                 if (fileSize == 0) return;
-
-                 long long pos = fileSize;
-                 long long linesFound = 0;
-                 // Optimization: Reading from end
-                 // Note: This is simpler than full buffer management but effective
-                 // We step back 4KB at a time
-                 const int CHUNK = 4096;
-                 char buffer[CHUNK];
-                 
-                 // If file is small, just read it all
-                 if (fileSize < CHUNK * 2 && count > 100) {
-                     file.seekg(0);
-                     // Fallback to forward read for small files/huge N
-                     std::vector<std::string> buf;
-                     std::string l;
-                     while(std::getline(file, l)) {
-                         buf.push_back(l);
-                         if (buf.size() > count) buf.erase(buf.begin());
-                     }
-                     for(const auto& s : buf) std::cout << s << "\n";
+             TextStream::MappedFile mapped(path);
+             if (!mapped.isOpen()) {
+                 TextStream::LineReader reader = TextStream::LineReader::openFile(path);
+                 if (!reader.isOpen()) {
+                     printError("tail: cannot open '" + path + "'");
                      return;
                  }
-
-                 while (pos > 0 && linesFound <= count) {
-                      long long toRead = (std::min)((long long)CHUNK, pos);
-                      pos -= toRead;
-                      file.seekg(pos);
-                      file.read(buffer, toRead);
-                      for (long long k = toRead - 1; k >= 0; --k) {
-                          if (buffer[k] == '\n') {
-                              linesFound++;
-                              if (linesFound > count) {
-                                  pos += k + 1; // Point to char after newline
-                                  goto found_start;
-                              }
-                          }
-                      }
-                 }
-                 pos = 0; // Read from start if we didn't find N newlines
-                 
-                 found_start:
-                 file.seekg(pos);
-                 // Dump from pos
-                 std::cout << file.rdbuf(); 
-                 // Note: rdbuf dumping might lose the last newline if not present? usually ok
+                 if (showHeader) out() << "==> " << path << " <==\n";
+                 tailStream(reader);
+                 if (showHeader) out() << "\n";
+                 return;
              }
-             if (showHeader) std::cout << "\n";
+             if (showHeader) out() << "==> " << path << " <==\n";
+
+             // Backwards scan over the mapping: nothing before the tail is touched
+             std::string_view data = mapped.view();
+             size_t start = useBytes ? data.size() - (std::min)(data.size(), (size_t)count)
+                                     : TextStream::tailLinesStart(data, count);
+             out().write(data.data() + start, (std::streamsize)(data.size() - start));
+             if (showHeader) out() << "\n";
 
              if (follow) {
-                 file.clear(); // Clear EOF
-                 std::streampos lastPos = file.tellg();
+                 std::ifstream file(path, std::ios::binary);
+                 std::streampos lastPos = (std::streamoff)mapped.size();
+                 mapped.close();
                  while (ctx.running) {
                      // Check for new data
                      // In real implementation we should use generic filesystem watcher
@@ -2788,7 +3089,7 @@ public:
                          file.seekg(lastPos);
                          std::string line;
                          while (std::getline(file, line)) { // Or read block
-                             std::cout << line << std::endl;
+                             out() << line << std::endl;
                          }
                          if (!file.eof()) {
                              // Block read might leave partial line? std::getline handles up to delim
@@ -2804,25 +3105,9 @@ public:
              }
         };
 
-        if (files.empty() && !pipedInput.empty()) {
-            // Cannot seek on pipe, must use buffer
-            std::istringstream iss(pipedInput);
-            std::deque<std::string> ring;
-            if (useBytes) {
-                // ... byte ring buffer is harder, just dump last N chars? 
-                // String supports it
-                if (pipedInput.size() > count) 
-                    std::cout << pipedInput.substr(pipedInput.size() - count);
-                else 
-                    std::cout << pipedInput;
-            } else {
-                std::string line;
-                while (std::getline(iss, line)) {
-                    ring.push_back(line);
-                    if (ring.size() > count) ring.pop_front();
-                }
-                for (const auto& l : ring) std::cout << l << "\n";
-            }
+        if (files.empty() && (!pipedInput.empty() || hasStageInput())) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
+            tailStream(reader);
         } else if (!files.empty()) {
             bool showHeader = (files.size() > 1 && !quiet) || verbose;
             for (const auto& f : files) {
@@ -2854,17 +3139,26 @@ public:
             lines = words = bytes = true;
         }
 
-        auto countFile = [&](std::istream& is, const std::string& name) {
+        auto countFile = [&](TextStream::LineReader& reader, const std::string& name) {
              long long l = 0, w = 0, c = 0, b = 0, L = 0;
              long long currentL = 0;
              bool inWord = false;
-             char buf[8192];
+             std::string_view chunk;
              
-             // Optimized stream reading
-             while (is.read(buf, sizeof(buf)) || is.gcount() > 0) {
-                 size_t n = is.gcount();
+             // -l / -c alone only need newline counts: vectorized scan, no per-byte state
+             bool countOnlyLines = !words && !chars && !maxLine;
+
+             // Chunked reading, no line splitting
+             while (reader.nextChunk(chunk)) {
+                 const char* buf = chunk.data();
+                 size_t n = chunk.size();
                  b += n;
 
+                 if (countOnlyLines) {
+                     l += (long long)TextStream::countNewlines(chunk);
+                     continue;
+                 }
+
                  for (size_t i = 0; i < n; ++i) {
                      unsigned char ch = (unsigned char)buf[i];
                      if (ch == '\n') {
@@ -2889,183 +3183,145 @@ public:
                          w++;
                      }
                  }
-                 if (is.eof()) break;
              }
              if (currentL > L) L = currentL;
 
-             if (lines) std::cout << std::setw(4) << l << " ";
-             if (words) std::cout << std::setw(4) << w << " ";
-             if (bytes) std::cout << std::setw(4) << b << " ";
-             if (chars) std::cout << std::setw(4) << c << " ";
-             if (maxLine) std::cout << std::setw(4) << L << " ";
-             if (!name.empty()) std::cout << name;
-             std::cout << std::endl;
+             if (lines) out() << std::setw(4) << l << " ";
+             if (words) out() << std::setw(4) << w << " ";
+             if (bytes) out() << std::setw(4) << b << " ";
+             if (chars) out() << std::setw(4) << c << " ";
+             if (maxLine) out() << std::setw(4) << L << " ";
+             if (!name.empty()) out() << name;
+             out() << std::endl;
              return std::make_tuple(l, w, b, c, L);
         };
 
         if (files.empty()) {
-             std::istringstream iss(pipedInput);
-             countFile(iss, "");
+             TextStream::LineReader reader = hasStageInput() ? openStdInput(pipedInput)
+                                                             : TextStream::LineReader(std::string_view(pipedInput));
+             countFile(reader, "");
         } else {
              long long tl=0, tw=0, tb=0, tc=0, tL=0;
              for (const auto& file : files) {
-                  std::ifstream ifs(resolvePath(file), std::ios::binary);
-                  if (!ifs) {
+                  TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(file));
+                  if (!reader.isOpen()) {
                       printError("wc: " + file + ": No such file or directory");
                       continue;
                   }
-                  auto [l, w, b, c, L] = countFile(ifs, file);
+                  auto [l, w, b, c, L] = countFile(reader, file);
                   tl += l; tw += w; tb += b; tc += c; tL = (std::max)(tL, L);
              }
              if (files.size() > 1) {
-                 if (lines) std::cout << std::setw(4) << tl << " ";
-                 if (words) std::cout << std::setw(4) << tw << " ";
-                 if (bytes) std::cout << std::setw(4) << tb << " ";
-                 if (chars) std::cout << std::setw(4) << tc << " ";
-                 if (maxLine) std::cout << std::setw(4) << tL << " ";
-                 std::cout << "total" << std::endl;
+                 if (lines) out() << std::setw(4) << tl << " ";
+                 if (words) out() << std::setw(4) << tw << " ";
+                 if (bytes) out() << std::setw(4) << tb << " ";
+                 if (chars) out() << std::setw(4) << tc << " ";
+                 if (maxLine) out() << std::setw(4) << tL << " ";
+                 out() << "total" << std::endl;
              }
         }
     }
 
     // sort - sort lines of text files
     void cmdSort(const std::vector<std::string>& args, const std::string& pipedInput = "") {
-        bool reverse = false;
-        bool numeric = false;
-        bool unique = false;
-        bool ignoreCase = false;
+        SortEngine::Options opts;
+        opts.threads = WorkPool::defaultThreadCount();
         bool check = false;
-        int keyStart = 0; 
-        int keyEnd = 0;
         std::vector<std::string> files;
         
         for (size_t i = 1; i < args.size(); ++i) {
             std::string arg = args[i];
-            if (arg == "-r" || arg == "--reverse") reverse = true;
-            else if (arg == "-n" || arg == "--numeric-sort") numeric = true;
-            else if (arg == "-u" || arg == "--unique") unique = true;
-            else if (arg == "-f" || arg == "--ignore-case") ignoreCase = true;
+            if (arg == "-r" || arg == "--reverse") opts.reverse = true;
+            else if (arg == "-n" || arg == "--numeric-sort") opts.numeric = true;
+            else if (arg == "-u" || arg == "--unique") opts.unique = true;
+            else if (arg == "-f" || arg == "--ignore-case") opts.ignoreCase = true;
             else if (arg == "-c" || arg == "--check") check = true;
             else if (arg == "-k" && i + 1 < args.size()) {
                 std::string kdef = args[++i];
                 size_t comma = kdef.find(',');
                 if (comma != std::string::npos) {
-                    keyStart = std::stoi(kdef.substr(0, comma));
-                    keyEnd = std::stoi(kdef.substr(comma + 1));
+                    opts.keyStart = std::stoi(kdef.substr(0, comma));
+                    opts.keyEnd = std::stoi(kdef.substr(comma + 1));
                 } else {
-                    keyStart = std::stoi(kdef);
-                    keyEnd = 0; 
+                    opts.keyStart = std::stoi(kdef);
+                    opts.keyEnd = 0; 
+                }
+            }
+            else if (arg == "-S" || arg.rfind("-S", 0) == 0 || arg.rfind("--buffer-size=", 0) == 0) {
+                std::string sizeArg;
+                if (arg == "-S" && i + 1 < args.size()) sizeArg = args[++i];
+                else if (arg.rfind("--buffer-size=", 0) == 0) sizeArg = arg.substr(14);
+                else sizeArg = arg.substr(2);
+                size_t budget = SortEngine::parseSize(sizeArg);
+                if (budget == 0) {
+                    printError("sort: invalid -S argument '" + sizeArg + "'");
+                    return;
                 }
+                opts.memoryBudget = budget;
             }
+            else if (arg == "-T" && i + 1 < args.size()) opts.tempDir = resolvePath(args[++i]);
+            else if (arg.rfind("--parallel=", 0) == 0) opts.threads = (size_t)(std::max)(1, std::stoi(arg.substr(11)));
             else if (arg[0] != '-') files.push_back(arg);
         }
-        
-        std::vector<std::string> lines;
-        
-        auto readLines = [&](std::istream& is) {
-            std::string line;
-            while (std::getline(is, line)) {
-                lines.push_back(line);
-            }
-        };
 
-        if (files.empty() && !pipedInput.empty()) {
-            std::istringstream iss(pipedInput);
-            readLines(iss);
+        std::vector<TextStream::LineReader> readers;
+        if (files.empty() && (!pipedInput.empty() || hasStageInput())) {
+            readers.push_back(openStdInput(pipedInput));
         } else if (files.empty()) {
              printError("sort: missing file operand");
              return;
         } else {
              for (const auto& file : files) {
-                 std::ifstream ifs(resolvePath(file));
-                 if (!ifs) {
+                 TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(file));
+                 if (!reader.isOpen()) {
                      printError("sort: cannot open '" + file + "'");
                      return;
                  }
-                 readLines(ifs);
+                 readers.push_back(std::move(reader));
              }
         }
 
-        auto extractKey = [&](const std::string& s) {
-            if (keyStart == 0) return s; 
-            
-            std::istringstream iss(s);
-            std::string token;
-            std::string keyStr;
-            int col = 1;
-            while (iss >> token) {
-                if (col >= keyStart) {
-                    if (!keyStr.empty()) keyStr += " ";
-                    keyStr += token;
-                }
-                if (keyEnd > 0 && col >= keyEnd) break;
-                col++;
-            }
-            return keyStr;
-        };
-
-        auto compare = [&](const std::string& a, const std::string& b) {
-             std::string ka = extractKey(a);
-             std::string kb = extractKey(b);
-
-             if (numeric) {
-                 try {
-                     double da = std::stod(ka);
-                     double db = std::stod(kb);
-                     return da < db;
-                 } catch (...) {
-                     return ka < kb;
-                 }
-             }
-             
-             if (ignoreCase) {
-                 std::transform(ka.begin(), ka.end(), ka.begin(), ::tolower);
-                 std::transform(kb.begin(), kb.end(), kb.begin(), ::tolower);
-             }
-             
-             return ka < kb;
-        };
-
         if (check) {
-            for (size_t i = 1; i < lines.size(); ++i) {
-                bool ordered = !reverse ? !compare(lines[i], lines[i-1]) : !compare(lines[i-1], lines[i]);
-                if (reverse) {
-                    if (compare(lines[i-1], lines[i])) { 
-                        std::cout << "sort: disorder: " << lines[i] << std::endl;
+            // Streaming: only the previous line's key is kept
+            std::string prevKey, key;
+            double prevNum = 0;
+            bool havePrev = false;
+            std::string_view line;
+            for (auto& reader : readers) {
+                while (reader.nextLine(line)) {
+                    key.clear();
+                    SortEngine::extractKey(line, opts, key);
+                    double num = opts.numeric ? SortEngine::numericValue(key) : 0.0;
+                    if (havePrev && SortEngine::compareKeys(key, num, prevKey, prevNum, opts) < 0) {
+                        out() << "sort: disorder: " << line << std::endl;
                         return;
                     }
-                } else {
-                     if (compare(lines[i], lines[i-1])) {
-                         std::cout << "sort: disorder: " << lines[i] << std::endl;
-                         return;
-                     }
+                    prevKey.swap(key);
+                    prevNum = num;
+                    havePrev = true;
                 }
             }
             return;
         }
 
-        std::sort(lines.begin(), lines.end(), compare);
-
-        if (reverse) {
-            std::reverse(lines.begin(), lines.end());
-        }
-        
-        if (unique) {
-            auto last = std::unique(lines.begin(), lines.end(), [&](const std::string& a, const std::string& b){
-                 std::string ka = extractKey(a);
-                 std::string kb = extractKey(b);
-                 if (ignoreCase) {
-                      std::transform(ka.begin(), ka.end(), ka.begin(), ::tolower);
-                      std::transform(kb.begin(), kb.end(), kb.begin(), ::tolower);
-                 }
-                 return ka == kb;
-            });
-            lines.erase(last, lines.end());
-        }
-        
-        for (const auto& line : lines) {
-            std::cout << line << std::endl;
+        SortEngine::ExternalSorter sorter(opts);
+        std::string_view line;
+        for (auto& reader : readers) {
+            while (reader.nextLine(line)) {
+                if (!sorter.add(line)) {
+                    printError("sort: cannot write temporary file");
+                    return;
+                }
+            }
         }
+
+        std::ostream& os = out();
+        bool ok = sorter.finish([&](std::string_view sorted) {
+            os.write(sorted.data(), (std::streamsize)sorted.size());
+            os.put('\n');
+        });
+        os.flush();
+        if (!ok) printError("sort: cannot read temporary file");
     }
 
     // uniq - report or omit repeated lines
@@ -3089,14 +3345,13 @@ public:
             else if (arg[0] != '-') files.push_back(arg);
         }
         
-        std::unique_ptr<std::istream> inputPtr;
-        std::ifstream fileStream;
+        std::unique_ptr<TextStream::LineReader> reader;
         
-        if (!pipedInput.empty()) {
-             inputPtr = std::make_unique<std::istringstream>(pipedInput);
+        if (!pipedInput.empty() || (files.empty() && hasStageInput())) {
+             reader = std::make_unique<TextStream::LineReader>(openStdInput(pipedInput));
         } else if (!files.empty()) {
-             fileStream.open(resolvePath(files[0])); 
-             if (!fileStream) {
+             reader = std::make_unique<TextStream::LineReader>(TextStream::LineReader::openFile(resolvePath(files[0])));
+             if (!reader->isOpen()) {
                  printError("uniq: cannot open '" + files[0] + "'");
                  return;
              }
@@ -3105,9 +3360,7 @@ public:
              return;
         }
         
-        std::istream& is = (!pipedInput.empty()) ? (std::istream&)*inputPtr : fileStream;
-        
-        std::ostream* os = &std::cout;
+        std::ostream* os = &out();
         std::ofstream outStream;
         if (files.size() > 1) {
              outStream.open(resolvePath(files[1]));
@@ -3159,7 +3412,7 @@ public:
              }
         };
 
-        while (std::getline(is, currentLine)) {
+        while (reader->nextLine(currentLine)) {
             if (first) {
                 prevLine = currentLine;
                 count = 1;
@@ -3486,7 +3739,7 @@ public:
                         first = false;
                     }
                 }
-                std::cout << result << "\n";
+                out() << result << "\n";
             } else {
                 if (onlyDelimited && line.find(delimiter) == std::string::npos) {
                     return;
@@ -3509,33 +3762,28 @@ public:
                         first = false;
                     }
                 }
-                std::cout << result << "\n";
+                out() << result << "\n";
             }
         };
 
-        if (!pipedInput.empty()) {
-            std::istringstream iss(pipedInput);
+        if (!pipedInput.empty() || files.empty()) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
             std::string line;
-            while (std::getline(iss, line)) {
+            while (reader.nextLine(line)) {
                 processLine(line);
             }
-        } else if (!files.empty()) {
+        } else {
             for (const auto& filePath : files) {
-                std::ifstream file(resolvePath(filePath));
-                if (!file) {
+                TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(filePath));
+                if (!reader.isOpen()) {
                     printError("cut: cannot open '" + filePath + "'");
                     continue;
                 }
                 std::string line;
-                while (std::getline(file, line)) {
+                while (reader.nextLine(line)) {
                     processLine(line);
                 }
             }
-        } else {
-            std::string line;
-            while (std::getline(std::cin, line)) {
-                processLine(line);
-            }
         }
     }
 
@@ -3676,44 +3924,39 @@ public:
             expandedSet2 += expandedSet2.back();
         }
         
-        std::string input = pipedInput;
-        if (input.empty()) {
-            std::ostringstream oss;
-            char buf[4096];
-            while (std::cin.read(buf, sizeof(buf)) || std::cin.gcount() > 0) {
-                oss.write(buf, std::cin.gcount());
-            }
-            input = oss.str();
-        }
-        
+        // Translate chunk by chunk; squeeze state carries across chunk boundaries
+        TextStream::LineReader reader = openStdInput(pipedInput);
+        std::string_view chunk;
         std::string result;
         char lastChar = '\0';
         bool lastWasInSet1 = false;
         
-        for (unsigned char c : input) {
-            size_t pos = expandedSet1.find(c);
-            if (deleteMode) {
-                if (pos == std::string::npos) {
-                    if (!squeezeMode || c != lastChar) {
-                        result += c;
-                        lastChar = c;
+        while (reader.nextChunk(chunk)) {
+            result.clear();
+            for (unsigned char c : chunk) {
+                size_t pos = expandedSet1.find(c);
+                if (deleteMode) {
+                    if (pos == std::string::npos) {
+                        if (!squeezeMode || c != lastChar) {
+                            result += c;
+                            lastChar = c;
+                        }
                     }
+                } else if (pos != std::string::npos) {
+                    char newChar = (pos < expandedSet2.length()) ? expandedSet2[pos] : c;
+                    if (!squeezeMode || newChar != lastChar || !lastWasInSet1) {
+                        result += newChar;
+                        lastChar = newChar;
+                    }
+                    lastWasInSet1 = true;
+                } else {
+                    result += c;
+                    lastChar = c;
+                    lastWasInSet1 = false;
                 }
-            } else if (pos != std::string::npos) {
-                char newChar = (pos < expandedSet2.length()) ? expandedSet2[pos] : c;
-                if (!squeezeMode || newChar != lastChar || !lastWasInSet1) {
-                    result += newChar;
-                    lastChar = newChar;
-                }
-                lastWasInSet1 = true;
-            } else {
-                result += c;
-                lastChar = c;
-                lastWasInSet1 = false;
             }
+            out() << result;
         }
-        
-        std::cout << result;
     }
 
     void cmdSed(const std::vector<std::string>& args, const std::string& pipedInput = "") {
@@ -3851,9 +4094,9 @@ public:
             allCommands.insert(allCommands.end(), cmds.begin(), cmds.end());
         }
 
-        auto matchAddress = [](const std::string& addr, int lineNum, int lastLine, const std::string& line) -> bool {
+        auto matchAddress = [](const std::string& addr, int lineNum, bool isLastLine, const std::string& line) -> bool {
             if (addr.empty()) return true;
-            if (addr == "$") return lineNum == lastLine;
+            if (addr == "$") return isLastLine;
             if (std::isdigit(addr[0])) return lineNum == std::stoi(addr);
             try {
                 std::regex re(addr);
@@ -3863,13 +4106,16 @@ public:
             }
         };
 
-        auto processLines = [&](std::vector<std::string>& lines) -> std::string {
-            std::ostringstream output;
-            int lastLine = (int)lines.size();
+        // Streams the input with one line of lookahead so '$' addresses still work
+        auto processLines = [&](TextStream::LineReader& reader, std::ostream& output) {
             std::map<int, bool> inRange;
+            std::string line;
+            std::string nextLine;
+            bool hasLine = reader.nextLine(line);
             
-            for (int lineNum = 1; lineNum <= (int)lines.size(); ++lineNum) {
-                std::string line = lines[lineNum - 1];
+            for (int lineNum = 1; hasLine; ++lineNum) {
+                bool hasNext = reader.nextLine(nextLine);
+                bool isLastLine = !hasNext;
                 bool deleted = false;
                 bool printed = false;
                 
@@ -3880,14 +4126,14 @@ public:
                     if (cmd.addr1.empty() && cmd.addr2.empty()) {
                         inAddr = true;
                     } else if (cmd.addr2.empty()) {
-                        inAddr = matchAddress(cmd.addr1, lineNum, lastLine, line);
+                        inAddr = matchAddress(cmd.addr1, lineNum, isLastLine, line);
                     } else {
-                        if (!inRange[ci] && matchAddress(cmd.addr1, lineNum, lastLine, line)) {
+                        if (!inRange[ci] && matchAddress(cmd.addr1, lineNum, isLastLine, line)) {
                             inRange[ci] = true;
                         }
                         if (inRange[ci]) {
                             inAddr = true;
-                            if (matchAddress(cmd.addr2, lineNum, lastLine, line)) {
+                            if (matchAddress(cmd.addr2, lineNum, isLastLine, line)) {
                                 inRange[ci] = false;
                             }
                         }
@@ -3905,7 +4151,7 @@ public:
                             break;
                         case 'q':
                             if (!quietMode && !deleted) output << line << "\n";
-                            return output.str();
+                            return;
                         case 's': {
                             try {
                                 std::regex re(cmd.arg1);
@@ -3952,45 +4198,40 @@ public:
                 if (!deleted && !quietMode) {
                     output << line << "\n";
                 }
+                line.swap(nextLine);
+                hasLine = hasNext;
             }
-            return output.str();
         };
 
-        if (!pipedInput.empty()) {
-            std::vector<std::string> lines;
-            std::istringstream iss(pipedInput);
-            std::string line;
-            while (std::getline(iss, line)) lines.push_back(line);
-            std::cout << processLines(lines);
-        } else if (!files.empty()) {
+        if (!pipedInput.empty() || files.empty()) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
+            processLines(reader, out());
+        } else {
             for (const auto& filePath : files) {
-                std::vector<std::string> lines;
-                std::ifstream file(resolvePath(filePath));
-                if (!file) {
-                    printError("sed: cannot open '" + filePath + "'");
-                    continue;
-                }
-                std::string line;
-                while (std::getline(file, line)) lines.push_back(line);
-                file.close();
-                
-                std::string result = processLines(lines);
-                
                 if (inPlace) {
+                    std::ostringstream result;
+                    {
+                        TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(filePath));
+                        if (!reader.isOpen()) {
+                            printError("sed: cannot open '" + filePath + "'");
+                            continue;
+                        }
+                        processLines(reader, result);
+                    }
                     if (!inPlaceSuffix.empty()) {
                         fs::copy_file(resolvePath(filePath), resolvePath(filePath) + inPlaceSuffix, fs::copy_options::overwrite_existing);
                     }
-                    std::ofstream out(resolvePath(filePath));
-                    out << result;
+                    std::ofstream outFile(resolvePath(filePath));
+                    outFile << result.str();
                 } else {
-                    std::cout << result;
+                    TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(filePath));
+                    if (!reader.isOpen()) {
+                        printError("sed: cannot open '" + filePath + "'");
+                        continue;
+                    }
+                    processLines(reader, out());
                 }
             }
-        } else {
-            std::vector<std::string> lines;
-            std::string line;
-            while (std::getline(std::cin, line)) lines.push_back(line);
-            std::cout << processLines(lines);
         }
     }
 
@@ -4140,7 +4381,7 @@ public:
                     while (!printArgs.empty() && printArgs.front() == ' ') printArgs.erase(0, 1);
                     
                     if (printArgs.empty()) {
-                        std::cout << fields[0] << vars["ORS"];
+                        out() << fields[0] << vars["ORS"];
                     } else {
                         std::vector<std::string> parts;
                         std::string current;
@@ -4165,7 +4406,7 @@ public:
                             if (i > 0) output += vars["OFS"];
                             output += evalExpr(parts[i], fields);
                         }
-                        std::cout << output << vars["ORS"];
+                        out() << output << vars["ORS"];
                     }
                 } else if (stmt.substr(0, 6) == "printf") {
                     std::string printfArgs = stmt.substr(6);
@@ -4212,7 +4453,7 @@ public:
                                 output += fmt[i];
                             }
                         }
-                        std::cout << output;
+                        out() << output;
                     }
                 }
             }
@@ -4292,29 +4533,24 @@ public:
             }
         };
 
-        if (!pipedInput.empty()) {
-            std::istringstream iss(pipedInput);
+        if (!pipedInput.empty() || files.empty()) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
             std::string line;
-            while (std::getline(iss, line)) {
+            while (reader.nextLine(line)) {
                 processLine(line, "");
             }
-        } else if (!files.empty()) {
+        } else {
             for (const auto& filePath : files) {
-                std::ifstream file(resolvePath(filePath));
-                if (!file) {
+                TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(filePath));
+                if (!reader.isOpen()) {
                     printError("awk: cannot open '" + filePath + "'");
                     continue;
                 }
                 std::string line;
-                while (std::getline(file, line)) {
+                while (reader.nextLine(line)) {
                     processLine(line, filePath);
                 }
             }
-        } else {
-            std::string line;
-            while (std::getline(std::cin, line)) {
-                processLine(line, "");
-            }
         }
 
         if (!endBlock.empty()) {
@@ -4496,33 +4732,29 @@ public:
 
     // rev - reverse lines character-wise
     void cmdRev(const std::vector<std::string>& args, const std::string& pipedInput = "") {
-        std::vector<std::string> lines;
-        
-        if (!pipedInput.empty()) {
-            std::istringstream iss(pipedInput);
-            std::string line;
-            while (std::getline(iss, line)) {
-                lines.push_back(line);
+        auto reverseLines = [&](TextStream::LineReader& reader) {
+            std::string_view line;
+            std::string reversed;
+            while (reader.nextLine(line)) {
+                reversed.assign(line.rbegin(), line.rend());
+                out() << reversed << "\n";
             }
+        };
+        
+        if (!pipedInput.empty() || (args.size() < 2 && hasStageInput())) {
+            TextStream::LineReader reader = openStdInput(pipedInput);
+            reverseLines(reader);
         } else if (args.size() > 1) {
-            std::ifstream file(resolvePath(args[1]));
-            if (!file) {
+            TextStream::LineReader reader = TextStream::LineReader::openFile(resolvePath(args[1]));
+            if (!reader.isOpen()) {
                 printError("rev: cannot open '" + args[1] + "'");
                 return;
             }
-            std::string line;
-            while (std::getline(file, line)) {
-                lines.push_back(line);
-            }
+            reverseLines(reader);
         } else {
             printError("rev: missing file operand or piped input");
             return;
         }
-        
-        for (const auto& line : lines) {
-            std::string reversed(line.rbegin(), line.rend());
-            std::cout << reversed << "\n";
-        }
     }
 
     // ============================================================================
@@ -4788,15 +5020,17 @@ public:
                 continue;
             }
             
-            std::ifstream file(filePath, std::ios::binary);
-            if (!file) {
+            // Only the header is inspected: the mapping faults in just the first page
+            TextStream::MappedFile file(filePath);
+            if (!file.isOpen()) {
                 std::cout << "cannot open\n";
                 continue;
             }
+            std::string_view content = file.view();
             
             unsigned char magic[32] = {0};
-            file.read(reinterpret_cast<char*>(magic), 32);
-            size_t bytesRead = file.gcount();
+            size_t bytesRead = (std::min)(content.size(), sizeof(magic));
+            std::memcpy(magic, content.data(), bytesRead);
             
             if (bytesRead == 0) {
                 std::cout << (mimeType ? "inode/x-empty" : "empty") << "\n";
@@ -4842,9 +5076,8 @@ public:
             } else if (magic[0] == 0x1A && magic[1] == 0x45 && magic[2] == 0xDF && magic[3] == 0xA3) {
                 std::cout << (mimeType ? "video/webm" : "WebM/MKV video") << "\n";
             } else if (magic[0] == 'P' && magic[1] == 'K' && magic[2] == 0x03 && magic[3] == 0x04) {
-                file.seekg(30);
                 char nameTest[8] = {0};
-                file.read(nameTest, 8);
+                if (content.size() > 30) std::memcpy(nameTest, content.data() + 30, (std::min)(content.size() - 30, sizeof(nameTest)));
                 if (strncmp(nameTest, "word/", 5) == 0) {
                     std::cout << (mimeType ? "application/vnd.openxmlformats-officedocument.wordprocessingml.document" : "Microsoft Word 2007+ document") << "\n";
                 } else if (strncmp(nameTest, "xl/", 3) == 0) {
@@ -7589,8 +7822,15 @@ public:
         loadPersistentVars();
 
         ctx.interpreter.getExecutor().setFallbackHandler([this](const std::vector<std::string>& args) {
+            // Inside $(...) external programs must write into the capture buffer, not the console
+            if (!args.empty() && ctx.interpreter.getExecutor().isCapturing() && !isBuiltinCommand(args[0])) {
+                std::string output;
+                int code = this->captureExternal(args, output);
+                std::cout << output;
+                return code;
+            }
             this->executeCommand(args);
-            return 0;
+            return ctx.lastExitCode;
         });
     }
 
@@ -7765,7 +8005,6 @@ public:
         si.cb = sizeof(si);
         si.hStdOutput = hStdoutWrite;
         si.hStdError = hStderrWrite;
-        si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
         si.dwFlags |= STARTF_USESTDHANDLES;
         ZeroMemory(&pi, sizeof(pi));
         
@@ -7806,6 +8045,101 @@ public:
         return capturedOutput;
     }
 
+    // Runs an external program with its stdout appended to `output`; stderr stays on the
+    // console. Returns the program's exit code, or 127 when no executable is found.
+    int captureExternal(const std::vector<std::string>& tokens, std::string& output) {
+        const std::string& cmd = tokens[0];
+        std::string execPath;
+        
+        // 1. Check if it's a path (starts with ./ or / or contains \)
+        if (cmd.find('/') != std::string::npos || cmd.find('\\') != std::string::npos) {
+            std::string resolved = resolvePath(cmd);
+            if (fs::exists(resolved)) {
+                execPath = resolved;
+            }
+        }
+        
+        // 2. Check registry
+        if (execPath.empty()) {
+            std::string regPath = g_registry.getExecutablePath(cmd);
+            if (!regPath.empty() && fs::exists(regPath)) {
+                execPath = regPath;
+            }
+        }
+        
+        // 3. Check cmds folder
+        if (execPath.empty()) {
+            char exePath[MAX_PATH];
+            GetModuleFileNameA(NULL, exePath, MAX_PATH);
+            fs::path cmdsDir = fs::path(exePath).parent_path() / "cmds";
+            
+            std::vector<std::string> exts = {".exe", ".cmd", ".bat", ""};
+            for (const auto& ext : exts) {
+                fs::path tryPath = cmdsDir / (cmd + ext);
+                if (fs::exists(tryPath)) {
+                    execPath = tryPath.string();
+                    break;
+                }
+            }
+        }
+        
+        if (execPath.empty()) {
+            // Command not found - NO delegation to Windows shell
+            printError("Command '" + cmd + "' not found in Linuxify.");
+            return 127;
+        }
+        
+        std::string cmdLine = "\"" + execPath + "\"";
+        for (size_t i = 1; i < tokens.size(); i++) {
+            cmdLine += " \"" + tokens[i] + "\"";
+        }
+        
+        SECURITY_ATTRIBUTES saAttr;
+        saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+        saAttr.bInheritHandle = TRUE;
+        saAttr.lpSecurityDescriptor = NULL;
+        
+        HANDLE hReadPipe, hWritePipe;
+        if (!CreatePipe(&hReadPipe, &hWritePipe, &saAttr, 0)) {
+            printError("Failed to create pipe for " + cmd);
+            return 1;
+        }
+        SetHandleInformation(hReadPipe, HANDLE_FLAG_INHERIT, 0);
+        
+        STARTUPINFOA si;
+        PROCESS_INFORMATION pi;
+        ZeroMemory(&si, sizeof(si));
+        si.cb = sizeof(si);
+        si.hStdOutput = hWritePipe;
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+        si.dwFlags |= STARTF_USESTDHANDLES;
+        ZeroMemory(&pi, sizeof(pi));
+        
+        std::vector<char> cmdBuffer = Bash::commandLineBuffer(cmdLine);
+        if (!CreateProcessA(NULL, cmdBuffer.data(), NULL, NULL, TRUE, 0, NULL,
+                            ctx.currentDir.c_str(), &si, &pi)) {
+            CloseHandle(hWritePipe);
+            CloseHandle(hReadPipe);
+            printError("Failed to create process for " + cmd);
+            return 126;
+        }
+        CloseHandle(hWritePipe);
+        
+        char buffer[4096];
+        DWORD bytesRead;
+        while (ReadFile(hReadPipe, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
+            output.append(buffer, bytesRead);
+        }
+        CloseHandle(hReadPipe);
+        
+        DWORD exitCode = 1;
+        WaitForSingleObject(pi.hProcess, INFINITE);
+        GetExitCodeProcess(pi.hProcess, &exitCode);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+        return (int)exitCode;
+    }
+
     // Execute a command and capture its output (internal execution)
     std::string executeAndCapture(const std::string& cmdStr) {
         std::string output;
@@ -7839,95 +8173,7 @@ public:
             std::cout.rdbuf(oldCout);
             output = capturedOutput.str();
         } else {
-            // External command - check registry and cmds folder, use CreateProcess
-            std::string execPath;
-            
-            // 1. Check if it's a path (starts with ./ or / or contains \)
-            if (cmd.find('/') != std::string::npos || cmd.find('\\') != std::string::npos) {
-                std::string resolved = resolvePath(cmd);
-                if (fs::exists(resolved)) {
-                    execPath = resolved;
-                }
-            }
-            
-            // 2. Check registry
-            if (execPath.empty()) {
-                std::string regPath = g_registry.getExecutablePath(cmd);
-                if (!regPath.empty() && fs::exists(regPath)) {
-                    execPath = regPath;
-                }
-            }
-            
-            // 3. Check cmds folder
-            if (execPath.empty()) {
-                char exePath[MAX_PATH];
-                GetModuleFileNameA(NULL, exePath, MAX_PATH);
-                fs::path cmdsDir = fs::path(exePath).parent_path() / "cmds";
-                
-                std::vector<std::string> exts = {".exe", ".cmd", ".bat", ""};
-                for (const auto& ext : exts) {
-                    fs::path tryPath = cmdsDir / (cmd + ext);
-                    if (fs::exists(tryPath)) {
-                        execPath = tryPath.string();
-                        break;
-                    }
-                }
-            }
-            
-            if (!execPath.empty()) {
-                // Build command line
-                std::string cmdLine = "\"" + execPath + "\"";
-                for (size_t i = 1; i < tokens.size(); i++) {
-                    cmdLine += " \"" + tokens[i] + "\"";
-                }
-                
-                // Create pipes for stdout capture
-                SECURITY_ATTRIBUTES saAttr;
-                saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-                saAttr.bInheritHandle = TRUE;
-                saAttr.lpSecurityDescriptor = NULL;
-                
-                HANDLE hReadPipe, hWritePipe;
-                if (CreatePipe(&hReadPipe, &hWritePipe, &saAttr, 0)) {
-                    SetHandleInformation(hReadPipe, HANDLE_FLAG_INHERIT, 0);
-                    
-                    STARTUPINFOA si;
-                    PROCESS_INFORMATION pi;
-                    ZeroMemory(&si, sizeof(si));
-                    si.cb = sizeof(si);
-                    si.hStdOutput = hWritePipe;
-                    si.hStdError = hWritePipe;
-                    si.dwFlags |= STARTF_USESTDHANDLES;
-                    ZeroMemory(&pi, sizeof(pi));
-                    
-                    char cmdBuffer[8192];
-                    strncpy_s(cmdBuffer, cmdLine.c_str(), sizeof(cmdBuffer) - 1);
-                    
-                    if (CreateProcessA(NULL, cmdBuffer, NULL, NULL, TRUE, 0, NULL, 
-                                       ctx.currentDir.c_str(), &si, &pi)) {
-                        CloseHandle(hWritePipe);
-                        
-                        // Read output
-                        char buffer[4096];
-                        DWORD bytesRead;
-                        while (ReadFile(hReadPipe, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-                            buffer[bytesRead] = '\0';
-                            output += buffer;
-                        }
-                        
-                        WaitForSingleObject(pi.hProcess, INFINITE);
-                        CloseHandle(pi.hProcess);
-                        CloseHandle(pi.hThread);
-                    } else {
-                        CloseHandle(hWritePipe);
-                        output = "Error: Failed to create process for " + cmd;
-                    }
-                    CloseHandle(hReadPipe);
-                }
-            } else {
-                // Command not found - NO delegation to Windows shell
-                output = "Error: Command '" + cmd + "' not found in Linuxify.";
-            }
+            ctx.lastExitCode = captureExternal(tokens, output);
         }
         
         return output;
@@ -8701,7 +8947,12 @@ public:
         
         std::stringstream buffer;
         buffer << file.rdbuf();
-        int result = ctx.interpreter.runCode(buffer.str());
+        int result;
+        try {
+            result = ctx.interpreter.runCode(buffer.str());
+        } catch (const Bash::ExitException& e) {
+            result = e.code;  // exit ends the script, not the shell that sourced it
+        }
         
         ctx.interpreter.clearScriptArgs();
         return result;
@@ -8709,7 +8960,11 @@ public:
     
     // Run a single command string (e.g. from -c)
     int runCommand(const std::string& command) {
-        return ctx.interpreter.runCode(command);
+        try {
+            return ctx.interpreter.runCode(command);
+        } catch (const Bash::ExitException& e) {
+            return e.code;
+        }
     }
     
 };
@@ -8872,8 +9127,7 @@ int main(int argc, char* argv[]) {
         
         ShellContext context;
         ShellLogic logic(context);
-        logic.runCommand(command);
-        return 0;
+        return logic.runCommand(command);
     }
 
     // 2. Initialize Signal Handler
@@ -8925,6 +9179,6 @@ int main(int argc, char* argv[]) {
     ShellEngine engine;
     engine.execute(std::make_unique<StateBoot>(), context);
     
-    return 0;
+    return context.lastExitCode;
 }
 
@@ -0,0 +1,187 @@
+// g++ -std=c++17 main.cpp -o main.exe
+#ifndef LINUXIFY_MAPPED_FILE_HPP
+#define LINUXIFY_MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINUXIFY_MAPPED_SSE2 1
+#endif
+
+// Read-only memory-mapped files.
+// Regular files are mapped whole and read as string_views over the mapping, so the
+// file builtins never copy bytes into per-line strings. Anything that cannot be
+// mapped (pipes, devices, consoles) reports !isOpen() and callers fall back to reads.
+namespace TextStream {
+
+    class MappedFile {
+    private:
+        const char* data = nullptr;
+        size_t length = 0;
+        bool opened = false;
+
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(const std::string& path) { open(path); }
+
+        ~MappedFile() { close(); }
+
+        MappedFile(MappedFile&& other) noexcept
+            : data(other.data), length(other.length), opened(other.opened) {
+            other.data = nullptr;
+            other.length = 0;
+            other.opened = false;
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                close();
+                data = other.data;
+                length = other.length;
+                opened = other.opened;
+                other.data = nullptr;
+                other.length = 0;
+                other.opened = false;
+            }
+            return *this;
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Maps a regular file. Empty files open successfully with an empty view.
+        bool open(const std::string& path) {
+            close();
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                      NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (file == INVALID_HANDLE_VALUE) return false;
+
+            LARGE_INTEGER size;
+            if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) ||
+                (unsigned long long)size.QuadPart > (unsigned long long)SIZE_MAX) {
+                CloseHandle(file);
+                return false;
+            }
+            if (size.QuadPart == 0) {
+                CloseHandle(file);
+                opened = true;
+                return true;
+            }
+
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            CloseHandle(file);
+            if (mapping == NULL) return false;
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);  // the view keeps the mapping alive
+            if (view == NULL) return false;
+
+            data = (const char*)view;
+            length = (size_t)size.QuadPart;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                ::close(fd);
+                return false;
+            }
+            if (st.st_size == 0) {
+                ::close(fd);
+                opened = true;
+                return true;
+            }
+
+            void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);  // the mapping keeps the file alive
+            if (view == MAP_FAILED) return false;
+            madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+            data = (const char*)view;
+            length = (size_t)st.st_size;
+#endif
+            opened = true;
+            return true;
+        }
+
+        void close() {
+            if (data) {
+#ifdef _WIN32
+                UnmapViewOfFile(data);
+#else
+                munmap((void*)data, length);
+#endif
+            }
+            data = nullptr;
+            length = 0;
+            opened = false;
+        }
+
+        bool isOpen() const { return opened; }
+        size_t size() const { return length; }
+        std::string_view view() const { return std::string_view(data ? data : "", length); }
+    };
+
+    // Number of `target` bytes in [data, data + len). Runs 16 bytes per step with SSE2:
+    // compare results are accumulated as per-lane byte counters and folded with
+    // _mm_sad_epu8 before they can overflow.
+    inline size_t countByte(const char* data, size_t len, char target) {
+        size_t total = 0;
+        size_t i = 0;
+#ifdef LINUXIFY_MAPPED_SSE2
+        const __m128i needle = _mm_set1_epi8(target);
+        const __m128i zero = _mm_setzero_si128();
+        while (len - i >= 16) {
+            __m128i acc = _mm_setzero_si128();
+            size_t blocks = (std::min)((len - i) / 16, (size_t)255);
+            for (size_t b = 0; b < blocks; ++b, i += 16) {
+                __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+                acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(chunk, needle));  // cmpeq yields -1 per hit
+            }
+            __m128i sums = _mm_sad_epu8(acc, zero);
+            total += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+        }
+#endif
+        for (; i < len; ++i) {
+            if (data[i] == target) total++;
+        }
+        return total;
+    }
+
+    inline size_t countNewlines(std::string_view text) {
+        return countByte(text.data(), text.size(), '\n');
+    }
+
+    // Offset where the last `lines` lines of `text` begin (a trailing newline ends the
+    // last line rather than starting an empty one)
+    inline size_t tailLinesStart(std::string_view text, long long lines) {
+        if (lines <= 0) return text.size();
+        size_t pos = text.size();
+        if (pos > 0 && text[pos - 1] == '\n') pos--;
+        long long found = 0;
+        while (pos > 0) {
+            if (text[pos - 1] == '\n' && ++found == lines) return pos;
+            pos--;
+        }
+        return 0;
+    }
+
+} // namespace TextStream
+
+#endif // LINUXIFY_MAPPED_FILE_HPP
@@ -0,0 +1,242 @@
+// g++ -std=c++17 main.cpp -o main.exe
+#ifndef LINUXIFY_PIPELINE_HPP
+#define LINUXIFY_PIPELINE_HPP
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <cstring>
+
+// In-process pipeline plumbing.
+// Built-in stages of a pipeline run as threads inside the shell and talk through
+// bounded in-memory channels instead of OS pipes + a fresh linuxify.exe per stage.
+namespace Pipeline {
+
+    // Bounded single-producer / single-consumer byte channel.
+    // Writers block while the channel is full, readers block while it is empty.
+    // Closing the read side makes further writes fail so upstream stages can stop
+    // early (e.g. `cat big.log | head`).
+    class BoundedChannel {
+    private:
+        std::vector<char> ring;
+        size_t head = 0;   // next byte to read
+        size_t count = 0;  // bytes currently buffered
+        bool writerClosed = false;
+        bool readerClosed = false;
+        std::mutex mtx;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 256 * 1024;
+
+        explicit BoundedChannel(size_t capacity = DEFAULT_CAPACITY) : ring(capacity) {}
+
+        // Returns false if the reader went away; the data is dropped in that case
+        bool write(const char* data, size_t len) {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (len > 0) {
+                notFull.wait(lock, [&] { return count < ring.size() || readerClosed; });
+                if (readerClosed) return false;
+
+                size_t tail = (head + count) % ring.size();
+                size_t space = ring.size() - count;
+                size_t chunk = (std::min)({len, space, ring.size() - tail});
+                std::memcpy(ring.data() + tail, data, chunk);
+                count += chunk;
+                data += chunk;
+                len -= chunk;
+                notEmpty.notify_one();
+            }
+            return true;
+        }
+
+        // Returns 0 on end of stream
+        size_t read(char* out, size_t maxLen) {
+            std::unique_lock<std::mutex> lock(mtx);
+            notEmpty.wait(lock, [&] { return count > 0 || writerClosed; });
+            if (count == 0) return 0;
+
+            size_t chunk = (std::min)({maxLen, count, ring.size() - head});
+            std::memcpy(out, ring.data() + head, chunk);
+            head = (head + chunk) % ring.size();
+            count -= chunk;
+            notFull.notify_one();
+            return chunk;
+        }
+
+        void closeWrite() {
+            std::lock_guard<std::mutex> lock(mtx);
+            writerClosed = true;
+            notEmpty.notify_all();
+        }
+
+        void closeRead() {
+            std::lock_guard<std::mutex> lock(mtx);
+            readerClosed = true;
+            count = 0;
+            notFull.notify_all();
+        }
+    };
+
+    // std::ostream adapter writing into a channel
+    class ChannelWriteBuf : public std::streambuf {
+    private:
+        BoundedChannel& channel;
+        char buffer[16384];
+        bool broken = false;
+
+        bool flushBuffer() {
+            std::ptrdiff_t n = pptr() - pbase();
+            if (n > 0 && !broken) {
+                if (!channel.write(pbase(), (size_t)n)) broken = true;
+            }
+            setp(buffer, buffer + sizeof(buffer));
+            return !broken;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!flushBuffer()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override {
+            return flushBuffer() ? 0 : -1;
+        }
+
+    public:
+        explicit ChannelWriteBuf(BoundedChannel& ch) : channel(ch) {
+            setp(buffer, buffer + sizeof(buffer));
+        }
+
+        ~ChannelWriteBuf() override {
+            flushBuffer();
+        }
+    };
+
+    // std::istream adapter reading from a channel
+    class ChannelReadBuf : public std::streambuf {
+    private:
+        BoundedChannel& channel;
+        char buffer[16384];
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            size_t n = channel.read(buffer, sizeof(buffer));
+            if (n == 0) return traits_type::eof();
+            setg(buffer, buffer, buffer + n);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        explicit ChannelReadBuf(BoundedChannel& ch) : channel(ch) {
+            setg(buffer, buffer, buffer);
+        }
+    };
+
+    // std::ostream adapter over a raw HANDLE (console, pipe or redirect file)
+    class HandleWriteBuf : public std::streambuf {
+    private:
+        HANDLE handle;
+        char buffer[16384];
+
+        bool flushBuffer() {
+            std::ptrdiff_t n = pptr() - pbase();
+            bool ok = true;
+            if (n > 0) {
+                DWORD written = 0;
+                ok = WriteFile(handle, pbase(), (DWORD)n, &written, NULL) != 0;
+            }
+            setp(buffer, buffer + sizeof(buffer));
+            return ok;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!flushBuffer()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override {
+            return flushBuffer() ? 0 : -1;
+        }
+
+    public:
+        explicit HandleWriteBuf(HANDLE h) : handle(h) {
+            setp(buffer, buffer + sizeof(buffer));
+        }
+
+        ~HandleWriteBuf() override {
+            flushBuffer();
+        }
+    };
+
+    // Streams bound to the pipeline stage running on the current thread.
+    // Built-ins read from `in` and write to `out` when a stage is bound, and fall
+    // back to std::cin / std::cout otherwise.
+    struct StageIO {
+        std::istream* in = nullptr;   // null for the first stage (no upstream)
+        std::ostream* out = nullptr;
+        int exitCode = 0;
+        // Console color changes as (offset in out, attributes), for output buffered on its
+        // way to the console; null means colors are dropped
+        std::vector<std::pair<size_t, WORD>>* colors = nullptr;
+    };
+
+    inline thread_local StageIO* currentStage = nullptr;
+
+    // RAII binding of a StageIO to the calling thread
+    class StageScope {
+    private:
+        StageIO* previous;
+
+    public:
+        explicit StageScope(StageIO* io) : previous(currentStage) { currentStage = io; }
+        ~StageScope() { currentStage = previous; }
+        StageScope(const StageScope&) = delete;
+        StageScope& operator=(const StageScope&) = delete;
+    };
+
+    // Copies a channel into an OS pipe feeding an external process
+    inline void pumpChannelToHandle(BoundedChannel& channel, HANDLE hWrite) {
+        char buf[16384];
+        size_t n;
+        bool alive = true;
+        while ((n = channel.read(buf, sizeof(buf))) > 0) {
+            DWORD written = 0;
+            if (!WriteFile(hWrite, buf, (DWORD)n, &written, NULL)) { alive = false; break; }
+        }
+        if (!alive) channel.closeRead();
+        CloseHandle(hWrite);
+    }
+
+    // Copies an external process' output pipe into a channel
+    inline void pumpHandleToChannel(HANDLE hRead, BoundedChannel& channel) {
+        char buf[16384];
+        DWORD n = 0;
+        while (ReadFile(hRead, buf, sizeof(buf), &n, NULL) && n > 0) {
+            if (!channel.write(buf, n)) break;
+        }
+        channel.closeWrite();
+        CloseHandle(hRead);
+    }
+
+} // namespace Pipeline
+
+#endif // LINUXIFY_PIPELINE_HPP
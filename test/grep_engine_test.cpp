@@ -0,0 +1,55 @@
+// grep match engine test - NFA size cap on nested counted repeats
+// Compile: g++ -std=c++17 -O2 -o grep_engine_test.exe grep_engine_test.cpp
+// Run: grep_engine_test    (exit code 0 when every case passes)
+
+#include "../cmds-src/grep_engine.hpp"
+#include <iostream>
+#include <chrono>
+
+static int failures = 0;
+
+static void check(const std::string& name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << "\n";
+    if (!ok) failures++;
+}
+
+// States the automaton backend builds for a pattern, or -1 if it gives up on it
+static long compiledStates(const std::string& pattern, double& seconds) {
+    using namespace GrepEngine;
+    auto start = std::chrono::steady_clock::now();
+    long states = -1;
+    try {
+        Parser parser(pattern, false);
+        std::unique_ptr<Node> root = parser.parse();
+        Nfa nfa;
+        Compiler(nfa).build(*root);
+        states = (long)nfa.states.size();
+    } catch (const Unsupported&) {
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return states;
+}
+
+int main() {
+    double secs = 0;
+
+    long small = compiledStates("(ab{3}){2}c", secs);
+    check("small counted repeat compiles", small > 0);
+
+    long nested = compiledStates("(a{1000}){1000}", secs);
+    check("(a{1000}){1000} is refused while compiling", nested < 0 && secs < 1.0);
+
+    long deeper = compiledStates("((a{1000}){1000}){1000}", secs);
+    check("triple nesting is refused just as fast", deeper < 0 && secs < 1.0);
+
+    long atCap = compiledStates("(a{1000}){40}", secs);
+    check("a large but bounded repeat still compiles", atCap > 0 && (size_t)atCap <= GrepEngine::Nfa::MAX_STATES);
+
+    {
+        GrepEngine::Matcher m("x(ab{2}){3}y", false, true);
+        check("matcher on a nested repeat", m.matches("--xabbabbabby--") && !m.matches("xabbabby"));
+    }
+
+    std::cout << (failures ? "FAILED: " + std::to_string(failures) + " case(s)\n" : "all passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+// LinMake dependency file parser test - make-style .d files as gcc writes them
+// Compile: g++ -std=c++17 -o linmake_deps_test.exe linmake_deps_test.cpp
+// Run: linmake_deps_test    (exit code 0 when every case passes)
+
+#include "../cmds-src/linmake_deps.hpp"
+#include <iostream>
+
+static int failures = 0;
+
+static void check(const std::string& name, const std::string& text, const std::vector<std::string>& expected) {
+    std::string path = (std::filesystem::temp_directory_path() / "linmake_deps_test.d").string();
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << text;
+    }
+    std::vector<std::string> got = LinMakeDeps::parseDepFile(path);
+    std::filesystem::remove(path);
+
+    if (got == expected) {
+        std::cout << "ok    " << name << "\n";
+        return;
+    }
+    failures++;
+    std::cout << "FAIL  " << name << "\n  expected:";
+    for (const auto& d : expected) std::cout << " [" << d << "]";
+    std::cout << "\n  got:     ";
+    for (const auto& d : got) std::cout << " [" << d << "]";
+    std::cout << "\n";
+}
+
+// Joins lines with `eol`, the way gcc wraps a rule at about 75 columns
+static std::string lines(const std::vector<std::string>& parts, const std::string& eol) {
+    std::string text;
+    for (const auto& p : parts) text += p + eol;
+    return text;
+}
+
+int main() {
+    const std::vector<std::string> wrapped = {
+        "build/a.o: src/a.cpp include/x.h \\",
+        " include/y.h \\",
+        " include/z.h",
+    };
+    const std::vector<std::string> abc = { "src/a.cpp", "include/x.h", "include/y.h", "include/z.h" };
+
+    check("single line", "build/a.o: src/a.cpp include/x.h\n", { "src/a.cpp", "include/x.h" });
+    check("wrapped, LF", lines(wrapped, "\n"), abc);
+    check("wrapped, CRLF", lines(wrapped, "\r\n"), abc);
+    check("wrapped, no final newline", lines(wrapped, "\n").substr(0, lines(wrapped, "\n").size() - 1), abc);
+    check("backslash glued to the last token", "build/a.o: src/a.cpp include/x.h\\\n include/y.h\n",
+          { "src/a.cpp", "include/x.h", "include/y.h" });
+
+    // gcc -MMD output for a source that includes four long-named headers
+    check("gcc style, CRLF",
+          lines({
+              "build/obj/delta_engine.o: src/delta_engine.cpp \\",
+              " include/delta_configuration.h include/delta_engine_internals.h \\",
+              " include/delta_stream_buffers.h include/delta_checksum_tables.h",
+          }, "\r\n"),
+          { "src/delta_engine.cpp", "include/delta_configuration.h", "include/delta_engine_internals.h",
+            "include/delta_stream_buffers.h", "include/delta_checksum_tables.h" });
+
+    // Only the first rule counts; -MP phony targets follow it
+    check("phony targets after the rule",
+          lines({ "build/a.o: src/a.cpp \\", " include/x.h", "", "include/x.h:" }, "\n"),
+          { "src/a.cpp", "include/x.h" });
+
+    check("drive letters and escapes",
+          "C:/proj/build/a.o: C:/proj/src/a.cpp C:/proj/my\\ dir/x.h \\\r\n C:/proj/cost$$.h\r\n",
+          { "C:/proj/src/a.cpp", "C:/proj/my dir/x.h", "C:/proj/cost$.h" });
+
+    check("empty file", "", {});
+
+    std::cout << (failures ? "FAILED: " + std::to_string(failures) + " case(s)\n" : "all passed\n");
+    return failures ? 1 : 0;
+}
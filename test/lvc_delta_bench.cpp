@@ -0,0 +1,239 @@
+// LVC delta encoder benchmark - gear hash encoder vs the old rsync-style one
+// Compile: g++ -std=c++17 -O2 -o lvc_delta_bench.exe lvc_delta_bench.cpp
+// Run: lvc_delta_bench <repo>                  every revision pair in an LVC repository
+//      lvc_delta_bench <old> <new> [<old> <new> ...]  explicit file pairs
+
+#include "../cmds-src/lvc.hpp"
+#include <deque>
+
+// The encoder LVC shipped before the gear hash one, kept verbatim for comparison
+namespace LegacyDelta {
+    using DeltaOp = DeltaCompression::DeltaOp;
+
+    constexpr size_t CHUNK_SIZE = 64;
+    constexpr size_t HASH_PRIME = 31;
+    constexpr size_t HASH_MOD = 1000000007;
+
+    struct RollingHash {
+        size_t hash = 0;
+        size_t power = 1;
+        std::deque<uint8_t> window;
+        size_t windowSize;
+
+        RollingHash(size_t size = CHUNK_SIZE) : windowSize(size) {
+            for (size_t i = 0; i < windowSize - 1; i++) {
+                power = (power * HASH_PRIME) % HASH_MOD;
+            }
+        }
+
+        void add(uint8_t byte) {
+            if (window.size() >= windowSize) {
+                uint8_t old = window.front();
+                window.pop_front();
+                hash = (hash + HASH_MOD - (old * power) % HASH_MOD) % HASH_MOD;
+            }
+            window.push_back(byte);
+            hash = (hash * HASH_PRIME + byte) % HASH_MOD;
+        }
+
+        size_t getHash() const { return hash; }
+        bool full() const { return window.size() >= windowSize; }
+    };
+
+    std::unordered_map<size_t, std::vector<size_t>> buildSignature(const std::string& src) {
+        std::unordered_map<size_t, std::vector<size_t>> sig;
+        if (src.size() < CHUNK_SIZE) return sig;
+        RollingHash rh;
+        for (size_t i = 0; i < src.size(); i++) {
+            rh.add((uint8_t)src[i]);
+            if (rh.full() && i >= CHUNK_SIZE - 1) {
+                sig[rh.getHash()].push_back(i - CHUNK_SIZE + 1);
+            }
+        }
+        return sig;
+    }
+
+    std::vector<DeltaOp> createDelta(const std::string& src, const std::string& tgt) {
+        std::vector<DeltaOp> ops;
+        if (src.empty()) {
+            if (!tgt.empty()) {
+                DeltaOp op;
+                op.type = DeltaOp::INSERT;
+                op.data = tgt;
+                op.length = tgt.size();
+                ops.push_back(op);
+            }
+            return ops;
+        }
+
+        auto sig = buildSignature(src);
+        RollingHash rh;
+        std::string pending;
+        size_t pos = 0;
+
+        while (pos < tgt.size()) {
+            rh.add((uint8_t)tgt[pos]);
+            if (rh.full()) {
+                auto it = sig.find(rh.getHash());
+                if (it != sig.end()) {
+                    size_t srcPos = it->second[0];
+                    size_t matchStart = pos - CHUNK_SIZE + 1;
+                    bool match = true;
+                    for (size_t i = 0; i < CHUNK_SIZE && match; i++) {
+                        if (src[srcPos + i] != tgt[matchStart + i]) match = false;
+                    }
+                    if (match) {
+                        if (!pending.empty()) {
+                            if (pending.size() >= CHUNK_SIZE) {
+                                pending = pending.substr(0, pending.size() - CHUNK_SIZE + 1);
+                            } else {
+                                pending.clear();
+                            }
+                            if (!pending.empty()) {
+                                DeltaOp iop;
+                                iop.type = DeltaOp::INSERT;
+                                iop.data = pending;
+                                iop.length = pending.size();
+                                ops.push_back(iop);
+                            }
+                            pending.clear();
+                        }
+                        size_t len = CHUNK_SIZE;
+                        while (srcPos + len < src.size() && matchStart + len < tgt.size() &&
+                               src[srcPos + len] == tgt[matchStart + len]) {
+                            len++;
+                        }
+                        DeltaOp cop;
+                        cop.type = DeltaOp::COPY;
+                        cop.srcOffset = srcPos;
+                        cop.length = len;
+                        ops.push_back(cop);
+                        pos = matchStart + len;
+                        rh = RollingHash();
+                        continue;
+                    }
+                }
+            }
+            pending += tgt[pos];
+            pos++;
+        }
+
+        if (!pending.empty()) {
+            DeltaOp iop;
+            iop.type = DeltaOp::INSERT;
+            iop.data = pending;
+            iop.length = pending.size();
+            ops.push_back(iop);
+        }
+        return ops;
+    }
+
+    std::string serialize(const std::vector<DeltaOp>& ops) {
+        std::ostringstream oss;
+        oss << "DELTA\n" << ops.size() << "\n";
+        for (const auto& op : ops) {
+            if (op.type == DeltaOp::COPY) {
+                oss << "C " << op.srcOffset << " " << op.length << "\n";
+            } else {
+                oss << "I " << op.data.size() << "\n";
+                oss.write(op.data.data(), op.data.size());
+            }
+        }
+        return oss.str();
+    }
+}
+
+struct Totals {
+    double seconds = 0;
+    size_t deltaBytes = 0;
+    size_t failures = 0;
+};
+
+static std::string readAll(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::ostringstream oss;
+    oss << f.rdbuf();
+    return oss.str();
+}
+
+static std::string trimmed(std::string s) {
+    while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+    return s;
+}
+
+// (older, newer) content of each file between consecutive commits reachable from HEAD
+static std::vector<std::pair<std::string, std::string>> repoPairs(const std::string& repo) {
+    std::string lvcDir = repo + "/.lvc";
+    LVCObjectDB db(lvcDir + "/objects");
+
+    std::string head = trimmed(readAll(lvcDir + "/HEAD"));
+    if (head.compare(0, 5, "ref: ") == 0) head = trimmed(readAll(lvcDir + "/" + head.substr(5)));
+
+    std::vector<std::map<std::string, std::string>> trees;  // newest first
+    for (std::string commit = head; !commit.empty();) {
+        auto data = db.parseCommit(commit);
+        std::map<std::string, std::string> files;
+        for (const auto& e : db.parseTree(data.tree)) files[e.name] = e.hash;
+        trees.push_back(std::move(files));
+        commit = data.parent;
+    }
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    for (size_t i = 0; i + 1 < trees.size(); i++) {
+        for (const auto& [path, hash] : trees[i]) {
+            auto old = trees[i + 1].find(path);
+            if (old == trees[i + 1].end() || old->second == hash) continue;
+            pairs.push_back({ db.getBlob(old->second), db.getBlob(hash) });
+        }
+    }
+    return pairs;
+}
+
+template <typename Encode>
+static Totals run(const std::vector<std::pair<std::string, std::string>>& pairs, Encode encode) {
+    Totals t;
+    for (const auto& [src, tgt] : pairs) {
+        auto start = std::chrono::steady_clock::now();
+        std::string delta = encode(src, tgt);
+        t.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        t.deltaBytes += delta.size();
+        if (DeltaCompression::applyDelta(src, DeltaCompression::deserialize(delta)) != tgt) t.failures++;
+    }
+    return t;
+}
+
+static void report(const char* name, const Totals& t, size_t targetBytes) {
+    double mb = targetBytes / (1024.0 * 1024.0);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+              << std::setw(10) << std::setprecision(3) << t.seconds << " s"
+              << std::setw(10) << std::setprecision(1) << (t.seconds > 0 ? mb / t.seconds : 0) << " MB/s"
+              << std::setw(12) << t.deltaBytes << " bytes"
+              << std::setw(8) << std::setprecision(2) << 100.0 * t.deltaBytes / std::max<size_t>(targetBytes, 1) << " %"
+              << "   " << t.failures << " bad round trips\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && (argc < 3 || argc % 2 == 0)) {
+        std::cerr << "usage: lvc_delta_bench <repo> | <old> <new> [<old> <new> ...]\n";
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    if (argc == 2) {
+        pairs = repoPairs(argv[1]);
+    } else {
+        for (int i = 1; i + 1 < argc; i += 2) pairs.push_back({ readAll(argv[i]), readAll(argv[i + 1]) });
+    }
+
+    size_t targetBytes = 0;
+    for (const auto& p : pairs) targetBytes += p.second.size();
+    std::cout << pairs.size() << " revision pairs, " << targetBytes << " target bytes\n";
+
+    report("legacy", run(pairs, [](const std::string& s, const std::string& t) {
+        return LegacyDelta::serialize(LegacyDelta::createDelta(s, t));
+    }), targetBytes);
+    report("gear", run(pairs, [](const std::string& s, const std::string& t) {
+        return DeltaCompression::serialize(DeltaCompression::createDelta(s, t));
+    }), targetBytes);
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Shell variable store test - copy-on-write arrays, snapshots and local frames
+// Compile: g++ -std=c++17 -O2 -o variable_store_test.exe variable_store_test.cpp
+// Run: variable_store_test    (exit code 0 when every case passes)
+
+#include "../cmds-src/variable_store.hpp"
+#include <iostream>
+#include <chrono>
+
+static int failures = 0;
+
+static void check(const std::string& name, bool ok) {
+    std::cout << (ok ? "ok    " : "FAIL  ") << name << "\n";
+    if (!ok) failures++;
+}
+
+using Values = std::vector<std::string>;
+
+int main() {
+    using ShellVars::VariableStore;
+
+    {
+        VariableStore vars;
+        vars.setArray("arr", { "a", "b", "c" });
+        VariableStore snapshot = vars;  // what a subshell gets
+        vars.setArrayElement("arr", 1, "B");
+        vars.setArrayElement("arr", 4, "E");
+        check("snapshot keeps the array it was taken with", *snapshot.getArray("arr") == Values{ "a", "b", "c" });
+        check("live array sees the writes", *vars.getArray("arr") == Values{ "a", "B", "c", "", "E" });
+
+        snapshot.setArrayElement("arr", 0, "x");
+        check("writing the snapshot leaves the live array", (*vars.getArray("arr"))[0] == "a");
+    }
+
+    {
+        VariableStore vars;
+        vars.setArray("arr", { "outer" });
+        {
+            ShellVars::FrameScope frame(vars);
+            vars.declareLocal("arr");
+            vars.setArrayElement("arr", 0, "inner");
+            check("local array shadows the outer one", *vars.getArray("arr") == Values{ "inner" });
+        }
+        check("outer array restored after the frame", *vars.getArray("arr") == Values{ "outer" });
+    }
+
+    {
+        VariableStore vars;
+        vars.setArrayElement("arr", 0, "first");
+        const std::vector<std::string>* before = vars.getArray("arr");
+        vars.setArrayElement("arr", 0, "second");
+        check("unshared array is written in place", vars.getArray("arr") == before && (*before)[0] == "second");
+    }
+
+    {
+        // Filling an array element by element must stay linear: 200k writes would take
+        // minutes if every write copied the array
+        VariableStore vars;
+        const size_t n = 200000;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) vars.setArrayElement("big", i, std::to_string(i));
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        check("filling 200k elements in a loop is linear", secs < 2.0 && vars.getArray("big")->size() == n);
+    }
+
+    std::cout << (failures ? "FAILED: " + std::to_string(failures) + " case(s)\n" : "all passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+// g++ -std=c++17 main.cpp -o main.exe
+#ifndef LINUXIFY_TEXT_STREAM_HPP
+#define LINUXIFY_TEXT_STREAM_HPP
+
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <cstring>
+#include <algorithm>
+
+#include "mapped_file.hpp"
+
+// Chunked, incremental input for the text filters (grep, sort, uniq, cut, tr, sed, awk, rev...).
+// A LineReader hands out one line (or one chunk) at a time from a file, a pipe / stream, or an
+// in-memory buffer, so a filter never needs its whole input in memory before it starts.
+namespace TextStream {
+
+    // Byte source behind a LineReader
+    class Source {
+    public:
+        virtual ~Source() = default;
+        // Copies up to cap bytes into dst; returns 0 at end of input
+        virtual size_t read(char* dst, size_t cap) = 0;
+    };
+
+    // Raw Win32 handle: files, anonymous pipes, redirected stdin
+    class HandleSource : public Source {
+    private:
+        HANDLE handle;
+        bool owned;
+
+    public:
+        HandleSource(HANDLE h, bool own) : handle(h), owned(own) {}
+
+        ~HandleSource() override {
+            if (owned && handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        }
+
+        size_t read(char* dst, size_t cap) override {
+            DWORD n = 0;
+            if (handle == INVALID_HANDLE_VALUE || handle == NULL) return 0;
+            if (!ReadFile(handle, dst, (DWORD)cap, &n, NULL)) return 0;
+            return n;
+        }
+    };
+
+    // Any std::istream, e.g. an in-process pipeline channel
+    class StreamSource : public Source {
+    private:
+        std::istream& stream;
+
+    public:
+        explicit StreamSource(std::istream& is) : stream(is) {}
+
+        size_t read(char* dst, size_t cap) override {
+            stream.read(dst, (std::streamsize)cap);
+            return (size_t)stream.gcount();
+        }
+    };
+
+    class LineReader {
+    private:
+        std::unique_ptr<Source> source;
+        std::vector<char> buffer;
+        size_t begin = 0;        // first unread byte in buffer
+        size_t end = 0;          // one past the last valid byte in buffer
+        bool exhausted = false;  // source returned end of input
+
+        // In-memory mode: lines are views straight into the caller's buffer
+        bool inMemory = false;
+        const char* memData = nullptr;
+        size_t memSize = 0;
+        size_t memPos = 0;
+
+        bool opened = true;
+        MappedFile mapping;  // regular files: lines are views straight into the mapping
+
+        static std::string_view trimCR(const char* data, size_t len) {
+            if (len > 0 && data[len - 1] == '\r') len--;
+            return std::string_view(data, len);
+        }
+
+        // Pulls more bytes into the buffer, growing it when a single line outgrows it
+        bool refill() {
+            if (exhausted) return false;
+            size_t avail = end - begin;
+            if (begin > 0) {
+                if (avail > 0) std::memmove(buffer.data(), buffer.data() + begin, avail);
+                begin = 0;
+                end = avail;
+            }
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+            size_t n = source->read(buffer.data() + end, buffer.size() - end);
+            if (n == 0) {
+                exhausted = true;
+                return false;
+            }
+            end += n;
+            return true;
+        }
+
+    public:
+        static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+        // Reads an in-memory buffer without copying it; the buffer must outlive the reader
+        explicit LineReader(std::string_view data)
+            : inMemory(true), memData(data.data()), memSize(data.size()) {}
+
+        explicit LineReader(std::istream& is)
+            : source(std::make_unique<StreamSource>(is)), buffer(CHUNK_SIZE) {}
+
+        LineReader(HANDLE h, bool own)
+            : source(std::make_unique<HandleSource>(h, own)), buffer(CHUNK_SIZE) {}
+
+        LineReader(LineReader&&) = default;
+        LineReader& operator=(LineReader&&) = default;
+
+        // Regular files are memory-mapped; anything that cannot be mapped is read in chunks
+        static LineReader openFile(const std::string& path) {
+            MappedFile mapped(path);
+            if (mapped.isOpen()) {
+                LineReader reader(mapped.view());
+                reader.mapping = std::move(mapped);
+                return reader;
+            }
+
+            HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            LineReader reader(h, true);
+            reader.opened = (h != INVALID_HANDLE_VALUE);
+            return reader;
+        }
+
+        bool isOpen() const { return opened; }
+        bool isMapped() const { return mapping.isOpen(); }
+
+        // Next line without its terminator ("\n" or "\r\n").
+        // The view stays valid until the next call on this reader.
+        bool nextLine(std::string_view& line) {
+            if (inMemory) {
+                if (memPos >= memSize) return false;
+                const char* start = memData + memPos;
+                size_t avail = memSize - memPos;
+                const char* nl = (const char*)std::memchr(start, '\n', avail);
+                size_t len = nl ? (size_t)(nl - start) : avail;
+                memPos += nl ? len + 1 : len;
+                line = trimCR(start, len);
+                return true;
+            }
+
+            for (;;) {
+                const char* start = buffer.data() + begin;
+                size_t avail = end - begin;
+                const char* nl = avail ? (const char*)std::memchr(start, '\n', avail) : nullptr;
+                if (nl) {
+                    size_t len = (size_t)(nl - start);
+                    begin += len + 1;
+                    line = trimCR(start, len);
+                    return true;
+                }
+                if (!refill()) {
+                    avail = end - begin;
+                    if (avail == 0) return false;
+                    start = buffer.data() + begin;
+                    begin = end;
+                    line = trimCR(start, avail);
+                    return true;
+                }
+            }
+        }
+
+        bool nextLine(std::string& line) {
+            std::string_view view;
+            if (!nextLine(view)) return false;
+            line.assign(view.data(), view.size());
+            return true;
+        }
+
+        // Next raw chunk of bytes (no line splitting); false at end of input
+        bool nextChunk(std::string_view& chunk) {
+            if (inMemory) {
+                if (memPos >= memSize) return false;
+                size_t len = (std::min)(CHUNK_SIZE, memSize - memPos);
+                chunk = std::string_view(memData + memPos, len);
+                memPos += len;
+                return true;
+            }
+            if (begin == end && !refill()) return false;
+            chunk = std::string_view(buffer.data() + begin, end - begin);
+            begin = end;
+            return true;
+        }
+    };
+
+} // namespace TextStream
+
+#endif // LINUXIFY_TEXT_STREAM_HPP